@@ -0,0 +1,336 @@
+--
+-- benchmark of the decoders.
+--
+--  usage: lua bench/bench.lua [--json] [--time=<sec>] [--filter=<pattern>]
+--
+--  --json              emit the result of each case as a line of JSON.
+--  --time=<sec>        minimum measurement time of each case. (default: 0.5)
+--  --filter=<pattern>  run only the cases whose name matches the lua pattern.
+--
+local DIR = string.match(arg[0], '^(.*[/\\])') or './'
+package.path = DIR .. '?.lua;' .. package.path
+
+local corpus = require('corpus')
+local clock = os.clock
+local format = string.format
+local concat = table.concat
+
+local decode = {}
+for _, name in ipairs({
+    'array',
+    'bit',
+    'bool',
+    'box',
+    'bytea',
+    'circle',
+    'copy',
+    'copy_binary',
+    'copyfile',
+    'date',
+    'float',
+    'hstore',
+    'inet',
+    'int',
+    'json',
+    'line',
+    'lseg',
+    'macaddr',
+    'multirange',
+    'path',
+    'point',
+    'polygon',
+    'range',
+    'record',
+    'stream',
+    'time',
+    'timestamp',
+    'tsvector',
+    'uuid',
+    'uuid_array',
+}) do
+    decode[name] = require('postgres.decode.' .. name)
+end
+local registry = require('postgres.decode')
+
+-- parse options
+local OPTS = {
+    json = false,
+    time = 0.5,
+}
+for _, v in ipairs(arg) do
+    if v == '--json' then
+        OPTS.json = true
+    elseif string.find(v, '^%-%-time=') then
+        OPTS.time = assert(tonumber(string.sub(v, 8)), 'invalid --time value')
+    elseif string.find(v, '^%-%-filter=') then
+        OPTS.filter = string.sub(v, 10)
+    else
+        error(format('unknown option %q', v))
+    end
+end
+
+local CASES = {}
+
+--- add adds the benchmark case
+--- @param name string
+--- @param str string input data
+--- @param nvalue integer number of the values in the input data
+--- @param fn function function that decodes the input data
+local function add(name, str, nvalue, fn)
+    CASES[#CASES + 1] = {
+        name = name,
+        nbyte = #str,
+        nvalue = nvalue,
+        fn = fn,
+    }
+end
+
+--- add_simple adds the benchmark case of the function that takes the input
+--- data as the first argument
+local function add_simple(name, str, nvalue, fn, ...)
+    local a, b, c = ...
+    add(name, str, nvalue, function()
+        return fn(str, a, b, c)
+    end)
+end
+
+corpus.reset()
+-- scalar types
+add_simple('int', '-1234567890', 1, decode.int)
+add_simple('float', '-12345.678901e-3', 1, decode.float)
+add_simple('bool', 't', 1, decode.bool)
+add_simple('bytea/1KB', '\\x' .. corpus.hex(1024), 1, decode.bytea)
+add_simple('bit/1024', corpus.bits(1024), 1, decode.bit)
+add_simple('uuid', corpus.uuid(), 1, decode.uuid)
+add_simple('inet/ipv4', '192.168.100.128/25', 1, decode.inet)
+add_simple('inet/ipv6', '2001:db8:85a3::8a2e:370:7334/64', 1, decode.inet)
+add_simple('macaddr', '08:00:2b:01:02:03', 1, decode.macaddr)
+-- datetime types of every DateStyle
+add_simple('date/iso', '1999-12-31', 1, decode.date)
+add_simple('date/german', '31.12.1999', 1, decode.date)
+add_simple('date/sql', '12/31/1999', 1, decode.date)
+add_simple('date/sql-dmy', '31/12/1999', 1, decode.date, true)
+add_simple('date/postgres', '12-31-1999', 1, decode.date)
+add_simple('time', '23:59:59.123456', 1, decode.time)
+add_simple('time/tz', '23:59:59.123456+09:30', 1, decode.time)
+add_simple('timestamp', '1999-12-31 23:59:59', 1, decode.timestamp)
+add_simple('timestamp/usec', '1999-12-31 23:59:59.123456', 1,
+           decode.timestamp)
+add_simple('timestamp/tz', '1999-12-31 23:59:59.123456+09:30:15', 1,
+           decode.timestamp)
+-- geometric types
+add_simple('point', '(10.5,-5.25)', 1, decode.point)
+add_simple('line', '{1.5,-2.5,3.25}', 1, decode.line)
+add_simple('lseg', '[(10.5,5.5),(20.5,15.5)]', 1, decode.lseg)
+add_simple('box', '(20.5,15.5),(10.5,5.5)', 1, decode.box)
+add_simple('circle', '<(10.5,5.5),3.25>', 1, decode.circle)
+add_simple('path/1000', '[' .. corpus.points(1000) .. ']', 1000, decode.path)
+add_simple('polygon/1000', '(' .. corpus.points(1000) .. ')', 1000,
+           decode.polygon)
+-- container types
+add_simple('array/int/1000', corpus.int_array(1000), 1000, decode.array,
+           decode.int)
+add_simple('array/float/1000', corpus.float_array(1000), 1000, decode.array,
+           decode.float)
+add_simple('array/nested/10x100', corpus.nested_array(10, 100), 1000,
+           decode.array, decode.int)
+add_simple('array/text/1000', corpus.text_array(1000), 1000, decode.array,
+           function(elm)
+    return elm
+end)
+add_simple('uuid_array/100', corpus.uuid_array(100), 100, decode.uuid_array)
+add_simple('hstore/1000', corpus.hstore(1000), 1000, decode.hstore)
+add_simple('tsvector/1000', corpus.tsvector(1000), 1000, decode.tsvector)
+add_simple('json/100', corpus.json(100), 100 * 7, decode.json)
+add_simple('record', '(1,"foo bar",t,1999-12-31,)', 5, decode.record, {
+    'int',
+    nil,
+    'bool',
+    'date',
+})
+add_simple('range', '[-1234567890,1234567890)', 2, decode.range, decode.int)
+add_simple('multirange/100', corpus.multirange(100), 200, decode.multirange,
+           decode.int)
+-- dispatch by the type oid
+do
+    local str = corpus.int_array(1000)
+    add('decode/int4[]/1000', str, 1000, function()
+        return registry.decode(1007, str)
+    end)
+end
+-- streaming decoders
+do
+    local str = corpus.int_array(1000)
+    add('stream/array/1000', str, 1000, function()
+        local s = decode.stream('array', decode.int)
+        for i = 1, #str, 256 do
+            s:feed(string.sub(str, i, i + 255))
+        end
+        return s:finish()
+    end)
+end
+do
+    local str = corpus.copy_text(1000)
+    local decoders = {
+        'int',
+        nil,
+        'float',
+        'date',
+    }
+    add('copy/1000x4', str, 4000, function()
+        local c = decode.copy(decoders)
+        local rows, err = c:feed(str)
+        if rows then
+            rows, err = c:finish()
+        end
+        return rows, err
+    end)
+end
+do
+    local str = corpus.copy_binary(1000)
+    local decoders = {
+        'int4',
+        'text',
+        'int4',
+    }
+    add('copy_binary/1000x3', str, 3000, function()
+        local c = decode.copy_binary(decoders)
+        local rows, err = c:feed(str)
+        if rows then
+            rows, err = c:finish()
+        end
+        return rows, err
+    end)
+end
+local COPYFILE = os.tmpname()
+do
+    local str = corpus.copy_text(1000)
+    local f = assert(io.open(COPYFILE, 'w'))
+    f:write(str)
+    f:close()
+    local decoders = {
+        'int',
+        nil,
+        'float',
+        'date',
+    }
+    add('copyfile/1000x4', str, 4000, function()
+        local cf, err = decode.copyfile(COPYFILE, decoders)
+        if not cf then
+            return nil, err
+        end
+        for i = 1, cf:nrow() do
+            local row
+            row, err = cf:row(i)
+            if not row then
+                cf:close()
+                return nil, err
+            end
+        end
+        cf:close()
+        return true
+    end)
+end
+
+--- measure measures the elapsed time and the allocated memory of the case
+--- @param c table
+--- @return table result
+local function measure(c)
+    local fn = c.fn
+
+    -- verify that the case decodes the input data
+    local v, err = fn()
+    if v == nil then
+        error(format('%s: %s', c.name, tostring(err)))
+    end
+
+    -- measure the allocated memory while the garbage collector is stopped
+    local nalloc = 100
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local before = collectgarbage('count')
+    for _ = 1, nalloc do
+        fn()
+    end
+    local alloc = (collectgarbage('count') - before) * 1024 / nalloc
+    collectgarbage('restart')
+    collectgarbage('collect')
+
+    -- double the number of iterations until it takes the minimum time
+    local niter = 1
+    local elapsed = 0
+    while true do
+        local t = clock()
+        for _ = 1, niter do
+            fn()
+        end
+        elapsed = clock() - t
+        if elapsed >= OPTS.time then
+            break
+        end
+        niter = niter * 2
+    end
+
+    return {
+        name = c.name,
+        iterations = niter,
+        nvalue = c.nvalue,
+        nbyte = c.nbyte,
+        ns_per_value = elapsed * 1e9 / (niter * c.nvalue),
+        ns_per_call = elapsed * 1e9 / niter,
+        mb_per_sec = c.nbyte * niter / elapsed / 1e6,
+        alloc_bytes_per_call = alloc,
+    }
+end
+
+local FIELDS = {
+    'name',
+    'iterations',
+    'nvalue',
+    'nbyte',
+    'ns_per_value',
+    'ns_per_call',
+    'mb_per_sec',
+    'alloc_bytes_per_call',
+}
+local VERSION = _VERSION
+if type(jit) == 'table' then
+    VERSION = jit.version
+end
+
+local function tojson(res)
+    local buf = {
+        format('"lua":%q', VERSION),
+    }
+    for _, k in ipairs(FIELDS) do
+        local v = res[k]
+        if type(v) == 'string' then
+            buf[#buf + 1] = format('"%s":%q', k, v)
+        elseif math.floor(v) == v then
+            buf[#buf + 1] = format('"%s":%d', k, v)
+        else
+            buf[#buf + 1] = format('"%s":%.3f', k, v)
+        end
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+if not OPTS.json then
+    print(VERSION)
+    print(format('%-24s %12s %12s %10s %14s', 'name', 'ns/value',
+                 'ns/call', 'MB/s', 'alloc B/call'))
+end
+for _, c in ipairs(CASES) do
+    if not OPTS.filter or string.find(c.name, OPTS.filter) then
+        local res = measure(c)
+        if OPTS.json then
+            print(tojson(res))
+        else
+            print(format('%-24s %12.1f %12.1f %10.2f %14.1f', res.name,
+                         res.ns_per_value, res.ns_per_call, res.mb_per_sec,
+                         res.alloc_bytes_per_call))
+        end
+        io.stdout:flush()
+    end
+end
+os.remove(COPYFILE)
@@ -0,0 +1,248 @@
+--
+-- generate representative inputs of the decoders.
+-- the inputs are generated by the own pseudo random number generator, so the
+-- same corpus is generated on every lua version.
+--
+local concat = table.concat
+local format = string.format
+local char = string.char
+local floor = math.floor
+
+local SEED = 20221001
+local state = SEED
+
+--- random returns a pseudo random integer in the range [m, n].
+--- the range must be smaller than 2^31-1.
+--- @param m integer
+--- @param n integer
+--- @return integer
+local function random(m, n)
+    -- minimal standard generator. the product never exceeds 2^53, so that
+    -- it is exact in the lua 5.1 number type.
+    state = (state * 48271) % 2147483647
+    return m + state % (n - m + 1)
+end
+
+--- reset resets the seed of the random number generator
+local function reset()
+    state = SEED
+end
+
+local function int_str()
+    local v = random(0, 2147483646)
+    if random(0, 1) == 1 then
+        v = -v
+    end
+    return tostring(v)
+end
+
+local function float_str()
+    return format('%.6g', (random(-1000000, 1000000) / random(1, 1000)))
+end
+
+local function word(minlen, maxlen)
+    local buf = {}
+    for i = 1, random(minlen, maxlen) do
+        buf[i] = char(random(97, 122))
+    end
+    return concat(buf)
+end
+
+local function points(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = format('(%s,%s)', float_str(), float_str())
+    end
+    return concat(buf, ',')
+end
+
+local function int_array(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = int_str()
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+local function float_array(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = float_str()
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+local function nested_array(n, m)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = int_array(m)
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+local function text_array(n)
+    local buf = {}
+    for i = 1, n do
+        if i % 10 == 0 then
+            buf[i] = 'NULL'
+        elseif i % 3 == 0 then
+            -- quoted element that contains the spaces and escapes
+            buf[i] = format('"%s \\"%s\\""', word(4, 16), word(4, 16))
+        else
+            buf[i] = word(4, 16)
+        end
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+local function hstore(n)
+    local buf = {}
+    for i = 1, n do
+        if i % 10 == 0 then
+            buf[i] = format('"key%d"=>NULL', i)
+        else
+            buf[i] = format('"key%d"=>"%s"', i, word(4, 32))
+        end
+    end
+    return concat(buf, ', ')
+end
+
+local function tsvector(n)
+    local buf = {}
+    for i = 1, n do
+        local pos = {}
+        for j = 1, random(1, 4) do
+            pos[j] = tostring(random(1, 16383)) .. char(random(65, 68))
+        end
+        buf[i] = format("'%s%d':%s", word(3, 12), i, concat(pos, ','))
+    end
+    return concat(buf, ' ')
+end
+
+local function bits(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = random(0, 1) == 0 and '0' or '1'
+    end
+    return concat(buf)
+end
+
+local function hex(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = format('%02x', random(0, 255))
+    end
+    return concat(buf)
+end
+
+local function uuid()
+    local s = hex(16)
+    return concat({
+        s:sub(1, 8),
+        s:sub(9, 12),
+        s:sub(13, 16),
+        s:sub(17, 20),
+        s:sub(21, 32),
+    }, '-')
+end
+
+local function uuid_array(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = uuid()
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+local function json(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = format(
+                     '{"id":%d,"name":"%s","score":%s,"tags":["%s","%s"],"active":%s,"note":null}',
+                     i, word(4, 16), float_str(), word(3, 8), word(3, 8),
+                     random(0, 1) == 0 and 'false' or 'true')
+    end
+    return '[' .. concat(buf, ',') .. ']'
+end
+
+local function multirange(n)
+    local buf = {}
+    local v = 0
+    for i = 1, n do
+        local lower = v + random(1, 100)
+        v = lower + random(1, 100)
+        buf[i] = format('[%d,%d)', lower, v)
+    end
+    return '{' .. concat(buf, ',') .. '}'
+end
+
+local function copy_text(n)
+    local buf = {}
+    for i = 1, n do
+        buf[i] = concat({
+            tostring(i),
+            word(4, 16) .. '\\t' .. word(4, 16),
+            i % 10 == 0 and '\\N' or float_str(),
+            '1999-12-31',
+        }, '\t')
+    end
+    buf[n + 1] = '\\.'
+    buf[n + 2] = ''
+    return concat(buf, '\n')
+end
+
+--- int16/int32 encode the integer as a big-endian string
+local function int16(v)
+    v = v % 65536
+    return char(floor(v / 256), v % 256)
+end
+
+local function int32(v)
+    v = v % 4294967296
+    return char(floor(v / 16777216), floor(v / 65536) % 256,
+                floor(v / 256) % 256, v % 256)
+end
+
+local function copy_binary(n)
+    local buf = {
+        'PGCOPY\n\255\r\n\0',
+        int32(0),
+        int32(0),
+    }
+    for i = 1, n do
+        local text = word(4, 32)
+        buf[#buf + 1] = concat({
+            int16(3),
+            int32(4),
+            int32(i),
+            int32(#text),
+            text,
+            int32(-1),
+        })
+    end
+    buf[#buf + 1] = int16(-1)
+    return concat(buf)
+end
+
+return {
+    reset = reset,
+    random = random,
+    int_str = int_str,
+    float_str = float_str,
+    word = word,
+    points = points,
+    int_array = int_array,
+    float_array = float_array,
+    nested_array = nested_array,
+    text_array = text_array,
+    hstore = hstore,
+    tsvector = tsvector,
+    bits = bits,
+    hex = hex,
+    uuid = uuid,
+    uuid_array = uuid_array,
+    json = json,
+    multirange = multirange,
+    copy_text = copy_text,
+    copy_binary = copy_binary,
+}
@@ -20,9 +20,13 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode.h"
+#include "lua_postgres_decode_dict.h"
+#include "lua_postgres_decode_limits.h"
+#include "lua_postgres_decode_yield.h"
+#include "pgdec/pgdec_array.h"
 
-#define MAX_ARRAY_DEPTH 64
+// stack index of the arena
+#define ARRAY_ARENA 6
 
 static void decode_array_item(lua_State *L, const char *token, size_t len)
 {
@@ -31,155 +35,374 @@ static void decode_array_item(lua_State *L, const char *token, size_t len)
     lua_pushlstring(L, token, len);
     lua_pushboolean(L, *token == '"');
     lua_pushvalue(L, 3); // passed arg
-    lua_call(L, 3, 2);
+    decode_arena_call(L, lua_upvalueindex(1), ARRAY_ARENA, 3, 2);
 }
 
-static int decode_array_lua(lua_State *L)
+/**
+ * @brief decode_array_dict_item
+ *  push the code of the element in the dictionary. the quoted element is
+ *  unquoted and unescaped before it is encoded.
+ * @return int 0 on success, otherwise -1 and errno is set.
+ */
+static int decode_array_dict_item(lua_State *L, dict_t *d, const char *token,
+                                  size_t len)
 {
-    static const char *op           = "postgres.decode.array";
-    size_t len                      = 0;
-    char *src                       = (char *)lauxh_checklstring(L, 1, &len);
-    char *str                       = src;
-    char delim                      = ',';
-    int depth                       = 0;
-    int arrlen[MAX_ARRAY_DEPTH + 1] = {0};
-    const char *token               = NULL;
-    size_t token_len                = 0;
-
-    luaL_checktype(L, 2, LUA_TFUNCTION);
-    if (lua_gettop(L) < 3) {
-        lua_pushnil(L);
-    } else if (lua_gettop(L) > 3) {
-        size_t delim_len = 0;
-        char *delim_str  = (char *)lauxh_optlstring(L, 4, ",", &delim_len);
-        if (delim_len != 1) {
-            return decode_error(L, op, EINVAL,
-                                "delimiter must be a single character");
+    char buf[256];
+    char *str        = buf;
+    size_t n         = 0;
+    lua_Integer code = 0;
+
+    if (*token != '"') {
+        code = decode_dict_encode(L, d, token, len);
+    } else if (!memchr(token + 1, '\\', len - 2)) {
+        code = decode_dict_encode(L, d, token + 1, len - 2);
+    } else {
+        const char *p   = token + 1;
+        const char *end = token + len - 1;
+
+        if (len > sizeof(buf) && !(str = malloc(len))) {
+            return -1;
         }
-        delim = *delim_str;
+        // the token contains at least one escaped character, and the closing
+        // quotation is never escaped
+        do {
+            if (*p == '\\') {
+                p++;
+            }
+            str[n++] = *p++;
+        } while (p < end);
+        code = decode_dict_encode(L, d, str, n);
+        if (str != buf) {
+            free(str);
+        }
+    }
+
+    if (code < 0) {
+        return -1;
+    }
+    lua_pushinteger(L, code);
+    return 0;
+}
+
+// the array string is decoded in two phases. the first phase parses the
+// whole string into the nodes in the arena, and the second phase builds the
+// tables of the exact sizes only after the string is validated.
+
+enum {
+    ARRAY_NODE_ARRAY = 0,
+    ARRAY_NODE_ELEM,
+    ARRAY_NODE_NULL,
+};
+
+typedef struct {
+    int kind;
+    // number of the elements of the array node
+    size_t n;
+    // offset and length of the element from the head of the string
+    size_t off;
+    size_t len;
+} array_node_t;
+
+typedef struct {
+    decode_arena_t *arena;
+    const char *src;
+    size_t nnode;
+    // index of the array node of each depth
+    size_t parents[PGDEC_ARRAY_MAXDEPTH + 1];
+    decode_quota_t quota;
+} array_ctx_t;
+
+static int array_push_node(array_ctx_t *c, int kind, const char *token,
+                           size_t len)
+{
+    array_node_t *node = decode_arena_alloc(c->arena, sizeof(array_node_t));
+
+    if (!node) {
+        return -1;
     }
+    *node = (array_node_t){
+        .kind = kind,
+        .off  = token ? (size_t)(token - c->src) : 0,
+        .len  = len,
+    };
+    c->nnode++;
+    return 0;
+}
 
-    lua_settop(L, 3);
-    lua_newtable(L);
+static int array_open(void *ctx, int depth, size_t idx)
+{
+    array_ctx_t *c = (array_ctx_t *)ctx;
 
-    // skip spaces
-    str = decode_skip_space(str);
-    if (!*str) {
-        return decode_error(L, op, EINVAL, "empty string");
-    } else if (*str != '{') {
-        return decode_error(L, op, EILSEQ, "opening curly bracket not found");
+    (void)idx;
+    // the nested array is counted as the element of the parent array
+    if (decode_quota_depth(&c->quota, depth) ||
+        decode_quota_add(&c->quota, depth > 1,
+                         DECODE_SIZEOF_TABLE +
+                             (depth > 1 ? DECODE_SIZEOF_SLOT : 0))) {
+        return -1;
     }
-    str = decode_skip_space(str + 1);
-    depth++;
-    arrlen[depth] = 0;
-
-NEXT_ELEMENT:
-    switch (*str) {
-    case 0:
-        return decode_error(L, op, EILSEQ, "malformed array string");
-
-    case '{':
-        // found nested array
-        depth++;
-        if (depth > MAX_ARRAY_DEPTH || !lua_checkstack(L, 1)) {
-            return decode_error(L, op, EILSEQ, "nesting level %d/%d too deep",
-                                depth, MAX_ARRAY_DEPTH);
+    c->parents[depth] = c->nnode;
+    return array_push_node(c, ARRAY_NODE_ARRAY, NULL, 0);
+}
+
+static int array_close(void *ctx, int depth, size_t idx, size_t nelem)
+{
+    array_ctx_t *c     = (array_ctx_t *)ctx;
+    array_node_t *node = decode_arena_at(c->arena, sizeof(array_node_t),
+                                         c->parents[depth]);
+
+    (void)idx;
+    node->n = nelem;
+    return 0;
+}
+
+static int array_elem(void *ctx, int depth, size_t idx, const char *token,
+                      size_t len)
+{
+    array_ctx_t *c = (array_ctx_t *)ctx;
+
+    (void)depth;
+    (void)idx;
+    if (decode_quota_add(&c->quota, 1, DECODE_SIZEOF_SLOT) ||
+        (token && decode_quota_string(&c->quota, len))) {
+        return -1;
+    }
+    return array_push_node(c, token ? ARRAY_NODE_ELEM : ARRAY_NODE_NULL,
+                           token, len);
+}
+
+static const pgdec_array_visitor_t ARRAY_VISITOR = {
+    array_open,
+    array_close,
+    array_elem,
+};
+
+/**
+ * @brief decode_array_value
+ *  push the value of the element that decoded by the dictionary or the
+ *  function.
+ * @return int 0 on success, or -1 on error, when error then nil and error
+ * are pushed.
+ */
+static int decode_array_value(lua_State *L, const char *op, dict_t *dict,
+                              const char *token, size_t len)
+{
+    if (dict) {
+        // encode the element by the dictionary
+        if (decode_array_dict_item(L, dict, token, len)) {
+            decode_error(L, op, errno, NULL);
+            return -1;
         }
-        arrlen[depth] = 0;
-        lua_newtable(L);
-        str = decode_skip_space(str + 1);
-        goto NEXT_ELEMENT;
-
-    case '}':
-        // found end of array
-        depth--;
-        str = decode_skip_space(str + 1);
-        if (depth) {
-            // end of nested array
-            arrlen[depth]++;
-            lua_rawseti(L, -2, arrlen[depth]);
-            if (*str == delim) {
-                // skip comma
-                str = decode_skip_space(str + 1);
+        return 0;
+    }
+
+    // call function
+    decode_array_item(L, token, len);
+    // check for error
+    if (!lua_isnil(L, -1)) {
+        decode_error(L, op, EILSEQ, lua_tostring(L, -1));
+        return -1;
+    }
+    lua_pop(L, 1);
+    return 0;
+}
+
+// the array tables are placed on the stack from the outermost to the
+// innermost while they are built.
+typedef struct {
+    // index of the array node
+    size_t node;
+    // index of the next element
+    size_t k;
+} array_frame_t;
+
+// state of the second phase that is kept in the arena to resume it
+typedef struct {
+    decode_yield_t y;
+    const char *op;
+    const char *src;
+    dict_t *dict;
+    int reuse;
+    int depth;
+    // index of the last built node
+    size_t i;
+    array_frame_t frames[PGDEC_ARRAY_MAXDEPTH + 1];
+} array_build_t;
+
+/**
+ * @brief decode_array_build
+ *  set the elements of the nodes to the tables on the stack. if reuse is
+ *  not 0, the nested tables of the tables are reused.
+ * @return int 0 on success, 1 if the current step is exhausted, or -1 on
+ * error, when error then nil and error are pushed.
+ */
+static int decode_array_build(lua_State *L, decode_arena_t *a,
+                              array_build_t *b)
+{
+    array_node_t *nodes = decode_arena_at(a, sizeof(array_node_t), 0);
+
+    for (;;) {
+        array_frame_t *f   = b->frames + b->depth;
+        array_node_t *node = nodes + f->node;
+
+        if (f->k > node->n) {
+            // all elements of the array are built
+            if (b->reuse) {
+                decode_trimtable(L, (int)node->n);
             }
-            goto NEXT_ELEMENT;
-        }
-        // end of array
-        if (*str) {
-            return decode_error_at(L, op, EILSEQ, src, str);
-        }
-        lua_settop(L, 4);
-        return 1;
-
-    case '"':
-        // found quoted value
-        token = str;
-        str++;
-        // search closing quotation
-        while (*str != '"') {
-            if (!*str) {
-                return decode_error(L, op, EILSEQ,
-                                    "closing quotation not found");
-            } else if (*str == '\\') {
-                // skip escaped character
-                str++;
+            if (b->depth == 1) {
+                return 0;
             }
-            str++;
-        }
-        str++;
-        token_len = str - token;
-        break;
-
-    default:
-        if (*str == delim) {
-            // empty elements are not allowed
-            return decode_error(L, op, EILSEQ,
-                                "empty elements are not allowed");
+            f = b->frames + --b->depth;
+            lua_rawseti(L, -2, (int)f->k++);
+            continue;
         }
 
-        // found unquoted value
-        token = str;
-        while (*str != ' ' && *str != delim && *str != '}') {
-            if (!*str) {
-                return decode_error(L, op, EILSEQ, "malformed array string");
+        node = nodes + ++b->i;
+        if (node->kind == ARRAY_NODE_ARRAY) {
+            if (!lua_checkstack(L, 5)) {
+                decode_error(L, b->op, EILSEQ, "nesting level %d/%d too deep",
+                             b->depth + 1, PGDEC_ARRAY_MAXDEPTH);
+                return -1;
+            }
+            decode_subtable(L, (int)f->k, (int)node->n, 0, 1);
+            b->frames[++b->depth] = (array_frame_t){b->i, 1};
+        } else {
+            if (node->kind == ARRAY_NODE_NULL) {
+                lua_pushnil(L);
+            } else if (decode_array_value(L, b->op, b->dict,
+                                          b->src + node->off, node->len)) {
+                return -1;
             }
-            str++;
+            lua_rawseti(L, -2, (int)f->k++);
         }
-        token_len = str - token;
-        // check for NULL
-        if (token_len == 4 && strncasecmp(token, "NULL", token_len) == 0) {
-            arrlen[depth]++;
-            lua_pushnil(L);
-            lua_rawseti(L, -2, arrlen[depth]);
-            goto CHECK_DELIMITER;
+        if (decode_yield_tick(&b->y)) {
+            return 1;
         }
-        break;
     }
+}
 
-    // call function
-    decode_array_item(L, token, token_len);
-    // check for error
-    if (!lua_isnil(L, -1)) {
-        return decode_error(L, op, EILSEQ, lua_tostring(L, -1));
+static int decode_array_continue(lua_State *L, size_t off);
+
+#if LUA_VERSION_NUM >= 503
+static int decode_array_resume(lua_State *L, int status, lua_KContext ctx)
+{
+    (void)status;
+    decode_yield_state(L, ARRAY_ARENA, (size_t)ctx);
+    return decode_array_continue(L, (size_t)ctx);
+}
+#endif
+
+/**
+ * @brief decode_array_continue
+ *  build the tables from the state at the offset off in the arena, and
+ *  release the arena when it is done.
+ */
+static int decode_array_continue(lua_State *L, size_t off)
+{
+    decode_arena_t *a = lua_touserdata(L, ARRAY_ARENA);
+    array_build_t *b  = (array_build_t *)(a->buf + off);
+    int rv            = decode_array_build(L, a, b);
+
+#if LUA_VERSION_NUM >= 503
+    if (rv > 0) {
+        return decode_yield(L, lua_upvalueindex(1), ARRAY_ARENA, &b->y, off,
+                            decode_array_resume);
     }
-    lua_pop(L, 1);
-    arrlen[depth]++;
-    lua_rawseti(L, -2, arrlen[depth]);
-
-CHECK_DELIMITER:
-    // next delimiter must be delim or '}'
-    str = decode_skip_space(str);
-    if (*str == delim) {
-        str = decode_skip_space(str + 1);
-    } else if (*str != '}') {
-        return decode_error_at(L, op, EILSEQ, src, str);
+#endif
+    decode_arena_leave(L, lua_upvalueindex(1), a);
+    return rv ? lua_gettop(L) : 1;
+}
+
+/**
+ * @brief decode_array_parse
+ *  parse the array string into the arena, and push the table to build.
+ * @return int 0 on success and the offset of the build state is stored to
+ * *off, otherwise the number of the pushed error values.
+ */
+static int decode_array_parse(lua_State *L, const char *op, char *str,
+                              size_t len, char delim, dict_t *dict,
+                              decode_arena_t *a, size_t *off)
+{
+    array_ctx_t ctx     = {.arena = a, .src = str};
+    pgdec_error_t err   = {0};
+    array_node_t *nodes = NULL;
+    array_build_t *b    = NULL;
+
+    // phase 1: parse the whole string into the arena
+    decode_quota_start(L, &ctx.quota);
+    if (decode_array_scan(str, len, delim, &ARRAY_VISITOR, &ctx, &err)) {
+        if (err.errnum != ECANCELED) {
+            return decode_error_from(L, op, &err);
+        } else if (ctx.quota.err.errnum) {
+            // exceeded the limit
+            return decode_error_from(L, op, &ctx.quota.err);
+        }
+        // failed to allocate the node
+        return decode_error(L, op, ENOMEM, NULL);
+    } else if (!(b = decode_arena_alloc_state(a, sizeof(array_build_t),
+                                              off))) {
+        return decode_error(L, op, ENOMEM, NULL);
+    }
+
+    // phase 2: build the tables of the exact sizes
+    *b = (array_build_t){
+        .op     = op,
+        .src    = str,
+        .dict   = dict,
+        .reuse  = lua_type(L, 5) == LUA_TTABLE,
+        .depth  = 1,
+        .frames = {[1] = {0, 1}},
+    };
+    decode_yield_init(L, &b->y);
+    nodes = decode_arena_at(a, sizeof(array_node_t), 0);
+    decode_table(L, 5, (int)nodes->n, 0, 1);
+    return 0;
+}
+
+static int decode_array_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.array";
+    size_t len            = 0;
+    char *str             = (char *)lauxh_checklstring(L, 1, &len);
+    char delim            = ',';
+    dict_t *dict          = NULL;
+    decode_arena_t *a     = NULL;
+    size_t off            = 0;
+    int rv                = 0;
+
+    if (lua_type(L, 2) == LUA_TUSERDATA) {
+        dict = decode_dict_check(L, 2);
+    } else {
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+    }
+    if (lua_gettop(L) < 3) {
+        lua_pushnil(L);
+    } else if (lua_gettop(L) > 3) {
+        size_t delim_len = 0;
+        char *delim_str  = (char *)lauxh_optlstring(L, 4, ",", &delim_len);
+        if (delim_len != 1) {
+            return decode_error(L, op, EINVAL,
+                                "delimiter must be a single character");
+        }
+        delim = *delim_str;
+    }
+
+    lua_settop(L, 5);
+    a = decode_arena_enter(L, lua_upvalueindex(1));
+    if ((rv = decode_array_parse(L, op, str, len, delim, dict, a, &off))) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        return rv;
     }
-    goto NEXT_ELEMENT;
+    return decode_array_continue(L, off);
 }
 
 LUALIB_API int luaopen_postgres_decode_array(lua_State *L)
 {
     lua_errno_loadlib(L);
-    lua_pushcfunction(L, decode_array_lua);
+    // arena to parse the array string
+    decode_arena_new(L);
+    lua_pushcclosure(L, decode_array_lua, 1);
+    DECODE_STATS_WRAP(L, "postgres.decode.array", NULL);
     return 1;
 }
@@ -32,12 +32,12 @@ static int decode_bit_lua(lua_State *L)
     const char *str       = lauxh_checklstring(L, 1, &len);
     size_t blen           = (len + 7) / 8;
 
-    lua_settop(L, 1);
+    lua_settop(L, 2);
     if (!len) {
         return decode_error(L, op, EINVAL, "empty string");
     }
 
-    lua_createtable(L, blen, 0);
+    decode_table(L, 2, blen, 0, 0);
     for (size_t i = 0; i < blen; i++) {
         unsigned char c = 0;
         for (size_t j = 0; j < 8; j++) {
@@ -66,5 +66,6 @@ LUALIB_API int luaopen_postgres_decode_bit(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_bit_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.bit", NULL);
     return 1;
 }
@@ -20,7 +20,7 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode.h"
+#include "lua_postgres_decode_scalar.h"
 
 // 8.6. Boolean Type
 // https://www.postgresql.org/docs/current/datatype-boolean.html
@@ -31,24 +31,13 @@ static int decode_bool_lua(lua_State *L)
     size_t len            = 0;
     const char *str       = lauxh_checklstring(L, 1, &len);
     int boolv             = 0;
+    pgdec_error_t err     = {0};
 
     lua_settop(L, 1);
-    if (len > 1) {
-        return decode_error_at(L, op, EILSEQ, str, str + 1);
+    if (decode_bool(&boolv, &err, str, len)) {
+        return decode_error_from(L, op, &err);
     }
 
-    // boolean: t or f
-    DECODE_START(L, op, str, len);
-    switch (*str) {
-    case 't':
-        boolv = 1;
-    case 'f':
-        break;
-    default:
-        return decode_error_at(L, op, EILSEQ, str, str);
-    }
-    DECODE_END(str + 1);
-
     lua_pushboolean(L, boolv);
     return 1;
 }
@@ -57,5 +46,6 @@ LUALIB_API int luaopen_postgres_decode_bool(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_bool_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.bool", NULL);
     return 1;
 }
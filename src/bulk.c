@@ -0,0 +1,403 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <pthread.h>
+#include <unistd.h>
+// lua
+#include "lua_postgres_decode.h"
+
+// the strings are parsed by the core decoders on the worker threads, and the
+// decoded values are pushed to the lua table on the calling thread.
+
+// maximum number of the worker threads
+#define BULK_MAX_THREADS 64
+// number of the rows that are parsed at once
+#define BULK_BATCH       65536
+// minimum number of the rows that are parsed by a thread
+#define BULK_MIN_ROWS    4096
+
+enum {
+    BULK_INT = 0,
+    BULK_FLOAT,
+    BULK_BOOL,
+    BULK_DATE,
+    BULK_TIME,
+    BULK_TIMESTAMP,
+    BULK_POINT,
+    BULK_LINE,
+    BULK_LSEG,
+    BULK_BOX,
+    BULK_CIRCLE,
+};
+
+static const char *const BULK_TYPES[] = {
+    "int",
+    "float",
+    "bool",
+    "date",
+    "time",
+    "timestamp",
+    "point",
+    "line",
+    "lseg",
+    "box",
+    "circle",
+    NULL,
+};
+
+static const char *const BULK_OPS[] = {
+    "postgres.decode.int",
+    "postgres.decode.float",
+    "postgres.decode.bool",
+    "postgres.decode.date",
+    "postgres.decode.time",
+    "postgres.decode.timestamp",
+    "postgres.decode.point",
+    "postgres.decode.line",
+    "postgres.decode.lseg",
+    "postgres.decode.box",
+    "postgres.decode.circle",
+};
+
+typedef struct {
+    const char *str; // NULL if the value is NULL
+    size_t len;
+} bulk_input_t;
+
+typedef union {
+    int64_t i;
+    double f;
+    int b;
+    pgdec_timestamp_t ts;
+    pgdec_point_t point;
+    pgdec_line_t line;
+    pgdec_lseg_t lseg;
+    pgdec_circle_t circle;
+} bulk_value_t;
+
+typedef struct {
+    int type;
+    const bulk_input_t *in;
+    bulk_value_t *out;
+    // rows in [head, tail) are parsed
+    size_t head;
+    size_t tail;
+    // row of the error, or tail if no error
+    size_t errrow;
+    pgdec_error_t err;
+} bulk_task_t;
+
+static inline int bulk_parse(int type, const bulk_input_t *in,
+                             bulk_value_t *v, pgdec_error_t *err)
+{
+    switch (type) {
+    case BULK_INT:
+        return pgdec_int(in->str, in->len, &v->i, err);
+    case BULK_FLOAT:
+        return pgdec_float(in->str, in->len, &v->f, err);
+    case BULK_BOOL:
+        return pgdec_bool(in->str, in->len, &v->b, err);
+    case BULK_DATE:
+        return pgdec_date(in->str, in->len, 0, &v->ts, err);
+    case BULK_TIME:
+        return pgdec_time(in->str, in->len, &v->ts, err);
+    case BULK_TIMESTAMP:
+        return pgdec_timestamp(in->str, in->len, &v->ts, err);
+    case BULK_POINT:
+        return pgdec_point(in->str, in->len, &v->point, err);
+    case BULK_LINE:
+        return pgdec_line(in->str, in->len, &v->line, err);
+    case BULK_LSEG:
+        return pgdec_lseg(in->str, in->len, &v->lseg, err);
+    case BULK_BOX:
+        return pgdec_box(in->str, in->len, &v->lseg, err);
+    default:
+        return pgdec_circle(in->str, in->len, &v->circle, err);
+    }
+}
+
+static void *bulk_worker(void *arg)
+{
+    bulk_task_t *t = (bulk_task_t *)arg;
+
+    t->errrow = t->tail;
+    for (size_t i = t->head; i < t->tail; i++) {
+        if (t->in[i].str &&
+            bulk_parse(t->type, t->in + i, t->out + i, &t->err)) {
+            t->errrow = i;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief bulk_run
+ *  parse n rows by nthread threads. the calling thread also parses the rows
+ *  of the first task, and the rows of the task that failed to create the
+ *  thread.
+ * @return bulk_task_t* the task that failed at the smallest row, or NULL.
+ */
+static bulk_task_t *bulk_run(bulk_task_t *tasks, int nthread, int type,
+                             const bulk_input_t *in, bulk_value_t *out,
+                             size_t n)
+{
+    pthread_t tids[BULK_MAX_THREADS];
+    int created[BULK_MAX_THREADS] = {0};
+    size_t chunk                  = (n + nthread - 1) / nthread;
+    bulk_task_t *failed           = NULL;
+
+    for (int i = 0; i < nthread; i++) {
+        tasks[i] = (bulk_task_t){
+            .type = type,
+            .in   = in,
+            .out  = out,
+            .head = chunk * i < n ? chunk * i : n,
+            .tail = chunk * (i + 1) < n ? chunk * (i + 1) : n,
+        };
+        if (i) {
+            created[i] =
+                !pthread_create(tids + i, NULL, bulk_worker, tasks + i);
+        }
+    }
+
+    for (int i = 0; i < nthread; i++) {
+        if (!created[i]) {
+            bulk_worker(tasks + i);
+        }
+    }
+    for (int i = 0; i < nthread; i++) {
+        if (created[i]) {
+            pthread_join(tids[i], NULL);
+        }
+        // tasks are ordered by the rows
+        if (!failed && tasks[i].errrow < tasks[i].tail) {
+            failed = tasks + i;
+        }
+    }
+    return failed;
+}
+
+static void bulk_push_timestamp(lua_State *L, const pgdec_timestamp_t *ts,
+                                int has_date, int has_time)
+{
+    if (has_date) {
+        lauxh_pushint2tbl(L, "year", ts->year);
+        lauxh_pushint2tbl(L, "month", ts->mon);
+        lauxh_pushint2tbl(L, "day", ts->day);
+    }
+    if (has_time) {
+        lauxh_pushint2tbl(L, "hour", ts->hour);
+        lauxh_pushint2tbl(L, "min", ts->min);
+        lauxh_pushint2tbl(L, "sec", ts->sec);
+        lauxh_pushint2tbl(L, "usec", ts->usec);
+        if (ts->tzsign[0]) {
+            lauxh_pushstr2tbl(L, "tz", ts->tzsign);
+            lauxh_pushint2tbl(L, "tzhour", ts->tzhour);
+            lauxh_pushint2tbl(L, "tzmin", ts->tzmin);
+            lauxh_pushint2tbl(L, "tzsec", ts->tzsec);
+        }
+    }
+}
+
+/**
+ * @brief bulk_push
+ *  set the decoded value to the row of the table at the top of the stack.
+ *  the values are the same as the values returned by each decoder.
+ */
+static void bulk_push(lua_State *L, int type, const bulk_value_t *v, int row)
+{
+    switch (type) {
+    case BULK_INT:
+        lua_pushinteger(L, (lua_Integer)v->i);
+        break;
+    case BULK_FLOAT:
+        lua_pushnumber(L, v->f);
+        break;
+    case BULK_BOOL:
+        lua_pushboolean(L, v->b);
+        break;
+    case BULK_DATE:
+        decode_subtable(L, row, 0, 3, 0);
+        bulk_push_timestamp(L, &v->ts, 1, 0);
+        break;
+    case BULK_TIME:
+        decode_subtable(L, row, 0, 4, 0);
+        bulk_push_timestamp(L, &v->ts, 0, 1);
+        break;
+    case BULK_TIMESTAMP:
+        decode_subtable(L, row, 0, 7, 0);
+        bulk_push_timestamp(L, &v->ts, 1, 1);
+        break;
+    case BULK_POINT:
+        decode_subtable(L, row, 2, 0, 0);
+        lauxh_pushnum2arr(L, 1, v->point.x);
+        lauxh_pushnum2arr(L, 2, v->point.y);
+        break;
+    case BULK_LINE:
+        decode_subtable(L, row, 3, 0, 0);
+        lauxh_pushnum2arr(L, 1, v->line.a);
+        lauxh_pushnum2arr(L, 2, v->line.b);
+        lauxh_pushnum2arr(L, 3, v->line.c);
+        break;
+    case BULK_LSEG:
+    case BULK_BOX:
+        decode_subtable(L, row, 2, 0, 1);
+        for (int i = 0; i < 2; i++) {
+            decode_subtable(L, i + 1, 2, 0, 0);
+            lauxh_pushnum2arr(L, 1, v->lseg.p[i].x);
+            lauxh_pushnum2arr(L, 2, v->lseg.p[i].y);
+            lua_rawseti(L, -2, i + 1);
+        }
+        decode_trimtable(L, 2);
+        break;
+    default:
+        decode_subtable(L, row, 3, 0, 0);
+        lauxh_pushnum2arr(L, 1, v->circle.center.x);
+        lauxh_pushnum2arr(L, 2, v->circle.center.y);
+        lauxh_pushnum2arr(L, 3, v->circle.radius);
+        break;
+    }
+    lua_rawseti(L, -2, row);
+}
+
+static int bulk_error(lua_State *L, int type, const pgdec_error_t *err,
+                      size_t row)
+{
+    const char *op = BULK_OPS[type];
+
+    if (decode_fastfail(L)) {
+        return decode_error_fast(L, err->errnum, err->pos);
+    } else if (err->pos) {
+        return decode_error(L, op, err->errnum, "'%c' at position %d of row %d",
+                            err->c, (int)err->pos, (int)row);
+    } else if (err->msg) {
+        return decode_error(L, op, err->errnum, "%s at row %d", err->msg,
+                            (int)row);
+    }
+    return decode_error(L, op, err->errnum, "at row %d", (int)row);
+}
+
+static int decode_bulk_lua(lua_State *L)
+{
+    int type            = luaL_checkoption(L, 1, NULL, BULK_TYPES);
+    lua_Integer nthread = 0;
+    size_t n            = 0;
+    size_t nbuf         = 0;
+    bulk_input_t *in    = NULL;
+    bulk_value_t *out   = NULL;
+    bulk_task_t tasks[BULK_MAX_THREADS];
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    if (lua_isnoneornil(L, 3)) {
+        nthread = sysconf(_SC_NPROCESSORS_ONLN);
+    } else {
+        nthread = luaL_checkinteger(L, 3);
+        luaL_argcheck(L, nthread > 0, 3, "nthread must be greater than 0");
+    }
+    if (nthread < 1) {
+        nthread = 1;
+    } else if (nthread > BULK_MAX_THREADS) {
+        nthread = BULK_MAX_THREADS;
+    }
+    if (!lua_isnoneornil(L, 4)) {
+        luaL_checktype(L, 4, LUA_TTABLE);
+        luaL_argcheck(L, !lua_rawequal(L, 2, 4), 4,
+                      "dst must not be the same table as strs");
+    }
+    if (lua_isnoneornil(L, 5)) {
+        // the rows after a nil hole may be dropped without n
+#if LUA_VERSION_NUM >= 502
+        n = lua_rawlen(L, 2);
+#else
+        n = lua_objlen(L, 2);
+#endif
+        luaL_argcheck(L, n <= INT_MAX, 2, "too many strings");
+    } else {
+        lua_Integer nrow = luaL_checkinteger(L, 5);
+        luaL_argcheck(L, nrow >= 0 && nrow <= INT_MAX, 5,
+                      "n must be between 0 and INT_MAX");
+        n = (size_t)nrow;
+    }
+    lua_settop(L, 4);
+    decode_table(L, 4, (int)n, 0, 1);
+
+    // buffers of a batch
+    nbuf = n < BULK_BATCH ? n : BULK_BATCH;
+    in   = lua_newuserdata(L, (sizeof(bulk_input_t) + sizeof(bulk_value_t)) *
+                                  (nbuf ? nbuf : 1));
+    out  = (bulk_value_t *)(in + nbuf);
+
+    for (size_t head = 0; head < n; head += nbuf) {
+        size_t nrow = n - head < nbuf ? n - head : nbuf;
+        // use fewer threads for the small batch
+        int nt = (int)((nrow + BULK_MIN_ROWS - 1) / BULK_MIN_ROWS);
+        bulk_task_t *failed = NULL;
+
+        if (nt > nthread) {
+            nt = (int)nthread;
+        }
+        // collect the strings on the calling thread. they are referenced by
+        // the strs table until the batch is finished.
+        for (size_t i = 0; i < nrow; i++) {
+            lua_rawgeti(L, 2, (int)(head + i + 1));
+            if (lua_type(L, -1) == LUA_TSTRING) {
+                in[i].str = lua_tolstring(L, -1, &in[i].len);
+            } else {
+                // other values are treated as NULL
+                in[i].str = NULL;
+            }
+            lua_pop(L, 1);
+        }
+
+        failed = bulk_run(tasks, nt, type, in, out, nrow);
+        if (failed) {
+            return bulk_error(L, type, &failed->err,
+                              head + failed->errrow + 1);
+        }
+
+        lua_pushvalue(L, 5);
+        for (size_t i = 0; i < nrow; i++) {
+            int row = (int)(head + i + 1);
+            if (in[i].str) {
+                bulk_push(L, type, out + i, row);
+            } else {
+                lua_pushnil(L);
+                lua_rawseti(L, -2, row);
+            }
+        }
+        lua_pop(L, 1);
+    }
+
+    lua_settop(L, 5);
+    decode_trimtable(L, (int)n);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_bulk(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, decode_bulk_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.bulk", NULL);
+    return 1;
+}
@@ -58,5 +58,6 @@ LUALIB_API int luaopen_postgres_decode_bytea(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_bytea_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.bytea", NULL);
     return 1;
 }
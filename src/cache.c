@@ -0,0 +1,387 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_field.h"
+#include <string.h>
+
+// bounded LRU cache of the decoded values keyed by the input string.
+// the cached value is shared by all callers that decode the same string.
+
+#define CACHE_MT "postgres.decode.cache"
+
+// fields of the environment table
+enum {
+    CACHE_DECODER = 1,
+    // input string -> entry index
+    CACHE_INDEX,
+    // entry index -> input string
+    CACHE_KEYS,
+    // entry index -> decoded value
+    CACHE_VALUES,
+};
+
+typedef struct {
+    int prev; // more recently used entry, or 0
+    int next; // less recently used entry, or 0
+} cache_node_t;
+
+typedef struct {
+    int ref;            // reference of the environment table
+    int size;           // maximum number of the entries
+    int len;            // number of the entries
+    int head;           // most recently used entry, or 0
+    int tail;           // least recently used entry, or 0
+    int readonly;       // cached tables are returned as read-only proxies
+    lua_Integer nhit;   // number of the cache hits
+    lua_Integer nmiss;  // number of the cache misses
+    cache_node_t nodes[]; // 1-based index of the entries
+} cache_t;
+
+static void cache_unlink(cache_t *c, int i)
+{
+    cache_node_t *n = &c->nodes[i];
+
+    if (n->prev) {
+        c->nodes[n->prev].next = n->next;
+    } else {
+        c->head = n->next;
+    }
+    if (n->next) {
+        c->nodes[n->next].prev = n->prev;
+    } else {
+        c->tail = n->prev;
+    }
+    *n = (cache_node_t){0};
+}
+
+static void cache_push_head(cache_t *c, int i)
+{
+    c->nodes[i] = (cache_node_t){
+        .next = c->head,
+    };
+    if (c->head) {
+        c->nodes[c->head].prev = i;
+    } else {
+        c->tail = i;
+    }
+    c->head = i;
+}
+
+static int cache_readonly_lua(lua_State *L)
+{
+    return luaL_error(L, "attempt to modify a read-only value");
+}
+
+static int cache_proxy_len_lua(lua_State *L)
+{
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, "__index");
+#if LUA_VERSION_NUM >= 502
+    lua_pushinteger(L, lua_rawlen(L, -1));
+#else
+    lua_pushinteger(L, lua_objlen(L, -1));
+#endif
+    return 1;
+}
+
+static int cache_proxy_pairs_lua(lua_State *L)
+{
+    lua_getmetatable(L, 1);
+    lua_getglobal(L, "next");
+    lua_getfield(L, -2, "__index");
+    lua_pushnil(L);
+    return 3;
+}
+
+/**
+ * @brief cache_proxy
+ *  replace the table at the top of the stack with the read-only proxy of
+ *  the table. the nested tables are also replaced with their proxies.
+ */
+static void cache_proxy(lua_State *L)
+{
+    int idx = lua_gettop(L);
+
+    luaL_checkstack(L, 6, "nested tables too deep to be read-only");
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+        if (lua_type(L, -1) == LUA_TTABLE) {
+            // it is allowed to overwrite the existing field during the
+            // traversal
+            cache_proxy(L);
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_rawset(L, idx);
+        } else {
+            lua_pop(L, 1);
+        }
+    }
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 5);
+    lua_pushvalue(L, idx);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, cache_readonly_lua);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, cache_proxy_len_lua);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, cache_proxy_pairs_lua);
+    lua_setfield(L, -2, "__pairs");
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "__metatable");
+    lua_setmetatable(L, -2);
+    lua_replace(L, idx);
+}
+
+/**
+ * @brief cache_store
+ *  store the value at the top of the stack as the most recently used entry
+ *  of the key at index 2. the least recently used entry is evicted if the
+ *  cache is full.
+ */
+static void cache_store(lua_State *L, cache_t *c, int env)
+{
+    int i = 0;
+
+    lua_rawgeti(L, env, CACHE_INDEX);
+    lua_rawgeti(L, env, CACHE_KEYS);
+    if (c->len < c->size) {
+        i = ++c->len;
+    } else {
+        // evict the least recently used entry
+        i = c->tail;
+        cache_unlink(c, i);
+        lua_rawgeti(L, -1, i);
+        lua_pushnil(L);
+        lua_rawset(L, -4);
+    }
+    cache_push_head(c, i);
+    lua_pushvalue(L, 2);
+    lua_rawseti(L, -2, i);
+    lua_pushvalue(L, 2);
+    lua_pushinteger(L, i);
+    lua_rawset(L, -4);
+    lua_pop(L, 2);
+    lua_rawgeti(L, env, CACHE_VALUES);
+    lua_pushvalue(L, -2);
+    lua_rawseti(L, -2, i);
+    lua_pop(L, 1);
+}
+
+/**
+ * @brief cache_decode_lua
+ *  return the cached value of the string at index 2. if the value is not
+ *  cached, the string is passed to the decoder, and the decoded value is
+ *  cached. the error and the nil value that returned from the decoder are
+ *  not cached.
+ *  if the rest of the arguments are passed, they are passed to the decoder
+ *  without using the cache, because the decoded value depends on them.
+ */
+static int cache_decode_lua(lua_State *L)
+{
+    cache_t *c = luaL_checkudata(L, 1, CACHE_MT);
+    int narg   = 0;
+    int cached = 0;
+    int env    = 0;
+    int nres   = 0;
+
+    // trailing nil arguments are the same as no arguments
+    while (lua_gettop(L) > 2 && lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+    }
+    narg   = lua_gettop(L) - 1;
+    cached = narg == 1 && lua_type(L, 2) == LUA_TSTRING;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, c->ref);
+    env = lua_gettop(L);
+    if (cached) {
+        int i = 0;
+
+        lua_rawgeti(L, env, CACHE_INDEX);
+        lua_pushvalue(L, 2);
+        lua_rawget(L, -2);
+        i = (int)lua_tointeger(L, -1);
+        lua_pop(L, 2);
+        if (i) {
+            c->nhit++;
+            if (c->head != i) {
+                cache_unlink(c, i);
+                cache_push_head(c, i);
+            }
+            lua_rawgeti(L, env, CACHE_VALUES);
+            lua_rawgeti(L, -1, i);
+            return 1;
+        }
+        c->nmiss++;
+    }
+
+    // decoder(str, ...)
+    lua_rawgeti(L, env, CACHE_DECODER);
+    for (int i = 2; i < env; i++) {
+        lua_pushvalue(L, i);
+    }
+    lua_call(L, narg, LUA_MULTRET);
+    nres = lua_gettop(L) - env;
+    if (!nres || lua_isnil(L, env + 1) || !cached) {
+        return nres;
+    }
+
+    lua_settop(L, env + 1);
+    if (c->readonly && lua_type(L, -1) == LUA_TTABLE) {
+        cache_proxy(L);
+    }
+    cache_store(L, c, env);
+    return 1;
+}
+
+/**
+ * @brief cache_stats_lua
+ *  return the table of the hit and miss counters. if reset is true, the
+ *  counters are reset after they are returned.
+ */
+static int cache_stats_lua(lua_State *L)
+{
+    cache_t *c = luaL_checkudata(L, 1, CACHE_MT);
+
+    lua_createtable(L, 0, 4);
+    lauxh_pushint2tbl(L, "hits", c->nhit);
+    lauxh_pushint2tbl(L, "misses", c->nmiss);
+    lauxh_pushint2tbl(L, "len", c->len);
+    lauxh_pushint2tbl(L, "size", c->size);
+    if (lua_toboolean(L, 2)) {
+        c->nhit  = 0;
+        c->nmiss = 0;
+    }
+    return 1;
+}
+
+static int cache_clear_lua(lua_State *L)
+{
+    cache_t *c = luaL_checkudata(L, 1, CACHE_MT);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, c->ref);
+    for (int i = CACHE_INDEX; i <= CACHE_VALUES; i++) {
+        lua_newtable(L);
+        lua_rawseti(L, -2, i);
+    }
+    memset(c->nodes, 0, sizeof(cache_node_t) * (c->size + 1));
+    c->len  = 0;
+    c->head = 0;
+    c->tail = 0;
+    return 0;
+}
+
+static int cache_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, CACHE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int cache_gc_lua(lua_State *L)
+{
+    cache_t *c = lua_touserdata(L, 1);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, c->ref);
+    c->ref = LUA_NOREF;
+    return 0;
+}
+
+static int decode_cache_lua(lua_State *L)
+{
+    lua_Integer size = luaL_checkinteger(L, 2);
+    int readonly     = lauxh_optboolean(L, 3, 0);
+    cache_t *c       = NULL;
+
+    luaL_argcheck(L, size > 0 && size <= INT_MAX / (int)sizeof(cache_node_t),
+                  2, "size out of range");
+    lua_settop(L, 1);
+    if (lua_type(L, 1) == LUA_TSTRING) {
+        // resolve the built-in decoder by name
+        lua_newtable(L);
+        lua_pushvalue(L, 1);
+        decode_field_builtin(L, 2, 1);
+        lua_replace(L, 1);
+        lua_settop(L, 1);
+    }
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+
+    // environment table: {decoder, index, keys, values}
+    lua_createtable(L, 4, 0);
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, CACHE_DECODER);
+    for (int i = CACHE_INDEX; i <= CACHE_VALUES; i++) {
+        lua_newtable(L);
+        lua_rawseti(L, -2, i);
+    }
+
+    c = lua_newuserdata(L, sizeof(cache_t) +
+                               sizeof(cache_node_t) * ((size_t)size + 1));
+    memset(c, 0, sizeof(cache_t) + sizeof(cache_node_t) * ((size_t)size + 1));
+    c->ref      = LUA_NOREF;
+    c->size     = (int)size;
+    c->readonly = readonly;
+    luaL_getmetatable(L, CACHE_MT);
+    lua_setmetatable(L, -2);
+    lua_insert(L, -2);
+    c->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_cache(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__call",     cache_decode_lua  },
+        {"__gc",       cache_gc_lua      },
+        {"__tostring", cache_tostring_lua},
+        {NULL,         NULL              }
+    };
+    struct luaL_Reg method[] = {
+        {"decode", cache_decode_lua},
+        {"stats",  cache_stats_lua },
+        {"clear",  cache_clear_lua },
+        {NULL,     NULL            }
+    };
+
+    lua_errno_loadlib(L);
+
+    // create metatable for the cache
+    if (luaL_newmetatable(L, CACHE_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, decode_cache_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.cache", NULL);
+    return 1;
+}
@@ -30,22 +30,18 @@ static int decode_circle_lua(lua_State *L)
     static const char *op = "postgres.decode.circle";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    double x, y, r;
+    pgdec_circle_t v      = {0};
+    pgdec_error_t err     = {0};
 
-    lua_settop(L, 1);
-    // circle: <(x,y),r>
-    DECODE_START(L, op, str, len);
-    GEOM_SKIP_DELIM(str, '<', "opening angle bracket not found");
-    GEOM_STR2POINT(str, x, y);
-    GEOM_SKIP_DELIM(str, ',', "separator not found");
-    GEOM_STR2DBL(str, r);
-    GEOM_SKIP_DELIM(str, '>', "closing angle bracket not found");
-    DECODE_END(str);
+    lua_settop(L, 2);
+    if (decode_circle(&v, &err, str, len)) {
+        return decode_error_from(L, op, &err);
+    }
 
-    lua_createtable(L, 3, 0);
-    lauxh_pushnum2arr(L, 1, x);
-    lauxh_pushnum2arr(L, 2, y);
-    lauxh_pushnum2arr(L, 3, r);
+    decode_table(L, 2, 3, 0, 0);
+    lauxh_pushnum2arr(L, 1, v.center.x);
+    lauxh_pushnum2arr(L, 2, v.center.y);
+    lauxh_pushnum2arr(L, 3, v.radius);
     return 1;
 }
 
@@ -53,5 +49,6 @@ LUALIB_API int luaopen_postgres_decode_circle(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_circle_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.circle", NULL);
     return 1;
 }
@@ -0,0 +1,334 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_copy.h"
+
+#define COPY_MT "postgres.decode.copy"
+
+typedef struct {
+    char *buf;        // partial row that is not terminated by a newline
+    size_t len;       // length of the partial row
+    size_t cap;       // capacity of the buffer
+    char delim;       // column delimiter
+    int done;         // end-of-data marker is found or finish is called
+    int ref;          // reference of the table {decoders, ctx, cache}
+    lua_Integer nrow; // number of the decoded lines
+} copy_t;
+
+static int copy_buffer(lua_State *L, copy_t *c, const char *s, size_t len)
+{
+    if (c->len + len > c->cap) {
+        size_t cap = c->cap ? c->cap : 1024;
+        char *buf  = NULL;
+
+        while (cap < c->len + len) {
+            cap *= 2;
+        }
+        if (!(buf = realloc(c->buf, cap))) {
+            return decode_error(L, COPY_MT, errno, NULL);
+        }
+        c->buf = buf;
+        c->cap = cap;
+    }
+    memcpy(c->buf + c->len, s, len);
+    c->len += len;
+    return 0;
+}
+
+/**
+ * @brief copy_decode_line
+ *  decode the line that is not including the newline, and push the row table.
+ *  the decoders, context object and the decoder cache must be placed at
+ *  index 3, 4 and 5 of the stack.
+ * @return int 0 on success, -1 if the line is the end-of-data marker,
+ *  otherwise the number of the error values that pushed to the stack.
+ */
+static int copy_decode_line(lua_State *L, copy_t *c, const char *s,
+                            size_t len)
+{
+    const char *tail = s + len;
+    int nfield       = 0;
+
+    c->nrow++;
+    if (len == 2 && s[0] == '\\' && s[1] == '.') {
+        // end-of-data marker
+        c->done = 1;
+        return -1;
+    }
+
+    lua_newtable(L);
+    while (1) {
+        const char *head = s;
+        int escaped      = 0;
+
+        nfield++;
+        while (s < tail && *s != c->delim) {
+            if (*s == '\\') {
+                // escaped character
+                escaped = 1;
+                if (++s == tail) {
+                    break;
+                }
+            }
+            s++;
+        }
+
+        if (s - head == 2 && head[0] == '\\' && head[1] == 'N') {
+            // \N is NULL
+            goto NEXT_FIELD;
+        } else if (escaped) {
+            decode_copy_unescape(L, head, s);
+        } else {
+            lua_pushlstring(L, head, s - head);
+        }
+        if (decode_field(L, COPY_MT, 3, 4, 5, nfield, 0)) {
+            return lua_gettop(L);
+        }
+        lua_rawseti(L, -2, nfield);
+
+NEXT_FIELD:
+        if (s == tail) {
+            return 0;
+        }
+        // skip delimiter
+        s++;
+    }
+}
+
+/**
+ * @brief copy_decode
+ *  decode the complete lines of the chunk and the buffered partial row, and
+ *  set the decoded rows to the table at index 6 of the stack. the remaining
+ *  partial row is buffered. if eof is not 0, the remaining partial row is
+ *  decoded as the last row.
+ * @return int the number of the return values.
+ */
+static int copy_decode(lua_State *L, copy_t *c, const char *s, size_t len,
+                       int eof)
+{
+    const char *tail = s + len;
+    int nrow         = 0;
+    int rc           = 0;
+
+    if (c->done) {
+        goto CHECK_TRAILING;
+    } else if (c->len) {
+        // complete the buffered partial row
+        const char *eol = memchr(s, '\n', len);
+        if (!eol) {
+            if (copy_buffer(L, c, s, len)) {
+                return lua_gettop(L);
+            } else if (!eof) {
+                return 1;
+            }
+            s = tail;
+        } else {
+            if (copy_buffer(L, c, s, eol - s)) {
+                return lua_gettop(L);
+            }
+            s = eol + 1;
+        }
+        rc     = copy_decode_line(L, c, c->buf, c->len);
+        c->len = 0;
+        if (rc > 0) {
+            return rc;
+        } else if (rc < 0) {
+            goto CHECK_TRAILING;
+        }
+        lua_rawseti(L, 6, ++nrow);
+    }
+
+    while (s < tail) {
+        const char *eol = memchr(s, '\n', tail - s);
+        if (!eol) {
+            if (!eof) {
+                // buffer the partial row
+                if (copy_buffer(L, c, s, tail - s)) {
+                    return lua_gettop(L);
+                }
+                return 1;
+            }
+            eol = tail;
+        }
+        rc = copy_decode_line(L, c, s, eol - s);
+        s  = eol < tail ? eol + 1 : tail;
+        if (rc > 0) {
+            return rc;
+        } else if (rc < 0) {
+            goto CHECK_TRAILING;
+        }
+        lua_rawseti(L, 6, ++nrow);
+    }
+    return 1;
+
+CHECK_TRAILING:
+    if (s < tail) {
+        return decode_error(L, COPY_MT, EILSEQ,
+                            "found data after end-of-data marker at line %d",
+                            (int)c->nrow + 1);
+    }
+    return 1;
+}
+
+/**
+ * @brief copy_pushenv
+ *  push the decoders, context object and the decoder cache to the stack at
+ *  index 3, 4 and 5, and push the table of the rows at index 6.
+ */
+static void copy_pushenv(lua_State *L, copy_t *c)
+{
+    lua_settop(L, 2);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, c->ref);
+    lua_rawgeti(L, 3, 1);
+    lua_rawgeti(L, 3, 2);
+    lua_rawgeti(L, 3, 3);
+    lua_remove(L, 3);
+    lua_newtable(L);
+}
+
+static int copy_feed_lua(lua_State *L)
+{
+    copy_t *c         = luaL_checkudata(L, 1, COPY_MT);
+    size_t len        = 0;
+    const char *chunk = lauxh_checklstring(L, 2, &len);
+
+    copy_pushenv(L, c);
+    return copy_decode(L, c, chunk, len, 0);
+}
+
+static int copy_finish_lua(lua_State *L)
+{
+    copy_t *c = luaL_checkudata(L, 1, COPY_MT);
+    int rc    = 0;
+
+    lua_settop(L, 1);
+    lua_pushliteral(L, "");
+    copy_pushenv(L, c);
+    rc      = copy_decode(L, c, "", 0, 1);
+    c->done = 1;
+    return rc;
+}
+
+static int copy_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, COPY_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int copy_gc_lua(lua_State *L)
+{
+    copy_t *c = lua_touserdata(L, 1);
+
+    if (c->buf) {
+        free(c->buf);
+        c->buf = NULL;
+    }
+    luaL_unref(L, LUA_REGISTRYINDEX, c->ref);
+    c->ref = LUA_NOREF;
+    return 0;
+}
+
+static int decode_copy_lua(lua_State *L)
+{
+    char delim = '\t';
+    copy_t *c  = NULL;
+
+    lua_settop(L, 3);
+    if (!lua_isnil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+    }
+    if (decode_copy_delim(L, COPY_MT, 3, &delim)) {
+        return lua_gettop(L);
+    }
+
+    // resolve the built-in decoders in advance
+    lua_newtable(L);
+    if (!lua_isnil(L, 1)) {
+        lua_pushnil(L);
+        while (lua_next(L, 1)) {
+            if (lua_type(L, -1) == LUA_TSTRING) {
+                decode_field_builtin(L, 4, 1);
+            }
+            lua_pop(L, 1);
+        }
+    }
+
+    // environment table: {decoders, ctx, cache}
+    lua_createtable(L, 3, 0);
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, 1);
+    lua_pushvalue(L, 2);
+    lua_rawseti(L, -2, 2);
+    lua_pushvalue(L, 4);
+    lua_rawseti(L, -2, 3);
+
+    c  = lua_newuserdata(L, sizeof(copy_t));
+    *c = (copy_t){
+        .delim = delim,
+        .ref   = LUA_NOREF,
+    };
+    luaL_getmetatable(L, COPY_MT);
+    lua_setmetatable(L, -2);
+    lua_insert(L, -2);
+    c->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_copy(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       copy_gc_lua      },
+        {"__tostring", copy_tostring_lua},
+        {NULL,         NULL             }
+    };
+    struct luaL_Reg method[] = {
+        {"feed",   copy_feed_lua  },
+        {"finish", copy_finish_lua},
+        {NULL,     NULL           }
+    };
+
+    lua_errno_loadlib(L);
+
+    // create metatable for the copy decoder
+    if (luaL_newmetatable(L, COPY_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            DECODE_STATS_WRAP(L, "postgres.decode.copy", ptr->name);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, decode_copy_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.copy", NULL);
+    return 1;
+}
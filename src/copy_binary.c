@@ -0,0 +1,677 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode.h"
+#include <math.h>
+#include <string.h>
+
+// COPY: Binary Format
+// https://www.postgresql.org/docs/current/sql-copy.html#id-1.9.3.55.9.4
+
+#define COPY_BINARY_MT "postgres.decode.copy_binary"
+
+#define COPY_BINARY_SIGNATURE     "PGCOPY\n\377\r\n\0"
+#define COPY_BINARY_SIGNATURE_LEN 11
+// signature + flags field + header extension area length
+#define COPY_BINARY_HEADER_LEN    (COPY_BINARY_SIGNATURE_LEN + 4 + 4)
+// bit 16: if 1, OIDs are included in the data
+#define COPY_BINARY_FLAG_OIDS     (1 << 16)
+// bits 17-31 are reserved to flag critical file format issues
+#define COPY_BINARY_FLAG_CRITICAL 0xFFFE0000
+
+// days from 0000-03-01 to 2000-01-01 (postgres epoch)
+#define POSTGRES_EPOCH_DAYS 730425
+#define USECS_PER_DAY       INT64_C(86400000000)
+
+// built-in binary decoders
+enum {
+    CB_RAW = 0,
+    CB_FUNCTION,
+    CB_BOOL,
+    CB_INT2,
+    CB_INT4,
+    CB_INT8,
+    CB_FLOAT4,
+    CB_FLOAT8,
+    CB_OID,
+    CB_DATE,
+    CB_TIME,
+    CB_TIMESTAMP,
+    CB_TIMESTAMPTZ,
+    CB_JSONB,
+};
+
+static const struct {
+    const char *name;
+    int type;
+} COPY_BINARY_DECODERS[] = {
+    {"bool",        CB_BOOL       },
+    {"int2",        CB_INT2       },
+    {"int4",        CB_INT4       },
+    {"int8",        CB_INT8       },
+    {"float4",      CB_FLOAT4     },
+    {"float8",      CB_FLOAT8     },
+    {"oid",         CB_OID        },
+    {"date",        CB_DATE       },
+    {"time",        CB_TIME       },
+    {"timestamp",   CB_TIMESTAMP  },
+    {"timestamptz", CB_TIMESTAMPTZ},
+    {"jsonb",       CB_JSONB      },
+    {"text",        CB_RAW        },
+    {"bytea",       CB_RAW        },
+    {"uuid",        CB_RAW        },
+    {NULL,          0             }
+};
+
+typedef struct {
+    unsigned char *buf; // unconsumed data
+    size_t len;         // length of the unconsumed data
+    size_t cap;         // capacity of the buffer
+    int header;         // header is decoded
+    int has_oids;       // OIDs are included in the data
+    int done;           // trailer is found or finish is called
+    int failed;         // failed to decode the data
+    int ref;            // reference of the table {decoders, ctx}
+    int ntype;          // number of the column decoders
+    uint8_t *types;     // column decoder types
+    lua_Integer nrow;   // number of the decoded rows
+} copy_binary_t;
+
+static inline uint16_t cb_uint16(const unsigned char *p)
+{
+    return (uint16_t)p[0] << 8 | p[1];
+}
+
+static inline uint32_t cb_uint32(const unsigned char *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+           p[3];
+}
+
+static inline uint64_t cb_uint64(const unsigned char *p)
+{
+    return (uint64_t)cb_uint32(p) << 32 | cb_uint32(p + 4);
+}
+
+/**
+ * @brief cb_push_date
+ *  set the year, month and day fields of the days since 2000-01-01 to the
+ *  table at the top of the stack.
+ */
+static void cb_push_date(lua_State *L, int64_t days)
+{
+    // convert days to civil date (proleptic gregorian calendar)
+    int64_t z   = days + POSTGRES_EPOCH_DAYS;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp  = (5 * doy + 2) / 153;
+    int64_t day = doy - (153 * mp + 2) / 5 + 1;
+    int64_t mon = mp < 10 ? mp + 3 : mp - 9;
+
+    lauxh_pushint2tbl(L, "year", yoe + era * 400 + (mon <= 2));
+    lauxh_pushint2tbl(L, "month", mon);
+    lauxh_pushint2tbl(L, "day", day);
+}
+
+/**
+ * @brief cb_push_time
+ *  set the hour, min, sec and usec fields of the microseconds since midnight
+ *  to the table at the top of the stack.
+ */
+static void cb_push_time(lua_State *L, int64_t usec)
+{
+    lauxh_pushint2tbl(L, "hour", usec / INT64_C(3600000000));
+    lauxh_pushint2tbl(L, "min", usec / 60000000 % 60);
+    lauxh_pushint2tbl(L, "sec", usec / 1000000 % 60);
+    lauxh_pushint2tbl(L, "usec", usec % 1000000);
+}
+
+/**
+ * @brief cb_decode_field
+ *  decode the field value by the decoder of the column, and push it.
+ *  the decoders and the context object must be placed at index 3 and 4 of
+ *  the stack.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static int cb_decode_field(lua_State *L, copy_binary_t *c, int ncol,
+                           const unsigned char *p, size_t len)
+{
+    static const int FIXED_LEN[] = {
+        [CB_BOOL] = 1,   [CB_INT2] = 2,      [CB_INT4] = 4,
+        [CB_INT8] = 8,   [CB_FLOAT4] = 4,    [CB_FLOAT8] = 8,
+        [CB_OID] = 4,    [CB_DATE] = 4,      [CB_TIME] = 8,
+        [CB_TIMESTAMP] = 8, [CB_TIMESTAMPTZ] = 8,
+    };
+    int type = ncol <= c->ntype ? c->types[ncol - 1] : CB_RAW;
+
+    if (type < (int)(sizeof(FIXED_LEN) / sizeof(int)) && FIXED_LEN[type] &&
+        (size_t)FIXED_LEN[type] != len) {
+        return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                            "invalid field length %d of column #%d at row %d",
+                            (int)len, ncol, (int)c->nrow);
+    }
+
+    switch (type) {
+    case CB_FUNCTION:
+        lua_rawgeti(L, 3, ncol);
+        lua_pushlstring(L, (const char *)p, len);
+        lua_pushvalue(L, 4);
+        lua_call(L, 2, 2);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            return 0;
+        } else if (lua_type(L, -1) == LUA_TSTRING) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ, lua_tostring(L, -1));
+        }
+        // pass through the error object
+        return decode_error_pass(L);
+
+    case CB_BOOL:
+        lua_pushboolean(L, *p);
+        return 0;
+
+    case CB_INT2:
+        lua_pushinteger(L, (int16_t)cb_uint16(p));
+        return 0;
+
+    case CB_INT4:
+        lua_pushinteger(L, (int32_t)cb_uint32(p));
+        return 0;
+
+    case CB_INT8:
+        lua_pushinteger(L, (lua_Integer)(int64_t)cb_uint64(p));
+        return 0;
+
+    case CB_OID:
+        lua_pushinteger(L, (lua_Integer)cb_uint32(p));
+        return 0;
+
+    case CB_FLOAT4: {
+        uint32_t v = cb_uint32(p);
+        float f    = 0;
+        memcpy(&f, &v, 4);
+        lua_pushnumber(L, f);
+        return 0;
+    }
+
+    case CB_FLOAT8: {
+        uint64_t v = cb_uint64(p);
+        double d   = 0;
+        memcpy(&d, &v, 8);
+        lua_pushnumber(L, d);
+        return 0;
+    }
+
+    case CB_DATE: {
+        int32_t days = (int32_t)cb_uint32(p);
+        if (days == INT32_MAX || days == INT32_MIN) {
+            // infinity or -infinity
+            lua_pushnumber(L, days == INT32_MAX ? HUGE_VAL : -HUGE_VAL);
+            return 0;
+        }
+        lua_createtable(L, 0, 3);
+        cb_push_date(L, days);
+        return 0;
+    }
+
+    case CB_TIME:
+        lua_createtable(L, 0, 4);
+        cb_push_time(L, (int64_t)cb_uint64(p));
+        return 0;
+
+    case CB_TIMESTAMP:
+    case CB_TIMESTAMPTZ: {
+        int64_t usec = (int64_t)cb_uint64(p);
+        int64_t days = 0;
+
+        if (usec == INT64_MAX || usec == INT64_MIN) {
+            // infinity or -infinity
+            lua_pushnumber(L, usec == INT64_MAX ? HUGE_VAL : -HUGE_VAL);
+            return 0;
+        }
+        days = usec / USECS_PER_DAY;
+        usec %= USECS_PER_DAY;
+        if (usec < 0) {
+            days--;
+            usec += USECS_PER_DAY;
+        }
+        lua_createtable(L, 0, 11);
+        cb_push_date(L, days);
+        cb_push_time(L, usec);
+        if (type == CB_TIMESTAMPTZ) {
+            // timestamptz is sent in UTC
+            lauxh_pushstr2tbl(L, "tz", "+");
+            lauxh_pushint2tbl(L, "tzhour", 0);
+            lauxh_pushint2tbl(L, "tzmin", 0);
+            lauxh_pushint2tbl(L, "tzsec", 0);
+        }
+        return 0;
+    }
+
+    case CB_JSONB:
+        // version number followed by the json text
+        if (!len || *p != 1) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                                "unsupported jsonb version of column #%d at "
+                                "row %d",
+                                ncol, (int)c->nrow);
+        }
+        lua_pushlstring(L, (const char *)p + 1, len - 1);
+        return 0;
+
+    default:
+        lua_pushlstring(L, (const char *)p, len);
+        return 0;
+    }
+}
+
+/**
+ * @brief cb_decode_tuple
+ *  decode the tuple at the head of the data, and push the row table.
+ * @return int 0 on success, -1 if the data is not enough to decode the tuple,
+ *  otherwise the number of the error values that pushed to the stack.
+ */
+static int cb_decode_tuple(lua_State *L, copy_binary_t *c,
+                           const unsigned char **sp, const unsigned char *tail)
+{
+    const unsigned char *s = *sp + 2;
+    int nfield             = (int16_t)cb_uint16(*sp);
+    int ncol               = 0;
+
+    if (nfield < 0) {
+        return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                            "invalid field count %d at row %d", nfield,
+                            (int)c->nrow + 1);
+    }
+    // check that the data contains the whole tuple
+    for (int i = nfield + c->has_oids; i > 0; i--) {
+        int32_t len = 0;
+        if (tail - s < 4) {
+            return -1;
+        }
+        len = (int32_t)cb_uint32(s);
+        s += 4;
+        if (len > 0) {
+            if (tail - s < len) {
+                return -1;
+            }
+            s += len;
+        }
+    }
+
+    c->nrow++;
+    s = *sp + 2;
+    lua_createtable(L, nfield, c->has_oids);
+    if (c->has_oids) {
+        // OID field immediately follows the field-count word
+        if (cb_uint32(s) != 4) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                                "invalid oid field length at row %d",
+                                (int)c->nrow);
+        }
+        lauxh_pushint2tbl(L, "oid", cb_uint32(s + 4));
+        s += 8;
+    }
+    for (ncol = 1; ncol <= nfield; ncol++) {
+        int32_t len = (int32_t)cb_uint32(s);
+
+        s += 4;
+        if (len < 0) {
+            // NULL
+            continue;
+        } else if (cb_decode_field(L, c, ncol, s, len)) {
+            return lua_gettop(L);
+        }
+        lua_rawseti(L, -2, ncol);
+        s += len;
+    }
+
+    *sp = s;
+    return 0;
+}
+
+/**
+ * @brief cb_decode
+ *  decode the complete tuples of the data, and set the decoded rows to the
+ *  table at index 5 of the stack.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack. *sp is advanced to the unconsumed data.
+ */
+static int cb_decode(lua_State *L, copy_binary_t *c, const unsigned char **sp,
+                     const unsigned char *tail)
+{
+    const unsigned char *s = *sp;
+    int nrow               = 0;
+    int rc                 = 0;
+
+    if (!c->header) {
+        uint32_t flags  = 0;
+        uint32_t extlen = 0;
+
+        if (tail - s < COPY_BINARY_HEADER_LEN) {
+            return 0;
+        } else if (memcmp(s, COPY_BINARY_SIGNATURE,
+                          COPY_BINARY_SIGNATURE_LEN) != 0) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                                "invalid signature of binary copy data");
+        }
+        flags = cb_uint32(s + COPY_BINARY_SIGNATURE_LEN);
+        if (flags & COPY_BINARY_FLAG_CRITICAL) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                                "unrecognized critical flags 0x%08x",
+                                flags & COPY_BINARY_FLAG_CRITICAL);
+        }
+        // skip the header extension area
+        extlen = cb_uint32(s + COPY_BINARY_SIGNATURE_LEN + 4);
+        if ((uint64_t)(tail - s) < COPY_BINARY_HEADER_LEN + (uint64_t)extlen) {
+            return 0;
+        }
+        s += COPY_BINARY_HEADER_LEN + extlen;
+        c->has_oids = (flags & COPY_BINARY_FLAG_OIDS) ? 1 : 0;
+        c->header   = 1;
+    }
+
+    while (tail - s >= 2) {
+        if (cb_uint16(s) == 0xFFFF) {
+            // file trailer
+            s += 2;
+            c->done = 1;
+            break;
+        }
+        rc = cb_decode_tuple(L, c, &s, tail);
+        if (rc > 0) {
+            return rc;
+        } else if (rc < 0) {
+            break;
+        }
+        lua_rawseti(L, 5, ++nrow);
+    }
+
+    *sp = s;
+    return 0;
+}
+
+/**
+ * @brief cb_pushenv
+ *  push the decoders and the context object to the stack at index 3 and 4,
+ *  and push the table of the rows at index 5.
+ */
+static void cb_pushenv(lua_State *L, copy_binary_t *c)
+{
+    lua_settop(L, 2);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, c->ref);
+    lua_rawgeti(L, 3, 1);
+    lua_rawgeti(L, 3, 2);
+    lua_remove(L, 3);
+    lua_newtable(L);
+}
+
+static int cb_feed_lua(lua_State *L)
+{
+    copy_binary_t *c = luaL_checkudata(L, 1, COPY_BINARY_MT);
+    size_t len       = 0;
+    const unsigned char *chunk =
+        (const unsigned char *)lauxh_checklstring(L, 2, &len);
+    const unsigned char *s    = chunk;
+    const unsigned char *tail = chunk + len;
+
+    cb_pushenv(L, c);
+    if (c->failed) {
+        return decode_error(L, COPY_BINARY_MT, EINVAL,
+                            "cannot decode data after an error");
+    } else if (c->done) {
+        if (len) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                                "found data after file trailer");
+        }
+        return 1;
+    }
+
+    if (c->len) {
+        // append the chunk to the unconsumed data
+        if (c->len + len > c->cap) {
+            size_t cap         = c->cap;
+            unsigned char *buf = NULL;
+
+            while (cap < c->len + len) {
+                cap *= 2;
+            }
+            if (!(buf = realloc(c->buf, cap))) {
+                return decode_error(L, COPY_BINARY_MT, errno, NULL);
+            }
+            c->buf = buf;
+            c->cap = cap;
+        }
+        memcpy(c->buf + c->len, chunk, len);
+        c->len += len;
+        s    = c->buf;
+        tail = c->buf + c->len;
+    }
+
+    if (cb_decode(L, c, &s, tail)) {
+        // the unconsumed data cannot be decoded anymore
+        c->failed = 1;
+        c->len    = 0;
+        return lua_gettop(L);
+    } else if (c->done && s < tail) {
+        return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                            "found data after file trailer");
+    }
+
+    // keep the unconsumed data
+    len = tail - s;
+    if (len && !c->len) {
+        if (len > c->cap) {
+            size_t cap         = c->cap ? c->cap : 1024;
+            unsigned char *buf = NULL;
+
+            while (cap < len) {
+                cap *= 2;
+            }
+            if (!(buf = realloc(c->buf, cap))) {
+                return decode_error(L, COPY_BINARY_MT, errno, NULL);
+            }
+            c->buf = buf;
+            c->cap = cap;
+        }
+        memcpy(c->buf, s, len);
+    } else if (len) {
+        memmove(c->buf, s, len);
+    }
+    c->len = len;
+
+    return 1;
+}
+
+static int cb_finish_lua(lua_State *L)
+{
+    copy_binary_t *c = luaL_checkudata(L, 1, COPY_BINARY_MT);
+    int done         = c->done;
+
+    c->done = 1;
+    if (c->failed) {
+        return decode_error(L, COPY_BINARY_MT, EINVAL,
+                            "cannot decode data after an error");
+    } else if (!done) {
+        if (c->len || c->header) {
+            return decode_error(L, COPY_BINARY_MT, EILSEQ,
+                                "unexpected end of binary copy data");
+        }
+        return decode_error(L, COPY_BINARY_MT, EINVAL, "empty data");
+    }
+    lua_newtable(L);
+    return 1;
+}
+
+static int cb_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, COPY_BINARY_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int cb_gc_lua(lua_State *L)
+{
+    copy_binary_t *c = lua_touserdata(L, 1);
+
+    if (c->buf) {
+        free(c->buf);
+        c->buf = NULL;
+    }
+    if (c->types) {
+        free(c->types);
+        c->types = NULL;
+    }
+    luaL_unref(L, LUA_REGISTRYINDEX, c->ref);
+    c->ref = LUA_NOREF;
+    return 0;
+}
+
+static int decode_copy_binary_lua(lua_State *L)
+{
+    copy_binary_t *c = NULL;
+    int ntype        = 0;
+
+    lua_settop(L, 3);
+    if (!lua_isnil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        if (lua_isnil(L, 3)) {
+            // the decoders after a nil hole may be ignored without ncol
+#if LUA_VERSION_NUM >= 502
+            ntype = lua_rawlen(L, 1);
+#else
+            ntype = lua_objlen(L, 1);
+#endif
+        } else {
+            lua_Integer ncol = luaL_checkinteger(L, 3);
+            luaL_argcheck(L, ncol >= 0 && ncol <= INT16_MAX, 3,
+                          "ncol must be between 0 and 32767");
+            ntype = (int)ncol;
+        }
+    }
+    lua_settop(L, 2);
+
+    c  = lua_newuserdata(L, sizeof(copy_binary_t));
+    *c = (copy_binary_t){
+        .ref = LUA_NOREF,
+    };
+    luaL_getmetatable(L, COPY_BINARY_MT);
+    lua_setmetatable(L, -2);
+
+    // resolve the column decoders
+    if (ntype) {
+        if (!(c->types = calloc(ntype, sizeof(uint8_t)))) {
+            return decode_error(L, COPY_BINARY_MT, errno, NULL);
+        }
+        c->ntype = ntype;
+    }
+    for (int i = 1; i <= ntype; i++) {
+        lua_rawgeti(L, 1, i);
+        switch (lua_type(L, -1)) {
+        case LUA_TNIL:
+        case LUA_TBOOLEAN:
+            // no decoder
+            break;
+
+        case LUA_TFUNCTION:
+            c->types[i - 1] = CB_FUNCTION;
+            break;
+
+        case LUA_TSTRING: {
+            const char *name = lua_tostring(L, -1);
+            int j            = 0;
+
+            for (; COPY_BINARY_DECODERS[j].name; j++) {
+                if (strcmp(name, COPY_BINARY_DECODERS[j].name) == 0) {
+                    break;
+                }
+            }
+            if (!COPY_BINARY_DECODERS[j].name) {
+                return luaL_argerror(
+                    L, 1,
+                    lua_pushfstring(L, "unknown decoder name '%s'", name));
+            }
+            c->types[i - 1] = COPY_BINARY_DECODERS[j].type;
+            break;
+        }
+
+        default:
+            return luaL_argerror(
+                L, 1,
+                lua_pushfstring(L,
+                                "decoder #%d must be string or function, got %s",
+                                i, luaL_typename(L, -1)));
+        }
+        lua_pop(L, 1);
+    }
+
+    // environment table: {decoders, ctx}
+    lua_createtable(L, 2, 0);
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, 1);
+    lua_pushvalue(L, 2);
+    lua_rawseti(L, -2, 2);
+    c->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_copy_binary(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       cb_gc_lua      },
+        {"__tostring", cb_tostring_lua},
+        {NULL,         NULL           }
+    };
+    struct luaL_Reg method[] = {
+        {"feed",   cb_feed_lua  },
+        {"finish", cb_finish_lua},
+        {NULL,     NULL         }
+    };
+
+    lua_errno_loadlib(L);
+
+    // create metatable for the binary copy decoder
+    if (luaL_newmetatable(L, COPY_BINARY_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            DECODE_STATS_WRAP(L, "postgres.decode.copy_binary", ptr->name);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, decode_copy_binary_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.copy_binary", NULL);
+    return 1;
+}
@@ -0,0 +1,472 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_copy.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#define COPYFILE_MT "postgres.decode.copyfile"
+
+typedef struct {
+    const char *data; // mapped file
+    size_t size;      // size of the mapped file
+    size_t nrow;      // number of the rows
+    uint64_t *lines;  // start offset of each line
+    size_t *rows;     // index of the first field offset of each row
+    uint32_t *fields; // field offsets relative to the start of the line
+    size_t nfield;    // number of the field offsets
+    size_t rowcap;    // capacity of the lines and rows
+    size_t fieldcap;  // capacity of the fields
+    char delim;       // column delimiter
+    int ref;          // reference of the table {decoders, ctx, cache}
+} copyfile_t;
+
+static int copyfile_grow(copyfile_t *f, size_t nrow, size_t nfield)
+{
+    if (nrow > f->rowcap) {
+        size_t cap      = f->rowcap ? f->rowcap * 2 : 1024;
+        uint64_t *lines = NULL;
+        size_t *rows    = NULL;
+
+        if (!(lines = realloc(f->lines, sizeof(uint64_t) * cap))) {
+            return -1;
+        }
+        f->lines = lines;
+        if (!(rows = realloc(f->rows, sizeof(size_t) * cap))) {
+            return -1;
+        }
+        f->rows   = rows;
+        f->rowcap = cap;
+    }
+    if (nfield > f->fieldcap) {
+        size_t cap       = f->fieldcap ? f->fieldcap * 2 : 4096;
+        uint32_t *fields = realloc(f->fields, sizeof(uint32_t) * cap);
+
+        if (!fields) {
+            return -1;
+        }
+        f->fields   = fields;
+        f->fieldcap = cap;
+    }
+    return 0;
+}
+
+/**
+ * @brief copyfile_is_escaped
+ *  check that the character at pos is escaped by the preceding backslashes.
+ */
+static inline int copyfile_is_escaped(const char *data, size_t head,
+                                      size_t pos)
+{
+    size_t n = 0;
+
+    while (pos > head && data[pos - 1] == '\\') {
+        pos--;
+        n++;
+    }
+    return n & 1;
+}
+
+/**
+ * @brief copyfile_add
+ *  add the delimiter or the newline at pos to the index.
+ * @return int 0 on success, 1 if the end-of-data marker is found, otherwise
+ *  -1.
+ */
+static inline int copyfile_add(copyfile_t *f, size_t *head, size_t pos)
+{
+    const char *data = f->data;
+
+    if (data[pos] != '\n' && copyfile_is_escaped(data, *head, pos)) {
+        // escaped delimiter
+        return 0;
+    } else if (pos - *head > UINT32_MAX) {
+        errno = ERANGE;
+        return -1;
+    } else if (copyfile_grow(f, f->nrow + 2, f->nfield + 1)) {
+        return -1;
+    } else if (data[pos] != '\n') {
+        // start of the next field
+        f->fields[f->nfield++] = pos - *head + 1;
+        return 0;
+    } else if (pos - *head == 2 && data[*head] == '\\' &&
+               data[*head + 1] == '.') {
+        // end-of-data marker
+        f->nfield = f->rows[f->nrow];
+        return 1;
+    }
+
+    // end of the line
+    f->fields[f->nfield++] = pos - *head + 1;
+    f->nrow++;
+    *head             = pos + 1;
+    f->lines[f->nrow] = *head;
+    f->rows[f->nrow]  = f->nfield;
+    return 0;
+}
+
+/**
+ * @brief copyfile_index
+ *  build the row and field offset index by scanning the newlines and the
+ *  delimiters.
+ * @return int 0 on success, otherwise -1.
+ */
+static int copyfile_index(copyfile_t *f)
+{
+    const char *data = f->data;
+    size_t size      = f->size;
+    size_t head      = 0;
+    size_t pos       = 0;
+    int rc           = 0;
+
+    if (copyfile_grow(f, 1, 0)) {
+        return -1;
+    }
+    f->lines[0] = 0;
+    f->rows[0]  = 0;
+
+#if defined(__SSE2__)
+    {
+        __m128i nl = _mm_set1_epi8('\n');
+        __m128i dl = _mm_set1_epi8(f->delim);
+
+        for (; pos + 16 <= size; pos += 16) {
+            __m128i v     = _mm_loadu_si128((const __m128i *)(data + pos));
+            unsigned mask = _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, dl)));
+
+            while (mask) {
+                int i = __builtin_ctz(mask);
+                mask &= mask - 1;
+                if ((rc = copyfile_add(f, &head, pos + i))) {
+                    return rc < 0 ? -1 : 0;
+                }
+            }
+        }
+    }
+#endif
+
+    for (; pos < size; pos++) {
+        if (data[pos] == '\n' || data[pos] == f->delim) {
+            if ((rc = copyfile_add(f, &head, pos))) {
+                return rc < 0 ? -1 : 0;
+            }
+        }
+    }
+
+    if (head < size) {
+        // last line that is not terminated by a newline
+        if (size - head == 2 && data[head] == '\\' && data[head + 1] == '.') {
+            f->nfield = f->rows[f->nrow];
+            return 0;
+        } else if (size - head > UINT32_MAX) {
+            errno = ERANGE;
+            return -1;
+        } else if (copyfile_grow(f, f->nrow + 2, f->nfield + 1)) {
+            return -1;
+        }
+        f->fields[f->nfield++] = size - head + 1;
+        f->nrow++;
+        f->lines[f->nrow] = size + 1;
+        f->rows[f->nrow]  = f->nfield;
+    }
+    return 0;
+}
+
+/**
+ * @brief copyfile_push_field
+ *  push the decoded value of the field. the decoders, context object and
+ *  the decoder cache must be placed at index 4, 5 and 6 of the stack.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static int copyfile_push_field(lua_State *L, copyfile_t *f, size_t row,
+                               size_t col)
+{
+    size_t idx       = f->rows[row] + col - 1;
+    const char *line = f->data + f->lines[row];
+    const char *head = line + (col > 1 ? f->fields[idx - 1] : 0);
+    const char *tail = line + f->fields[idx] - 1;
+
+    if (tail - head == 2 && head[0] == '\\' && head[1] == 'N') {
+        // \N is NULL
+        lua_pushnil(L);
+        return 0;
+    } else if (memchr(head, '\\', tail - head)) {
+        decode_copy_unescape(L, head, tail);
+    } else {
+        lua_pushlstring(L, head, tail - head);
+    }
+    return decode_field(L, COPYFILE_MT, 4, 5, 6, col, 0);
+}
+
+static copyfile_t *copyfile_check(lua_State *L)
+{
+    copyfile_t *f = luaL_checkudata(L, 1, COPYFILE_MT);
+
+    if (!f->lines) {
+        luaL_error(L, "attempt to use a closed " COPYFILE_MT);
+    }
+    return f;
+}
+
+/**
+ * @brief copyfile_pushenv
+ *  push the decoders, context object and the decoder cache to the stack at
+ *  index 4, 5 and 6.
+ */
+static void copyfile_pushenv(lua_State *L, copyfile_t *f)
+{
+    lua_settop(L, 3);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, f->ref);
+    lua_rawgeti(L, 4, 1);
+    lua_rawgeti(L, 4, 2);
+    lua_rawgeti(L, 4, 3);
+    lua_remove(L, 4);
+}
+
+static int copyfile_field_lua(lua_State *L)
+{
+    copyfile_t *f = copyfile_check(L);
+    lua_Integer i = lauxh_checkinteger(L, 2);
+    lua_Integer j = lauxh_checkinteger(L, 3);
+
+    if (i < 1 || (size_t)i > f->nrow || j < 1 ||
+        (size_t)j > f->rows[i] - f->rows[i - 1]) {
+        lua_pushnil(L);
+        return 1;
+    }
+    copyfile_pushenv(L, f);
+    if (copyfile_push_field(L, f, i - 1, j)) {
+        return lua_gettop(L);
+    }
+    return 1;
+}
+
+static int copyfile_row_lua(lua_State *L)
+{
+    copyfile_t *f = copyfile_check(L);
+    lua_Integer i = lauxh_checkinteger(L, 2);
+    size_t nfield = 0;
+
+    if (i < 1 || (size_t)i > f->nrow) {
+        lua_pushnil(L);
+        return 1;
+    }
+    copyfile_pushenv(L, f);
+    nfield = f->rows[i] - f->rows[i - 1];
+    lua_createtable(L, nfield, 0);
+    for (size_t j = 1; j <= nfield; j++) {
+        if (copyfile_push_field(L, f, i - 1, j)) {
+            return lua_gettop(L);
+        }
+        lua_rawseti(L, -2, j);
+    }
+    return 1;
+}
+
+static int copyfile_nfield_lua(lua_State *L)
+{
+    copyfile_t *f = copyfile_check(L);
+    lua_Integer i = lauxh_checkinteger(L, 2);
+
+    if (i < 1 || (size_t)i > f->nrow) {
+        lua_pushinteger(L, 0);
+    } else {
+        lua_pushinteger(L, f->rows[i] - f->rows[i - 1]);
+    }
+    return 1;
+}
+
+static int copyfile_nrow_lua(lua_State *L)
+{
+    copyfile_t *f = copyfile_check(L);
+    lua_pushinteger(L, f->nrow);
+    return 1;
+}
+
+static void copyfile_free(lua_State *L, copyfile_t *f)
+{
+    if (f->data) {
+        munmap((void *)f->data, f->size);
+        f->data = NULL;
+    }
+    free(f->lines);
+    free(f->rows);
+    free(f->fields);
+    f->lines  = NULL;
+    f->rows   = NULL;
+    f->fields = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, f->ref);
+    f->ref = LUA_NOREF;
+}
+
+static int copyfile_close_lua(lua_State *L)
+{
+    copyfile_t *f = luaL_checkudata(L, 1, COPYFILE_MT);
+    copyfile_free(L, f);
+    return 0;
+}
+
+static int copyfile_gc_lua(lua_State *L)
+{
+    copyfile_free(L, lua_touserdata(L, 1));
+    return 0;
+}
+
+static int copyfile_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, COPYFILE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int decode_copyfile_lua(lua_State *L)
+{
+    const char *pathname = lauxh_checkstring(L, 1);
+    copyfile_t *f        = NULL;
+    struct stat st       = {0};
+    int fd               = -1;
+
+    lua_settop(L, 4);
+    if (!lua_isnil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+    }
+
+    f  = lua_newuserdata(L, sizeof(copyfile_t));
+    *f = (copyfile_t){
+        .delim = '\t',
+        .ref   = LUA_NOREF,
+    };
+    luaL_getmetatable(L, COPYFILE_MT);
+    lua_setmetatable(L, -2);
+    if (decode_copy_delim(L, COPYFILE_MT, 4, &f->delim)) {
+        return lua_gettop(L);
+    }
+
+    // resolve the built-in decoders in advance
+    lua_newtable(L);
+    if (!lua_isnil(L, 2)) {
+        lua_pushnil(L);
+        while (lua_next(L, 2)) {
+            if (lua_type(L, -1) == LUA_TSTRING) {
+                decode_field_builtin(L, 6, 2);
+            }
+            lua_pop(L, 1);
+        }
+    }
+    // environment table: {decoders, ctx, cache}
+    lua_createtable(L, 3, 0);
+    lua_pushvalue(L, 2);
+    lua_rawseti(L, -2, 1);
+    lua_pushvalue(L, 3);
+    lua_rawseti(L, -2, 2);
+    lua_pushvalue(L, 6);
+    lua_rawseti(L, -2, 3);
+    f->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_pop(L, 1);
+
+    // map the file
+    if ((fd = open(pathname, O_RDONLY)) == -1) {
+        return decode_error(L, COPYFILE_MT, errno, "failed to open '%s'",
+                            pathname);
+    } else if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        return decode_error(L, COPYFILE_MT, err, "failed to stat '%s'",
+                            pathname);
+    } else if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            return decode_error(L, COPYFILE_MT, err, "failed to map '%s'",
+                                pathname);
+        }
+        f->data = data;
+        f->size = st.st_size;
+#if defined(MADV_SEQUENTIAL)
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+#endif
+    }
+    close(fd);
+
+    if (copyfile_index(f)) {
+        return decode_error(L, COPYFILE_MT, errno,
+                            "failed to build the index of '%s'", pathname);
+    }
+#if defined(MADV_RANDOM)
+    if (f->data) {
+        // rows are accessed randomly after indexing
+        madvise((void *)f->data, f->size, MADV_RANDOM);
+    }
+#endif
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_copyfile(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       copyfile_gc_lua      },
+        {"__len",      copyfile_nrow_lua    },
+        {"__tostring", copyfile_tostring_lua},
+        {NULL,         NULL                 }
+    };
+    struct luaL_Reg method[] = {
+        {"nrow",   copyfile_nrow_lua  },
+        {"nfield", copyfile_nfield_lua},
+        {"field",  copyfile_field_lua },
+        {"row",    copyfile_row_lua   },
+        {"close",  copyfile_close_lua },
+        {NULL,     NULL               }
+    };
+
+    lua_errno_loadlib(L);
+
+    // create metatable for the copy file reader
+    if (luaL_newmetatable(L, COPYFILE_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            DECODE_STATS_WRAP(L, "postgres.decode.copyfile", ptr->name);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, decode_copyfile_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.copyfile", NULL);
+    return 1;
+}
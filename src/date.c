@@ -24,14 +24,16 @@
 
 static int decode_date_lua(lua_State *L)
 {
-    size_t len           = 0;
-    const char *str      = lauxh_checklstring(L, 1, &len);
-    int is_dmy           = lauxh_optboolean(L, 2, 0);
-    datum_timestamp_t ts = {0};
+    static const char *op = "postgres.decode.date";
+    size_t len            = 0;
+    const char *str       = lauxh_checklstring(L, 1, &len);
+    int is_dmy            = lauxh_optboolean(L, 2, 0);
+    datum_timestamp_t ts  = {0};
+    pgdec_error_t err     = {0};
 
     lua_settop(L, 1);
-    if (decode_date(&ts, L, "postgres.decode.date", str, len, is_dmy)) {
-        return 2;
+    if (decode_date(&ts, &err, str, len, is_dmy)) {
+        return decode_error_from(L, op, &err);
     }
     lua_createtable(L, 0, 3);
     lauxh_pushint2tbl(L, "year", ts.year);
@@ -44,5 +46,6 @@ LUALIB_API int luaopen_postgres_decode_date(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_date_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.date", NULL);
     return 1;
 }
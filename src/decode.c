@@ -0,0 +1,899 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_field.h"
+#include "lua_postgres_decode_limits.h"
+#include "lua_postgres_decode_yield.h"
+#include <string.h>
+
+// decoder dispatcher by the type oid.
+// the built-in decoders are resolved at the first use.
+
+#define REGISTRY_MT "postgres.decode.registry"
+
+enum {
+    // return the string as is
+    DECODE_OID_TEXT = 0,
+    // built-in decoder
+    DECODE_OID_BUILTIN,
+    // array of the element type
+    DECODE_OID_ARRAY,
+    // range of the element type
+    DECODE_OID_RANGE,
+    // multirange of the element type
+    DECODE_OID_MULTIRANGE,
+    // registered decoder function
+    DECODE_OID_FUNCTION,
+};
+
+#ifdef POSTGRES_DECODE_AMALGAMATE
+// all decoder modules that are linked into the amalgamated library
+# define DECODE_MODULES(X)                                                     \
+    X(array)                                                                   \
+    X(bit)                                                                     \
+    X(bool)                                                                    \
+    X(box)                                                                     \
+    X(bulk)                                                                    \
+    X(bytea)                                                                   \
+    X(cache)                                                                   \
+    X(circle)                                                                  \
+    X(copy)                                                                    \
+    X(copy_binary)                                                             \
+    X(copyfile)                                                                \
+    X(date)                                                                    \
+    X(dict)                                                                    \
+    X(ffi)                                                                     \
+    X(float)                                                                   \
+    X(hstore)                                                                  \
+    X(inet)                                                                    \
+    X(int)                                                                     \
+    X(json)                                                                    \
+    X(line)                                                                    \
+    X(lseg)                                                                    \
+    X(macaddr)                                                                 \
+    X(multirange)                                                              \
+    X(path)                                                                    \
+    X(point)                                                                   \
+    X(polygon)                                                                 \
+    X(range)                                                                   \
+    X(record)                                                                  \
+    X(stream)                                                                  \
+    X(time)                                                                    \
+    X(timestamp)                                                               \
+    X(tsvector)                                                                \
+    X(uuid)                                                                    \
+    X(uuid_array)                                                              \
+    X(validate)
+
+# define DECODE_MODULE_DECL(name)                                              \
+    LUALIB_API int luaopen_postgres_decode_##name(lua_State *L);
+DECODE_MODULES(DECODE_MODULE_DECL)
+# undef DECODE_MODULE_DECL
+
+/**
+ * @brief decode_preload_modules
+ *  register the entry points of the decoder modules to package.preload, so
+ *  that require() of the module names resolves to this library.
+ */
+static void decode_preload_modules(lua_State *L)
+{
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "preload");
+# define DECODE_MODULE_PRELOAD(name)                                           \
+    lua_pushcfunction(L, luaopen_postgres_decode_##name);                      \
+    lua_setfield(L, -2, "postgres.decode." #name);
+    DECODE_MODULES(DECODE_MODULE_PRELOAD)
+# undef DECODE_MODULE_PRELOAD
+    lua_pop(L, 2);
+}
+#endif
+
+typedef struct {
+    uint32_t oid;      // type oid. 0 is the empty slot
+    int kind;          // kind of the decoder
+    uint32_t elem;     // element type oid of the array or (multi)range type
+    char delim;        // delimiter of the array type
+    const char *name;  // name of the built-in decoder
+    int fn;            // reference of the resolved built-in decoder
+    int ref;           // reference of the registered decoder function
+} decode_oid_t;
+
+typedef struct {
+    size_t size;
+    size_t used;
+    decode_oid_t *slots;
+    int array_fn;
+    int range_fn;
+    int multirange_fn;
+    int validate_fn;
+} decode_registry_t;
+
+#define TEXT(oid, arroid)                                                      \
+    {(oid), DECODE_OID_TEXT, 0, 0, NULL, LUA_NOREF, LUA_NOREF},                \
+        {(arroid), DECODE_OID_ARRAY, (oid), ',', NULL, LUA_NOREF, LUA_NOREF}
+#define BUILTIN(oid, arroid, name)                                             \
+    {(oid), DECODE_OID_BUILTIN, 0, 0, (name), LUA_NOREF, LUA_NOREF},           \
+        {(arroid), DECODE_OID_ARRAY, (oid), ',', NULL, LUA_NOREF, LUA_NOREF}
+#define RANGE(oid, arroid, elem)                                               \
+    {(oid), DECODE_OID_RANGE, (elem), 0, NULL, LUA_NOREF, LUA_NOREF},          \
+        {(arroid), DECODE_OID_ARRAY, (oid), ',', NULL, LUA_NOREF, LUA_NOREF}
+#define MULTIRANGE(oid, arroid, elem)                                          \
+    {(oid), DECODE_OID_MULTIRANGE, (elem), 0, NULL, LUA_NOREF, LUA_NOREF},     \
+        {(arroid), DECODE_OID_ARRAY, (oid), ',', NULL, LUA_NOREF, LUA_NOREF}
+
+// 8.1. - 8.17. built-in data types and their array types.
+// https://github.com/postgres/postgres/blob/master/src/include/catalog/pg_type.dat
+static const decode_oid_t DECODE_OIDS[] = {
+    BUILTIN(16, 1000, "bool"),
+    BUILTIN(17, 1001, "bytea"),
+    TEXT(18, 1002),               // char
+    TEXT(19, 1003),               // name
+    BUILTIN(20, 1016, "int"),     // int8
+    BUILTIN(21, 1005, "int"),     // int2
+    BUILTIN(23, 1007, "int"),     // int4
+    TEXT(25, 1009),               // text
+    BUILTIN(26, 1028, "int"),     // oid
+    BUILTIN(114, 199, "json"),
+    TEXT(142, 143),               // xml
+    BUILTIN(600, 1017, "point"),
+    BUILTIN(601, 1018, "lseg"),
+    BUILTIN(602, 1019, "path"),
+    // box array is delimited by semicolon
+    {603,  DECODE_OID_BUILTIN, 0,   0,   "box", LUA_NOREF, LUA_NOREF},
+    {1020, DECODE_OID_ARRAY,   603, ';', NULL,  LUA_NOREF, LUA_NOREF},
+    BUILTIN(604, 1027, "polygon"),
+    BUILTIN(628, 629, "line"),
+    BUILTIN(650, 651, "inet"),    // cidr
+    BUILTIN(700, 1021, "float"),  // float4
+    BUILTIN(701, 1022, "float"),  // float8
+    BUILTIN(718, 719, "circle"),
+    BUILTIN(774, 775, "macaddr"), // macaddr8
+    BUILTIN(829, 1040, "macaddr"),
+    BUILTIN(869, 1041, "inet"),
+    TEXT(1042, 1014),             // bpchar
+    TEXT(1043, 1015),             // varchar
+    BUILTIN(1082, 1182, "date"),
+    BUILTIN(1083, 1183, "time"),
+    BUILTIN(1114, 1115, "timestamp"),
+    BUILTIN(1184, 1185, "timestamp"), // timestamptz
+    BUILTIN(1266, 1270, "time"),      // timetz
+    BUILTIN(1560, 1561, "bit"),
+    BUILTIN(1562, 1563, "bit"),       // varbit
+    TEXT(1700, 1231),                 // numeric
+    BUILTIN(2950, 2951, "uuid"),
+    BUILTIN(3614, 3643, "tsvector"),
+    BUILTIN(3802, 3807, "json"),      // jsonb
+    RANGE(3904, 3905, 23),            // int4range
+    RANGE(3906, 3907, 1700),          // numrange
+    RANGE(3908, 3909, 1114),          // tsrange
+    RANGE(3910, 3911, 1184),          // tstzrange
+    RANGE(3912, 3913, 1082),          // daterange
+    RANGE(3926, 3927, 20),            // int8range
+    MULTIRANGE(4451, 6150, 23),       // int4multirange
+    MULTIRANGE(4532, 6151, 1700),     // nummultirange
+    MULTIRANGE(4533, 6152, 1114),     // tsmultirange
+    MULTIRANGE(4534, 6153, 1184),     // tstzmultirange
+    MULTIRANGE(4535, 6155, 1082),     // datemultirange
+    MULTIRANGE(4536, 6157, 20),       // int8multirange
+};
+
+#undef TEXT
+#undef BUILTIN
+#undef RANGE
+#undef MULTIRANGE
+
+static inline size_t registry_hash(decode_registry_t *r, uint32_t oid)
+{
+    return (oid * 2654435761U) & (r->size - 1);
+}
+
+static decode_oid_t *registry_lookup(decode_registry_t *r, uint32_t oid)
+{
+    size_t i = registry_hash(r, oid);
+
+    while (r->slots[i].oid) {
+        if (r->slots[i].oid == oid) {
+            return &r->slots[i];
+        }
+        i = (i + 1) & (r->size - 1);
+    }
+    return NULL;
+}
+
+static decode_oid_t *registry_slot(decode_registry_t *r, uint32_t oid)
+{
+    size_t i = registry_hash(r, oid);
+
+    while (r->slots[i].oid && r->slots[i].oid != oid) {
+        i = (i + 1) & (r->size - 1);
+    }
+    return &r->slots[i];
+}
+
+/**
+ * @brief registry_set
+ *  set the decoder of the type oid. the previous decoder function of the
+ *  type is released.
+ * @return int 0 on success, otherwise -1 and errno is set.
+ */
+static int registry_set(lua_State *L, decode_registry_t *r,
+                        const decode_oid_t *entry)
+{
+    decode_oid_t *slot = NULL;
+
+    // keep the load factor below 0.5
+    if ((r->used + 1) * 2 > r->size) {
+        size_t size          = r->size ? r->size * 2 : 256;
+        decode_oid_t *slots  = calloc(size, sizeof(decode_oid_t));
+        decode_registry_t nr = *r;
+        size_t i             = 0;
+
+        if (!slots) {
+            return -1;
+        }
+        nr.size  = size;
+        nr.slots = slots;
+        for (; i < r->size; i++) {
+            if (r->slots[i].oid) {
+                *registry_slot(&nr, r->slots[i].oid) = r->slots[i];
+            }
+        }
+        free(r->slots);
+        *r = nr;
+    }
+
+    slot = registry_slot(r, entry->oid);
+    if (slot->oid) {
+        luaL_unref(L, LUA_REGISTRYINDEX, slot->fn);
+        luaL_unref(L, LUA_REGISTRYINDEX, slot->ref);
+    } else {
+        r->used++;
+    }
+    *slot = *entry;
+    return 0;
+}
+
+/**
+ * @brief registry_call
+ *  call the built-in decoder of the name with the arguments on the stack.
+ *  the decoder is resolved at the first call, and its reference is stored
+ *  in fn.
+ *  the decoder must be called as a lua function, since it refers to its own
+ *  upvalues, and it must not yield across this function.
+ * @return int the number of the return values.
+ */
+static int registry_call(lua_State *L, int *fn, const char *name)
+{
+    if (*fn == LUA_NOREF) {
+        // require('postgres.decode.<name>')
+        lua_getglobal(L, "require");
+        lua_pushfstring(L, "postgres.decode.%s", name);
+        lua_call(L, 1, 1);
+        *fn = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, *fn);
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
+static int decode_oid_call(lua_State *L, decode_registry_t *r,
+                           decode_oid_t *e);
+static int fastfail_lua(lua_State *L);
+
+// built-in decoders that accept the destination table as the second argument
+static const char *DECODE_DST_BUILTINS[] = {
+    "bit",  "box",   "circle",  "hstore", "inet",      "line",     "lseg",
+    "path", "point", "polygon", "time",   "timestamp", "tsvector", NULL,
+};
+
+/**
+ * @brief decode_accepts_dst
+ *  return non-zero if the built-in decoder accepts the destination table.
+ */
+static int decode_accepts_dst(const char *name)
+{
+    int i = 0;
+
+    for (; DECODE_DST_BUILTINS[i]; i++) {
+        if (strcmp(name, DECODE_DST_BUILTINS[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief decode_elem_lua
+ *  decode the element of the array or range type by the decoder of the
+ *  element type oid that passed as the context object.
+ */
+static int decode_elem_lua(lua_State *L)
+{
+    decode_registry_t *r = lua_touserdata(L, lua_upvalueindex(1));
+    size_t len           = 0;
+    const char *str      = lua_tolstring(L, 1, &len);
+    decode_oid_t *e      = registry_lookup(r, lua_tointeger(L, 3));
+    int nres             = 0;
+
+    if (lua_toboolean(L, 2)) {
+        // unquote the element: "foo \"bar\"" or "foo ""bar"""
+        const char *tail = str + len - 1;
+        const char *head = ++str;
+        luaL_Buffer b;
+
+        luaL_buffinit(L, &b);
+        while (str < tail) {
+            if (*str == '\\' || (*str == '"' && str[1] == '"')) {
+                luaL_addlstring(&b, head, str - head);
+                head = ++str;
+            }
+            str++;
+        }
+        luaL_addlstring(&b, head, str - head);
+        luaL_pushresult(&b);
+        lua_replace(L, 1);
+    }
+    lua_settop(L, 1);
+    if (!e) {
+        return 1;
+    }
+
+    nres = decode_oid_call(L, r, e);
+    if (nres == 2 && lua_isnil(L, -2) && !lua_isnil(L, -1) &&
+        lua_type(L, -1) != LUA_TSTRING) {
+        // convert the error object to string for the array and range decoder
+        if (luaL_callmeta(L, -1, "__tostring")) {
+            lua_replace(L, -2);
+        }
+    }
+    return nres;
+}
+
+/**
+ * @brief decode_oid_call
+ *  decode the string at index 1 of the stack by the decoder of the entry.
+ *  the stack must have only the string, or the string and the destination
+ *  table at index 2. the destination table is ignored if the decoder does
+ *  not accept it. the element decoder must be placed at upvalue 2 of the
+ *  caller.
+ * @return int the number of the return values.
+ */
+static int decode_oid_call(lua_State *L, decode_registry_t *r,
+                           decode_oid_t *e)
+{
+    int dst = lua_gettop(L) > 1;
+
+    switch (e->kind) {
+    case DECODE_OID_BUILTIN:
+        if (dst && !decode_accepts_dst(e->name)) {
+            lua_settop(L, 1);
+        }
+        return registry_call(L, &e->fn, e->name);
+
+    case DECODE_OID_ARRAY:
+        lua_pushvalue(L, lua_upvalueindex(2));
+        lua_pushinteger(L, e->elem);
+        lua_pushlstring(L, &e->delim, 1);
+        if (dst) {
+            // array(str, fn, ctx, delim, dst)
+            lua_pushvalue(L, 2);
+            lua_remove(L, 2);
+        }
+        return registry_call(L, &r->array_fn, "array");
+
+    case DECODE_OID_RANGE:
+        lua_pushvalue(L, lua_upvalueindex(2));
+        lua_pushinteger(L, e->elem);
+        if (dst) {
+            // range(str, fn, ctx, dst)
+            lua_pushvalue(L, 2);
+            lua_remove(L, 2);
+        }
+        return registry_call(L, &r->range_fn, "range");
+
+    case DECODE_OID_MULTIRANGE:
+        lua_pushvalue(L, lua_upvalueindex(2));
+        lua_pushinteger(L, e->elem);
+        if (dst) {
+            // multirange(str, fn, ctx, packed, dst)
+            lua_pushnil(L);
+            lua_pushvalue(L, 2);
+            lua_remove(L, 2);
+        }
+        return registry_call(L, &r->multirange_fn, "multirange");
+
+    case DECODE_OID_FUNCTION:
+        lua_settop(L, 1);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, e->ref);
+        lua_insert(L, 1);
+        lua_call(L, 1, LUA_MULTRET);
+        return lua_gettop(L);
+
+    default:
+        // DECODE_OID_TEXT
+        lua_settop(L, 1);
+        return 1;
+    }
+}
+
+static int decode_lua(lua_State *L)
+{
+    decode_registry_t *r = lua_touserdata(L, lua_upvalueindex(1));
+    lua_Integer oid      = luaL_checkinteger(L, 1);
+    decode_oid_t *e      = NULL;
+
+    luaL_checktype(L, 2, LUA_TSTRING);
+    lua_settop(L, 3);
+    lua_remove(L, 1);
+    if (!lua_istable(L, 2)) {
+        lua_settop(L, 1);
+    }
+    if (oid <= 0 || oid > UINT32_MAX ||
+        !(e = registry_lookup(r, (uint32_t)oid))) {
+        // unknown type is returned as is
+        lua_settop(L, 1);
+        return 1;
+    }
+    return decode_oid_call(L, r, e);
+}
+
+// built-in decoders that have no validator in postgres.decode.validate
+static const char *DECODE_NO_VALIDATOR[] = {
+    "inet", "json", "macaddr", "uuid", NULL,
+};
+
+/**
+ * @brief decode_validator
+ *  return the name of the validator of the entry, or NULL if the entry has
+ *  no validator.
+ */
+static const char *decode_validator(decode_oid_t *e)
+{
+    int i = 0;
+
+    if (e->kind != DECODE_OID_BUILTIN) {
+        return NULL;
+    }
+    for (; DECODE_NO_VALIDATOR[i]; i++) {
+        if (strcmp(e->name, DECODE_NO_VALIDATOR[i]) == 0) {
+            return NULL;
+        }
+    }
+    return e->name;
+}
+
+static int validate_lua(lua_State *L)
+{
+    decode_registry_t *r = lua_touserdata(L, lua_upvalueindex(1));
+    lua_Integer oid       = luaL_checkinteger(L, 1);
+    decode_oid_t *e       = NULL;
+    decode_oid_t *elem    = NULL;
+    const char *name      = NULL;
+
+    luaL_checktype(L, 2, LUA_TSTRING);
+    lua_settop(L, 2);
+    lua_remove(L, 1);
+    if (oid <= 0 || oid > UINT32_MAX ||
+        !(e = registry_lookup(r, (uint32_t)oid)) ||
+        e->kind == DECODE_OID_TEXT) {
+        // unknown type and text type are always valid
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+
+    switch (e->kind) {
+    case DECODE_OID_ARRAY:
+    case DECODE_OID_RANGE:
+    case DECODE_OID_MULTIRANGE:
+        name = (e->kind == DECODE_OID_ARRAY) ? "array" :
+               (e->kind == DECODE_OID_RANGE) ? "range" :
+                                               "multirange";
+        elem = registry_lookup(r, e->elem);
+        if (!elem || elem->kind == DECODE_OID_TEXT ||
+            elem->kind == DECODE_OID_RANGE ||
+            elem->kind == DECODE_OID_MULTIRANGE) {
+            // validate the structure only. the elements of the range and
+            // multirange types are not validated, because the validator
+            // does not accept the nested container types.
+            elem = NULL;
+        } else if (!decode_validator(elem)) {
+            name = NULL;
+        }
+        break;
+
+    default:
+        name = decode_validator(e);
+    }
+
+    if (name) {
+        // validate(type, str [, elemtype [, delim]])
+        lua_pushstring(L, name);
+        lua_insert(L, 1);
+        if (elem) {
+            lua_pushstring(L, elem->name);
+        } else {
+            lua_pushnil(L);
+        }
+        lua_pushlstring(L, e->delim ? &e->delim : ",", 1);
+        return registry_call(L, &r->validate_fn, "validate");
+    }
+
+    // validate by decoding the value in the fast-fail mode if the type has
+    // no validator, so that the position is returned if the error has one.
+    lua_settop(L, 1);
+    lua_pushcfunction(L, fastfail_lua);
+    lua_pushvalue(L, lua_upvalueindex(3));
+    lua_pushinteger(L, oid);
+    lua_pushvalue(L, 1);
+    lua_call(L, 3, 3);
+    if (lua_isnil(L, 2) && !lua_isnil(L, 3)) {
+        lua_pushboolean(L, 0);
+        if (lua_type(L, 4) == LUA_TNUMBER) {
+            lua_pushvalue(L, 4);
+            return 2;
+        }
+        return 1;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int register_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.register";
+    decode_registry_t *r  = lua_touserdata(L, lua_upvalueindex(1));
+    lua_Integer oid       = luaL_checkinteger(L, 1);
+    lua_Integer arroid    = luaL_optinteger(L, 3, 0);
+    decode_oid_t entry    = {
+        .oid  = (uint32_t)oid,
+        .kind = DECODE_OID_FUNCTION,
+        .fn   = LUA_NOREF,
+        .ref  = LUA_NOREF,
+    };
+
+    luaL_argcheck(L, oid > 0 && oid <= UINT32_MAX, 1, "oid out of range");
+    luaL_argcheck(L, arroid >= 0 && arroid <= UINT32_MAX && arroid != oid, 3,
+                  "invalid array type oid");
+    lua_settop(L, 2);
+    switch (lua_type(L, 2)) {
+    case LUA_TSTRING: {
+        const char *name = lua_tostring(L, 2);
+        int i            = 0;
+
+        if (strcmp(name, "text") == 0) {
+            entry.kind = DECODE_OID_TEXT;
+            break;
+        }
+        for (; DECODE_FIELD_BUILTINS[i]; i++) {
+            if (strcmp(name, DECODE_FIELD_BUILTINS[i]) == 0) {
+                break;
+            }
+        }
+        if (!DECODE_FIELD_BUILTINS[i]) {
+            return luaL_argerror(
+                L, 2, lua_pushfstring(L, "unknown decoder name '%s'", name));
+        }
+        entry.kind = DECODE_OID_BUILTIN;
+        entry.name = DECODE_FIELD_BUILTINS[i];
+    } break;
+
+    case LUA_TFUNCTION:
+        entry.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        break;
+
+    case LUA_TTABLE:
+    case LUA_TUSERDATA:
+        // callable object such as postgres.decode.cache
+        if (luaL_getmetafield(L, 2, "__call")) {
+            lua_pop(L, 1);
+            entry.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+            break;
+        }
+        // fall through
+
+    default:
+        return luaL_argerror(
+            L, 2,
+            lua_pushfstring(L, "string or function expected, got %s",
+                            luaL_typename(L, 2)));
+    }
+
+    if (registry_set(L, r, &entry) ||
+        (arroid &&
+         registry_set(L, r,
+                      &(decode_oid_t){
+                          .oid   = (uint32_t)arroid,
+                          .kind  = DECODE_OID_ARRAY,
+                          .elem  = (uint32_t)oid,
+                          .delim = ',',
+                          .fn    = LUA_NOREF,
+                          .ref   = LUA_NOREF,
+                      }))) {
+        return decode_error(L, op, errno, NULL);
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * @brief stats_lua
+ *  return the statistics of the decoders. if reset is true, the statistics
+ *  are reset after they are returned. the statistics are counted only if
+ *  POSTGRES_DECODE_STATS is defined.
+ */
+static int stats_lua(lua_State *L)
+{
+    int reset = lua_toboolean(L, 1);
+
+    lua_settop(L, 0);
+    lua_newtable(L);
+#ifdef POSTGRES_DECODE_STATS
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_STATS);
+    if (lua_istable(L, 2)) {
+        lua_pushnil(L);
+        while (lua_next(L, 2)) {
+            decode_stats_t *s = lua_touserdata(L, -1);
+
+            lua_pop(L, 1);
+            lua_pushvalue(L, -1);
+            lua_createtable(L, 0, 7);
+            lauxh_pushint2tbl(L, "calls", s->ncall);
+            lauxh_pushint2tbl(L, "bytes", s->nbyte);
+            lauxh_pushint2tbl(L, "tables", s->ntable);
+            lauxh_pushint2tbl(L, "strings", s->nstring);
+            lauxh_pushint2tbl(L, "alloc", s->nalloc);
+            lauxh_pushint2tbl(L, "errors", s->nerror);
+            lauxh_pushnum2tbl(L, "time", s->time);
+            lua_rawset(L, 1);
+            if (reset) {
+                *s = (decode_stats_t){0};
+            }
+        }
+    }
+    lua_settop(L, 1);
+#else
+    (void)reset;
+#endif
+    return 1;
+}
+
+/**
+ * @brief fastfail_lua
+ *  call the function with the rest of the arguments in the fast-fail mode,
+ *  and return the values that returned from the function. in the fast-fail
+ *  mode, the decoders return nil, the error number and the position of the
+ *  invalid character (if known) instead of nil and the error object.
+ *  the previous mode is restored after the call even if the function throws
+ *  an error.
+ */
+static int fastfail_lua(lua_State *L)
+{
+    int enabled = decode_fastfail(L);
+    int rc      = 0;
+
+    if (lua_type(L, 1) != LUA_TFUNCTION) {
+        if (!luaL_getmetafield(L, 1, "__call")) {
+            return luaL_argerror(
+                L, 1,
+                lua_pushfstring(L, "function expected, got %s",
+                                luaL_typename(L, 1)));
+        }
+        lua_pop(L, 1);
+    }
+
+    lua_pushboolean(L, 1);
+    lua_setfield(L, LUA_REGISTRYINDEX, DECODE_FASTFAIL);
+    rc = lua_pcall(L, lua_gettop(L) - 1, LUA_MULTRET, 0);
+    lua_pushboolean(L, enabled);
+    lua_setfield(L, LUA_REGISTRYINDEX, DECODE_FASTFAIL);
+    if (rc) {
+        return lua_error(L);
+    }
+    return lua_gettop(L);
+}
+
+/**
+ * @brief yieldstep_lua
+ *  set the number of the elements that the decoders of the large values
+ *  build before yielding the running coroutine if the argument is passed,
+ *  and return the previous number. 0 disables yielding.
+ */
+static int yieldstep_lua(lua_State *L)
+{
+    lua_Integer n = decode_yieldstep(L);
+
+    if (lua_gettop(L) > 0) {
+        lua_Integer step = luaL_optinteger(L, 1, 0);
+        luaL_argcheck(L, step >= 0, 1, "must be a non-negative integer");
+        lua_pushinteger(L, step);
+        lua_setfield(L, LUA_REGISTRYINDEX, DECODE_YIELDSTEP);
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+// fields of the limits table
+#define LIMITS_FIELDS(X)                                                       \
+    X(elements)                                                                \
+    X(length)                                                                  \
+    X(depth)                                                                   \
+    X(bytes)
+
+static size_t limits_field(lua_State *L, const char *name)
+{
+    lua_Integer v = 0;
+
+    lua_getfield(L, 1, name);
+    if (!lua_isnil(L, -1)) {
+        v = lua_tointeger(L, -1);
+        if (lua_type(L, -1) != LUA_TNUMBER || v < 0 ||
+            (lua_Number)v != lua_tonumber(L, -1)) {
+            return luaL_argerror(
+                L, 1,
+                lua_pushfstring(L, "%s must be a non-negative integer", name));
+        }
+    }
+    lua_pop(L, 1);
+    return (size_t)v;
+}
+
+/**
+ * @brief limits_lua
+ *  set the limits of the values that decoded by the decoders of the large
+ *  values if the argument is passed, and return the previous limits. the
+ *  limits are removed if the argument is nil.
+ */
+static int limits_lua(lua_State *L)
+{
+    int narg             = lua_gettop(L);
+    decode_limits_t *lim = NULL;
+
+    lua_settop(L, 1);
+    // previous limits
+    lua_createtable(L, 0, 4);
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_LIMITS);
+    lim = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (lim) {
+#define PUSH_LIMIT(name)                                                       \
+    if (lim->name) {                                                           \
+        lua_pushinteger(L, (lua_Integer)lim->name);                            \
+        lua_setfield(L, -2, #name);                                            \
+    }
+        LIMITS_FIELDS(PUSH_LIMIT)
+#undef PUSH_LIMIT
+    }
+
+    if (narg > 0) {
+        if (lua_isnil(L, 1)) {
+            lua_pushnil(L);
+        } else {
+            decode_limits_t v = {0};
+
+            luaL_checktype(L, 1, LUA_TTABLE);
+#define CHECK_LIMIT(name) v.name = limits_field(L, #name);
+            LIMITS_FIELDS(CHECK_LIMIT)
+#undef CHECK_LIMIT
+            lim  = lua_newuserdata(L, sizeof(decode_limits_t));
+            *lim = v;
+        }
+        lua_setfield(L, LUA_REGISTRYINDEX, DECODE_LIMITS);
+    }
+    return 1;
+}
+
+static int registry_gc_lua(lua_State *L)
+{
+    decode_registry_t *r = lua_touserdata(L, 1);
+
+    if (r->slots) {
+        size_t i = 0;
+        for (; i < r->size; i++) {
+            if (r->slots[i].oid) {
+                luaL_unref(L, LUA_REGISTRYINDEX, r->slots[i].fn);
+                luaL_unref(L, LUA_REGISTRYINDEX, r->slots[i].ref);
+            }
+        }
+        free(r->slots);
+        r->slots = NULL;
+    }
+    luaL_unref(L, LUA_REGISTRYINDEX, r->array_fn);
+    luaL_unref(L, LUA_REGISTRYINDEX, r->range_fn);
+    luaL_unref(L, LUA_REGISTRYINDEX, r->multirange_fn);
+    luaL_unref(L, LUA_REGISTRYINDEX, r->validate_fn);
+    r->array_fn      = LUA_NOREF;
+    r->range_fn      = LUA_NOREF;
+    r->multirange_fn = LUA_NOREF;
+    r->validate_fn   = LUA_NOREF;
+    return 0;
+}
+
+LUALIB_API int luaopen_postgres_decode(lua_State *L)
+{
+    decode_registry_t *r = NULL;
+    size_t i             = 0;
+
+    lua_errno_loadlib(L);
+#ifdef POSTGRES_DECODE_AMALGAMATE
+    decode_preload_modules(L);
+#endif
+
+    // create registry of the decoders
+    r  = lua_newuserdata(L, sizeof(decode_registry_t));
+    *r = (decode_registry_t){
+        .array_fn      = LUA_NOREF,
+        .range_fn      = LUA_NOREF,
+        .multirange_fn = LUA_NOREF,
+        .validate_fn   = LUA_NOREF,
+    };
+    if (luaL_newmetatable(L, REGISTRY_MT)) {
+        lua_pushcfunction(L, registry_gc_lua);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_setmetatable(L, -2);
+    for (; i < sizeof(DECODE_OIDS) / sizeof(DECODE_OIDS[0]); i++) {
+        if (registry_set(L, r, &DECODE_OIDS[i])) {
+            return luaL_error(L, "failed to create the registry: %s",
+                              strerror(errno));
+        }
+    }
+
+    lua_createtable(L, 0, 7);
+    // decode(oid, str)
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -3);
+    lua_pushnil(L);
+    lua_pushcclosure(L, decode_elem_lua, 2);
+    // the element decoder refers to itself to decode the nested types
+    lua_pushvalue(L, -1);
+    lua_setupvalue(L, -2, 2);
+    // validate(oid, str)
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    // decode(oid, str) for the types that have no validator
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, decode_lua, 2);
+    lua_pushcclosure(L, validate_lua, 3);
+    lua_setfield(L, -4, "validate");
+    lua_pushcclosure(L, decode_lua, 2);
+    DECODE_STATS_WRAP(L, "postgres.decode", NULL);
+    lua_setfield(L, -2, "decode");
+    // register(oid, decoder [, arroid])
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, register_lua, 1);
+    lua_setfield(L, -2, "register");
+    // stats([reset])
+    lua_pushcfunction(L, stats_lua);
+    lua_setfield(L, -2, "stats");
+    // fastfail(fn, ...)
+    lua_pushcfunction(L, fastfail_lua);
+    lua_setfield(L, -2, "fastfail");
+    // yieldstep([n])
+    lua_pushcfunction(L, yieldstep_lua);
+    lua_setfield(L, -2, "yieldstep");
+    // limits([limits])
+    lua_pushcfunction(L, limits_lua);
+    lua_setfield(L, -2, "limits");
+    return 1;
+}
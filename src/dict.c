@@ -0,0 +1,152 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_dict.h"
+
+// the dictionary object is passed to decode.array and decode.hstore in
+// place of the element decoder to decode the strings into the codes.
+
+static int dict_encode_lua(lua_State *L)
+{
+    dict_t *d        = decode_dict_check(L, 1);
+    size_t len       = 0;
+    const char *str  = lauxh_checklstring(L, 2, &len);
+    lua_Integer code = decode_dict_encode(L, d, str, len);
+
+    if (code < 0) {
+        return decode_error(L, DICT_MT, errno, NULL);
+    }
+    lua_pushinteger(L, code);
+    return 1;
+}
+
+static int dict_code_lua(lua_State *L)
+{
+    dict_t *d         = decode_dict_check(L, 1);
+    size_t len        = 0;
+    const char *str   = lauxh_checklstring(L, 2, &len);
+    dict_slot_t *slot = NULL;
+
+    if (d->len) {
+        slot = decode_dict_lookup(d, str, len, decode_dict_hash(str, len));
+        if (slot->code) {
+            lua_pushinteger(L, slot->code);
+            return 1;
+        }
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+static int dict_values_lua(lua_State *L)
+{
+    dict_t *d = decode_dict_check(L, 1);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, d->ref);
+    return 1;
+}
+
+static int dict_len_lua(lua_State *L)
+{
+    dict_t *d = decode_dict_check(L, 1);
+
+    lua_pushinteger(L, d->len);
+    return 1;
+}
+
+static int dict_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, DICT_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int dict_gc_lua(lua_State *L)
+{
+    dict_t *d = lua_touserdata(L, 1);
+
+    free(d->slots);
+    free(d->buf);
+    d->slots = NULL;
+    d->buf   = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, d->ref);
+    d->ref = LUA_NOREF;
+    return 0;
+}
+
+static int decode_dict_lua(lua_State *L)
+{
+    dict_t *d = NULL;
+
+    lua_settop(L, 0);
+    d  = lua_newuserdata(L, sizeof(dict_t));
+    *d = (dict_t){
+        .ref = LUA_NOREF,
+    };
+    luaL_getmetatable(L, DICT_MT);
+    lua_setmetatable(L, -2);
+    // values table
+    lua_newtable(L);
+    d->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_dict(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       dict_gc_lua      },
+        {"__len",      dict_len_lua     },
+        {"__tostring", dict_tostring_lua},
+        {NULL,         NULL             }
+    };
+    struct luaL_Reg method[] = {
+        {"encode", dict_encode_lua},
+        {"code",   dict_code_lua  },
+        {"values", dict_values_lua},
+        {"len",    dict_len_lua   },
+        {NULL,     NULL           }
+    };
+
+    lua_errno_loadlib(L);
+
+    // create metatable for the dictionary
+    if (luaL_newmetatable(L, DICT_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, decode_dict_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.dict", NULL);
+    return 1;
+}
@@ -0,0 +1,387 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode.h"
+
+// the lua module returns the table of the decoders that call the functions
+// of libpgdecode (src/pgdec/pgdec.h) by the LuaJIT FFI. if the FFI is not available, the decoders of
+// the lua C API are returned instead. the error is always created by the
+// decoder of the lua C API.
+static const char PGDEC_FFI_BINDING[] =
+    "local modname = ...\n"
+    "local type = type\n"
+    "local byte = string.byte\n"
+    "local sub = string.sub\n"
+    "local decode_int = require('postgres.decode.int')\n"
+    "local decode_float = require('postgres.decode.float')\n"
+    "local decode_bool = require('postgres.decode.bool')\n"
+    "local decode_date = require('postgres.decode.date')\n"
+    "local decode_time = require('postgres.decode.time')\n"
+    "local decode_timestamp = require('postgres.decode.timestamp')\n"
+    "local decode_point = require('postgres.decode.point')\n"
+    "local decode_line = require('postgres.decode.line')\n"
+    "local decode_lseg = require('postgres.decode.lseg')\n"
+    "local decode_box = require('postgres.decode.box')\n"
+    "local decode_circle = require('postgres.decode.circle')\n"
+    "local decode_range = require('postgres.decode.range')\n"
+    "-- the decoders of the lua C API are used if the FFI is not available\n"
+    "local M = {\n"
+    "    int = decode_int,\n"
+    "    float = decode_float,\n"
+    "    bool = decode_bool,\n"
+    "    date = decode_date,\n"
+    "    time = decode_time,\n"
+    "    timestamp = decode_timestamp,\n"
+    "    point = decode_point,\n"
+    "    line = decode_line,\n"
+    "    lseg = decode_lseg,\n"
+    "    box = decode_box,\n"
+    "    circle = decode_circle,\n"
+    "    range = decode_range,\n"
+    "}\n"
+    "\n"
+    "local ok, ffi = pcall(require, 'ffi')\n"
+    "local pathname = ok and package.searchpath(modname, package.cpath)\n"
+    "if not pathname then\n"
+    "    return M\n"
+    "end\n"
+    "\n"
+    "ffi.cdef [[\n"
+    "typedef struct {\n"
+    "    int errnum;\n"
+    "    int c;\n"
+    "    size_t pos;\n"
+    "    const char *msg;\n"
+    "} pgdec_error_t;\n"
+    "typedef struct {\n"
+    "    int year;\n"
+    "    int mon;\n"
+    "    int day;\n"
+    "    int hour;\n"
+    "    int min;\n"
+    "    int sec;\n"
+    "    int usec;\n"
+    "    int tzhour;\n"
+    "    int tzmin;\n"
+    "    int tzsec;\n"
+    "    char tzsign[2];\n"
+    "} pgdec_timestamp_t;\n"
+    "typedef struct {\n"
+    "    double x;\n"
+    "    double y;\n"
+    "} pgdec_point_t;\n"
+    "typedef struct {\n"
+    "    double a;\n"
+    "    double b;\n"
+    "    double c;\n"
+    "} pgdec_line_t;\n"
+    "typedef struct {\n"
+    "    pgdec_point_t p[2];\n"
+    "} pgdec_lseg_t;\n"
+    "typedef struct {\n"
+    "    pgdec_point_t center;\n"
+    "    double radius;\n"
+    "} pgdec_circle_t;\n"
+    "typedef struct {\n"
+    "    int empty;\n"
+    "    int lower_inc;\n"
+    "    int upper_inc;\n"
+    "    size_t lower;\n"
+    "    size_t lower_len;\n"
+    "    size_t upper;\n"
+    "    size_t upper_len;\n"
+    "} pgdec_range_t;\n"
+    "int pgdec_int(const char *str, size_t len, int64_t *v, pgdec_error_t *err);\n"
+    "int pgdec_float(const char *str, size_t len, double *v, pgdec_error_t *err);\n"
+    "int pgdec_bool(const char *str, size_t len, int *v, pgdec_error_t *err);\n"
+    "int pgdec_date(const char *str, size_t len, int is_dmy, pgdec_timestamp_t *v,\n"
+    "               pgdec_error_t *err);\n"
+    "int pgdec_time(const char *str, size_t len, pgdec_timestamp_t *v,\n"
+    "               pgdec_error_t *err);\n"
+    "int pgdec_timestamp(const char *str, size_t len, pgdec_timestamp_t *v,\n"
+    "                    pgdec_error_t *err);\n"
+    "int pgdec_point(const char *str, size_t len, pgdec_point_t *v,\n"
+    "                pgdec_error_t *err);\n"
+    "int pgdec_line(const char *str, size_t len, pgdec_line_t *v,\n"
+    "               pgdec_error_t *err);\n"
+    "int pgdec_lseg(const char *str, size_t len, pgdec_lseg_t *v,\n"
+    "               pgdec_error_t *err);\n"
+    "int pgdec_box(const char *str, size_t len, pgdec_lseg_t *v,\n"
+    "              pgdec_error_t *err);\n"
+    "int pgdec_circle(const char *str, size_t len, pgdec_circle_t *v,\n"
+    "                 pgdec_error_t *err);\n"
+    "int pgdec_range(const char *str, size_t len, pgdec_range_t *v,\n"
+    "                pgdec_error_t *err);\n"
+    "typedef struct {\n"
+    "    int (*open)(void *ctx, int depth, size_t idx);\n"
+    "    int (*close)(void *ctx, int depth, size_t idx, size_t nelem);\n"
+    "    int (*elem)(void *ctx, int depth, size_t idx, const char *str,\n"
+    "                size_t len);\n"
+    "} pgdec_array_visitor_t;\n"
+    "typedef int (*pgdec_hstore_visitor_t)(void *ctx, const char *key,\n"
+    "                                      size_t klen, const char *val,\n"
+    "                                      size_t vlen);\n"
+    "int pgdec_array(const char *str, size_t len, char delim,\n"
+    "                const pgdec_array_visitor_t *v, void *ctx,\n"
+    "                pgdec_error_t *err);\n"
+    "int pgdec_hstore(const char *str, size_t len, pgdec_hstore_visitor_t fn,\n"
+    "                 void *ctx, pgdec_error_t *err);\n"
+    "]]\n"
+    "local lib = ffi.load(pathname)\n"
+    "M.lib = lib\n"
+    "\n"
+    "-- clear the destination table, or create a new table\n"
+    "local clear = select(2, pcall(require, 'table.clear'))\n"
+    "if type(clear) ~= 'function' then\n"
+    "    clear = function(tbl)\n"
+    "        for k in pairs(tbl) do\n"
+    "            tbl[k] = nil\n"
+    "        end\n"
+    "    end\n"
+    "end\n"
+    "\n"
+    "local function newtable(dst)\n"
+    "    if type(dst) == 'table' then\n"
+    "        clear(dst)\n"
+    "        return dst\n"
+    "    end\n"
+    "    return {}\n"
+    "end\n"
+    "\n"
+    "local function subtable(tbl, i)\n"
+    "    local v = tbl[i]\n"
+    "    if type(v) == 'table' then\n"
+    "        clear(v)\n"
+    "        return v\n"
+    "    end\n"
+    "    return {}\n"
+    "end\n"
+    "\n"
+    "-- the values are decoded into the following buffers, and the error is\n"
+    "-- created by calling the decoder of the lua C API again.\n"
+    "local i64 = ffi.new('int64_t[1]')\n"
+    "local dbl = ffi.new('double[1]')\n"
+    "local int = ffi.new('int[1]')\n"
+    "local ts = ffi.new('pgdec_timestamp_t')\n"
+    "local pt = ffi.new('pgdec_point_t')\n"
+    "local line = ffi.new('pgdec_line_t')\n"
+    "local lseg = ffi.new('pgdec_lseg_t')\n"
+    "local circle = ffi.new('pgdec_circle_t')\n"
+    "local range = ffi.new('pgdec_range_t')\n"
+    "\n"
+    "function M.int(str)\n"
+    "    if type(str) == 'string' and lib.pgdec_int(str, #str, i64, nil) == 0 then\n"
+    "        return tonumber(i64[0])\n"
+    "    end\n"
+    "    return decode_int(str)\n"
+    "end\n"
+    "\n"
+    "function M.float(str)\n"
+    "    if type(str) == 'string' and lib.pgdec_float(str, #str, dbl, nil) == 0 then\n"
+    "        return dbl[0]\n"
+    "    end\n"
+    "    return decode_float(str)\n"
+    "end\n"
+    "\n"
+    "function M.bool(str)\n"
+    "    if type(str) == 'string' and lib.pgdec_bool(str, #str, int, nil) == 0 then\n"
+    "        return int[0] == 1\n"
+    "    end\n"
+    "    return decode_bool(str)\n"
+    "end\n"
+    "\n"
+    "local function settz(v)\n"
+    "    if ts.tzsign[0] ~= 0 then\n"
+    "        v.tz = ffi.string(ts.tzsign, 1)\n"
+    "        v.tzhour = ts.tzhour\n"
+    "        v.tzmin = ts.tzmin\n"
+    "        v.tzsec = ts.tzsec\n"
+    "    end\n"
+    "    return v\n"
+    "end\n"
+    "\n"
+    "function M.date(str, is_dmy)\n"
+    "    if type(str) == 'string' and\n"
+    "        lib.pgdec_date(str, #str, is_dmy and 1 or 0, ts, nil) == 0 then\n"
+    "        local v = {}\n"
+    "        v.year = ts.year\n"
+    "        v.month = ts.mon\n"
+    "        v.day = ts.day\n"
+    "        return v\n"
+    "    end\n"
+    "    return decode_date(str, is_dmy)\n"
+    "end\n"
+    "\n"
+    "function M.time(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_time(str, #str, ts, nil) == 0 then\n"
+    "        local v = newtable(dst)\n"
+    "        v.hour = ts.hour\n"
+    "        v.min = ts.min\n"
+    "        v.sec = ts.sec\n"
+    "        v.usec = ts.usec\n"
+    "        return settz(v)\n"
+    "    end\n"
+    "    return decode_time(str, dst)\n"
+    "end\n"
+    "\n"
+    "function M.timestamp(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_timestamp(str, #str, ts, nil) ==\n"
+    "        0 then\n"
+    "        local v = newtable(dst)\n"
+    "        v.year = ts.year\n"
+    "        v.month = ts.mon\n"
+    "        v.day = ts.day\n"
+    "        v.hour = ts.hour\n"
+    "        v.min = ts.min\n"
+    "        v.sec = ts.sec\n"
+    "        v.usec = ts.usec\n"
+    "        return settz(v)\n"
+    "    end\n"
+    "    return decode_timestamp(str, dst)\n"
+    "end\n"
+    "\n"
+    "function M.point(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_point(str, #str, pt, nil) == 0 then\n"
+    "        local v = newtable(dst)\n"
+    "        v[1] = pt.x\n"
+    "        v[2] = pt.y\n"
+    "        return v\n"
+    "    end\n"
+    "    return decode_point(str, dst)\n"
+    "end\n"
+    "\n"
+    "function M.line(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_line(str, #str, line, nil) == 0 then\n"
+    "        local v = newtable(dst)\n"
+    "        v[1] = line.a\n"
+    "        v[2] = line.b\n"
+    "        v[3] = line.c\n"
+    "        return v\n"
+    "    end\n"
+    "    return decode_line(str, dst)\n"
+    "end\n"
+    "\n"
+    "-- the nested tables of the destination table are reused\n"
+    "local function lseg2table(dst)\n"
+    "    local v = type(dst) == 'table' and dst or {}\n"
+    "    local p1 = subtable(v, 1)\n"
+    "    local p2 = subtable(v, 2)\n"
+    "    clear(v)\n"
+    "    p1[1] = lseg.p[0].x\n"
+    "    p1[2] = lseg.p[0].y\n"
+    "    p2[1] = lseg.p[1].x\n"
+    "    p2[2] = lseg.p[1].y\n"
+    "    v[1] = p1\n"
+    "    v[2] = p2\n"
+    "    return v\n"
+    "end\n"
+    "\n"
+    "function M.lseg(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_lseg(str, #str, lseg, nil) == 0 then\n"
+    "        return lseg2table(dst)\n"
+    "    end\n"
+    "    return decode_lseg(str, dst)\n"
+    "end\n"
+    "\n"
+    "function M.box(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_box(str, #str, lseg, nil) == 0 then\n"
+    "        return lseg2table(dst)\n"
+    "    end\n"
+    "    return decode_box(str, dst)\n"
+    "end\n"
+    "\n"
+    "function M.circle(str, dst)\n"
+    "    if type(str) == 'string' and lib.pgdec_circle(str, #str, circle, nil) ==\n"
+    "        0 then\n"
+    "        local v = newtable(dst)\n"
+    "        v[1] = circle.center.x\n"
+    "        v[2] = circle.center.y\n"
+    "        v[3] = circle.radius\n"
+    "        return v\n"
+    "    end\n"
+    "    return decode_circle(str, dst)\n"
+    "end\n"
+    "\n"
+    "-- decode the bound string by the callback function\n"
+    "local function decode_bound(str, off, len, fn, ctx)\n"
+    "    local head = tonumber(off) + 1\n"
+    "    local token = sub(str, head, head + tonumber(len) - 1)\n"
+    "    return fn(token, byte(token) == 34, ctx)\n"
+    "end\n"
+    "\n"
+    "function M.range(str, fn, ctx, dst)\n"
+    "    if type(str) ~= 'string' or type(fn) ~= 'function' or\n"
+    "        lib.pgdec_range(str, #str, range, nil) ~= 0 then\n"
+    "        return decode_range(str, fn, ctx, dst)\n"
+    "    end\n"
+    "\n"
+    "    local v = newtable(dst)\n"
+    "    if range.empty == 1 then\n"
+    "        return v\n"
+    "    end\n"
+    "\n"
+    "    local lower_inc = range.lower_inc == 1\n"
+    "    local upper_inc = range.upper_inc == 1\n"
+    "    if range.lower_len > 0 then\n"
+    "        local val, err = decode_bound(str, range.lower, range.lower_len, fn,\n"
+    "                                      ctx)\n"
+    "        if err ~= nil then\n"
+    "            -- create the same error as the lua C API\n"
+    "            return decode_range(str, function()\n"
+    "                return nil, err\n"
+    "            end)\n"
+    "        elseif val == nil then\n"
+    "            lower_inc = false\n"
+    "        end\n"
+    "        v[1] = val\n"
+    "    end\n"
+    "    if range.upper_len > 0 then\n"
+    "        local val, err = decode_bound(str, range.upper, range.upper_len, fn,\n"
+    "                                      ctx)\n"
+    "        if err ~= nil then\n"
+    "            -- create the same error as the lua C API\n"
+    "            return decode_range(str, function()\n"
+    "                return nil, err\n"
+    "            end)\n"
+    "        elseif val == nil then\n"
+    "            upper_inc = false\n"
+    "        end\n"
+    "        v[2] = val\n"
+    "    end\n"
+    "    v.lower_inc = lower_inc or nil\n"
+    "    v.upper_inc = upper_inc or nil\n"
+    "    return v\n"
+    "end\n"
+    "\n"
+    "return M\n";
+
+LUALIB_API int luaopen_postgres_decode_ffi(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    if (luaL_loadbuffer(L, PGDEC_FFI_BINDING, sizeof(PGDEC_FFI_BINDING) - 1,
+                        "=postgres.decode.ffi")) {
+        return lua_error(L);
+    }
+    lua_pushliteral(L, "postgres.decode.ffi");
+    lua_call(L, 1, 1);
+    return 1;
+}
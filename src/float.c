@@ -20,37 +20,20 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode.h"
+#include "lua_postgres_decode_scalar.h"
 
 static int decode_float_lua(lua_State *L)
 {
     static const char *op = "postgres.decode.float";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    char *endptr          = str;
     double fv             = 0;
+    pgdec_error_t err     = {0};
 
     lua_settop(L, 1);
-    DECODE_START(L, op, str, len);
-    switch (*str) {
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-    case '+':
-    case '-':
-        fv = decode_str2dbl(str, &endptr);
-        if (errno) {
-            return decode_error(L, op, errno, NULL);
-        }
+    if (decode_float(&fv, &err, str, len)) {
+        return decode_error_from(L, op, &err);
     }
-    DECODE_END(endptr);
 
     lua_pushnumber(L, fv);
     return 1;
@@ -60,5 +43,6 @@ LUALIB_API int luaopen_postgres_decode_float(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_float_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.float", NULL);
     return 1;
 }
@@ -20,73 +20,221 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode_geom.h"
+#include "lua_postgres_decode_dict.h"
+#include "lua_postgres_decode_limits.h"
+#include "lua_postgres_decode_yield.h"
+#include "pgdec/pgdec_hstore.h"
 
 // F.18. hstore
 // https://www.postgresql.org/docs/current/hstore.html
 
+/**
+ * @brief decode_hstore_push
+ *  push the string, or the code of the string if the dictionary is passed.
+ * @return int 0 on success, otherwise -1 and errno is set.
+ */
+static int decode_hstore_push(lua_State *L, dict_t *dict, const char *s,
+                              size_t len)
+{
+    if (dict) {
+        lua_Integer code = decode_dict_encode(L, dict, s, len);
+        if (code < 0) {
+            return -1;
+        }
+        lua_pushinteger(L, code);
+        return 0;
+    }
+    lua_pushlstring(L, s, len);
+    return 0;
+}
+
+// the hstore string is decoded in two phases. the first phase scans the
+// whole string into the pairs in the arena, and the second phase pushes the
+// pairs only after the string is validated.
+typedef struct {
+    // offset and length of the key and the value from the head of the string
+    size_t koff;
+    size_t klen;
+    size_t voff;
+    size_t vlen;
+    // non-zero if the value is NULL
+    int isnull;
+} hstore_pair_t;
+
+typedef struct {
+    decode_arena_t *arena;
+    const char *src;
+    size_t npair;
+    // number of the non-NULL values
+    size_t nval;
+    decode_quota_t quota;
+} hstore_ctx_t;
+
+static int hstore_pair(void *ctx, const char *key, size_t klen,
+                       const char *val, size_t vlen)
+{
+    hstore_ctx_t *c     = (hstore_ctx_t *)ctx;
+    hstore_pair_t *pair = NULL;
+
+    if (decode_quota_string(&c->quota, klen) ||
+        (val && decode_quota_string(&c->quota, vlen)) ||
+        decode_quota_add(&c->quota, 1, DECODE_SIZEOF_NODE)) {
+        return -1;
+    } else if (!(pair = decode_arena_alloc(c->arena, sizeof(hstore_pair_t)))) {
+        return -1;
+    }
+    *pair = (hstore_pair_t){
+        .koff   = key - c->src,
+        .klen   = klen,
+        .voff   = val ? (size_t)(val - c->src) : 0,
+        .vlen   = vlen,
+        .isnull = !val,
+    };
+    c->npair++;
+    c->nval += !!val;
+    return 0;
+}
+
+// state of the second phase that is kept in the arena to resume it
+typedef struct {
+    decode_yield_t y;
+    const char *op;
+    const char *src;
+    dict_t *dict;
+    size_t npair;
+    // index of the next pair
+    size_t i;
+} hstore_build_t;
+
+// stack index of the arena
+#define HSTORE_ARENA 4
+
+/**
+ * @brief decode_hstore_build
+ *  set the pairs to the table at the top of the stack.
+ * @return int 0 on success, 1 if the current step is exhausted, or -1 on
+ * error, when error then errno is set.
+ */
+static int decode_hstore_build(lua_State *L, decode_arena_t *a,
+                               hstore_build_t *b)
+{
+    while (b->i < b->npair) {
+        hstore_pair_t *pair = decode_arena_at(a, sizeof(hstore_pair_t),
+                                              b->i++);
+
+        if (pair->isnull) {
+            // ignore NULL value, but the key is encoded by the dictionary
+            if (b->dict && decode_dict_encode(L, b->dict, b->src + pair->koff,
+                                              pair->klen) < 0) {
+                return -1;
+            }
+        } else if (decode_hstore_push(L, b->dict, b->src + pair->koff,
+                                      pair->klen) ||
+                   decode_hstore_push(L, b->dict, b->src + pair->voff,
+                                      pair->vlen)) {
+            return -1;
+        } else {
+            // set key-value pair
+            lua_rawset(L, -3);
+        }
+        if (decode_yield_tick(&b->y)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int decode_hstore_continue(lua_State *L, size_t off);
+
+#if LUA_VERSION_NUM >= 503
+static int decode_hstore_resume(lua_State *L, int status, lua_KContext ctx)
+{
+    (void)status;
+    decode_yield_state(L, HSTORE_ARENA, (size_t)ctx);
+    return decode_hstore_continue(L, (size_t)ctx);
+}
+#endif
+
+/**
+ * @brief decode_hstore_continue
+ *  set the pairs from the state at the offset off in the arena, and release
+ *  the arena when it is done.
+ */
+static int decode_hstore_continue(lua_State *L, size_t off)
+{
+    decode_arena_t *a = lua_touserdata(L, HSTORE_ARENA);
+    hstore_build_t *b = (hstore_build_t *)(a->buf + off);
+    int rv            = decode_hstore_build(L, a, b);
+
+#if LUA_VERSION_NUM >= 503
+    if (rv > 0) {
+        return decode_yield(L, lua_upvalueindex(1), HSTORE_ARENA, &b->y, off,
+                            decode_hstore_resume);
+    }
+#endif
+    if (rv) {
+        // failed to encode the string by the dictionary
+        rv = decode_error(L, b->op, errno, NULL);
+    } else {
+        rv = 1;
+    }
+    decode_arena_leave(L, lua_upvalueindex(1), a);
+    return rv;
+}
+
 static int decode_hstore_lua(lua_State *L)
 {
     static const char *op = "postgres.decode.polygon";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    char *chunk           = NULL;
+    dict_t *dict          = NULL;
+    decode_arena_t *a     = NULL;
+    hstore_build_t *b     = NULL;
+    hstore_ctx_t ctx      = {0};
+    pgdec_error_t err     = {0};
+    size_t off            = 0;
 
-    lua_settop(L, 1);
-    lua_newtable(L);
-    // hstore: "key"=>"value", ... "keyn"=>"valuen"
-    DECODE_START(L, op, str, len);
-
-#define SKIP_DELIM(s, delim, errmsg)                                           \
-    do {                                                                       \
-        (s) = decode_skip_delim((s), delim, 0, 0);                             \
-        if (!(s)) {                                                            \
-            return decode_error(L, op, EILSEQ, errmsg);                        \
-        }                                                                      \
-    } while (0)
-
-CHECK_NEXT:
-    // key
-    SKIP_DELIM(str, '"', "opening double-quote not found");
-    chunk = str;
-    SKIP_DELIM(str, '"', "closing double-quote not found");
-    lua_pushlstring(L, chunk, str - chunk - 1);
-    str = decode_skip_space(str);
-    // separator: =>
-    if (str[0] != '=' || str[1] != '>') {
-        return decode_error(L, op, EILSEQ, "key-value separator not found");
+    if (lua_type(L, 3) == LUA_TUSERDATA) {
+        dict = decode_dict_check(L, 3);
     }
-    str += 2;
-    if (*str == 'N') {
-        // NULL value
-        if (str[1] != 'U' || str[2] != 'L' || str[3] != 'L') {
-            return decode_error(L, op, EILSEQ, "invalid null value");
+    lua_settop(L, 3);
+    a   = decode_arena_enter(L, lua_upvalueindex(1));
+    ctx = (hstore_ctx_t){.arena = a, .src = str};
+    decode_quota_start(L, &ctx.quota);
+    // hstore: "key"=>"value", ... "keyn"=>"valuen"
+    if (decode_hstore_scan(str, len, hstore_pair, &ctx, &err)) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        if (err.errnum != ECANCELED) {
+            return decode_error_from(L, op, &err);
+        } else if (ctx.quota.err.errnum) {
+            // exceeded the limit
+            return decode_error_from(L, op, &ctx.quota.err);
         }
-        str += 4;
-        // remove pushed key
-        lua_pop(L, 1);
-    } else {
-        // quoted value
-        SKIP_DELIM(str, '"', "opening double-quote not found");
-        chunk = str;
-        SKIP_DELIM(str, '"', "closing double-quote not found");
-        // set key-value pair
-        lua_pushlstring(L, chunk, str - chunk - 1);
-        lua_rawset(L, -3);
+        // failed to allocate the pair
+        return decode_error(L, op, ENOMEM, NULL);
+    } else if (!(b = decode_arena_alloc_state(a, sizeof(hstore_build_t),
+                                              &off))) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        return decode_error(L, op, ENOMEM, NULL);
     }
-    str = decode_skip_space(str);
-    if (*str == ',') {
-        str++;
-        goto CHECK_NEXT;
-    }
-    DECODE_END(str);
 
-    return 1;
+    *b = (hstore_build_t){
+        .op    = op,
+        .src   = str,
+        .dict  = dict,
+        .npair = ctx.npair,
+    };
+    decode_yield_init(L, &b->y);
+    decode_table(L, 2, 0, (int)ctx.nval, 0);
+    return decode_hstore_continue(L, off);
 }
 
 LUALIB_API int luaopen_postgres_decode_hstore(lua_State *L)
 {
     lua_errno_loadlib(L);
-    lua_pushcfunction(L, decode_hstore_lua);
+    // arena to scan the hstore string
+    decode_arena_new(L);
+    lua_pushcclosure(L, decode_hstore_lua, 1);
+    DECODE_STATS_WRAP(L, "postgres.decode.hstore", NULL);
     return 1;
 }
@@ -0,0 +1,234 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode.h"
+
+// 8.9.1. inet
+// 8.9.2. cidr
+// https://www.postgresql.org/docs/current/datatype-net-types.html
+
+#define INET4_ADDRLEN 4
+#define INET6_ADDRLEN 16
+
+/**
+ * @brief decode_inet4
+ *  decode the dotted decimal notation of IPv4 address to 4 bytes.
+ * @return int 0 on success, otherwise -1. the *sp is advanced to the end of
+ *  the address, or the position of the invalid character.
+ */
+static int decode_inet4(char **sp, unsigned char *addr)
+{
+    char *s = *sp;
+
+    for (int i = 0; i < INET4_ADDRLEN; i++) {
+        char *head = NULL;
+        int v      = 0;
+
+        if (i) {
+            if (*s != '.') {
+                *sp = s;
+                return -1;
+            }
+            s++;
+        }
+        head = s;
+        while (isdigit(*s) && s - head < 3) {
+            v = v * 10 + (*s - '0');
+            s++;
+        }
+        if (s == head || v > 255) {
+            *sp = head;
+            return -1;
+        }
+        addr[i] = v;
+    }
+
+    *sp = s;
+    return 0;
+}
+
+/**
+ * @brief decode_inet6
+ *  decode the text representation of IPv6 address to 16 bytes. the zero
+ *  compression (::) and the embedded IPv4 address are supported.
+ * @return int 0 on success, otherwise -1. the *sp is advanced to the end of
+ *  the address, or the position of the invalid character.
+ */
+static int decode_inet6(char **sp, unsigned char *addr)
+{
+    char *s = *sp;
+    int n   = 0;  // number of 16-bit groups
+    int gap = -1; // position of the zero compression
+
+    memset(addr, 0, INET6_ADDRLEN);
+    if (*s == ':') {
+        // leading zero compression
+        if (s[1] != ':') {
+            *sp = s + 1;
+            return -1;
+        }
+        gap = 0;
+        s += 2;
+        if (decode_hexval(*s) < 0) {
+            goto DONE;
+        }
+    }
+
+    while (n < 8) {
+        char *head = s;
+        int v      = 0;
+        int hv     = 0;
+
+        while (s - head < 4 && (hv = decode_hexval(*s)) >= 0) {
+            v = (v << 4) | hv;
+            s++;
+        }
+        if (s == head) {
+            *sp = s;
+            return -1;
+        } else if (*s == '.') {
+            // embedded IPv4 address in the last 32 bits
+            s = head;
+            if (n > 6 || decode_inet4(&s, addr + n * 2)) {
+                *sp = s;
+                return -1;
+            }
+            n += 2;
+            break;
+        }
+        addr[n * 2]     = v >> 8;
+        addr[n * 2 + 1] = v & 0xFF;
+        n++;
+
+        if (n == 8 || *s != ':') {
+            break;
+        } else if (s[1] == ':') {
+            // zero compression
+            if (gap >= 0) {
+                *sp = s + 1;
+                return -1;
+            }
+            gap = n;
+            s += 2;
+            if (decode_hexval(*s) < 0) {
+                break;
+            }
+        } else {
+            s++;
+        }
+    }
+
+DONE:
+    if (gap >= 0) {
+        int ntail = n - gap;
+        if (n == 8) {
+            // zero compression must represent at least one group
+            *sp = s;
+            return -1;
+        }
+        memmove(addr + INET6_ADDRLEN - ntail * 2, addr + gap * 2, ntail * 2);
+        memset(addr + gap * 2, 0, (8 - n) * 2);
+    } else if (n != 8) {
+        *sp = s;
+        return -1;
+    }
+
+    *sp = s;
+    return 0;
+}
+
+static int decode_inet_error_at(lua_State *L, const char *op, char *str,
+                                char *s)
+{
+    if (!*s) {
+        return decode_error(L, op, EILSEQ, "unexpected end of inet string");
+    }
+    return decode_error_at(L, op, EILSEQ, str, s);
+}
+
+static int decode_inet_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.inet";
+    size_t len            = 0;
+    char *str             = (char *)lauxh_checklstring(L, 1, &len);
+    char *s               = str;
+    unsigned char addr[INET6_ADDRLEN];
+    size_t addrlen = INET4_ADDRLEN;
+    int maxbits    = 32;
+    int bits       = 0;
+
+    lua_settop(L, 2);
+    // inet: address[/bits]
+    DECODE_START(L, op, str, len);
+
+    // IPv4 address starts with the decimal digits followed by a dot
+    while (isdigit(*s)) {
+        s++;
+    }
+    if (*s == '.') {
+        s = str;
+        if (decode_inet4(&s, addr)) {
+            return decode_inet_error_at(L, op, str, s);
+        }
+    } else {
+        s       = str;
+        addrlen = INET6_ADDRLEN;
+        maxbits = 128;
+        if (decode_inet6(&s, addr)) {
+            return decode_inet_error_at(L, op, str, s);
+        }
+    }
+
+    bits = maxbits;
+    if (*s == '/') {
+        char *head = ++s;
+        bits       = 0;
+        while (isdigit(*s) && s - head < 3) {
+            bits = bits * 10 + (*s - '0');
+            s++;
+        }
+        if (s == head) {
+            return decode_inet_error_at(L, op, str, s);
+        } else if (bits > maxbits) {
+            return decode_error(L, op, ERANGE,
+                                "netmask bits %d out of range 0-%d", bits,
+                                maxbits);
+        }
+    }
+
+    DECODE_END(s);
+
+    decode_table(L, 2, 0, 3, 0);
+    lauxh_pushint2tbl(L, "family", addrlen == INET4_ADDRLEN ? 4 : 6);
+    lauxh_pushint2tbl(L, "bits", bits);
+    lua_pushlstring(L, (const char *)addr, addrlen);
+    lua_setfield(L, -2, "addr");
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_inet(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, decode_inet_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.inet", NULL);
+    return 1;
+}
@@ -20,51 +20,20 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode.h"
+#include "lua_postgres_decode_scalar.h"
 
 static int decode_int_lua(lua_State *L)
 {
     static const char *op = "postgres.decode.int";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    char *endptr          = str;
     intmax_t iv           = 0;
-    uintmax_t uv          = 0;
+    pgdec_error_t err     = {0};
 
     lua_settop(L, 1);
-    DECODE_START(L, op, str, len);
-    switch (*str) {
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-    case '+':
-        uv = decode_str2umax(str, &endptr);
-        if (uv > (uintmax_t)INTMAX_MAX) {
-            errno = ERANGE;
-            return decode_error(L, op, errno, NULL);
-        }
-        iv = (intmax_t)uv;
-        break;
-
-    case '-':
-        iv = decode_str2imax(str, &endptr);
-        break;
-
-    default:
-        return decode_error_at(L, op, EILSEQ, str, endptr);
-    }
-
-    if (errno) {
-        return decode_error(L, op, errno, NULL);
+    if (decode_int(&iv, &err, str, len)) {
+        return decode_error_from(L, op, &err);
     }
-    DECODE_END(endptr);
 
     lua_pushinteger(L, iv);
     return 1;
@@ -74,5 +43,6 @@ LUALIB_API int luaopen_postgres_decode_int(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_int_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.int", NULL);
     return 1;
 }
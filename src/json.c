@@ -0,0 +1,929 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode.h"
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#if defined(__PCLMUL__) && defined(__x86_64__)
+# include <wmmintrin.h>
+#endif
+
+// 8.14. JSON Types
+// https://www.postgresql.org/docs/current/datatype-json.html
+//
+// the json string is decoded in two stages;
+//
+//  1. build the index of the structural characters by scanning the string in
+//     64 bytes blocks. each block is classified into the bitmaps of quotes,
+//     backslashes, operators and whitespaces, and then the bitmap of the
+//     characters inside the strings is computed from the unescaped quotes.
+//  2. build the lua value by walking the structural index.
+
+#define MAX_JSON_DEPTH 512
+
+typedef struct {
+    uint64_t quote;
+    uint64_t bslash;
+    uint64_t op;
+    uint64_t ws;
+} json_block_t;
+
+#if !defined(__SSE2__)
+# define JSON_C_QUOTE  0x1
+# define JSON_C_BSLASH 0x2
+# define JSON_C_OP     0x4
+# define JSON_C_WS     0x8
+
+static const unsigned char JSON_CLASS[256] = {
+    ['"'] = JSON_C_QUOTE, ['\\'] = JSON_C_BSLASH, ['{'] = JSON_C_OP,
+    ['}'] = JSON_C_OP,    ['['] = JSON_C_OP,      [']'] = JSON_C_OP,
+    [':'] = JSON_C_OP,    [','] = JSON_C_OP,      [' '] = JSON_C_WS,
+    ['\t'] = JSON_C_WS,   ['\n'] = JSON_C_WS,     ['\r'] = JSON_C_WS,
+};
+#endif
+
+static inline void json_classify(const char *s, json_block_t *blk)
+{
+#if defined(__SSE2__)
+    const __m128i quote  = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i lower  = _mm_set1_epi8(0x20);
+    // '[' and ']' are folded into '{' and '}' by setting the 0x20 bit
+    const __m128i lbrace = _mm_set1_epi8('{');
+    const __m128i rbrace = _mm_set1_epi8('}');
+    const __m128i colon  = _mm_set1_epi8(':');
+    const __m128i comma  = _mm_set1_epi8(',');
+    const __m128i sp     = _mm_set1_epi8(' ');
+    const __m128i tab    = _mm_set1_epi8('\t');
+    const __m128i lf     = _mm_set1_epi8('\n');
+    const __m128i cr     = _mm_set1_epi8('\r');
+
+    *blk = (json_block_t){0};
+    for (int i = 0; i < 4; i++) {
+        __m128i v  = _mm_loadu_si128((const __m128i *)(s + i * 16));
+        __m128i vl = _mm_or_si128(v, lower);
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(vl, lbrace), _mm_cmpeq_epi8(vl, rbrace)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        int shift  = i * 16;
+
+        blk->quote |=
+            (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote))
+            << shift;
+        blk->bslash |=
+            (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, bslash))
+            << shift;
+        blk->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+        blk->ws |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << shift;
+    }
+#else
+    *blk = (json_block_t){0};
+    for (int i = 0; i < 64; i++) {
+        unsigned char c = JSON_CLASS[(unsigned char)s[i]];
+        uint64_t bit    = (uint64_t)1 << i;
+
+        if (c & JSON_C_QUOTE) {
+            blk->quote |= bit;
+        } else if (c & JSON_C_BSLASH) {
+            blk->bslash |= bit;
+        } else if (c & JSON_C_OP) {
+            blk->op |= bit;
+        } else if (c & JSON_C_WS) {
+            blk->ws |= bit;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief json_prefix_xor
+ *  each bit of the result is the xor of all the bits up to that position.
+ */
+static inline uint64_t json_prefix_xor(uint64_t x)
+{
+#if defined(__PCLMUL__) && defined(__x86_64__)
+    return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(
+        _mm_set_epi64x(0, (long long)x), _mm_set1_epi8((char)0xFF), 0));
+#else
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+#endif
+}
+
+/**
+ * @brief json_find_escaped
+ *  returns the bitmap of the characters escaped by the odd length sequence of
+ *  backslashes. the escaped state of the next block is stored in the
+ *  prev_escaped.
+ */
+static inline uint64_t json_find_escaped(uint64_t bslash,
+                                         uint64_t *prev_escaped)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    uint64_t follows_escape  = 0;
+    uint64_t odd_starts      = 0;
+    uint64_t even_seqs       = 0;
+
+    bslash &= ~*prev_escaped;
+    follows_escape = bslash << 1 | *prev_escaped;
+    odd_starts     = bslash & ~even_bits & ~follows_escape;
+    even_seqs      = odd_starts + bslash;
+    *prev_escaped  = even_seqs < odd_starts;
+    return (even_bits ^ (even_seqs << 1)) & follows_escape;
+}
+
+static inline int json_ctz(uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+typedef struct {
+    size_t len;
+    size_t cap;
+    uint32_t pos[];
+} json_index_t;
+
+/**
+ * @brief json_index_grow
+ *  reallocate the index placed at the index slot of the stack if its
+ *  remaining capacity is less than n.
+ */
+static json_index_t *json_index_grow(lua_State *L, int slot, size_t n)
+{
+    json_index_t *idx = lua_touserdata(L, slot);
+
+    if (idx->cap - idx->len < n) {
+        size_t cap        = (idx->cap + n) * 2;
+        json_index_t *nidx = lua_newuserdata(L, sizeof(json_index_t) +
+                                                   sizeof(uint32_t) * cap);
+        memcpy(nidx, idx, sizeof(json_index_t) + sizeof(uint32_t) * idx->len);
+        nidx->cap = cap;
+        lua_replace(L, slot);
+        idx = nidx;
+    }
+    return idx;
+}
+
+/**
+ * @brief json_index_build
+ *  push the structural index of the json string to the stack.
+ *  the index contains the positions of the structural characters, the quotes
+ *  and the first characters of the scalar values.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static int json_index_build(lua_State *L, const char *op, const char *str,
+                            size_t len)
+{
+    int slot                = 0;
+    json_index_t *idx       = NULL;
+    uint64_t prev_escaped   = 0;
+    uint64_t prev_in_string = 0;
+    uint64_t prev_scalar    = 0;
+    char tail[64];
+
+    if (len >= UINT32_MAX) {
+        return decode_error(L, op, ERANGE, "json string too long");
+    }
+
+    idx  = lua_newuserdata(L, sizeof(json_index_t) + sizeof(uint32_t) * 64);
+    *idx = (json_index_t){
+        .len = 0,
+        .cap = 64,
+    };
+    slot = lua_gettop(L);
+
+    for (size_t base = 0; base < len; base += 64) {
+        const char *s = str + base;
+        json_block_t blk;
+        uint64_t escaped   = 0;
+        uint64_t quote     = 0;
+        uint64_t in_string = 0;
+        uint64_t scalar    = 0;
+        uint64_t bits      = 0;
+
+        if (len - base < 64) {
+            // pad the last block with whitespaces
+            memset(tail, ' ', 64);
+            memcpy(tail, s, len - base);
+            s = tail;
+        }
+        json_classify(s, &blk);
+
+        escaped   = json_find_escaped(blk.bslash, &prev_escaped);
+        quote     = blk.quote & ~escaped;
+        in_string = json_prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+        // first characters of the scalar values
+        scalar = ~(blk.op | blk.ws | quote | in_string);
+        bits   = scalar & ~(scalar << 1 | prev_scalar);
+        prev_scalar = scalar >> 63;
+        // operators outside the strings and quotes
+        bits |= quote | (blk.op & ~in_string);
+
+        idx = json_index_grow(L, slot, 64);
+        while (bits) {
+            idx->pos[idx->len++] = (uint32_t)(base + json_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    if (prev_in_string) {
+        return decode_error(L, op, EILSEQ, "closing quotation not found");
+    }
+    return 0;
+}
+
+typedef struct {
+    lua_State *L;
+    const char *op;
+    const char *str;
+    size_t len;
+    json_index_t *idx;
+    size_t cur;
+    // stack index of the null sentinel
+    int null_idx;
+    // decode integer numbers as lua_Integer
+    int integer;
+    // lazy decoding threshold and the source of the json string
+    size_t lazy;
+    int src_idx;
+    size_t offset;
+    // index of the closing bracket of the container at each index of the
+    // opening bracket. it is recorded by validating the whole string before
+    // decoding it in the lazy mode.
+    uint32_t *close;
+} json_parser_t;
+
+static int json_error_at(json_parser_t *p, size_t pos)
+{
+    if (pos >= p->len) {
+        return decode_error(p->L, p->op, EILSEQ,
+                            "unexpected end of json string");
+    }
+    return decode_error_at(p->L, p->op, EILSEQ, p->str, p->str + pos);
+}
+
+static inline int json_next(json_parser_t *p, size_t *pos)
+{
+    if (p->cur >= p->idx->len) {
+        *pos = p->len;
+        return 0;
+    }
+    *pos = p->idx->pos[p->cur];
+    return p->str[*pos];
+}
+
+static inline int json_hex4(const char *s)
+{
+    int v = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int c = s[i];
+        if (c >= '0' && c <= '9') {
+            c -= '0';
+        } else if (c >= 'a' && c <= 'f') {
+            c -= 'a' - 10;
+        } else if (c >= 'A' && c <= 'F') {
+            c -= 'A' - 10;
+        } else {
+            return -1;
+        }
+        v = (v << 4) | c;
+    }
+    return v;
+}
+
+/**
+ * @brief json_unescape
+ *  unescape the string between head and tail into the buffer b.
+ *  if b is NULL, the escape sequences are only validated.
+ * @return char* NULL on success, otherwise the position of the invalid escape
+ *  sequence.
+ */
+static const char *json_unescape(luaL_Buffer *b, const char *head,
+                                 const char *tail)
+{
+    const char *s = head;
+
+    while ((s = memchr(s, '\\', tail - s))) {
+        const char *esc = s;
+        char utf8[4];
+        size_t n = 1;
+        int cp   = 0;
+
+        if (b) {
+            luaL_addlstring(b, head, s - head);
+        }
+        s++;
+        switch (*s) {
+        case '"':
+        case '\\':
+        case '/':
+            utf8[0] = *s;
+            break;
+        case 'b':
+            utf8[0] = '\b';
+            break;
+        case 'f':
+            utf8[0] = '\f';
+            break;
+        case 'n':
+            utf8[0] = '\n';
+            break;
+        case 'r':
+            utf8[0] = '\r';
+            break;
+        case 't':
+            utf8[0] = '\t';
+            break;
+
+        case 'u':
+            if (tail - s < 5 || (cp = json_hex4(s + 1)) < 0) {
+                return esc;
+            }
+            s += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                // surrogate pair
+                int lo = -1;
+                if (tail - s >= 7 && s[1] == '\\' && s[2] == 'u') {
+                    lo = json_hex4(s + 3);
+                }
+                if (lo < 0xDC00 || lo > 0xDFFF) {
+                    return esc;
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                s += 6;
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                return esc;
+            }
+            // encode to utf-8
+            if (cp < 0x80) {
+                utf8[0] = cp;
+            } else if (cp < 0x800) {
+                utf8[0] = 0xC0 | (cp >> 6);
+                utf8[1] = 0x80 | (cp & 0x3F);
+                n       = 2;
+            } else if (cp < 0x10000) {
+                utf8[0] = 0xE0 | (cp >> 12);
+                utf8[1] = 0x80 | ((cp >> 6) & 0x3F);
+                utf8[2] = 0x80 | (cp & 0x3F);
+                n       = 3;
+            } else {
+                utf8[0] = 0xF0 | (cp >> 18);
+                utf8[1] = 0x80 | ((cp >> 12) & 0x3F);
+                utf8[2] = 0x80 | ((cp >> 6) & 0x3F);
+                utf8[3] = 0x80 | (cp & 0x3F);
+                n       = 4;
+            }
+            break;
+
+        default:
+            return esc;
+        }
+        if (b) {
+            luaL_addlstring(b, utf8, n);
+        }
+        head = ++s;
+    }
+
+    if (b) {
+        luaL_addlstring(b, head, tail - head);
+    }
+    return NULL;
+}
+
+static int json_parse_string(json_parser_t *p, int validate)
+{
+    size_t head       = p->idx->pos[p->cur] + 1;
+    size_t tail       = p->idx->pos[p->cur + 1];
+    const char *s     = p->str + head;
+    const char *e     = p->str + tail;
+    const char *inval = NULL;
+
+    // the quotes in the index are always paired
+    p->cur += 2;
+    if (!memchr(s, '\\', e - s)) {
+        if (!validate) {
+            lua_pushlstring(p->L, s, e - s);
+        }
+        return 0;
+    } else if (validate) {
+        inval = json_unescape(NULL, s, e);
+    } else {
+        luaL_Buffer b;
+        luaL_buffinit(p->L, &b);
+        inval = json_unescape(&b, s, e);
+        if (!inval) {
+            luaL_pushresult(&b);
+        }
+    }
+
+    if (inval) {
+        return json_error_at(p, inval - p->str);
+    }
+    return 0;
+}
+
+static int json_parse_number(json_parser_t *p, size_t pos, size_t end,
+                             int validate)
+{
+    const char *head = p->str + pos;
+    const char *s    = head;
+    const char *e    = p->str + end;
+    int is_float     = 0;
+    uint64_t uv      = 0;
+    int overflow     = 0;
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    if (*s == '-') {
+        s++;
+    }
+    if (s < e && *s == '0') {
+        s++;
+    } else if (s < e && isdigit(*s)) {
+        for (; s < e && isdigit(*s); s++) {
+            uint64_t prev = uv;
+            uv            = uv * 10 + (*s - '0');
+            if (uv / 10 != prev) {
+                overflow = 1;
+            }
+        }
+    } else {
+        return json_error_at(p, s - p->str);
+    }
+    if (s < e && *s == '.') {
+        is_float = 1;
+        s++;
+        if (s == e || !isdigit(*s)) {
+            return json_error_at(p, s - p->str);
+        }
+        while (s < e && isdigit(*s)) {
+            s++;
+        }
+    }
+    if (s < e && (*s == 'e' || *s == 'E')) {
+        is_float = 1;
+        s++;
+        if (s < e && (*s == '+' || *s == '-')) {
+            s++;
+        }
+        if (s == e || !isdigit(*s)) {
+            return json_error_at(p, s - p->str);
+        }
+        while (s < e && isdigit(*s)) {
+            s++;
+        }
+    }
+    if (s != e) {
+        return json_error_at(p, s - p->str);
+    } else if (validate) {
+        return 0;
+    }
+
+    if (p->integer && !is_float && !overflow) {
+        if (*head != '-' && uv <= (uint64_t)INT64_MAX) {
+            lua_pushinteger(p->L, (lua_Integer)uv);
+            return 0;
+        } else if (*head == '-' && uv <= (uint64_t)INT64_MAX + 1) {
+            lua_pushinteger(p->L, (lua_Integer)(0 - uv));
+            return 0;
+        }
+    }
+    // the number is followed by the non-numeric character
+    lua_pushnumber(p->L,
+                   decode_str2dbl((char *)head, p->str + p->len, NULL));
+    return 0;
+}
+
+static int json_parse_scalar(json_parser_t *p, int validate)
+{
+    size_t pos = p->idx->pos[p->cur];
+    size_t end = pos;
+
+    p->cur++;
+    // find the end of the scalar value
+    while (end < p->len) {
+        switch (p->str[end]) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+        case '"':
+            goto FOUND;
+        }
+        end++;
+    }
+
+FOUND:
+    switch (p->str[pos]) {
+    case 't':
+        if (end - pos != 4 || memcmp(p->str + pos, "true", 4) != 0) {
+            return json_error_at(p, pos);
+        } else if (!validate) {
+            lua_pushboolean(p->L, 1);
+        }
+        return 0;
+
+    case 'f':
+        if (end - pos != 5 || memcmp(p->str + pos, "false", 5) != 0) {
+            return json_error_at(p, pos);
+        } else if (!validate) {
+            lua_pushboolean(p->L, 0);
+        }
+        return 0;
+
+    case 'n':
+        if (end - pos != 4 || memcmp(p->str + pos, "null", 4) != 0) {
+            return json_error_at(p, pos);
+        } else if (!validate) {
+            lua_pushvalue(p->L, p->null_idx);
+        }
+        return 0;
+
+    default:
+        return json_parse_number(p, pos, end, validate);
+    }
+}
+
+static int json_parse_value(json_parser_t *p, int depth, int validate,
+                            int target);
+
+static int json_lazy_index_lua(lua_State *L);
+static int json_lazy_newindex_lua(lua_State *L);
+static int json_lazy_len_lua(lua_State *L);
+static int json_lazy_pairs_lua(lua_State *L);
+
+/**
+ * @brief json_push_lazy
+ *  push the lazy table of the container value between head and tail.
+ *  the container value is decoded when the table is accessed.
+ */
+static void json_push_lazy(json_parser_t *p, size_t head, size_t tail)
+{
+    lua_State *L = p->L;
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 10);
+    lua_pushcfunction(L, json_lazy_index_lua);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, json_lazy_newindex_lua);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, json_lazy_len_lua);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, json_lazy_pairs_lua);
+    lua_setfield(L, -2, "__pairs");
+    lua_pushvalue(L, p->src_idx);
+    lua_setfield(L, -2, "src");
+    lua_pushinteger(L, p->offset + head);
+    lua_setfield(L, -2, "head");
+    lua_pushinteger(L, p->offset + tail);
+    lua_setfield(L, -2, "tail");
+    lua_pushvalue(L, p->null_idx);
+    lua_setfield(L, -2, "null");
+    lua_pushboolean(L, p->integer);
+    lua_setfield(L, -2, "integer");
+    lua_pushinteger(L, p->lazy);
+    lua_setfield(L, -2, "lazy");
+    lua_setmetatable(L, -2);
+}
+
+/**
+ * @brief json_parse_container
+ *  parse the object or array value. if the target is not 0, the value is
+ *  decoded into the table at the target index of the stack.
+ */
+static int json_parse_container(json_parser_t *p, int depth, int validate,
+                                int target)
+{
+    lua_State *L = p->L;
+    size_t open  = p->cur;
+    size_t head  = p->idx->pos[open];
+    int is_array = p->str[head] == '[';
+    int close    = is_array ? ']' : '}';
+    int n        = 0;
+    size_t pos   = 0;
+    int c        = 0;
+
+    if (depth >= MAX_JSON_DEPTH || (!validate && !lua_checkstack(L, 4))) {
+        return decode_error(L, p->op, EILSEQ, "nesting level %d/%d too deep",
+                            depth + 1, MAX_JSON_DEPTH);
+    } else if (!validate && p->lazy && depth) {
+        // the nested container is already validated, and it is decoded later
+        // if it is large
+        size_t end = p->close[open];
+        pos        = p->idx->pos[end];
+        if (pos - head + 1 >= p->lazy) {
+            json_push_lazy(p, head, pos);
+            p->cur = end + 1;
+            return 0;
+        }
+    }
+
+    p->cur++;
+    if (!validate) {
+        if (target) {
+            lua_pushvalue(L, target);
+        } else {
+            lua_newtable(L);
+        }
+    }
+
+    c = json_next(p, &pos);
+    if (c == close) {
+        goto CLOSED;
+    }
+
+NEXT_ELEMENT:
+    if (!is_array) {
+        // key
+        if (c != '"') {
+            return json_error_at(p, pos);
+        } else if (json_parse_string(p, validate)) {
+            return -1;
+        }
+        // key-value separator
+        if (json_next(p, &pos) != ':') {
+            return json_error_at(p, pos);
+        }
+        p->cur++;
+    }
+
+    // value
+    if (json_next(p, &pos) == 0) {
+        return json_error_at(p, pos);
+    } else if (json_parse_value(p, depth + 1, validate, 0)) {
+        return -1;
+    } else if (!validate) {
+        if (is_array) {
+            lua_rawseti(L, -2, ++n);
+        } else {
+            lua_rawset(L, -3);
+        }
+    }
+
+    c = json_next(p, &pos);
+    if (c == ',') {
+        p->cur++;
+        c = json_next(p, &pos);
+        goto NEXT_ELEMENT;
+    } else if (c != close) {
+        return json_error_at(p, pos);
+    }
+
+CLOSED:
+    if (p->close) {
+        p->close[open] = (uint32_t)p->cur;
+    }
+    p->cur++;
+    return 0;
+}
+
+static int json_parse_value(json_parser_t *p, int depth, int validate,
+                            int target)
+{
+    size_t pos = 0;
+
+    switch (json_next(p, &pos)) {
+    case '{':
+    case '[':
+        return json_parse_container(p, depth, validate, target);
+
+    case '"':
+        return json_parse_string(p, validate);
+
+    case '}':
+    case ']':
+    case ':':
+    case ',':
+    case 0:
+        return json_error_at(p, pos);
+
+    default:
+        return json_parse_scalar(p, validate);
+    }
+}
+
+/**
+ * @brief json_decode
+ *  decode the json string and push the value to the stack.
+ *  the parser fields except str, len and idx must be initialized.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static int json_decode(json_parser_t *p, int target)
+{
+    lua_State *L = p->L;
+    int top      = lua_gettop(L);
+    size_t pos   = 0;
+
+    if (json_index_build(L, p->op, p->str, p->len)) {
+        return lua_gettop(L);
+    }
+    p->idx = lua_touserdata(L, -1);
+    p->cur = 0;
+    if (!p->idx->len) {
+        return decode_error(L, p->op, EINVAL, "empty string");
+    } else if (p->lazy) {
+        // validate the whole string in one pass, and record the closing
+        // brackets to find the large containers without validating them
+        // again at each nesting level
+        p->close = lua_newuserdata(L, sizeof(uint32_t) * p->idx->len);
+        if (json_parse_value(p, 0, 1, 0)) {
+            return lua_gettop(L);
+        } else if (json_next(p, &pos)) {
+            // found trailing characters
+            return json_error_at(p, pos);
+        }
+        p->cur = 0;
+    }
+
+    if (json_parse_value(p, 0, 0, target)) {
+        return lua_gettop(L);
+    } else if (json_next(p, &pos)) {
+        // found trailing characters
+        return json_error_at(p, pos);
+    }
+    // remove the index
+    lua_replace(L, top + 1);
+    lua_settop(L, top + 1);
+    return 0;
+}
+
+/**
+ * @brief json_lazy_decode
+ *  decode the lazy table at the index 1 of the stack.
+ */
+static void json_lazy_decode(lua_State *L)
+{
+    json_parser_t p = {
+        .L  = L,
+        .op = "postgres.decode.json",
+    };
+    size_t head = 0;
+    size_t tail = 0;
+
+    if (!lua_getmetatable(L, 1)) {
+        return;
+    }
+    lua_getfield(L, -1, "head");
+    lua_getfield(L, -2, "tail");
+    lua_getfield(L, -3, "integer");
+    lua_getfield(L, -4, "lazy");
+    head      = lua_tointeger(L, -4);
+    tail      = lua_tointeger(L, -3);
+    p.integer = lua_toboolean(L, -2);
+    p.lazy    = lua_tointeger(L, -1);
+    lua_pop(L, 4);
+    lua_getfield(L, -1, "src");
+    p.src_idx = lua_gettop(L);
+    lua_getfield(L, -2, "null");
+    p.null_idx = lua_gettop(L);
+    p.str      = lua_tostring(L, p.src_idx) + head;
+    p.len      = tail - head + 1;
+    p.offset   = head;
+
+    // the table is no longer lazy
+    lua_pushnil(L);
+    lua_setmetatable(L, 1);
+    if (json_decode(&p, 1)) {
+        // throw the error object, or the error number in the fast-fail mode
+        lua_settop(L, 2);
+        lua_error(L);
+    }
+    lua_settop(L, p.src_idx - 2);
+}
+
+static int json_lazy_index_lua(lua_State *L)
+{
+    lua_settop(L, 2);
+    json_lazy_decode(L);
+    lua_rawget(L, 1);
+    return 1;
+}
+
+static int json_lazy_newindex_lua(lua_State *L)
+{
+    lua_settop(L, 3);
+    json_lazy_decode(L);
+    lua_rawset(L, 1);
+    return 0;
+}
+
+static int json_lazy_len_lua(lua_State *L)
+{
+    lua_settop(L, 1);
+    json_lazy_decode(L);
+#if LUA_VERSION_NUM >= 502
+    lua_pushinteger(L, lua_rawlen(L, 1));
+#else
+    lua_pushinteger(L, lua_objlen(L, 1));
+#endif
+    return 1;
+}
+
+static int json_lazy_pairs_lua(lua_State *L)
+{
+    lua_settop(L, 1);
+    json_lazy_decode(L);
+    lua_getglobal(L, "next");
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int decode_json_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *str = lauxh_checklstring(L, 1, &len);
+    json_parser_t p = {
+        .L       = L,
+        .op      = "postgres.decode.json",
+        .str     = str,
+        .len     = len,
+        .integer = 1,
+        .src_idx = 1,
+    };
+
+    // options
+    lua_settop(L, 2);
+    if (!lua_isnil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_getfield(L, 2, "integer");
+        if (!lua_isnil(L, -1)) {
+            p.integer = lua_toboolean(L, -1);
+        }
+        lua_getfield(L, 2, "lazy");
+        if (!lua_isnil(L, -1)) {
+            lua_Integer lazy = lua_tointeger(L, -1);
+            if (!lua_isnumber(L, -1) || lazy < 0) {
+                return luaL_argerror(L, 2,
+                                     "lazy must be a non-negative integer");
+            }
+            p.lazy = lazy;
+        }
+        lua_pop(L, 2);
+        lua_getfield(L, 2, "null");
+    } else {
+        lua_pushnil(L);
+    }
+    p.null_idx = 3;
+
+    if (!len) {
+        return decode_error(L, p.op, EINVAL, "empty string");
+    } else if (json_decode(&p, 0)) {
+        return lua_gettop(L);
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_json(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, decode_json_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.json", NULL);
+    return 1;
+}
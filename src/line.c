@@ -30,25 +30,18 @@ static int decode_line_lua(lua_State *L)
     static const char *op = "postgres.decode.line";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    double a, b, c;
+    pgdec_line_t v        = {0};
+    pgdec_error_t err     = {0};
 
-    lua_settop(L, 1);
+    lua_settop(L, 2);
+    if (decode_line(&v, &err, str, len)) {
+        return decode_error_from(L, op, &err);
+    }
 
-    // parse {a,b,c}
-    DECODE_START(L, op, str, len);
-    GEOM_SKIP_DELIM(str, '{', "opening curly bracket not found");
-    GEOM_STR2DBL(str, a);
-    GEOM_SKIP_DELIM(str, ',', "separator not found");
-    GEOM_STR2DBL(str, b);
-    GEOM_SKIP_DELIM(str, ',', "separator not found");
-    GEOM_STR2DBL(str, c);
-    GEOM_SKIP_DELIM(str, '}', "closing curly bracket not found");
-    DECODE_END(str);
-
-    lua_createtable(L, 3, 0);
-    lauxh_pushnum2arr(L, 1, a);
-    lauxh_pushnum2arr(L, 2, b);
-    lauxh_pushnum2arr(L, 3, c);
+    decode_table(L, 2, 3, 0, 0);
+    lauxh_pushnum2arr(L, 1, v.a);
+    lauxh_pushnum2arr(L, 2, v.b);
+    lauxh_pushnum2arr(L, 3, v.c);
     return 1;
 }
 
@@ -56,5 +49,6 @@ LUALIB_API int luaopen_postgres_decode_line(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_line_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.line", NULL);
     return 1;
 }
@@ -30,26 +30,22 @@ static int decode_lseg_lua(lua_State *L)
     static const char *op = "postgres.decode.lseg";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    double x[2]           = {0};
-    double y[2]           = {0};
+    pgdec_lseg_t v        = {0};
+    pgdec_error_t err     = {0};
 
-    // line-segment: [(x1, y1), (x2, y2)]
-    lua_settop(L, 1);
-    DECODE_START(L, op, str, len);
-    GEOM_SKIP_DELIM(str, '[', "opening square bracket not found");
-    GEOM_STR2POINT(str, x[0], y[0]);
-    GEOM_SKIP_DELIM(str, ',', "separator not found");
-    GEOM_STR2POINT(str, x[1], y[1]);
-    GEOM_SKIP_DELIM(str, ']', "closing square bracket not found");
-    DECODE_END(str);
+    lua_settop(L, 2);
+    if (decode_lseg(&v, &err, str, len)) {
+        return decode_error_from(L, op, &err);
+    }
 
-    lua_createtable(L, 2, 0);
+    decode_table(L, 2, 2, 0, 1);
     for (int i = 0; i < 2; i++) {
-        lua_createtable(L, 2, 0);
-        lauxh_pushnum2arr(L, 1, x[i]);
-        lauxh_pushnum2arr(L, 2, y[i]);
+        decode_subtable(L, i + 1, 2, 0, 0);
+        lauxh_pushnum2arr(L, 1, v.p[i].x);
+        lauxh_pushnum2arr(L, 2, v.p[i].y);
         lua_rawseti(L, -2, i + 1);
     }
+    decode_trimtable(L, 2);
     return 1;
 }
 
@@ -57,5 +53,6 @@ LUALIB_API int luaopen_postgres_decode_lseg(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_lseg_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.lseg", NULL);
     return 1;
 }
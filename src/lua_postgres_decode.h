@@ -25,19 +25,76 @@
 
 #include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
 // lua
 #include <lauxhlib.h>
 #include <lua_errno.h>
+// core decoders
+#include "pgdec/pgdec_core.h"
 
+#if defined(POSTGRES_DECODE_AMALGAMATE) && defined(__GNUC__)
+// the amalgamated library is compiled with -fvisibility=hidden, so only the
+// luaopen_* entry points are exported.
+# undef LUALIB_API
+# define LUALIB_API __attribute__((visibility("default"))) extern
+#endif
+
+#include "lua_postgres_decode_stats.h"
+
+// registry key of the fast-fail flag
+#define DECODE_FASTFAIL "postgres.decode.fastfail"
+
+/**
+ * @brief decode_fastfail
+ *  return non-zero if the decoder is called in the function that is called
+ *  by decode.fastfail().
+ */
+static inline int decode_fastfail(lua_State *L)
+{
+    int enabled = 0;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_FASTFAIL);
+    enabled = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    return enabled;
+}
+
+/**
+ * @brief decode_error_fast
+ *  push nil, the error number and the position if it is greater than 0.
+ *  neither the message is formatted nor the error object is allocated.
+ * @return int the number of the pushed values.
+ */
+static inline int decode_error_fast(lua_State *L, int errnum, size_t pos)
+{
+    lua_settop(L, 0);
+    lua_pushnil(L);
+    lua_pushinteger(L, errnum);
+    if (pos) {
+        lua_pushinteger(L, (lua_Integer)pos);
+        return 3;
+    }
+    return 2;
+}
+
+/**
+ * @brief decode_error
+ *  clear the stack, and push nil and the error object.
+ *  in the fast-fail mode, the error number is pushed instead of the error
+ *  object.
+ * @return int the number of the pushed values.
+ */
 static inline int decode_error(lua_State *L, const char *op, int errnum,
                                const char *fmt, ...)
 {
     const char *msg = NULL;
     char buf[255]   = {0};
 
-    if (fmt) {
+    if (decode_fastfail(L)) {
+        return decode_error_fast(L, errnum, 0);
+    } else if (fmt) {
         va_list ap;
         va_start(ap, fmt);
         vsnprintf(buf, 255, fmt, ap);
@@ -51,149 +108,151 @@ static inline int decode_error(lua_State *L, const char *op, int errnum,
     return 2;
 }
 
-static inline int decode_error_at(lua_State *L, const char *op, int errnum,
-                                  const char *str, const char *endptr)
+/**
+ * @brief decode_error_pos
+ *  same as decode_error, but the message is "'<c>' at position <pos>".
+ *  in the fast-fail mode, the position is pushed after the error number.
+ */
+static inline int decode_error_pos(lua_State *L, const char *op, int errnum,
+                                   int c, size_t pos)
 {
-    return decode_error(L, op, errnum, "'%c' at position %d", *endptr,
-                        endptr - str + 1);
+    if (decode_fastfail(L)) {
+        return decode_error_fast(L, errnum, pos);
+    }
+    return decode_error(L, op, errnum, "'%c' at position %d", c, (int)pos);
 }
 
-static inline double decode_str2dbl(char *str, char **endptr)
+static inline int decode_error_at(lua_State *L, const char *op, int errnum,
+                                  const char *str, const char *endptr)
 {
-    if (endptr) {
-        *endptr = NULL;
-    }
-    errno = 0;
-    return strtod(str, endptr);
+    return decode_error_pos(L, op, errnum, *endptr, endptr - str + 1);
 }
 
-static inline uintmax_t decode_str2umax(char *str, char **endptr)
+/**
+ * @brief decode_error_pass
+ *  pass through the error value at the top of the stack that returned from
+ *  the decoder. the stack is cleared, and nil and the error value are
+ *  pushed.
+ * @return int the number of the pushed values.
+ */
+static inline int decode_error_pass(lua_State *L)
 {
-    if (endptr) {
-        *endptr = NULL;
-    }
-    errno = 0;
-    return strtoumax(str, endptr, 10);
+    lua_replace(L, 1);
+    lua_settop(L, 1);
+    lua_pushnil(L);
+    lua_insert(L, 1);
+    return 2;
 }
 
-static inline intmax_t decode_str2imax(char *str, char **endptr)
+/**
+ * @brief decode_error_from
+ *  same as decode_error, but the error is taken from err that is stored by
+ *  decode_seterr or decode_seterr_at.
+ */
+static inline int decode_error_from(lua_State *L, const char *op,
+                                    const pgdec_error_t *err)
 {
-    if (endptr) {
-        *endptr = NULL;
+    if (err->pos) {
+        return decode_error_pos(L, op, err->errnum, err->c, err->pos);
+    } else if (err->msg) {
+        return decode_error(L, op, err->errnum, "%s", err->msg);
     }
-    errno = 0;
-    return strtoimax(str, endptr, 10);
+    return decode_error(L, op, err->errnum, NULL);
 }
 
-static inline intmax_t decode_digit(char *str, uint8_t mindigit,
-                                    uint8_t maxdigit, uintmax_t minval,
-                                    uintmax_t maxval, char **endptr)
-
+/**
+ * @brief decode_isarrkey
+ *  return non-zero if the value at idx is an integer in the range of 1 to
+ *  INT_MAX.
+ */
+static inline int decode_isarrkey(lua_State *L, int idx)
 {
-    char *s         = str;
-    uintmax_t limit = INTMAX_MAX;
-    uintmax_t digit = 1;
-    union {
-        uintmax_t uv;
-        intmax_t iv;
-    } v = {0};
-
-    if (mindigit == 0 || mindigit > maxdigit || maxdigit > 19) {
-        errno = EDOM;
+    lua_Number n = 0;
+
+    if (lua_type(L, idx) != LUA_TNUMBER) {
         return 0;
     }
-    for (int i = 1; i < maxdigit; i++) {
-        digit = (digit << 3) + (digit << 1);
-    }
-
-    errno = 0;
-    while (digit >= 1) {
-        uintmax_t prev = v.uv;
-
-        if (!isdigit(*s)) {
-            // not treated as an error if more than min digits are decoded
-            if ((s - str) >= mindigit) {
-                break;
-            }
-            errno = EILSEQ;
-            goto FAILED;
-        }
+    n = lua_tonumber(L, idx);
+    return n >= 1 && n <= (lua_Number)INT_MAX && n == (lua_Number)(int)n;
+}
 
-        // decode
-        v.uv += (*s - '0') * digit;
-        if (v.uv > limit || v.uv < prev) {
-            errno = EOVERFLOW;
-            v.iv  = INTMAX_MAX;
-            goto FAILED;
-        } else if (v.uv > maxval) {
-            errno = ERANGE;
-            goto FAILED;
+/**
+ * @brief decode_cleartable
+ *  remove all fields of the table at idx. if keep_tables is not 0, the
+ *  tables at the array indices are kept to be reused as the nested tables.
+ *  the stack index must be an absolute index.
+ */
+static inline void decode_cleartable(lua_State *L, int idx, int keep_tables)
+{
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+        if (keep_tables && lua_type(L, -1) == LUA_TTABLE &&
+            decode_isarrkey(L, -2)) {
+            lua_pop(L, 1);
+            continue;
         }
-        digit /= 10;
-        s++;
+        lua_pop(L, 1);
+        // it is allowed to clear the existing field during the traversal
+        lua_pushvalue(L, -1);
+        lua_pushnil(L);
+        lua_rawset(L, idx);
     }
+}
 
-    if (v.uv < minval) {
-        errno = ERANGE;
-        goto FAILED;
-    }
+/**
+ * @brief decode_trimtable
+ *  remove the fields of the array indices greater than n from the table at
+ *  the top of the stack.
+ */
+static inline void decode_trimtable(lua_State *L, int n)
+{
+    int idx = lua_gettop(L);
 
-FAILED:
-    if (endptr) {
-        *endptr = s;
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+        lua_pop(L, 1);
+        if (decode_isarrkey(L, -1) && lua_tonumber(L, -1) > n) {
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, idx);
+        }
     }
-
-    return v.iv;
 }
 
-static inline char *decode_skip_space(char *s)
+/**
+ * @brief decode_table
+ *  push the destination table at dst to store the decoded value. if the
+ *  value at dst is not a table, a new table is created instead.
+ *  the fields of the destination table are removed by decode_cleartable.
+ */
+static inline void decode_table(lua_State *L, int dst, int narr, int nrec,
+                                int keep_tables)
 {
-    while (*s == ' ') {
-        s++;
+    if (dst && lua_type(L, dst) == LUA_TTABLE) {
+        decode_cleartable(L, dst, keep_tables);
+        lua_pushvalue(L, dst);
+        return;
     }
-    return s;
+    lua_createtable(L, narr, nrec);
 }
 
-static inline char *decode_skip_delim(char *s, char delim, char open_delim,
-                                      int skip_trailing_spaces)
+/**
+ * @brief decode_subtable
+ *  push the i-th table of the table at the top of the stack to reuse it as
+ *  the nested table, or a new table if it does not exist.
+ */
+static inline void decode_subtable(lua_State *L, int i, int narr, int nrec,
+                                   int keep_tables)
 {
-    int skip = 0;
-
-    // skip leading whitespaces
-    s = decode_skip_space(s);
-    while (*s) {
-        if (*s == delim) {
-            if (!skip) {
-                s++;
-                // skip trailing whitespaces
-                if (skip_trailing_spaces) {
-                    return decode_skip_space(s);
-                }
-                return s;
-            }
-            skip--;
-        } else if (*s == open_delim) {
-            // should skip nested delimiters
-            skip++;
-        } else if (*s == '\\') {
-            if (s[1]) {
-                s++;
-            }
-        }
-        s++;
+    lua_rawgeti(L, -1, i);
+    if (lua_type(L, -1) == LUA_TTABLE) {
+        decode_cleartable(L, lua_gettop(L), keep_tables);
+        return;
     }
-
-    return NULL;
+    lua_pop(L, 1);
+    lua_createtable(L, narr, nrec);
 }
 
-#define DECODE_TAIL_SET(str, len)                                              \
-    char *str_  = (char *)(str);                                               \
-    size_t len_ = (len);                                                       \
-    char tailc_ = str_[len_];                                                  \
-    str_[len_]  = 0
-
-#define DECODE_TAIL_UNSET() str_[len_] = tailc_
-
 #define DECODE_START(L, op, str, len)                                          \
     do {                                                                       \
         if (!(len)) {                                                          \
@@ -0,0 +1,124 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_arena_h
+#define lua_postgres_decode_arena_h
+
+#include "lua_postgres_decode.h"
+// core decoders
+#include "pgdec/pgdec_arena.h"
+
+#define DECODE_ARENA_MT "postgres.decode.arena"
+
+static int decode_arena_gc_lua(lua_State *L)
+{
+    decode_arena_free(lua_touserdata(L, 1));
+    return 0;
+}
+
+/**
+ * @brief decode_arena_new
+ *  push the new arena. the buffer of the arena is released by __gc.
+ */
+static inline decode_arena_t *decode_arena_new(lua_State *L)
+{
+    decode_arena_t *a = lua_newuserdata(L, sizeof(decode_arena_t));
+
+    *a = (decode_arena_t){0};
+    if (luaL_newmetatable(L, DECODE_ARENA_MT)) {
+        lua_pushcfunction(L, decode_arena_gc_lua);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_setmetatable(L, -2);
+    return a;
+}
+
+/**
+ * @brief decode_arena_enter
+ *  push the arena at the upvalue index idx to reuse it across the calls. if
+ *  it is in use by the caller of the decoder, e.g. the decoder is called by
+ *  the callback function, the temporary arena is pushed instead.
+ */
+static inline decode_arena_t *decode_arena_enter(lua_State *L, int idx)
+{
+    decode_arena_t *a = lua_touserdata(L, idx);
+
+    if (a->busy) {
+        a = decode_arena_new(L);
+    } else {
+        lua_pushvalue(L, idx);
+    }
+    a->busy = 1;
+    decode_arena_reset(a);
+    return a;
+}
+
+/**
+ * @brief decode_arena_detach
+ *  if the arena at the stack index slot is the arena at the upvalue index
+ *  idx, move its buffer to the new arena that replaces the stack index slot,
+ *  so the closure arena can be used by the other calls while the decoder is
+ *  suspended. the address of the buffer is not changed.
+ */
+static inline void decode_arena_detach(lua_State *L, int idx, int slot)
+{
+    decode_arena_t *a = lua_touserdata(L, slot);
+
+    if (a == lua_touserdata(L, idx)) {
+        decode_arena_t *t = decode_arena_new(L);
+
+        *t = *a;
+        *a = (decode_arena_t){0};
+        lua_replace(L, slot);
+    }
+}
+
+/**
+ * @brief decode_arena_leave
+ *  release the arena if it is the arena at the upvalue index idx. the
+ *  temporary arena is released by __gc, because it may have been removed
+ *  from the stack by decode_error.
+ */
+static inline void decode_arena_leave(lua_State *L, int idx, decode_arena_t *a)
+{
+    if (a == lua_touserdata(L, idx)) {
+        decode_arena_release(a);
+    }
+}
+
+/**
+ * @brief decode_arena_call
+ *  call the callback function as lua_call. if the function raises an error,
+ *  the arena at the stack index slot is released as decode_arena_leave
+ *  before the error is propagated, so that the closure arena at the upvalue
+ *  index idx is not left busy.
+ */
+static inline void decode_arena_call(lua_State *L, int idx, int slot,
+                                     int nargs, int nresults)
+{
+    if (lua_pcall(L, nargs, nresults, 0)) {
+        decode_arena_leave(L, idx, lua_touserdata(L, slot));
+        lua_error(L);
+    }
+}
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_copy_h
+#define lua_postgres_decode_copy_h
+
+#include "lua_postgres_decode_field.h"
+
+// COPY: Text Format
+// https://www.postgresql.org/docs/current/sql-copy.html#id-1.9.3.55.9.2
+
+/**
+ * @brief decode_copy_delim
+ *  check the delimiter argument at idx of the stack. if the argument is nil,
+ *  the delimiter is not changed.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static inline int decode_copy_delim(lua_State *L, const char *op, int idx,
+                                    char *delim)
+{
+    if (!lua_isnil(L, idx)) {
+        size_t len      = 0;
+        const char *str = lauxh_checklstring(L, idx, &len);
+        if (len != 1) {
+            return decode_error(L, op, EINVAL,
+                                "delimiter must be a single character");
+        } else if (*str == '\\' || *str == '\n' || *str == '\r') {
+            return decode_error(L, op, EINVAL,
+                                "delimiter cannot be backslash or newline");
+        }
+        *delim = *str;
+    }
+    return 0;
+}
+
+/**
+ * @brief decode_copy_unescape
+ *  push the string that the backslash escape sequences are unescaped.
+ */
+static inline void decode_copy_unescape(lua_State *L, const char *s, const char *tail)
+{
+    const char *head = s;
+    luaL_Buffer b;
+
+    luaL_buffinit(L, &b);
+    while (s < tail) {
+        int c = 0;
+
+        if (*s != '\\') {
+            s++;
+            continue;
+        }
+        luaL_addlstring(&b, head, s - head);
+        if (++s == tail) {
+            // trailing backslash is treated as a literal backslash
+            head = s - 1;
+            break;
+        }
+
+        switch (*s) {
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'v':
+            c = '\v';
+            break;
+
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+            // \digits: octal value (1 to 3 digits)
+            c = *s - '0';
+            for (int i = 1; i < 3 && s + 1 < tail && s[1] >= '0' && s[1] <= '7';
+                 i++) {
+                c = (c << 3) | (*++s - '0');
+            }
+            break;
+
+        case 'x':
+            // \xdigits: hexadecimal value (1 or 2 digits)
+            if (s + 1 < tail && decode_hexval(s[1]) >= 0) {
+                c = decode_hexval(*++s);
+                if (s + 1 < tail && decode_hexval(s[1]) >= 0) {
+                    c = (c << 4) | decode_hexval(*++s);
+                }
+                break;
+            }
+            // fallthrough
+
+        default:
+            // any other character is taken literally
+            c = *s;
+        }
+        luaL_addchar(&b, c);
+        head = ++s;
+    }
+    luaL_addlstring(&b, head, tail - head);
+    luaL_pushresult(&b);
+}
+
+#endif
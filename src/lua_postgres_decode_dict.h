@@ -0,0 +1,168 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_dict_h
+#define lua_postgres_decode_dict_h
+
+#include "lua_postgres_decode.h"
+#include <string.h>
+
+// dictionary that maps each distinct string to a small integer code.
+// the strings are interned in the C hash table, and each string is pushed
+// to the lua state only once when it is added to the dictionary.
+
+#define DICT_MT "postgres.decode.dict"
+
+typedef struct {
+    uint32_t hash; // hash value of the string
+    uint32_t code; // code of the string. 0 is the empty slot
+    size_t off;    // offset of the string in the buffer
+    size_t len;    // length of the string
+} dict_slot_t;
+
+typedef struct {
+    int ref;            // reference of the values table: code -> string
+    uint32_t len;       // number of the codes
+    uint32_t size;      // number of the slots
+    dict_slot_t *slots; // open addressing hash table
+    char *buf;          // buffer of the strings
+    size_t buflen;
+    size_t bufcap;
+} dict_t;
+
+static inline dict_t *decode_dict_check(lua_State *L, int idx)
+{
+    return luaL_checkudata(L, idx, DICT_MT);
+}
+
+static inline uint32_t decode_dict_hash(const char *s, size_t len)
+{
+    // FNV-1a
+    uint32_t h = 2166136261U;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619U;
+    }
+    return h;
+}
+
+static inline int decode_dict_grow(dict_t *d)
+{
+    uint32_t size      = d->size ? d->size * 2 : 64;
+    dict_slot_t *slots = NULL;
+
+    if (size < d->size) {
+        errno = ENOMEM;
+        return -1;
+    } else if (!(slots = calloc(size, sizeof(dict_slot_t)))) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < d->size; i++) {
+        if (d->slots[i].code) {
+            uint32_t j = d->slots[i].hash & (size - 1);
+            while (slots[j].code) {
+                j = (j + 1) & (size - 1);
+            }
+            slots[j] = d->slots[i];
+        }
+    }
+    free(d->slots);
+    d->slots = slots;
+    d->size  = size;
+    return 0;
+}
+
+/**
+ * @brief decode_dict_lookup
+ *  return the slot of the string, or the empty slot to insert the string.
+ *  the hash table must have at least one empty slot.
+ */
+static inline dict_slot_t *decode_dict_lookup(dict_t *d, const char *s,
+                                              size_t len, uint32_t hash)
+{
+    uint32_t i = hash & (d->size - 1);
+
+    while (d->slots[i].code) {
+        dict_slot_t *slot = &d->slots[i];
+        if (slot->hash == hash && slot->len == len &&
+            memcmp(d->buf + slot->off, s, len) == 0) {
+            break;
+        }
+        i = (i + 1) & (d->size - 1);
+    }
+    return &d->slots[i];
+}
+
+/**
+ * @brief decode_dict_encode
+ *  return the code of the string. if the string is not in the dictionary,
+ *  it is added to the dictionary and the values table.
+ * @return lua_Integer the code of the string, or -1 and errno is set on
+ *  failure.
+ */
+static inline lua_Integer decode_dict_encode(lua_State *L, dict_t *d,
+                                             const char *s, size_t len)
+{
+    uint32_t hash     = decode_dict_hash(s, len);
+    dict_slot_t *slot = NULL;
+
+    // keep the load factor below 0.5
+    if ((d->len + 1) * 2 > d->size && decode_dict_grow(d)) {
+        return -1;
+    }
+    slot = decode_dict_lookup(d, s, len, hash);
+    if (slot->code) {
+        return slot->code;
+    }
+
+    // add the string to the buffer
+    if (d->bufcap - d->buflen < len) {
+        size_t cap = d->bufcap ? d->bufcap : 1024;
+        char *buf  = NULL;
+
+        while (cap - d->buflen < len) {
+            cap *= 2;
+        }
+        if (!(buf = realloc(d->buf, cap))) {
+            return -1;
+        }
+        d->buf    = buf;
+        d->bufcap = cap;
+    }
+    memcpy(d->buf + d->buflen, s, len);
+    *slot = (dict_slot_t){
+        .hash = hash,
+        .code = ++d->len,
+        .off  = d->buflen,
+        .len  = len,
+    };
+    d->buflen += len;
+
+    // values[code] = string
+    lua_rawgeti(L, LUA_REGISTRYINDEX, d->ref);
+    lua_pushlstring(L, s, len);
+    lua_rawseti(L, -2, slot->code);
+    lua_pop(L, 1);
+    return slot->code;
+}
+
+#endif
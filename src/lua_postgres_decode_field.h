@@ -0,0 +1,137 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_field_h
+#define lua_postgres_decode_field_h
+
+#include "lua_postgres_decode.h"
+
+// built-in decoders that can be specified by name as a field decoder
+static const char *const DECODE_FIELD_BUILTINS[] = {
+    "bit",       "bool",      "box",       "bytea",     "circle",    "date",
+    "float",     "hstore",    "inet",      "int",       "json",      "line",
+    "lseg",      "macaddr",   "path",      "point",     "polygon",   "time",
+    "timestamp", "tsvector",  "uuid",      NULL,
+};
+
+/**
+ * @brief decode_field_builtin
+ *  replace the name at the top of the stack with the built-in decoder
+ *  function of the name. the loaded decoder is cached in the table at
+ *  cache_idx of the stack.
+ */
+static inline void decode_field_builtin(lua_State *L, int cache_idx, int argn)
+{
+    const char *name = lua_tostring(L, -1);
+    int i            = 0;
+
+    lua_pushvalue(L, -1);
+    lua_rawget(L, cache_idx);
+    if (!lua_isnil(L, -1)) {
+        // cached decoder
+        lua_replace(L, -2);
+        return;
+    }
+    lua_pop(L, 1);
+
+    for (; DECODE_FIELD_BUILTINS[i]; i++) {
+        if (strcmp(name, DECODE_FIELD_BUILTINS[i]) == 0) {
+            break;
+        }
+    }
+    if (!DECODE_FIELD_BUILTINS[i]) {
+        luaL_argerror(L, argn,
+                      lua_pushfstring(L, "unknown decoder name '%s'", name));
+        return;
+    }
+
+    // require('postgres.decode.<name>')
+    lua_getglobal(L, "require");
+    lua_pushfstring(L, "postgres.decode.%s", name);
+    lua_call(L, 1, 1);
+    // cache the decoder
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, cache_idx);
+    lua_replace(L, -2);
+}
+
+/**
+ * @brief decode_field
+ *  decode the field string at the top of the stack by the nfield-th decoder
+ *  of the decoder table at decoders_idx, and replace it with the decoded
+ *  value. the built-in decoder is called with the field string, and the
+ *  decoder function is called with the field string, is_quoted and the
+ *  context object at ctx_idx.
+ *  the stack indices must be absolute indices.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static inline int decode_field(lua_State *L, const char *op, int decoders_idx,
+                               int ctx_idx, int cache_idx, int nfield,
+                               int is_quoted)
+{
+    int nargs = 1;
+
+    if (lua_isnil(L, decoders_idx)) {
+        return 0;
+    }
+    lua_rawgeti(L, decoders_idx, nfield);
+    switch (lua_type(L, -1)) {
+    case LUA_TNIL:
+    case LUA_TBOOLEAN:
+        // no decoder
+        lua_pop(L, 1);
+        return 0;
+
+    case LUA_TSTRING:
+        decode_field_builtin(L, cache_idx, decoders_idx);
+        break;
+
+    case LUA_TFUNCTION:
+        nargs = 3;
+        break;
+
+    default:
+        return decode_error(L, op, EINVAL,
+                            "decoder #%d must be string or function, got %s",
+                            nfield, luaL_typename(L, -1));
+    }
+
+    // call decoder
+    lua_insert(L, -2);
+    if (nargs == 3) {
+        lua_pushboolean(L, is_quoted);
+        lua_pushvalue(L, ctx_idx);
+    }
+    lua_call(L, nargs, 2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return 0;
+    } else if (lua_type(L, -1) == LUA_TSTRING) {
+        return decode_error(L, op, EILSEQ, lua_tostring(L, -1));
+    }
+    // pass through the error object of the built-in decoder
+    return decode_error_pass(L);
+}
+
+#endif
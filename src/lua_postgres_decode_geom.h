@@ -24,36 +24,7 @@
 #define lua_postgres_decode_geom_h
 
 #include "lua_postgres_decode.h"
-
-// 8.8. Geometric Types
-// https://www.postgresql.org/docs/current/datatype-geometric.html
-
-#define GEOM_SKIP_DELIM(s, delim, ...)                                         \
-    do {                                                                       \
-        (s) = decode_skip_delim((s), (delim), 0, 1);                           \
-        if (!(s)) {                                                            \
-            return decode_error((L), (op), EILSEQ, __VA_ARGS__);               \
-        }                                                                      \
-    } while (0)
-
-#define GEOM_STR2DBL(s, v)                                                     \
-    do {                                                                       \
-        char *endptr_ = NULL;                                                  \
-        (v)           = decode_str2dbl((s), &endptr_);                         \
-        if (errno) {                                                           \
-            return decode_error((L), (op), errno, NULL);                       \
-        }                                                                      \
-        (s) = endptr_;                                                         \
-    } while (0)
-
-#define GEOM_STR2POINT(s, x, y)                                                \
-    do {                                                                       \
-        /* parse (x,y) */                                                      \
-        GEOM_SKIP_DELIM((s), '(', "opening round bracket not found");          \
-        GEOM_STR2DBL((s), (x));                                                \
-        GEOM_SKIP_DELIM(s, ',', "separator not found");                        \
-        GEOM_STR2DBL((s), (y));                                                \
-        GEOM_SKIP_DELIM((s), ')', "closing round bracket not found");          \
-    } while (0)
+// core decoders
+#include "pgdec/pgdec_geom.h"
 
 #endif
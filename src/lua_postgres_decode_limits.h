@@ -0,0 +1,65 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_limits_h
+#define lua_postgres_decode_limits_h
+
+#include "lua_postgres_decode.h"
+// core decoders
+#include "pgdec/pgdec_limits.h"
+
+// registry key of the decode_limits_t that is set by decode.limits()
+#define DECODE_LIMITS "postgres.decode.limits"
+
+// estimated sizes of the lua objects to count the bytes of the decoded value
+#define DECODE_SIZEOF_TABLE       56
+#define DECODE_SIZEOF_SLOT        16
+#define DECODE_SIZEOF_NODE        32
+#define DECODE_SIZEOF_STRING(len) (24 + (len) + 1)
+
+/**
+ * @brief decode_quota_start
+ *  initialize the quota by the limits that are set by decode.limits().
+ */
+static inline void decode_quota_start(lua_State *L, decode_quota_t *q)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_LIMITS);
+    decode_quota_init(q, lua_touserdata(L, -1));
+    lua_pop(L, 1);
+}
+
+/**
+ * @brief decode_quota_string
+ *  check the length of the element string, and count the bytes of the
+ *  string.
+ * @return int 0 on success, or -1 if the limit is exceeded, when error then
+ * q->err is set to E2BIG.
+ */
+static inline int decode_quota_string(decode_quota_t *q, size_t len)
+{
+    if (decode_quota_length(q, len)) {
+        return -1;
+    }
+    return decode_quota_add(q, 0, DECODE_SIZEOF_STRING(len));
+}
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_points_h
+#define lua_postgres_decode_points_h
+
+#include "lua_postgres_decode_geom.h"
+#include "lua_postgres_decode_limits.h"
+#include "lua_postgres_decode_yield.h"
+
+// the path and polygon strings are decoded in two phases. the first phase
+// parses the whole string into the points in the arena, and the second
+// phase builds the point tables only after the string is validated.
+
+// state of the second phase that is kept in the arena to resume it
+typedef struct {
+    decode_yield_t y;
+    int npoint;
+    // number of the built points
+    int k;
+} decode_points_t;
+
+// stack index of the arena
+#define DECODE_POINTS_ARENA 3
+
+/**
+ * @brief decode_points_add
+ *  count the point by the quota q, and append it to the arena.
+ * @return int 0 on success, or -1 on error, when error then nil and error
+ * are pushed.
+ */
+static inline int decode_points_add(lua_State *L, const char *op,
+                                    decode_quota_t *q, decode_arena_t *a,
+                                    const pgdec_point_t *pt)
+{
+    pgdec_point_t *p = NULL;
+
+    if (decode_quota_add(q, 1,
+                         DECODE_SIZEOF_SLOT * 3 + DECODE_SIZEOF_TABLE)) {
+        decode_error_from(L, op, &q->err);
+        return -1;
+    } else if (!(p = decode_arena_alloc(a, sizeof(pgdec_point_t)))) {
+        decode_error(L, op, ENOMEM, NULL);
+        return -1;
+    }
+    *p = *pt;
+    return 0;
+}
+
+/**
+ * @brief decode_points_build
+ *  set the point tables to the table at the top of the stack.
+ * @return int 0 on success, or 1 if the current step is exhausted.
+ */
+static inline int decode_points_build(lua_State *L, decode_arena_t *a,
+                                      decode_points_t *b)
+{
+    while (b->k < b->npoint) {
+        pgdec_point_t *pt = decode_arena_at(a, sizeof(pgdec_point_t), b->k++);
+
+        decode_subtable(L, b->k, 2, 0, 0);
+        lauxh_pushnum2arr(L, 1, pt->x);
+        lauxh_pushnum2arr(L, 2, pt->y);
+        lua_rawseti(L, -2, b->k);
+        if (decode_yield_tick(&b->y)) {
+            return 1;
+        }
+    }
+    decode_trimtable(L, b->npoint);
+    return 0;
+}
+
+static inline int decode_points_continue(lua_State *L, size_t off);
+
+#if LUA_VERSION_NUM >= 503
+static inline int decode_points_resume(lua_State *L, int status,
+                                       lua_KContext ctx)
+{
+    (void)status;
+    decode_yield_state(L, DECODE_POINTS_ARENA, (size_t)ctx);
+    return decode_points_continue(L, (size_t)ctx);
+}
+#endif
+
+/**
+ * @brief decode_points_continue
+ *  build the point tables from the state at the offset off in the arena,
+ *  and release the arena when it is done.
+ */
+static inline int decode_points_continue(lua_State *L, size_t off)
+{
+    decode_arena_t *a  = lua_touserdata(L, DECODE_POINTS_ARENA);
+    decode_points_t *b = (decode_points_t *)(a->buf + off);
+
+#if LUA_VERSION_NUM >= 503
+    if (decode_points_build(L, a, b)) {
+        return decode_yield(L, lua_upvalueindex(1), DECODE_POINTS_ARENA,
+                            &b->y, off, decode_points_resume);
+    }
+#else
+    decode_points_build(L, a, b);
+#endif
+    decode_arena_leave(L, lua_upvalueindex(1), a);
+    return 1;
+}
+
+/**
+ * @brief decode_points
+ *  build the npoint points in the arena a at the stack index
+ *  DECODE_POINTS_ARENA into the table at the stack index 2, or a new table.
+ *  the arena must be the arena of the closure at the upvalue index 1.
+ */
+static inline int decode_points(lua_State *L, const char *op,
+                                decode_arena_t *a, int npoint)
+{
+    size_t off         = 0;
+    decode_points_t *b = decode_arena_alloc_state(a, sizeof(decode_points_t),
+                                                  &off);
+
+    if (!b) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        return decode_error(L, op, ENOMEM, NULL);
+    }
+    *b = (decode_points_t){
+        .npoint = npoint,
+    };
+    decode_yield_init(L, &b->y);
+    decode_table(L, 2, npoint, 0, 1);
+    return decode_points_continue(L, off);
+}
+
+#endif
@@ -23,7 +23,9 @@
 #ifndef lua_postgres_decode_range_h
 #define lua_postgres_decode_range_h
 
-#include "lua_postgres_decode.h"
+#include "lua_postgres_decode_arena.h"
+// core decoders
+#include "pgdec/pgdec_range.h"
 
 // 8.17. Range Types
 // https://www.postgresql.org/docs/current/rangetypes.html
@@ -35,150 +37,83 @@
  * @param L
  * @param token
  * @param len
+ * @param arena stack index of the arena that is released if the callback
+ *  function raises an error, or 0 if the decoder does not use the arena.
  */
 static inline void decode_range_item(lua_State *L, const char *token,
-                                     size_t len)
+                                     size_t len, int arena)
 {
     // call function
     lua_pushvalue(L, 2); // passed function
     lua_pushlstring(L, token, len);
     lua_pushboolean(L, *token == '"');
     lua_pushvalue(L, 3); // passed arg
-    lua_call(L, 3, 2);
+    if (arena) {
+        decode_arena_call(L, lua_upvalueindex(1), arena, 3, 2);
+    } else {
+        lua_call(L, 3, 2);
+    }
 }
 
 /**
- * @brief decode_range
- *  decode range string.
- *  if pos is not NULL, then pos is used as the start position.
- * @param L
- * @param op operation name for error message
- * @param src source string
- * @param len source string length
- * @param pos start position of source string or NULL
- * @return char* next position of source string or NULL on error, when error
- * then nil and error message are pushed to the stack.
+ * @brief decode_range_bound
+ *  decode the bound string by the callback function, and set the value to
+ *  the table at the top of the stack. inc is cleared if the value is nil.
+ * @return int 0 on success, or -1 on error, when error then nil and error
+ * message are pushed to the stack.
  */
-static char *decode_range(lua_State *L, const char *op, char *src, char *pos)
+static inline int decode_range_bound(lua_State *L, const char *op,
+                                     const char *token, size_t len, int idx,
+                                     int *inc, int arena)
 {
-    char *str        = (pos) ? pos : src;
-    char *token      = NULL;
-    size_t token_len = 0;
-    int ntoken       = 0;
-    int lower_inc    = 0;
-    int upper_inc    = 0;
-
-    lua_newtable(L);
-    // skip spaces
-    str = decode_skip_space(str);
-    if (!*str) {
-        decode_error(L, op, EINVAL, "empty string");
-        return NULL;
-    } else if (strncasecmp(str, "empty", 5) == 0) {
-        // its empty range
-        str = decode_skip_space(str + 5);
-        goto DONE;
-    }
-
-    switch (*str) {
-    default:
-        decode_error_at(L, op, EILSEQ, src, str);
-        return NULL;
-
-    case '[':
-        lower_inc = 1;
-    case '(':
-        str   = decode_skip_space(str + 1);
-        token = str;
+    if (!len) {
+        return 0;
     }
-
-    // find delimiter or closing parenthesis
-NEXT_CHAR:
-    switch (*str) {
-    case 0:
-        decode_error(L, op, EILSEQ, "malformed range string");
-        return NULL;
-
-    case '{':
-        str = decode_skip_delim(str + 1, '}', '{', 1);
-        goto NEXT_CHAR;
-    case '(':
-        str = decode_skip_delim(str + 1, ')', '(', 1);
-        goto NEXT_CHAR;
-    case '[':
-        str = decode_skip_delim(str + 1, ']', '[', 1);
-        goto NEXT_CHAR;
-    case '<':
-        str = decode_skip_delim(str + 1, '>', '<', 1);
-        goto NEXT_CHAR;
-
-    default:
-        str++;
-        goto NEXT_CHAR;
-
-    case ',':
-        if (ntoken) {
-            // first token already processed
-            decode_error_at(L, op, EILSEQ, src, str);
-            return NULL;
-        }
-        break;
-
-    case ']':
-        upper_inc = 1;
-    case ')':
-        if (!ntoken) {
-            // first token not yet processed
-            decode_error_at(L, op, EILSEQ, src, str);
-            return NULL;
-        }
-        break;
+    decode_range_item(L, token, len, arena);
+    if (!lua_isnil(L, -1)) {
+        // function returns multiple values
+        decode_error(L, op, EILSEQ, lua_tostring(L, -1));
+        return -1;
     }
-
-    // call function
-    token_len = str - token;
-    ntoken++;
-    if (token_len) {
-        decode_range_item(L, token, token_len);
-        if (!lua_isnil(L, -1)) {
-            // function returns multiple values
-            decode_error(L, op, EILSEQ, lua_tostring(L, -1));
-            return NULL;
-        }
-        lua_pop(L, 1);
-        if (lua_isnil(L, -1)) {
-            if (ntoken == 1) {
-                lower_inc = 0;
-            } else {
-                upper_inc = 0;
-            }
-        }
-        lua_rawseti(L, -2, ntoken);
-    } else if (ntoken == 1) {
-        lower_inc = 0;
-    } else {
-        upper_inc = 0;
+    lua_pop(L, 1);
+    if (lua_isnil(L, -1)) {
+        *inc = 0;
     }
+    lua_rawseti(L, -2, idx);
+    return 0;
+}
 
-    str = decode_skip_space(str + 1);
-    if (ntoken < 2) {
-        token = str;
-        goto NEXT_CHAR;
+/**
+ * @brief decode_range_push
+ *  decode the bounds of the range that found by decode_range_scan into the
+ *  table at the top of the stack. arena is the same as decode_range_item.
+ * @return int 0 on success, or -1 on error, when error then nil and error
+ * message are pushed to the stack.
+ */
+static inline int decode_range_push(lua_State *L, const char *op,
+                                    const char *src, pgdec_range_t *v,
+                                    int arena)
+{
+    if (v->empty) {
+        return 0;
+    } else if (decode_range_bound(L, op, src + v->lower, v->lower_len, 1,
+                                  &v->lower_inc, arena) ||
+               decode_range_bound(L, op, src + v->upper, v->upper_len, 2,
+                                  &v->upper_inc, arena)) {
+        return -1;
     }
 
-DONE:
-    if (lower_inc) {
+    if (v->lower_inc) {
         lua_pushliteral(L, "lower_inc");
         lua_pushboolean(L, 1);
         lua_rawset(L, -3);
     }
-    if (upper_inc) {
+    if (v->upper_inc) {
         lua_pushliteral(L, "upper_inc");
         lua_pushboolean(L, 1);
         lua_rawset(L, -3);
     }
-
-    return str;
+    return 0;
 }
 
 #endif
@@ -0,0 +1,235 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_stats_h
+#define lua_postgres_decode_stats_h
+
+// statistics of the decoders that are enabled by POSTGRES_DECODE_STATS.
+// each decoder function is wrapped by decode_stats_wrap to count the calls,
+// and the tables and strings that are created while the decoder is running
+// are counted by the macros at the end of this file. the allocator of the
+// lua_State is wrapped to count the requested bytes.
+
+#ifndef POSTGRES_DECODE_STATS
+# define DECODE_STATS_WRAP(L, op, method) ((void)0)
+#else
+# include <time.h>
+# define DECODE_STATS_WRAP(L, op, method) decode_stats_wrap(L, op, method)
+
+// registry key of the statistics table {op = decode_stats_t}
+# define DECODE_STATS     "postgres.decode.stats"
+// registry key of the decode_stats_ctx_t
+# define DECODE_STATS_CTX "postgres.decode.stats.ctx"
+
+typedef struct {
+    lua_Integer ncall;   // number of calls
+    lua_Integer nbyte;   // total bytes of the string arguments
+    lua_Integer ntable;  // number of created tables
+    lua_Integer nstring; // number of pushed strings
+    lua_Integer nalloc;  // bytes requested to the lua_Alloc
+    lua_Integer nerror;  // number of errors
+    double time;         // cumulative time in seconds
+} decode_stats_t;
+
+typedef struct {
+    decode_stats_t *cur; // statistics of the running decoder
+    lua_Alloc allocf;    // wrapped allocator of the lua_State
+    void *ud;            // userdata of the wrapped allocator
+    lua_Integer nalloc;  // total bytes requested to the allocator
+} decode_stats_ctx_t;
+
+static inline decode_stats_ctx_t *decode_stats_ctx(lua_State *L)
+{
+    decode_stats_ctx_t *ctx = NULL;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_STATS_CTX);
+    ctx = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return ctx;
+}
+
+static inline void decode_stats_count(lua_State *L, int ntable, int nstring)
+{
+    decode_stats_ctx_t *ctx = decode_stats_ctx(L);
+
+    if (ctx && ctx->cur) {
+        ctx->cur->ntable += ntable;
+        ctx->cur->nstring += nstring;
+    }
+}
+
+static inline double decode_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief decode_stats_alloc
+ *  count the bytes that are requested to the wrapped allocator. the bytes
+ *  of the new block and the grown part of the reallocated block are counted,
+ *  and the released bytes are not subtracted.
+ */
+static void *decode_stats_alloc(void *ud, void *ptr, size_t osize,
+                                size_t nsize)
+{
+    decode_stats_ctx_t *ctx = (decode_stats_ctx_t *)ud;
+    // osize is the type of the object if ptr is NULL
+    size_t size             = ptr ? osize : 0;
+
+    if (nsize > size) {
+        ctx->nalloc += (lua_Integer)(nsize - size);
+    }
+    return ctx->allocf(ctx->ud, ptr, osize, nsize);
+}
+
+static int decode_stats_ctx_gc(lua_State *L)
+{
+    decode_stats_ctx_t *ctx = lua_touserdata(L, 1);
+    void *ud                = NULL;
+
+    // restore the allocator before the context is released, unless it is
+    // wrapped again by the other library
+    lua_getallocf(L, &ud);
+    if (ud == ctx) {
+        lua_setallocf(L, ctx->allocf, ctx->ud);
+    }
+    return 0;
+}
+
+/**
+ * @brief decode_stats_call
+ *  call the wrapped decoder at upvalue 1 and update the statistics at
+ *  upvalue 2.
+ */
+static inline int decode_stats_call(lua_State *L)
+{
+    decode_stats_t *s       = lua_touserdata(L, lua_upvalueindex(2));
+    decode_stats_ctx_t *ctx = lua_touserdata(L, lua_upvalueindex(3));
+    decode_stats_t *prev    = ctx->cur;
+    int narg                = lua_gettop(L);
+    lua_Integer nalloc      = ctx->nalloc;
+    double t                = 0;
+    int rc                  = 0;
+    int i                   = 1;
+
+    s->ncall++;
+    for (; i <= narg; i++) {
+        if (lua_type(L, i) == LUA_TSTRING) {
+# if LUA_VERSION_NUM >= 502
+            s->nbyte += (lua_Integer)lua_rawlen(L, i);
+# else
+            s->nbyte += (lua_Integer)lua_objlen(L, i);
+# endif
+        }
+    }
+
+    ctx->cur = s;
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    t  = decode_stats_now();
+    rc = lua_pcall(L, narg, LUA_MULTRET, 0);
+    s->time += decode_stats_now() - t;
+    ctx->cur = prev;
+    s->nalloc += ctx->nalloc - nalloc;
+
+    if (rc) {
+        s->nerror++;
+        return lua_error(L);
+    } else if (lua_gettop(L) > 1 && lua_isnil(L, 1) && !lua_isnil(L, 2)) {
+        // nil, err
+        s->nerror++;
+    }
+    return lua_gettop(L);
+}
+
+/**
+ * @brief decode_stats_wrap
+ *  replace the function at the top of the stack with the function that
+ *  counts the statistics of the op. if method is not NULL, the statistics
+ *  are counted as '<op>.<method>'.
+ */
+static inline void decode_stats_wrap(lua_State *L, const char *op,
+                                     const char *method)
+{
+    decode_stats_ctx_t *ctx = decode_stats_ctx(L);
+
+    if (!ctx) {
+        ctx  = lua_newuserdata(L, sizeof(decode_stats_ctx_t));
+        *ctx = (decode_stats_ctx_t){0};
+        lua_createtable(L, 0, 1);
+        lua_pushcfunction(L, decode_stats_ctx_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_setmetatable(L, -2);
+        lua_setfield(L, LUA_REGISTRYINDEX, DECODE_STATS_CTX);
+        // count the bytes requested by all decoders of the lua_State
+        ctx->allocf = lua_getallocf(L, &ctx->ud);
+        lua_setallocf(L, decode_stats_alloc, ctx);
+    }
+
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_STATS);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, DECODE_STATS);
+    }
+    if (method) {
+        lua_pushfstring(L, "%s.%s", op, method);
+    } else {
+        lua_pushstring(L, op);
+    }
+    lua_pushvalue(L, -1);
+    lua_rawget(L, -3);
+    if (lua_isnil(L, -1)) {
+        decode_stats_t *s = NULL;
+
+        lua_pop(L, 1);
+        s  = lua_newuserdata(L, sizeof(decode_stats_t));
+        *s = (decode_stats_t){0};
+        lua_pushvalue(L, -2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -5);
+    }
+    // fn, stats, op, s -> fn, s, ctx
+    lua_replace(L, -3);
+    lua_pop(L, 1);
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_STATS_CTX);
+    lua_pushcclosure(L, decode_stats_call, 3);
+}
+
+// count the created tables and pushed strings
+# define lua_createtable(L, narr, nrec)                                        \
+     (decode_stats_count((L), 1, 0), (lua_createtable)((L), (narr), (nrec)))
+# define lua_pushlstring(L, s, len)                                            \
+     (decode_stats_count((L), 0, 1), (lua_pushlstring)((L), (s), (len)))
+# define lua_pushstring(L, s)                                                  \
+     (decode_stats_count((L), 0, 1), (lua_pushstring)((L), (s)))
+# define lua_pushfstring(L, ...)                                               \
+     (decode_stats_count((L), 0, 1), (lua_pushfstring)((L), __VA_ARGS__))
+# define luaL_pushresult(b)                                                    \
+     (decode_stats_count((b)->L, 0, 1), (luaL_pushresult)(b))
+
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_uuid_h
+#define lua_postgres_decode_uuid_h
+
+#include "lua_postgres_decode.h"
+#include <string.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+// 8.12. UUID Type
+// https://www.postgresql.org/docs/current/datatype-uuid.html
+
+#define UUID_LEN    16
+#define UUID_STRLEN 36
+
+#if defined(__SSE2__)
+
+/**
+ * @brief decode_uuid_hex16
+ *  decode 16 hex characters to 8 bytes at once.
+ *  the decoded bytes are stored in the lower 8 bytes of each 16-bit lane.
+ * @return __m128i 16-bit lanes of the decoded bytes, or the lane of 0xFFFF if
+ *  the invalid character is contained.
+ */
+static inline __m128i decode_uuid_hex16(__m128i v, int *invalid)
+{
+    // '0'-'9'
+    __m128i dig    = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i is_dig = _mm_and_si128(_mm_cmpgt_epi8(dig, _mm_set1_epi8(-1)),
+                                   _mm_cmplt_epi8(dig, _mm_set1_epi8(10)));
+    // 'a'-'f' or 'A'-'F'
+    __m128i alpha    = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                                    _mm_set1_epi8('a'));
+    __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(alpha, _mm_set1_epi8(-1)),
+                                     _mm_cmplt_epi8(alpha, _mm_set1_epi8(6)));
+    __m128i val      = _mm_or_si128(
+        _mm_and_si128(dig, is_dig),
+        _mm_and_si128(_mm_add_epi8(alpha, _mm_set1_epi8(10)), is_alpha));
+
+    *invalid |= _mm_movemask_epi8(_mm_or_si128(is_dig, is_alpha)) ^ 0xFFFF;
+    // merge the high nibble of even bytes and the low nibble of odd bytes
+    return _mm_and_si128(_mm_or_si128(_mm_slli_epi16(val, 4),
+                                      _mm_srli_epi16(val, 8)),
+                         _mm_set1_epi16(0x00FF));
+}
+
+#endif
+
+/**
+ * @brief decode_uuid_hex
+ *  decode 32 hex characters to 16 bytes.
+ * @return int 0 on success, otherwise -1.
+ */
+static inline int decode_uuid_hex(const char *hex, unsigned char *uuid)
+{
+#if defined(__SSE2__)
+    int invalid = 0;
+    __m128i lo  = decode_uuid_hex16(
+        _mm_loadu_si128((const __m128i *)hex), &invalid);
+    __m128i hi = decode_uuid_hex16(
+        _mm_loadu_si128((const __m128i *)(hex + 16)), &invalid);
+
+    _mm_storeu_si128((__m128i *)uuid, _mm_packus_epi16(lo, hi));
+    return invalid ? -1 : 0;
+#else
+    for (int i = 0; i < UUID_LEN; i++) {
+        int hv = decode_hexval(hex[i * 2]);
+        int lv = decode_hexval(hex[i * 2 + 1]);
+        if (hv < 0 || lv < 0) {
+            return -1;
+        }
+        uuid[i] = (hv << 4) | lv;
+    }
+    return 0;
+#endif
+}
+
+/**
+ * @brief decode_uuid
+ *  decode the uuid string of the 8-4-4-4-12 layout to 16 bytes.
+ *  only the first 36 characters of the string are decoded.
+ * @return char* NULL on success, otherwise the pointer to the invalid
+ *  character. if the string is shorter than 36 characters, the pointer to the
+ *  end of the string is returned.
+ */
+static inline char *decode_uuid(char *str, size_t len, unsigned char *uuid)
+{
+    char hex[UUID_LEN * 2];
+
+    if (len >= UUID_STRLEN && str[8] == '-' && str[13] == '-' &&
+        str[18] == '-' && str[23] == '-') {
+        // remove hyphens
+        memcpy(hex, str, 8);
+        memcpy(hex + 8, str + 9, 4);
+        memcpy(hex + 12, str + 14, 4);
+        memcpy(hex + 16, str + 19, 4);
+        memcpy(hex + 20, str + 24, 12);
+        if (decode_uuid_hex(hex, uuid) == 0) {
+            return NULL;
+        }
+    }
+
+    // find the invalid character
+    if (len > UUID_STRLEN) {
+        len = UUID_STRLEN;
+    }
+    for (size_t i = 0; i < len; i++) {
+        switch (i) {
+        case 8:
+        case 13:
+        case 18:
+        case 23:
+            if (str[i] != '-') {
+                return str + i;
+            }
+            break;
+        default:
+            if (decode_hexval(str[i]) < 0) {
+                return str + i;
+            }
+        }
+    }
+    return str + len;
+}
+
+/**
+ * @brief decode_uuid_push
+ *  push the 16 bytes binary string of the uuid, or the canonical lowercase
+ *  text if as_text is not 0.
+ */
+static inline void decode_uuid_push(lua_State *L, const unsigned char *uuid,
+                                    int as_text)
+{
+    static const char HEXDIGITS[] = "0123456789abcdef";
+    char buf[UUID_STRLEN];
+    char *p = buf;
+
+    if (!as_text) {
+        lua_pushlstring(L, (const char *)uuid, UUID_LEN);
+        return;
+    }
+
+    for (int i = 0; i < UUID_LEN; i++) {
+        switch (i) {
+        case 4:
+        case 6:
+        case 8:
+        case 10:
+            *p++ = '-';
+        }
+        *p++ = HEXDIGITS[uuid[i] >> 4];
+        *p++ = HEXDIGITS[uuid[i] & 0xF];
+    }
+    lua_pushlstring(L, buf, UUID_STRLEN);
+}
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_postgres_decode_yield_h
+#define lua_postgres_decode_yield_h
+
+#include "lua_postgres_decode_arena.h"
+
+// the decoders of the large values build the result in the steps of the
+// elements, and yield the running coroutine between the steps if the step
+// size is set by decode.yieldstep(). the state of the decoder is kept in the
+// arena, and the decoder is resumed by the continuation function. yielding
+// requires lua_yieldk of Lua 5.3 or later, and the decoder that is called by
+// another C function, such as decode.decode(), never yields.
+
+// registry key of the step size
+#define DECODE_YIELDSTEP "postgres.decode.yieldstep"
+
+typedef struct {
+    // number of the elements to build before yielding, or 0
+    size_t step;
+    // number of the elements left in the current step
+    size_t left;
+    // stack top to restore on resume
+    int top;
+} decode_yield_t;
+
+/**
+ * @brief decode_yieldstep
+ *  return the step size that is set by decode.yieldstep().
+ */
+static inline lua_Integer decode_yieldstep(lua_State *L)
+{
+    lua_Integer n = 0;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, DECODE_YIELDSTEP);
+    n = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return n > 0 ? n : 0;
+}
+
+/**
+ * @brief decode_yield_init
+ *  initialize the yield state. the step size is 0 if the running decoder
+ *  cannot yield.
+ */
+static inline void decode_yield_init(lua_State *L, decode_yield_t *y)
+{
+    *y = (decode_yield_t){0};
+#if LUA_VERSION_NUM >= 503
+    if (lua_isyieldable(L)) {
+        y->step = y->left = (size_t)decode_yieldstep(L);
+    }
+#else
+    (void)L;
+#endif
+}
+
+/**
+ * @brief decode_yield_tick
+ *  count the built element.
+ * @return int non-zero if the current step is exhausted.
+ */
+static inline int decode_yield_tick(decode_yield_t *y)
+{
+    if (y->step && !--y->left) {
+        y->left = y->step;
+        return 1;
+    }
+    return 0;
+}
+
+#if LUA_VERSION_NUM >= 503
+/**
+ * @brief decode_yield
+ *  yield the running coroutine without values, and k is called with the
+ *  offset of the state in the arena when the coroutine is resumed.
+ *  the arena at the stack index slot is detached from the closure arena at
+ *  the upvalue index idx.
+ */
+static inline int decode_yield(lua_State *L, int idx, int slot,
+                               decode_yield_t *y, size_t off, lua_KFunction k)
+{
+    decode_arena_detach(L, idx, slot);
+    y->top = lua_gettop(L);
+    return lua_yieldk(L, 0, (lua_KContext)off, k);
+}
+
+/**
+ * @brief decode_yield_state
+ *  return the state at the offset off in the arena at the stack index slot,
+ *  and discard the values passed by resume. the state must begin with the
+ *  decode_yield_t.
+ */
+static inline void *decode_yield_state(lua_State *L, int slot, size_t off)
+{
+    decode_arena_t *a = lua_touserdata(L, slot);
+    decode_yield_t *y = (decode_yield_t *)(a->buf + off);
+
+    lua_settop(L, y->top);
+    return y;
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode.h"
+
+// 8.9.3. macaddr
+// 8.9.4. macaddr8
+// https://www.postgresql.org/docs/current/datatype-net-types.html
+
+#define MACADDR_LEN  6
+#define MACADDR8_LEN 8
+
+static int decode_macaddr_error_at(lua_State *L, const char *op, char *str,
+                                   char *s)
+{
+    if (!*s) {
+        return decode_error(L, op, EILSEQ, "unexpected end of macaddr string");
+    }
+    return decode_error_at(L, op, EILSEQ, str, s);
+}
+
+static int decode_macaddr_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.macaddr";
+    size_t len            = 0;
+    char *str             = (char *)lauxh_checklstring(L, 1, &len);
+    char *s               = str;
+    unsigned char addr[MACADDR8_LEN];
+    size_t n = 0;
+
+    lua_settop(L, 1);
+    // macaddr: xx:xx:xx:xx:xx:xx
+    // macaddr8: xx:xx:xx:xx:xx:xx:xx:xx
+    DECODE_START(L, op, str, len);
+    for (;;) {
+        int hv = decode_hexval(s[0]);
+        int lv = 0;
+
+        if (hv < 0) {
+            return decode_macaddr_error_at(L, op, str, s);
+        } else if ((lv = decode_hexval(s[1])) < 0) {
+            return decode_macaddr_error_at(L, op, str, s + 1);
+        }
+        addr[n++] = (hv << 4) | lv;
+        s += 2;
+        if (n == MACADDR8_LEN || *s != ':') {
+            break;
+        }
+        s++;
+    }
+    if (n != MACADDR_LEN && n != MACADDR8_LEN) {
+        if (*s) {
+            return decode_macaddr_error_at(L, op, str, s);
+        }
+        return decode_error(L, op, EILSEQ,
+                            "invalid number of octets %d, must be %d or %d",
+                            (int)n, MACADDR_LEN, MACADDR8_LEN);
+    }
+    DECODE_END(s);
+
+    lua_pushlstring(L, (const char *)addr, n);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_macaddr(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, decode_macaddr_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.macaddr", NULL);
+    return 1;
+}
@@ -20,39 +20,325 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
+#include "lua_postgres_decode_limits.h"
 #include "lua_postgres_decode_range.h"
+#include "lua_postgres_decode_yield.h"
 
-static int decode_multirange_lua(lua_State *L)
+#define MULTIRANGE_MT "postgres.decode.multirange"
+
+// bound flags of the packed range
+#define MRANGE_LOWER_INC 0x1
+#define MRANGE_UPPER_INC 0x2
+#define MRANGE_LOWER_INF 0x4
+#define MRANGE_UPPER_INF 0x8
+
+typedef struct {
+    lua_Number lower;
+    lua_Number upper;
+    int flags;
+} mrange_item_t;
+
+typedef struct {
+    size_t len;
+    size_t cap;
+    mrange_item_t items[];
+} mrange_t;
+
+/**
+ * @brief mrange_below_upper
+ *  returns 1 if the value v is lower than or equal to the upper bound of the
+ *  range item.
+ */
+static inline int mrange_below_upper(mrange_item_t *item, lua_Number v)
 {
-    static const char *op = "postgres.decode.multirange";
-    size_t len            = 0;
-    char *src             = (char *)lauxh_checklstring(L, 1, &len);
-    char *str             = src;
-    int nrange            = 0;
+    return (item->flags & MRANGE_UPPER_INF) || v < item->upper ||
+           (v == item->upper && (item->flags & MRANGE_UPPER_INC));
+}
 
-    luaL_checktype(L, 2, LUA_TFUNCTION);
-    if (lua_gettop(L) < 3) {
+/**
+ * @brief mrange_above_lower
+ *  returns 1 if the value v is greater than or equal to the lower bound of the
+ *  range item.
+ */
+static inline int mrange_above_lower(mrange_item_t *item, lua_Number v)
+{
+    return (item->flags & MRANGE_LOWER_INF) || v > item->lower ||
+           (v == item->lower && (item->flags & MRANGE_LOWER_INC));
+}
+
+/**
+ * @brief mrange_search
+ *  returns the index of the first range item whose upper bound is greater than
+ *  or equal to the value v. the range items must be sorted in canonical order.
+ */
+static size_t mrange_search(mrange_t *mr, lua_Number v)
+{
+    size_t lo = 0;
+    size_t hi = mr->len;
+
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) >> 1);
+        if (mrange_below_upper(&mr->items[mid], v)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+static int mrange_contains_lua(lua_State *L)
+{
+    mrange_t *mr = luaL_checkudata(L, 1, MULTIRANGE_MT);
+    lua_Number v = luaL_checknumber(L, 2);
+    size_t idx   = mrange_search(mr, v);
+
+    lua_pushboolean(L, idx < mr->len &&
+                           mrange_above_lower(&mr->items[idx], v));
+    return 1;
+}
+
+static int mrange_overlaps_lua(lua_State *L)
+{
+    mrange_t *mr = luaL_checkudata(L, 1, MULTIRANGE_MT);
+    size_t idx   = 0;
+
+    // nil means unbounded
+    if (!lua_isnoneornil(L, 2)) {
+        idx = mrange_search(mr, luaL_checknumber(L, 2));
+    }
+    if (idx < mr->len) {
+        if (lua_isnoneornil(L, 3)) {
+            lua_pushboolean(L, 1);
+            return 1;
+        }
+        lua_pushboolean(
+            L, mrange_above_lower(&mr->items[idx], luaL_checknumber(L, 3)));
+        return 1;
+    }
+    lua_pushboolean(L, 0);
+    return 1;
+}
+
+static int mrange_push_item(lua_State *L, mrange_t *mr, lua_Integer idx)
+{
+    mrange_item_t *item = NULL;
+
+    if (idx < 1 || (size_t)idx > mr->len) {
+        return 0;
+    }
+    item = &mr->items[idx - 1];
+    if (item->flags & MRANGE_LOWER_INF) {
+        lua_pushnil(L);
+    } else {
+        lua_pushnumber(L, item->lower);
+    }
+    if (item->flags & MRANGE_UPPER_INF) {
         lua_pushnil(L);
+    } else {
+        lua_pushnumber(L, item->upper);
+    }
+    lua_pushboolean(L, item->flags & MRANGE_LOWER_INC);
+    lua_pushboolean(L, item->flags & MRANGE_UPPER_INC);
+    return 4;
+}
+
+static int mrange_range_lua(lua_State *L)
+{
+    mrange_t *mr = luaL_checkudata(L, 1, MULTIRANGE_MT);
+    return mrange_push_item(L, mr, luaL_checkinteger(L, 2));
+}
+
+static int mrange_next_lua(lua_State *L)
+{
+    mrange_t *mr    = luaL_checkudata(L, 1, MULTIRANGE_MT);
+    lua_Integer idx = luaL_checkinteger(L, 2) + 1;
+
+    if (idx < 1 || (size_t)idx > mr->len) {
+        return 0;
     }
-    lua_settop(L, 3);
-    lua_newtable(L);
+    lua_pushinteger(L, idx);
+    return 1 + mrange_push_item(L, mr, idx);
+}
+
+static int mrange_ranges_lua(lua_State *L)
+{
+    luaL_checkudata(L, 1, MULTIRANGE_MT);
+    lua_pushcfunction(L, mrange_next_lua);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+
+static int mrange_len_lua(lua_State *L)
+{
+    mrange_t *mr = luaL_checkudata(L, 1, MULTIRANGE_MT);
+    lua_pushinteger(L, mr->len);
+    return 1;
+}
+
+static int mrange_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MULTIRANGE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+/**
+ * @brief mrange_append
+ *  append the range table at the top of the stack to the packed multirange
+ *  placed at the index 4 of the stack, and pop the range table.
+ *  the packed multirange is reallocated if its capacity is exhausted.
+ */
+static int mrange_append(lua_State *L, const char *op)
+{
+    mrange_t *mr        = lua_touserdata(L, 4);
+    mrange_item_t *item = NULL;
 
+    if (mr->len == mr->cap) {
+        size_t cap   = mr->cap * 2;
+        mrange_t *nr = lua_newuserdata(L, sizeof(mrange_t) +
+                                              sizeof(mrange_item_t) * cap);
+        memcpy(nr, mr, sizeof(mrange_t) + sizeof(mrange_item_t) * mr->len);
+        nr->cap = cap;
+        lua_replace(L, 4);
+        mr = nr;
+    }
+    item = &mr->items[mr->len];
+    *item = (mrange_item_t){0};
+
+    // lower bound
+    lua_rawgeti(L, -1, 1);
+    switch (lua_type(L, -1)) {
+    case LUA_TNIL:
+        item->flags |= MRANGE_LOWER_INF;
+        break;
+    case LUA_TNUMBER:
+        item->lower = lua_tonumber(L, -1);
+        break;
+    default:
+        return decode_error(L, op, EINVAL,
+                            "lower bound must be a number, got %s",
+                            luaL_typename(L, -1));
+    }
+    // upper bound
+    lua_rawgeti(L, -2, 2);
+    switch (lua_type(L, -1)) {
+    case LUA_TNIL:
+        item->flags |= MRANGE_UPPER_INF;
+        break;
+    case LUA_TNUMBER:
+        item->upper = lua_tonumber(L, -1);
+        break;
+    default:
+        return decode_error(L, op, EINVAL,
+                            "upper bound must be a number, got %s",
+                            luaL_typename(L, -1));
+    }
+    lua_getfield(L, -3, "lower_inc");
+    if (lua_toboolean(L, -1)) {
+        item->flags |= MRANGE_LOWER_INC;
+    }
+    lua_getfield(L, -4, "upper_inc");
+    if (lua_toboolean(L, -1)) {
+        item->flags |= MRANGE_UPPER_INC;
+    }
+    lua_pop(L, 5);
+
+    // ranges must be sorted and non-overlapping as postgres emits them
+    if (mr->len) {
+        mrange_item_t *prev = &mr->items[mr->len - 1];
+        if ((prev->flags & MRANGE_UPPER_INF) ||
+            (item->flags & MRANGE_LOWER_INF) || prev->upper > item->lower ||
+            (prev->upper == item->lower && (prev->flags & MRANGE_UPPER_INC) &&
+             (item->flags & MRANGE_LOWER_INC))) {
+            return decode_error(L, op, EINVAL,
+                                "ranges are not in canonical order");
+        }
+    }
+    mr->len++;
+    return 0;
+}
+
+#define MULTIRANGE_NODE(a, idx)                                                \
+    ((pgdec_range_t *)decode_arena_at((a), sizeof(pgdec_range_t), (idx)))
+
+// the multirange string is decoded in two phases. the first phase scans the
+// whole string into the ranges in the arena, and the second phase decodes
+// the bounds into the tables of the exact sizes only after the string is
+// validated.
+
+// state of the second phase that is kept in the arena to resume it
+typedef struct {
+    decode_yield_t y;
+    const char *op;
+    const char *src;
+    int packed;
+    size_t nrange;
+    // index of the next range
+    size_t i;
+} multirange_build_t;
+
+// stack index of the arena
+#define MULTIRANGE_ARENA 6
+
+/**
+ * @brief decode_multirange_parse
+ *  phase 1: scan the whole multirange string into the arena, and push the
+ *  table or replace the placeholder with the packed multirange to build.
+ * @return int 0 on success and the offset of the build state is stored to
+ * *off, otherwise the number of the pushed error values.
+ */
+static int decode_multirange_parse(lua_State *L, const char *op, char *src,
+                                   size_t len, int packed, decode_arena_t *a,
+                                   size_t *off)
+{
+    char *str             = src;
+    const char *tail      = src + len;
+    size_t nrange         = 0;
+    size_t nitem          = 0;
+    pgdec_error_t err     = {0};
+    multirange_build_t *b = NULL;
+    decode_quota_t quota;
+
+    decode_quota_start(L, &quota);
     DECODE_START(L, op, str, len);
     // skip spaces
-    str = decode_skip_space(str);
+    str = decode_skip_space(str, tail);
     if (!*str) {
         return decode_error(L, op, EINVAL, "empty string");
     } else if (*str != '{') {
         return decode_error_at(L, op, EILSEQ, src, str);
     }
-    str++;
+    str = decode_skip_space(str + 1, tail);
+    if (*str == '}') {
+        // empty multirange
+        goto CLOSED;
+    }
 
 NEXT_RANGE:
-    str = decode_range(L, op, src, str);
-    if (!str) {
-        return 2;
+    {
+        pgdec_range_t *v = decode_arena_alloc(a, sizeof(pgdec_range_t));
+        if (!v) {
+            return decode_error(L, op, ENOMEM, NULL);
+        }
+        str = decode_range_scan(v, &err, src, tail, str);
+        if (!str) {
+            return decode_error_from(L, op, &err);
+        } else if ((v->lower_len &&
+                    decode_quota_string(&quota, v->lower_len)) ||
+                   (v->upper_len &&
+                    decode_quota_string(&quota, v->upper_len)) ||
+                   decode_quota_add(&quota, 1,
+                                    packed ? sizeof(mrange_item_t)
+                                           : DECODE_SIZEOF_SLOT +
+                                                 DECODE_SIZEOF_TABLE +
+                                                 DECODE_SIZEOF_NODE * 2)) {
+            return decode_error_from(L, op, &quota.err);
+        }
+        nrange++;
+        // empty ranges are not stored in the packed multirange
+        nitem += !v->empty;
     }
-    lua_rawseti(L, -2, ++nrange);
 
     // find delimiter or closing parenthesis
     switch (*str) {
@@ -70,17 +356,178 @@ NEXT_RANGE:
         // found closing parenthesis
         break;
     }
-    // call function
-    str = decode_skip_space(str + 1);
 
+CLOSED:
+    str = decode_skip_space(str + 1, tail);
     DECODE_END(str);
 
-    return 1;
+    if (!(b = decode_arena_alloc_state(a, sizeof(multirange_build_t), off))) {
+        return decode_error(L, op, ENOMEM, NULL);
+    }
+    *b = (multirange_build_t){
+        .op     = op,
+        .src    = src,
+        .packed = packed,
+        .nrange = nrange,
+    };
+    decode_yield_init(L, &b->y);
+    if (packed) {
+        size_t cap   = nitem ? nitem : 1;
+        mrange_t *mr = lua_newuserdata(L, sizeof(mrange_t) +
+                                              sizeof(mrange_item_t) * cap);
+        *mr = (mrange_t){
+            .len = 0,
+            .cap = cap,
+        };
+        lua_replace(L, 4);
+        return 0;
+    }
+    decode_table(L, 5, (int)nrange, 0, 1);
+    return 0;
+}
+
+/**
+ * @brief decode_multirange_build
+ *  phase 2: decode the bounds of the ranges.
+ * @return int 0 on success, 1 if the current step is exhausted, or -1 on
+ * error, when error then nil and error are pushed.
+ */
+static int decode_multirange_build(lua_State *L, decode_arena_t *a,
+                                   multirange_build_t *b)
+{
+    while (b->i < b->nrange) {
+        pgdec_range_t *v = MULTIRANGE_NODE(a, b->i++);
+
+        if (b->packed) {
+            if (v->empty) {
+                continue;
+            }
+            lua_createtable(L, 2, 2);
+            if (decode_range_push(L, b->op, b->src, v, MULTIRANGE_ARENA) ||
+                mrange_append(L, b->op)) {
+                return -1;
+            }
+        } else {
+            decode_subtable(L, (int)b->i, 2, 2, 0);
+            if (decode_range_push(L, b->op, b->src, v, MULTIRANGE_ARENA)) {
+                return -1;
+            }
+            lua_rawseti(L, -2, (int)b->i);
+        }
+        if (decode_yield_tick(&b->y)) {
+            return 1;
+        }
+    }
+
+    if (b->packed) {
+        lua_pushvalue(L, 4);
+        luaL_getmetatable(L, MULTIRANGE_MT);
+        lua_setmetatable(L, -2);
+        return 0;
+    }
+    decode_trimtable(L, (int)b->nrange);
+    return 0;
+}
+
+static int decode_multirange_continue(lua_State *L, size_t off);
+
+#if LUA_VERSION_NUM >= 503
+static int decode_multirange_resume(lua_State *L, int status,
+                                    lua_KContext ctx)
+{
+    (void)status;
+    decode_yield_state(L, MULTIRANGE_ARENA, (size_t)ctx);
+    return decode_multirange_continue(L, (size_t)ctx);
+}
+#endif
+
+/**
+ * @brief decode_multirange_continue
+ *  build the ranges from the state at the offset off in the arena, and
+ *  release the arena when it is done.
+ */
+static int decode_multirange_continue(lua_State *L, size_t off)
+{
+    decode_arena_t *a     = lua_touserdata(L, MULTIRANGE_ARENA);
+    multirange_build_t *b = (multirange_build_t *)(a->buf + off);
+    int rv                = decode_multirange_build(L, a, b);
+
+#if LUA_VERSION_NUM >= 503
+    if (rv > 0) {
+        return decode_yield(L, lua_upvalueindex(1), MULTIRANGE_ARENA, &b->y,
+                            off, decode_multirange_resume);
+    }
+#endif
+    decode_arena_leave(L, lua_upvalueindex(1), a);
+    return rv ? lua_gettop(L) : 1;
+}
+
+static int decode_multirange_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.multirange";
+    size_t len            = 0;
+    char *src             = (char *)lauxh_checklstring(L, 1, &len);
+    int packed            = lauxh_optboolean(L, 4, 0);
+    decode_arena_t *a     = NULL;
+    size_t off            = 0;
+    int rv                = 0;
+
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    lua_settop(L, 5);
+    if (packed) {
+        // placeholder of the packed multirange. the destination table is
+        // not used for the packed multirange.
+        lua_pushnil(L);
+        lua_replace(L, 4);
+    }
+    a = decode_arena_enter(L, lua_upvalueindex(1));
+    if ((rv = decode_multirange_parse(L, op, src, len, packed, a, &off))) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        return rv;
+    }
+    return decode_multirange_continue(L, off);
 }
 
 LUALIB_API int luaopen_postgres_decode_multirange(lua_State *L)
 {
+    struct luaL_Reg mmethod[] = {
+        {"__len",      mrange_len_lua     },
+        {"__tostring", mrange_tostring_lua},
+        {NULL,         NULL               }
+    };
+    struct luaL_Reg method[] = {
+        {"len",      mrange_len_lua     },
+        {"contains", mrange_contains_lua},
+        {"overlaps", mrange_overlaps_lua},
+        {"range",    mrange_range_lua   },
+        {"ranges",   mrange_ranges_lua  },
+        {NULL,       NULL               }
+    };
+
     lua_errno_loadlib(L);
-    lua_pushcfunction(L, decode_multirange_lua);
+
+    // create metatable for the packed multirange
+    if (luaL_newmetatable(L, MULTIRANGE_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    // arena to parse the multirange string
+    decode_arena_new(L);
+    lua_pushcclosure(L, decode_multirange_lua, 1);
+    DECODE_STATS_WRAP(L, "postgres.decode.multirange", NULL);
     return 1;
 }
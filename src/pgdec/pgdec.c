@@ -0,0 +1,236 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+// core decoders
+#include "pgdec_array.h"
+#include "pgdec_datetime.h"
+#include "pgdec_geom.h"
+#include "pgdec_hstore.h"
+#include "pgdec_range.h"
+#include "pgdec_scalar.h"
+
+// plain C interface of the decoders that declared in pgdec.h.
+// this translation unit does not depend on lua, and it is built into
+// libpgdecode.
+//
+// the decoders never read the characters at or after str + len, and never
+// write to the string, so the caller's string is passed to them as it is.
+
+static inline int pgdec_result(int rc, pgdec_error_t *e, pgdec_error_t *err)
+{
+    if (rc && err) {
+        *err = *e;
+    }
+    return rc;
+}
+
+PGDEC_API int pgdec_int(const char *str, size_t len, int64_t *v,
+                        pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    intmax_t iv     = 0;
+    int rc;
+
+    rc = decode_int(&iv, &e, (char *)str, len);
+    *v = (int64_t)iv;
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_float(const char *str, size_t len, double *v,
+                          pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = 0;
+    rc = decode_float(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_bool(const char *str, size_t len, int *v,
+                         pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = 0;
+    rc = decode_bool(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_date(const char *str, size_t len, int is_dmy,
+                         pgdec_timestamp_t *v, pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_timestamp_t){0};
+    rc = decode_date(v, &e, (char *)str, len, is_dmy);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_time(const char *str, size_t len, pgdec_timestamp_t *v,
+                         pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_timestamp_t){0};
+    rc = decode_time(v, &e, (char *)str, len, NULL, 0);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_timestamp(const char *str, size_t len,
+                              pgdec_timestamp_t *v, pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_timestamp_t){0};
+    rc = decode_timestamp(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_point(const char *str, size_t len, pgdec_point_t *v,
+                          pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_point_t){0};
+    rc = decode_point(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_line(const char *str, size_t len, pgdec_line_t *v,
+                         pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_line_t){0};
+    rc = decode_line(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_lseg(const char *str, size_t len, pgdec_lseg_t *v,
+                         pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_lseg_t){0};
+    rc = decode_lseg(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_box(const char *str, size_t len, pgdec_lseg_t *v,
+                        pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_lseg_t){0};
+    rc = decode_box(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_circle(const char *str, size_t len, pgdec_circle_t *v,
+                           pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_circle_t){0};
+    rc = decode_circle(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+static inline int pgdec_decode_range(pgdec_range_t *v, pgdec_error_t *err,
+                                     char *str, size_t len)
+{
+    char *src = str;
+
+    DECODE_START_ERR(err, str, len);
+    str = decode_range_scan(v, err, src, tail_, NULL);
+    if (!str) {
+        return -1;
+    }
+    DECODE_END_ERR(str);
+    return 0;
+}
+
+PGDEC_API int pgdec_range(const char *str, size_t len, pgdec_range_t *v,
+                          pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    *v = (pgdec_range_t){0};
+    rc = pgdec_decode_range(v, &e, (char *)str, len);
+    return pgdec_result(rc, &e, err);
+}
+
+static inline int pgdec_decode_array(char *str, size_t len, char delim,
+                                     const pgdec_array_visitor_t *v,
+                                     void *ctx, pgdec_error_t *err)
+{
+    if (!len) {
+        return decode_seterr(err, EINVAL, "empty string");
+    }
+    return decode_array_scan(str, len, delim, v, ctx, err);
+}
+
+PGDEC_API int pgdec_array(const char *str, size_t len, char delim,
+                          const pgdec_array_visitor_t *v, void *ctx,
+                          pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    rc = pgdec_decode_array((char *)str, len, delim, v, ctx, &e);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_hstore(const char *str, size_t len,
+                           pgdec_hstore_visitor_t fn, void *ctx,
+                           pgdec_error_t *err)
+{
+    pgdec_error_t e = {0};
+    int rc;
+
+    rc = decode_hstore_scan((char *)str, len, fn, ctx, &e);
+    return pgdec_result(rc, &e, err);
+}
+
+PGDEC_API int pgdec_strerror(const pgdec_error_t *err, char *buf, size_t len)
+{
+    if (err->pos) {
+        return snprintf(buf, len, "%s: '%c' at position %d",
+                        strerror(err->errnum), err->c, (int)err->pos);
+    } else if (err->msg) {
+        return snprintf(buf, len, "%s: %s", strerror(err->errnum), err->msg);
+    }
+    return snprintf(buf, len, "%s", strerror(err->errnum));
+}
@@ -0,0 +1,160 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_h
+#define pgdec_h
+
+// plain C interface of the decoders. this header does not depend on the lua
+// headers, so it can be passed to the LuaJIT FFI as it is, except for the
+// preprocessor directives.
+//
+// each function decodes the text representation of the value, and returns 0
+// on success. otherwise, it returns -1 and the error is stored to err if err
+// is not NULL. str does not need to be terminated by '\0'.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+# define PGDEC_API __attribute__((visibility("default"))) extern
+#else
+# define PGDEC_API extern
+#endif
+
+typedef struct {
+    int errnum;      // EINVAL, EILSEQ, ERANGE, ENOMEM or ECANCELED
+    int c;           // the invalid character if pos is greater than 0
+    size_t pos;      // position of the invalid character, or 0
+    const char *msg; // static error message, or NULL
+} pgdec_error_t;
+
+typedef struct {
+    int year; // years
+    int mon;  // months since January [1-12]
+    int day;  // day of the month [1-31]
+    int hour; // hours since midnight [0-24]
+    int min;  // minutes [0-59]
+    int sec;  // seconds [0-59]
+    int usec; // microseconds [0-999999]
+    // timezone
+    int tzhour;     // timezone hours [0-24]
+    int tzmin;      // timezone minutes [0-59]
+    int tzsec;      // timezone seconds [0-59]
+    char tzsign[2]; // timezone sign [+-], or '\0' if no timezone
+} pgdec_timestamp_t;
+
+typedef struct {
+    double x;
+    double y;
+} pgdec_point_t;
+
+typedef struct {
+    double a;
+    double b;
+    double c;
+} pgdec_line_t;
+
+// lseg and box
+typedef struct {
+    pgdec_point_t p[2];
+} pgdec_lseg_t;
+
+typedef struct {
+    pgdec_point_t center;
+    double radius;
+} pgdec_circle_t;
+
+typedef struct {
+    int empty;     // 1 if the range is empty
+    int lower_inc; // 1 if the lower bound is inclusive
+    int upper_inc; // 1 if the upper bound is inclusive
+    // offset and length of the bound strings from the head of the string.
+    // the length is 0 if the bound is unbounded. the bound string is not
+    // unquoted, so it may start with '"'.
+    size_t lower;
+    size_t lower_len;
+    size_t upper;
+    size_t upper_len;
+} pgdec_range_t;
+
+// visitor of pgdec_array. each callback returns 0 to continue, or non-zero
+// to stop decoding, then pgdec_array fails with ECANCELED.
+typedef struct {
+    // called at the opening curly bracket. depth starts at 1, and idx is the
+    // 1-based index of the nested array in the parent array, or 0 for the
+    // outermost array.
+    int (*open)(void *ctx, int depth, size_t idx);
+    // called at the closing curly bracket with the number of the elements.
+    int (*close)(void *ctx, int depth, size_t idx, size_t nelem);
+    // called for each element. str is NULL if the element is NULL. the
+    // quoted element is not unquoted, so it starts with '"'. str points into
+    // the string passed to pgdec_array, so it is valid as long as the string
+    // is valid, and it is not terminated by '\0'.
+    int (*elem)(void *ctx, int depth, size_t idx, const char *str,
+                size_t len);
+} pgdec_array_visitor_t;
+
+// visitor of pgdec_hstore that is called for each key-value pair. the key
+// and the value are not unescaped, and val is NULL if the value is NULL.
+// key and val point into the string passed to pgdec_hstore as well as the
+// elements of pgdec_array. it returns 0 to continue, or non-zero to stop
+// decoding.
+typedef int (*pgdec_hstore_visitor_t)(void *ctx, const char *key,
+                                      size_t klen, const char *val,
+                                      size_t vlen);
+
+PGDEC_API int pgdec_int(const char *str, size_t len, int64_t *v,
+                        pgdec_error_t *err);
+PGDEC_API int pgdec_float(const char *str, size_t len, double *v,
+                          pgdec_error_t *err);
+PGDEC_API int pgdec_bool(const char *str, size_t len, int *v,
+                         pgdec_error_t *err);
+PGDEC_API int pgdec_date(const char *str, size_t len, int is_dmy,
+                         pgdec_timestamp_t *v, pgdec_error_t *err);
+PGDEC_API int pgdec_time(const char *str, size_t len, pgdec_timestamp_t *v,
+                         pgdec_error_t *err);
+PGDEC_API int pgdec_timestamp(const char *str, size_t len,
+                              pgdec_timestamp_t *v, pgdec_error_t *err);
+PGDEC_API int pgdec_point(const char *str, size_t len, pgdec_point_t *v,
+                          pgdec_error_t *err);
+PGDEC_API int pgdec_line(const char *str, size_t len, pgdec_line_t *v,
+                         pgdec_error_t *err);
+PGDEC_API int pgdec_lseg(const char *str, size_t len, pgdec_lseg_t *v,
+                         pgdec_error_t *err);
+PGDEC_API int pgdec_box(const char *str, size_t len, pgdec_lseg_t *v,
+                        pgdec_error_t *err);
+PGDEC_API int pgdec_circle(const char *str, size_t len, pgdec_circle_t *v,
+                           pgdec_error_t *err);
+PGDEC_API int pgdec_range(const char *str, size_t len, pgdec_range_t *v,
+                          pgdec_error_t *err);
+PGDEC_API int pgdec_array(const char *str, size_t len, char delim,
+                          const pgdec_array_visitor_t *v, void *ctx,
+                          pgdec_error_t *err);
+PGDEC_API int pgdec_hstore(const char *str, size_t len,
+                           pgdec_hstore_visitor_t fn, void *ctx,
+                           pgdec_error_t *err);
+
+// format the error message into buf like snprintf.
+PGDEC_API int pgdec_strerror(const pgdec_error_t *err, char *buf,
+                             size_t len);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_arena_h
+#define pgdec_arena_h
+
+#include "pgdec_core.h"
+
+// the arena is a bump-pointer buffer of the fixed size records that the
+// decoders use to keep the parse result before building the values. the
+// records are accessed by the index because the buffer may be reallocated
+// when it grows.
+
+// the arena buffer larger than this is released after use
+#define DECODE_ARENA_KEEP (1024 * 1024)
+// alignment of the state record
+#define DECODE_ARENA_ALIGN 16
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t used;
+    // non-zero while the decoder uses the arena
+    int busy;
+} decode_arena_t;
+
+static inline void decode_arena_reset(decode_arena_t *a)
+{
+    a->used = 0;
+}
+
+static inline void decode_arena_free(decode_arena_t *a)
+{
+    free(a->buf);
+    *a = (decode_arena_t){0};
+}
+
+/**
+ * @brief decode_arena_alloc
+ *  allocate the record of size bytes from the arena. the returned pointer is
+ *  valid until the next allocation.
+ * @return void* the allocated record, or NULL and errno is set to ENOMEM.
+ */
+static inline void *decode_arena_alloc(decode_arena_t *a, size_t size)
+{
+    void *ptr = NULL;
+
+    if (a->size - a->used < size) {
+        size_t newsize = a->size ? a->size * 2 : 4096;
+        char *buf      = NULL;
+
+        while (newsize - a->used < size) {
+            newsize *= 2;
+        }
+        if (!(buf = realloc(a->buf, newsize))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        a->buf  = buf;
+        a->size = newsize;
+    }
+    ptr = a->buf + a->used;
+    a->used += size;
+    return ptr;
+}
+
+/**
+ * @brief decode_arena_alloc_state
+ *  allocate the state record of size bytes that is aligned to
+ *  DECODE_ARENA_ALIGN after the records. the offset of the state is stored
+ *  to *off to find it again after the arena is moved to another owner.
+ * @return void* the allocated state, or NULL and errno is set to ENOMEM.
+ */
+static inline void *decode_arena_alloc_state(decode_arena_t *a, size_t size,
+                                             size_t *off)
+{
+    size_t pad = (DECODE_ARENA_ALIGN - a->used % DECODE_ARENA_ALIGN) %
+                 DECODE_ARENA_ALIGN;
+    char *ptr  = decode_arena_alloc(a, pad + size);
+
+    if (!ptr) {
+        return NULL;
+    }
+    *off = (size_t)(ptr + pad - a->buf);
+    return ptr + pad;
+}
+
+/**
+ * @brief decode_arena_at
+ *  return the idx-th record of size bytes.
+ */
+static inline void *decode_arena_at(decode_arena_t *a, size_t size,
+                                    size_t idx)
+{
+    return a->buf + size * idx;
+}
+
+/**
+ * @brief decode_arena_release
+ *  mark the arena as unused, and release the buffer if it grows too large to
+ *  keep it for the next call.
+ */
+static inline void decode_arena_release(decode_arena_t *a)
+{
+    a->busy = 0;
+    a->used = 0;
+    if (a->size > DECODE_ARENA_KEEP) {
+        decode_arena_free(a);
+    }
+}
+
+#endif
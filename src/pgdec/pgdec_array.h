@@ -0,0 +1,167 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_array_h
+#define pgdec_array_h
+
+#include "pgdec_core.h"
+
+// 8.15.6. Array Input and Output Syntax
+// https://www.postgresql.org/docs/current/arrays.html#ARRAYS-IO
+
+#define PGDEC_ARRAY_MAXDEPTH 64
+
+/**
+ * @brief decode_array_scan
+ *  find the elements of the array string, and pass them to the visitor.
+ *  the string does not need to be terminated by '\0', the characters at or
+ *  after src + len are never read.
+ * @return int 0 on success, or -1 on error, when error then err is set. if
+ * the visitor returns non-zero, err is set to ECANCELED.
+ */
+static inline int decode_array_scan(char *src, size_t len, char delim,
+                                    const pgdec_array_visitor_t *v, void *ctx,
+                                    pgdec_error_t *err)
+{
+    char *str                             = src;
+    const char *tail                      = src + len;
+    int depth                             = 0;
+    size_t arrlen[PGDEC_ARRAY_MAXDEPTH + 1] = {0};
+    const char *token                     = NULL;
+    size_t token_len                      = 0;
+
+#define ARRAY_VISIT(call)                                                      \
+    do {                                                                       \
+        if (call) {                                                            \
+            return decode_seterr(err, ECANCELED, "canceled by the visitor");   \
+        }                                                                      \
+    } while (0)
+
+    // skip spaces
+    str = decode_skip_space(str, tail);
+    if (!decode_peek(str, tail)) {
+        return decode_seterr(err, EINVAL, "empty string");
+    } else if (*str != '{') {
+        return decode_seterr(err, EILSEQ, "opening curly bracket not found");
+    }
+    str = decode_skip_space(str + 1, tail);
+    depth++;
+    arrlen[depth] = 0;
+    ARRAY_VISIT(v->open(ctx, depth, 0));
+
+NEXT_ELEMENT:
+    switch (decode_peek(str, tail)) {
+    case 0:
+        return decode_seterr(err, EILSEQ, "malformed array string");
+
+    case '{':
+        // found nested array
+        depth++;
+        if (depth > PGDEC_ARRAY_MAXDEPTH) {
+            return decode_seterr(err, EILSEQ, "nesting level 65/64 too deep");
+        }
+        arrlen[depth] = 0;
+        ARRAY_VISIT(v->open(ctx, depth, arrlen[depth - 1] + 1));
+        str = decode_skip_space(str + 1, tail);
+        goto NEXT_ELEMENT;
+
+    case '}':
+        // found end of array
+        depth--;
+        str = decode_skip_space(str + 1, tail);
+        if (depth) {
+            // end of nested array
+            arrlen[depth]++;
+            ARRAY_VISIT(v->close(ctx, depth + 1, arrlen[depth],
+                                 arrlen[depth + 1]));
+            if (decode_peek(str, tail) == delim) {
+                // skip comma
+                str = decode_skip_space(str + 1, tail);
+            }
+            goto NEXT_ELEMENT;
+        }
+        // end of array
+        if (str != tail) {
+            return decode_seterr_at(err, EILSEQ, src, str, tail);
+        }
+        ARRAY_VISIT(v->close(ctx, 1, 0, arrlen[1]));
+        return 0;
+
+    case '"':
+        // found quoted value
+        token = str;
+        str++;
+        // search closing quotation
+        while (decode_peek(str, tail) != '"') {
+            if (!decode_peek(str, tail)) {
+                return decode_seterr(err, EILSEQ,
+                                     "closing quotation not found");
+            } else if (*str == '\\' && str + 1 < tail) {
+                // skip escaped character
+                str++;
+            }
+            str++;
+        }
+        str++;
+        token_len = str - token;
+        break;
+
+    default:
+        if (*str == delim) {
+            // empty elements are not allowed
+            return decode_seterr(err, EILSEQ,
+                                 "empty elements are not allowed");
+        }
+
+        // found unquoted value
+        token = str;
+        for (char c = *str; c != ' ' && c != delim && c != '}';
+             c = decode_peek(++str, tail)) {
+            if (!c) {
+                return decode_seterr(err, EILSEQ, "malformed array string");
+            }
+        }
+        token_len = str - token;
+        // check for NULL
+        if (token_len == 4 && strncasecmp(token, "NULL", token_len) == 0) {
+            token     = NULL;
+            token_len = 0;
+        }
+        break;
+    }
+
+    arrlen[depth]++;
+    ARRAY_VISIT(v->elem(ctx, depth, arrlen[depth], token, token_len));
+
+    // next delimiter must be delim or '}'
+    str = decode_skip_space(str, tail);
+    if (decode_peek(str, tail) == delim) {
+        str = decode_skip_space(str + 1, tail);
+    } else if (decode_peek(str, tail) != '}') {
+        return decode_seterr_at(err, EILSEQ, src, str, tail);
+    }
+    goto NEXT_ELEMENT;
+
+#undef ARRAY_VISIT
+}
+
+#endif
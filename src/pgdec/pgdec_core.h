@@ -0,0 +1,382 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_core_h
+#define pgdec_core_h
+
+// the core helpers of the decoders that do not depend on the lua state.
+// the decoders of the pgdec_*.h headers report the errors by pgdec_error_t,
+// and the lua bindings convert them to the lua values.
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+// plain C interface
+#include "pgdec.h"
+
+/**
+ * @brief decode_seterr
+ *  store the error to err for the decoders that do not depend on the lua
+ *  state.
+ * @return int always -1.
+ */
+static inline int decode_seterr(pgdec_error_t *err, int errnum,
+                                const char *msg)
+{
+    *err = (pgdec_error_t){
+        .errnum = errnum,
+        .msg    = msg,
+    };
+    return -1;
+}
+
+/**
+ * @brief decode_seterr_at
+ *  store the error at endptr. the character at tail is reported as '\0',
+ *  since the string may not be terminated by '\0'.
+ * @return int always -1.
+ */
+static inline int decode_seterr_at(pgdec_error_t *err, int errnum,
+                                   const char *str, const char *endptr,
+                                   const char *tail)
+{
+    *err = (pgdec_error_t){
+        .errnum = errnum,
+        .c      = (endptr < tail) ? *endptr : 0,
+        .pos    = endptr - str + 1,
+    };
+    return -1;
+}
+
+/**
+ * @brief decode_peek
+ *  return the character at s, or '\0' if s reached to tail. this is used
+ *  instead of *s by the decoders that stop at the end of the string.
+ */
+static inline char decode_peek(const char *s, const char *tail)
+{
+    return (s < tail) ? *s : 0;
+}
+
+static inline int decode_isnumchar(char c)
+{
+    // strto* never consumes the other characters than these
+    switch (c) {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\v':
+    case '\f':
+    case '\r':
+    case '+':
+    case '-':
+    case '.':
+    case '_':
+    case '(':
+    case ')':
+        return 1;
+    default:
+        return isalnum((unsigned char)c);
+    }
+}
+
+enum {
+    DECODE_NUM_DBL,
+    DECODE_NUM_IMAX,
+    DECODE_NUM_UMAX,
+};
+
+typedef union {
+    double dbl;
+    intmax_t imax;
+    uintmax_t umax;
+} decode_num_t;
+
+/**
+ * @brief decode_str2num
+ *  decode the number at str by strto* without reading the characters at or
+ *  after tail. strto* stops at the character that cannot be a part of the
+ *  number, so the number is decoded in place if such a character is found
+ *  before tail. otherwise, the number continues to tail, and only it is
+ *  copied to be terminated by '\0'.
+ */
+static inline decode_num_t decode_str2num(char *str, const char *tail,
+                                          int type, char **endptr)
+{
+    char buf[64];
+    char *src      = str;
+    char *end      = str;
+    char *s        = str;
+    decode_num_t v = {0};
+
+    while (s < tail && decode_isnumchar(*s)) {
+        s++;
+    }
+    if (s == tail) {
+        size_t len = tail - str;
+
+        src = (len < sizeof(buf)) ? buf : malloc(len + 1);
+        if (!src) {
+            if (endptr) {
+                *endptr = str;
+            }
+            errno = ENOMEM;
+            return v;
+        }
+        memcpy(src, str, len);
+        src[len] = 0;
+    }
+
+    errno = 0;
+    switch (type) {
+    case DECODE_NUM_DBL:
+        v.dbl = strtod(src, &end);
+        break;
+    case DECODE_NUM_IMAX:
+        v.imax = strtoimax(src, &end, 10);
+        break;
+    default:
+        v.umax = strtoumax(src, &end, 10);
+    }
+    if (endptr) {
+        *endptr = str + (end - src);
+    }
+    if (src != str && src != buf) {
+        int errnum = errno;
+        free(src);
+        errno = errnum;
+    }
+    return v;
+}
+
+static inline double decode_str2dbl(char *str, const char *tail,
+                                    char **endptr)
+{
+    return decode_str2num(str, tail, DECODE_NUM_DBL, endptr).dbl;
+}
+
+static inline uintmax_t decode_str2umax(char *str, const char *tail,
+                                        char **endptr)
+{
+    return decode_str2num(str, tail, DECODE_NUM_UMAX, endptr).umax;
+}
+
+static inline intmax_t decode_str2imax(char *str, const char *tail,
+                                       char **endptr)
+{
+    return decode_str2num(str, tail, DECODE_NUM_IMAX, endptr).imax;
+}
+
+static inline intmax_t decode_digit(char *str, const char *tail,
+                                    uint8_t mindigit, uint8_t maxdigit,
+                                    uintmax_t minval, uintmax_t maxval,
+                                    char **endptr)
+
+{
+    char *s         = str;
+    uintmax_t limit = INTMAX_MAX;
+    uintmax_t digit = 1;
+    union {
+        uintmax_t uv;
+        intmax_t iv;
+    } v = {0};
+
+    if (mindigit == 0 || mindigit > maxdigit || maxdigit > 19) {
+        errno = EDOM;
+        return 0;
+    }
+    for (int i = 1; i < maxdigit; i++) {
+        digit = (digit << 3) + (digit << 1);
+    }
+
+    errno = 0;
+    while (digit >= 1) {
+        uintmax_t prev = v.uv;
+
+        if (s == tail || !isdigit((unsigned char)*s)) {
+            // not treated as an error if more than min digits are decoded
+            if ((s - str) >= mindigit) {
+                break;
+            }
+            errno = EILSEQ;
+            goto FAILED;
+        }
+
+        // decode
+        v.uv += (*s - '0') * digit;
+        if (v.uv > limit || v.uv < prev) {
+            errno = EOVERFLOW;
+            v.iv  = INTMAX_MAX;
+            goto FAILED;
+        } else if (v.uv > maxval) {
+            errno = ERANGE;
+            goto FAILED;
+        }
+        digit /= 10;
+        s++;
+    }
+
+    if (v.uv < minval) {
+        errno = ERANGE;
+        goto FAILED;
+    }
+
+FAILED:
+    if (endptr) {
+        *endptr = s;
+    }
+
+    return v.iv;
+}
+
+/**
+ * @brief decode_fixdigit
+ *  decode the decimal digits of the fixed width. this is the same as
+ *  decode_digit(str, tail, width, width, minval, maxval, endptr), but the
+ *  loop is unrolled by the compiler if the width is a constant.
+ */
+static inline intmax_t decode_fixdigit(char *str, const char *tail, int width,
+                                       uintmax_t minval, uintmax_t maxval,
+                                       char **endptr)
+{
+    static const uintmax_t scale[] = {1, 10, 100, 1000};
+    uintmax_t v                    = 0;
+    int i                          = 0;
+
+    errno = 0;
+    for (; i < width; i++) {
+        unsigned d = (unsigned char)decode_peek(str + i, tail) - '0';
+        if (d > 9) {
+            errno = EILSEQ;
+            break;
+        }
+        v += d * scale[width - 1 - i];
+        if (v > maxval) {
+            errno = ERANGE;
+            break;
+        }
+    }
+    if (!errno && v < minval) {
+        errno = ERANGE;
+    }
+    *endptr = str + i;
+    return (intmax_t)v;
+}
+
+static inline intmax_t decode_digit2(char *str, const char *tail,
+                                     uintmax_t minval, uintmax_t maxval,
+                                     char **endptr)
+{
+    return decode_fixdigit(str, tail, 2, minval, maxval, endptr);
+}
+
+static inline intmax_t decode_digit4(char *str, const char *tail,
+                                     uintmax_t minval, uintmax_t maxval,
+                                     char **endptr)
+{
+    return decode_fixdigit(str, tail, 4, minval, maxval, endptr);
+}
+
+static inline int decode_hexval(unsigned char c)
+{
+    if ((unsigned)(c - '0') < 10) {
+        return c - '0';
+    }
+    c |= 0x20;
+    if ((unsigned)(c - 'a') < 6) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static inline char *decode_skip_space(char *s, const char *tail)
+{
+    while (s < tail && *s == ' ') {
+        s++;
+    }
+    return s;
+}
+
+static inline char *decode_skip_delim(char *s, const char *tail, char delim,
+                                      char open_delim,
+                                      int skip_trailing_spaces)
+{
+    int skip = 0;
+
+    // skip leading whitespaces
+    s = decode_skip_space(s, tail);
+    while (s < tail && *s) {
+        if (*s == delim) {
+            if (!skip) {
+                s++;
+                // skip trailing whitespaces
+                if (skip_trailing_spaces) {
+                    return decode_skip_space(s, tail);
+                }
+                return s;
+            }
+            skip--;
+        } else if (*s == open_delim) {
+            // should skip nested delimiters
+            skip++;
+        } else if (*s == '\\') {
+            if (s + 1 < tail && s[1]) {
+                s++;
+            }
+        }
+        s++;
+    }
+
+    return NULL;
+}
+
+#define DECODE_TAIL_SET(str, len)                                              \
+    char *str_  = (char *)(str);                                               \
+    size_t len_ = (len);                                                       \
+    char tailc_ = str_[len_];                                                  \
+    str_[len_]  = 0
+
+#define DECODE_TAIL_UNSET() str_[len_] = tailc_
+
+// same as DECODE_START and DECODE_END, but the error is stored to err.
+// the decoders do not read the characters at or after tail_, so the string
+// does not need to be terminated by '\0'.
+#define DECODE_START_ERR(err, str, len)                                        \
+    do {                                                                       \
+        if (!(len)) {                                                          \
+            return decode_seterr((err), EINVAL, "empty string");               \
+        }                                                                      \
+        pgdec_error_t *err_ = (err);                                           \
+        char *head_         = (char *)(str);                                   \
+        const char *tail_   = head_ + (len)
+
+#define DECODE_END_ERR(ptr)                                                    \
+    if ((ptr) != tail_) {                                                      \
+        return decode_seterr_at(err_, EILSEQ, head_, (ptr), tail_);            \
+    }                                                                          \
+    }                                                                          \
+    while (0)
+
+#endif
@@ -0,0 +1,318 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_datetime_h
+#define pgdec_datetime_h
+
+#include "pgdec_core.h"
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#define DATETIME_SKIP_DELIM(s, delim, ...)                                     \
+    do {                                                                       \
+        if (decode_peek((s), tail_) != (delim)) {                              \
+            return decode_seterr((err), EILSEQ, __VA_ARGS__);                  \
+        }                                                                      \
+        (s)++;                                                                 \
+    } while (0)
+
+#define DATETIME_STR2DIGIT(s, v, mind, maxd, minv, maxv)                       \
+    do {                                                                       \
+        char *endptr_ = NULL;                                                  \
+        (v) = decode_digit((s), tail_, (mind), (maxd), (minv), (maxv),         \
+                           &endptr_);                                          \
+        if (errno) {                                                           \
+            return decode_seterr_at((err), errno, head_, endptr_, tail_);      \
+        }                                                                      \
+        (s) = endptr_;                                                         \
+    } while (0)
+
+// decode the fixed width digits by decode_digit2 or decode_digit4
+#define DATETIME_STR2FIXDIGIT(s, v, width, minv, maxv)                         \
+    do {                                                                       \
+        char *endptr_ = NULL;                                                  \
+        (v) = decode_digit##width((s), tail_, (minv), (maxv), &endptr_);       \
+        if (errno) {                                                           \
+            return decode_seterr_at((err), errno, head_, endptr_, tail_);      \
+        }                                                                      \
+        (s) = endptr_;                                                         \
+    } while (0)
+
+// 8.5.2. Date/Time Output
+// https://www.postgresql.org/docs/current/datatype-datetime.html#DATATYPE-DATETIME-OUTPUT
+//
+//
+// Table 8.14. Date/Time Output Styles
+//
+// Style Spec   Description             Example
+// ISO          ISO 8601, SQL standard  1997-12-17 07:37:16-08
+// SQL          traditional style       12/17/1997 07:37:16.00 PST
+// Postgres     original style          Wed Dec 17 07:37:16 1997 PST
+// German       regional style          17.12.1997 07:37:16.00 PST
+//
+//
+// Table 8.15. Date Order Conventions
+//
+// datestyle        Input Ordering  Example Output
+// SQL, DMY         day/month/year  17/12/1997 15:37:16.00 CET
+// SQL, MDY         month/day/year  12/17/1997 07:37:16.00 PST
+// Postgres, DMY    day/month/year  Wed 17 Dec 07:37:16 1997 PST
+//
+
+/**
+ * @brief decode_timestamp_canonical
+ *  decode the canonical form 'yyyy-mm-dd hh:mm:ss' at the head of the
+ *  string. the layout of the first 16 bytes is checked by a single SIMD
+ *  compare if SSE2 is available.
+ * @return int 1 on success, or 0 if the string is not in the canonical form
+ * or any field is out of range. in that case, the string should be decoded
+ * by the generic parser to report the error.
+ */
+static inline int decode_timestamp_canonical(pgdec_timestamp_t *ts,
+                                             const char *s, size_t len)
+{
+    // digits: 0-3, 5-6, 8-9, 11-12, 14-15. separators: 4, 7, 10, 13
+    const unsigned digit_mask = 0xDB6F;
+    const unsigned delim_mask = 0x2490;
+    unsigned digit            = 0;
+    unsigned delim            = 0;
+    int v[19]                 = {0};
+
+    if (len < 19) {
+        return 0;
+    }
+
+#if defined(__SSE2__)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)s);
+        __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+        __m128i p = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 0, 0, ' ', 0, 0,
+                                  ':', 0, 0);
+
+        // d <= 9 as unsigned
+        digit = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d));
+        delim = _mm_movemask_epi8(_mm_cmpeq_epi8(c, p));
+    }
+#else
+    {
+        static const char layout[] = "0000-00-00 00:00";
+        for (int i = 0; i < 16; i++) {
+            if ((unsigned)((unsigned char)s[i] - '0') <= 9) {
+                digit |= 1U << i;
+            } else if (s[i] == layout[i]) {
+                delim |= 1U << i;
+            }
+        }
+    }
+#endif
+    if (((digit & digit_mask) | (delim & delim_mask)) != 0xFFFF ||
+        s[16] != ':' || (unsigned)((unsigned char)s[17] - '0') > 9 ||
+        (unsigned)((unsigned char)s[18] - '0') > 9) {
+        return 0;
+    }
+
+    for (int i = 0; i < 19; i++) {
+        v[i] = s[i] - '0';
+    }
+    ts->year = v[0] * 1000 + v[1] * 100 + v[2] * 10 + v[3];
+    ts->mon  = v[5] * 10 + v[6];
+    ts->day  = v[8] * 10 + v[9];
+    ts->hour = v[11] * 10 + v[12];
+    ts->min  = v[14] * 10 + v[15];
+    ts->sec  = v[17] * 10 + v[18];
+    if (ts->mon < 1 || ts->mon > 12 || ts->day < 1 || ts->day > 31 ||
+        ts->hour > 24 || ts->min > 59 || ts->sec > 59 ||
+        (ts->hour == 24 && (ts->min || ts->sec))) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief decode_time
+ *  decode the time string. if pos is not NULL, then pos is used as the start
+ *  position. if hms is not 0, then hh:mm:ss is already decoded into ts, and
+ *  pos points to the next character of it.
+ */
+static inline int decode_time(pgdec_timestamp_t *ts, pgdec_error_t *err,
+                              const char *str, size_t len, const char *pos,
+                              int hms)
+{
+    char *s           = (char *)str;
+    intmax_t min_max  = 59;
+    intmax_t sec_max  = 59;
+    intmax_t usec_max = 999999;
+
+    DECODE_START_ERR(err, s, len);
+    if (pos) {
+        s = (char *)pos;
+    }
+    if (hms) {
+        if (ts->hour == 24) {
+            usec_max = 0;
+        }
+        goto DECODE_USEC;
+    }
+
+    // decode: hh:mm:ss
+    DATETIME_STR2FIXDIGIT(s, ts->hour, 2, 0, 24);
+    DATETIME_SKIP_DELIM(s, ':', "delimiter not found");
+    if (ts->hour == 24) {
+        min_max  = 0;
+        sec_max  = 0;
+        usec_max = 0;
+    }
+    DATETIME_STR2FIXDIGIT(s, ts->min, 2, 0, min_max);
+    DATETIME_SKIP_DELIM(s, ':', "delimiter not found");
+    DATETIME_STR2FIXDIGIT(s, ts->sec, 2, 0, sec_max);
+
+DECODE_USEC:
+    // decode: .uuuuuu (microseconds)
+    if (decode_peek(s, tail_) == '.') {
+        s++;
+        DATETIME_STR2DIGIT(s, ts->usec, 1, 6, 0, usec_max);
+    }
+
+    switch (decode_peek(s, tail_)) {
+    case 0:
+        goto DONE;
+
+    // parse timezone: [+-]hh:mm:ss
+    // parse sign [+-]
+    default:
+        return decode_seterr(err, EILSEQ, "timezone symbol not found");
+    case '+':
+    case '-':
+        ts->tzsign[0] = *s;
+        s++;
+    }
+
+    // parse: hh | hh:mm | hh:mm:ss
+    DATETIME_STR2FIXDIGIT(s, ts->tzhour, 2, 0, 24);
+    if (decode_peek(s, tail_) == ':') {
+        // parse: hh:mm
+        s++;
+        DATETIME_STR2FIXDIGIT(s, ts->tzmin, 2, 0, 59);
+        if (decode_peek(s, tail_) == ':') {
+            // parse: hh:mm:ss
+            s++;
+            DATETIME_STR2FIXDIGIT(s, ts->tzsec, 2, 0, 59);
+        }
+    }
+
+DONE:
+    DECODE_END_ERR(s);
+    return 0;
+}
+
+static inline int decode_date(pgdec_timestamp_t *ts, pgdec_error_t *err,
+                              const char *str, size_t len, int is_dmy)
+{
+    char *s    = (char *)str;
+    char delim = (len > 2) ? s[2] : 0;
+
+    DECODE_START_ERR(err, s, len);
+
+    // date styles
+    switch (delim) {
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        // ISO: yyyy-mm-dd
+        // XSD: yyyy-mm-dd
+        // decode year: yyyy
+        DATETIME_STR2FIXDIGIT(s, ts->year, 4, 0, -1);
+        DATETIME_SKIP_DELIM(s, '-', "separator not found");
+        DATETIME_STR2FIXDIGIT(s, ts->mon, 2, 1, 12);
+        DATETIME_SKIP_DELIM(s, '-', "separator not found");
+        DATETIME_STR2FIXDIGIT(s, ts->day, 2, 1, 31);
+        break;
+
+    case '.':
+        is_dmy = 1;
+    case '/':
+    case '-':
+        if (is_dmy) {
+            // German   : dd.mm.yyyy
+            // SQL      : dd/mm/yyyy
+            // Postgres : dd-mm-yyyy
+            DATETIME_STR2FIXDIGIT(s, ts->day, 2, 1, 31);
+            DATETIME_SKIP_DELIM(s, delim, "separator not found");
+            DATETIME_STR2FIXDIGIT(s, ts->mon, 2, 1, 12);
+        } else {
+            // SQL      : mm/dd/yyyy
+            // Postgres : mm-dd-yyyy
+            DATETIME_STR2FIXDIGIT(s, ts->mon, 2, 1, 12);
+            DATETIME_SKIP_DELIM(s, delim, "separator not found");
+            DATETIME_STR2FIXDIGIT(s, ts->day, 2, 1, 31);
+        }
+        // decode yyyy
+        DATETIME_SKIP_DELIM(s, delim, "separator not found");
+        DATETIME_STR2FIXDIGIT(s, ts->year, 4, 0, -1);
+        break;
+
+    default:
+        return decode_seterr(err, EINVAL, "invalid date format");
+    }
+
+    DECODE_END_ERR(s);
+    return 0;
+}
+
+static inline int decode_timestamp(pgdec_timestamp_t *ts, pgdec_error_t *err,
+                                   const char *str, size_t len)
+{
+    char *s = (char *)str;
+
+    // fast path: yyyy-mm-dd hh:mm:ss
+    if (decode_timestamp_canonical(ts, s, len)) {
+        return decode_time(ts, err, str, len, s + 19, 1);
+    }
+
+    // decode: yyyy-mm-dd
+    DECODE_START_ERR(err, s, len);
+    DATETIME_STR2FIXDIGIT(s, ts->year, 4, 0, -1);
+    DATETIME_SKIP_DELIM(s, '-', "separator not found");
+    DATETIME_STR2FIXDIGIT(s, ts->mon, 2, 1, 12);
+    DATETIME_SKIP_DELIM(s, '-', "separator not found");
+    DATETIME_STR2FIXDIGIT(s, ts->day, 2, 1, 31);
+    s = decode_skip_space(s, tail_);
+    // the rest of the string is checked by decode_time
+    DECODE_END_ERR(tail_);
+
+    return decode_time(ts, err, str, len, s, 0);
+}
+
+#undef DATETIME_SKIP_DELIM
+#undef DATETIME_STR2DIGIT
+#undef DATETIME_STR2FIXDIGIT
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_geom_h
+#define pgdec_geom_h
+
+#include "pgdec_core.h"
+
+// 8.8. Geometric Types
+// https://www.postgresql.org/docs/current/datatype-geometric.html
+
+#define GEOM_SKIP_DELIM(s, delim, msg)                                         \
+    do {                                                                       \
+        (s) = decode_skip_delim((s), tail, (delim), 0, 1);                     \
+        if (!(s)) {                                                            \
+            return decode_seterr((err), EILSEQ, (msg));                        \
+        }                                                                      \
+    } while (0)
+
+#define GEOM_STR2DBL(s, v)                                                     \
+    do {                                                                       \
+        char *endptr_ = NULL;                                                  \
+        (v)           = decode_str2dbl((s), tail, &endptr_);                   \
+        if (errno) {                                                           \
+            return decode_seterr((err), errno, NULL);                          \
+        }                                                                      \
+        (s) = endptr_;                                                         \
+    } while (0)
+
+#define GEOM_STR2POINT(s, x, y)                                                \
+    do {                                                                       \
+        /* parse (x,y) */                                                      \
+        GEOM_SKIP_DELIM((s), '(', "opening round bracket not found");          \
+        GEOM_STR2DBL((s), (x));                                                \
+        GEOM_SKIP_DELIM(s, ',', "separator not found");                        \
+        GEOM_STR2DBL((s), (y));                                                \
+        GEOM_SKIP_DELIM((s), ')', "closing round bracket not found");          \
+    } while (0)
+
+/**
+ * @brief decode_geom_point
+ *  decode the point (x, y) at *s, and advance *s to the next of it.
+ *  this is used to decode the variable number of points of path and polygon.
+ */
+static inline int decode_geom_point(char **s, const char *tail,
+                                    pgdec_point_t *v, pgdec_error_t *err)
+{
+    char *str = *s;
+
+    GEOM_STR2POINT(str, v->x, v->y);
+    *s = str;
+    return 0;
+}
+
+// 8.8.1. Points
+// https://www.postgresql.org/docs/current/datatype-geometric.html#id-1.5.7.16.5
+static inline int decode_point(pgdec_point_t *v, pgdec_error_t *err, char *str,
+                               size_t len)
+{
+    const char *tail = str + len;
+
+    // point: (x, y)
+    DECODE_START_ERR(err, str, len);
+    GEOM_STR2POINT(str, v->x, v->y);
+    DECODE_END_ERR(str);
+    return 0;
+}
+
+// 8.8.2. Lines
+// https://www.postgresql.org/docs/current/datatype-geometric.html#DATATYPE-LINE
+static inline int decode_line(pgdec_line_t *v, pgdec_error_t *err, char *str,
+                              size_t len)
+{
+    const char *tail = str + len;
+
+    // line: {a,b,c}
+    DECODE_START_ERR(err, str, len);
+    GEOM_SKIP_DELIM(str, '{', "opening curly bracket not found");
+    GEOM_STR2DBL(str, v->a);
+    GEOM_SKIP_DELIM(str, ',', "separator not found");
+    GEOM_STR2DBL(str, v->b);
+    GEOM_SKIP_DELIM(str, ',', "separator not found");
+    GEOM_STR2DBL(str, v->c);
+    GEOM_SKIP_DELIM(str, '}', "closing curly bracket not found");
+    DECODE_END_ERR(str);
+    return 0;
+}
+
+// 8.8.3. Line Segments
+// https://www.postgresql.org/docs/current/datatype-geometric.html#DATATYPE-LSEG
+static inline int decode_lseg(pgdec_lseg_t *v, pgdec_error_t *err, char *str,
+                              size_t len)
+{
+    const char *tail = str + len;
+
+    // line-segment: [(x1, y1), (x2, y2)]
+    DECODE_START_ERR(err, str, len);
+    GEOM_SKIP_DELIM(str, '[', "opening square bracket not found");
+    GEOM_STR2POINT(str, v->p[0].x, v->p[0].y);
+    GEOM_SKIP_DELIM(str, ',', "separator not found");
+    GEOM_STR2POINT(str, v->p[1].x, v->p[1].y);
+    GEOM_SKIP_DELIM(str, ']', "closing square bracket not found");
+    DECODE_END_ERR(str);
+    return 0;
+}
+
+// 8.8.4. Boxes
+// https://www.postgresql.org/docs/current/datatype-geometric.html#id-1.5.7.16.8
+static inline int decode_box(pgdec_lseg_t *v, pgdec_error_t *err, char *str,
+                             size_t len)
+{
+    const char *tail = str + len;
+
+    // box: (x1,y1), (x2,y2)
+    DECODE_START_ERR(err, str, len);
+    GEOM_STR2POINT(str, v->p[0].x, v->p[0].y);
+    GEOM_SKIP_DELIM(str, ',', "separator not found");
+    GEOM_STR2POINT(str, v->p[1].x, v->p[1].y);
+    DECODE_END_ERR(str);
+    return 0;
+}
+
+// 8.8.7. Circles
+// https://www.postgresql.org/docs/current/datatype-geometric.html#DATATYPE-CIRCLE
+static inline int decode_circle(pgdec_circle_t *v, pgdec_error_t *err,
+                                char *str, size_t len)
+{
+    const char *tail = str + len;
+
+    // circle: <(x,y),r>
+    DECODE_START_ERR(err, str, len);
+    GEOM_SKIP_DELIM(str, '<', "opening angle bracket not found");
+    GEOM_STR2POINT(str, v->center.x, v->center.y);
+    GEOM_SKIP_DELIM(str, ',', "separator not found");
+    GEOM_STR2DBL(str, v->radius);
+    GEOM_SKIP_DELIM(str, '>', "closing angle bracket not found");
+    DECODE_END_ERR(str);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_hstore_h
+#define pgdec_hstore_h
+
+#include "pgdec_core.h"
+
+// F.18. hstore
+// https://www.postgresql.org/docs/current/hstore.html
+
+/**
+ * @brief decode_hstore_scan
+ *  find the key-value pairs of the hstore string, and pass them to the
+ *  visitor. the keys and values are passed as they are without unescaping.
+ * @return int 0 on success, or -1 on error, when error then err is set. if
+ * the visitor returns non-zero, err is set to ECANCELED.
+ */
+static inline int decode_hstore_scan(char *str, size_t len,
+                                     pgdec_hstore_visitor_t fn, void *ctx,
+                                     pgdec_error_t *err)
+{
+    char *key   = NULL;
+    size_t klen = 0;
+    char *val   = NULL;
+    size_t vlen = 0;
+
+#define SKIP_DELIM(s, delim, errmsg)                                           \
+    do {                                                                       \
+        (s) = decode_skip_delim((s), tail_, delim, 0, 0);                      \
+        if (!(s)) {                                                            \
+            return decode_seterr(err, EILSEQ, errmsg);                         \
+        }                                                                      \
+    } while (0)
+
+    // hstore: "key"=>"value", ... "keyn"=>"valuen"
+    DECODE_START_ERR(err, str, len);
+
+CHECK_NEXT:
+    // key
+    SKIP_DELIM(str, '"', "opening double-quote not found");
+    key = str;
+    SKIP_DELIM(str, '"', "closing double-quote not found");
+    klen = str - key - 1;
+    str  = decode_skip_space(str, tail_);
+    // separator: =>
+    if (tail_ - str < 2 || str[0] != '=' || str[1] != '>') {
+        return decode_seterr(err, EILSEQ, "key-value separator not found");
+    }
+    str += 2;
+    if (decode_peek(str, tail_) == 'N') {
+        // NULL value
+        if (tail_ - str < 4 || str[1] != 'U' || str[2] != 'L' ||
+            str[3] != 'L') {
+            return decode_seterr(err, EILSEQ, "invalid null value");
+        }
+        str += 4;
+        val  = NULL;
+        vlen = 0;
+    } else {
+        // quoted value
+        SKIP_DELIM(str, '"', "opening double-quote not found");
+        val = str;
+        SKIP_DELIM(str, '"', "closing double-quote not found");
+        vlen = str - val - 1;
+    }
+    if (fn(ctx, key, klen, val, vlen)) {
+        return decode_seterr(err, ECANCELED, "canceled by the visitor");
+    }
+    str = decode_skip_space(str, tail_);
+    if (decode_peek(str, tail_) == ',') {
+        str++;
+        goto CHECK_NEXT;
+    }
+    DECODE_END_ERR(str);
+
+#undef SKIP_DELIM
+    return 0;
+}
+
+#endif
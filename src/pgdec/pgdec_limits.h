@@ -0,0 +1,113 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_limits_h
+#define pgdec_limits_h
+
+#include "pgdec_core.h"
+
+// the limits of the decoded value that are checked while the decoders scan
+// the string, before the values are allocated. the limit of 0 means
+// unlimited. exceeding the limit is reported as E2BIG.
+
+typedef struct {
+    // total number of the elements
+    size_t elements;
+    // length of each element string
+    size_t length;
+    // nesting depth of the nested values
+    size_t depth;
+    // estimated bytes of the decoded value
+    size_t bytes;
+} decode_limits_t;
+
+// usage of the limits by the running decoder
+typedef struct {
+    decode_limits_t lim;
+    // non-zero if any limit is set
+    int enabled;
+    size_t nelem;
+    size_t nbyte;
+    pgdec_error_t err;
+} decode_quota_t;
+
+static inline void decode_quota_init(decode_quota_t *q,
+                                     const decode_limits_t *lim)
+{
+    *q = (decode_quota_t){0};
+    if (lim) {
+        q->lim     = *lim;
+        q->enabled = lim->elements || lim->length || lim->depth || lim->bytes;
+    }
+}
+
+/**
+ * @brief decode_quota_add
+ *  count nelem elements and nbyte estimated bytes of the decoded value.
+ * @return int 0 on success, or -1 if the limit is exceeded, when error then
+ * q->err is set to E2BIG.
+ */
+static inline int decode_quota_add(decode_quota_t *q, size_t nelem,
+                                   size_t nbyte)
+{
+    if (!q->enabled) {
+        return 0;
+    }
+    q->nelem += nelem;
+    q->nbyte += nbyte;
+    if (q->lim.elements && q->nelem > q->lim.elements) {
+        return decode_seterr(&q->err, E2BIG, "too many elements");
+    } else if (q->lim.bytes && q->nbyte > q->lim.bytes) {
+        return decode_seterr(&q->err, E2BIG, "decoded value too large");
+    }
+    return 0;
+}
+
+/**
+ * @brief decode_quota_length
+ *  check the length of the element string.
+ * @return int 0 on success, or -1 if the limit is exceeded, when error then
+ * q->err is set to E2BIG.
+ */
+static inline int decode_quota_length(decode_quota_t *q, size_t len)
+{
+    if (q->lim.length && len > q->lim.length) {
+        return decode_seterr(&q->err, E2BIG, "element string too long");
+    }
+    return 0;
+}
+
+/**
+ * @brief decode_quota_depth
+ *  check the nesting depth.
+ * @return int 0 on success, or -1 if the limit is exceeded, when error then
+ * q->err is set to E2BIG.
+ */
+static inline int decode_quota_depth(decode_quota_t *q, size_t depth)
+{
+    if (q->lim.depth && depth > q->lim.depth) {
+        return decode_seterr(&q->err, E2BIG, "nesting level too deep");
+    }
+    return 0;
+}
+
+#endif
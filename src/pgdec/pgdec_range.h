@@ -0,0 +1,142 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_range_h
+#define pgdec_range_h
+
+#include "pgdec_core.h"
+
+// 8.17. Range Types
+// https://www.postgresql.org/docs/current/rangetypes.html
+
+/**
+ * @brief decode_range_scan
+ *  find the bounds of the range string without decoding them. the offsets of
+ *  the bounds are stored to v relative to src.
+ *  if pos is not NULL, then pos is used as the start position. the characters
+ *  at or after tail are never read.
+ * @return char* next position of source string or NULL on error, when error
+ * then err is set.
+ */
+static inline char *decode_range_scan(pgdec_range_t *v, pgdec_error_t *err,
+                                      char *src, const char *tail, char *pos)
+{
+    char *str   = (pos) ? pos : src;
+    char *token = NULL;
+    int ntoken  = 0;
+
+    *v = (pgdec_range_t){0};
+    // skip spaces
+    str = decode_skip_space(str, tail);
+    if (!decode_peek(str, tail)) {
+        decode_seterr(err, EINVAL, "empty string");
+        return NULL;
+    } else if (tail - str >= 5 && strncasecmp(str, "empty", 5) == 0) {
+        // its empty range
+        v->empty = 1;
+        return decode_skip_space(str + 5, tail);
+    }
+
+    switch (*str) {
+    default:
+        decode_seterr_at(err, EILSEQ, src, str, tail);
+        return NULL;
+
+    case '[':
+        v->lower_inc = 1;
+    case '(':
+        str   = decode_skip_space(str + 1, tail);
+        token = str;
+    }
+
+    // find delimiter or closing parenthesis
+NEXT_CHAR:
+    if (!str) {
+        // nested brackets are not closed
+        decode_seterr(err, EILSEQ, "malformed range string");
+        return NULL;
+    }
+    switch (decode_peek(str, tail)) {
+    case 0:
+        decode_seterr(err, EILSEQ, "malformed range string");
+        return NULL;
+
+    case '{':
+        str = decode_skip_delim(str + 1, tail, '}', '{', 1);
+        goto NEXT_CHAR;
+    case '(':
+        str = decode_skip_delim(str + 1, tail, ')', '(', 1);
+        goto NEXT_CHAR;
+    case '[':
+        str = decode_skip_delim(str + 1, tail, ']', '[', 1);
+        goto NEXT_CHAR;
+    case '<':
+        str = decode_skip_delim(str + 1, tail, '>', '<', 1);
+        goto NEXT_CHAR;
+
+    default:
+        str++;
+        goto NEXT_CHAR;
+
+    case ',':
+        if (ntoken) {
+            // first token already processed
+            decode_seterr_at(err, EILSEQ, src, str, tail);
+            return NULL;
+        }
+        break;
+
+    case ']':
+        v->upper_inc = 1;
+    case ')':
+        if (!ntoken) {
+            // first token not yet processed
+            decode_seterr_at(err, EILSEQ, src, str, tail);
+            return NULL;
+        }
+        break;
+    }
+
+    // unbounded range is not inclusive
+    if (++ntoken == 1) {
+        v->lower     = token - src;
+        v->lower_len = str - token;
+        if (!v->lower_len) {
+            v->lower_inc = 0;
+        }
+    } else {
+        v->upper     = token - src;
+        v->upper_len = str - token;
+        if (!v->upper_len) {
+            v->upper_inc = 0;
+        }
+    }
+
+    str = decode_skip_space(str + 1, tail);
+    if (ntoken < 2) {
+        token = str;
+        goto NEXT_CHAR;
+    }
+    return str;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef pgdec_scalar_h
+#define pgdec_scalar_h
+
+#include "pgdec_core.h"
+
+static inline int decode_int(intmax_t *v, pgdec_error_t *err, char *str,
+                             size_t len)
+{
+    char *endptr = str;
+    uintmax_t uv = 0;
+
+    DECODE_START_ERR(err, str, len);
+    switch (*str) {
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+    case '+':
+        uv = decode_str2umax(str, tail_, &endptr);
+        if (uv > (uintmax_t)INTMAX_MAX) {
+            return decode_seterr(err, ERANGE, NULL);
+        }
+        *v = (intmax_t)uv;
+        break;
+
+    case '-':
+        *v = decode_str2imax(str, tail_, &endptr);
+        break;
+
+    default:
+        return decode_seterr_at(err, EILSEQ, str, endptr, tail_);
+    }
+
+    if (errno) {
+        return decode_seterr(err, errno, NULL);
+    }
+    DECODE_END_ERR(endptr);
+    return 0;
+}
+
+static inline int decode_float(double *v, pgdec_error_t *err, char *str,
+                               size_t len)
+{
+    char *endptr = str;
+
+    DECODE_START_ERR(err, str, len);
+    switch (*str) {
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+    case '+':
+    case '-':
+        *v = decode_str2dbl(str, tail_, &endptr);
+        if (errno) {
+            return decode_seterr(err, errno, NULL);
+        }
+    }
+    DECODE_END_ERR(endptr);
+    return 0;
+}
+
+// 8.6. Boolean Type
+// https://www.postgresql.org/docs/current/datatype-boolean.html
+static inline int decode_bool(int *v, pgdec_error_t *err, const char *str,
+                              size_t len)
+{
+    if (len > 1) {
+        return decode_seterr_at(err, EILSEQ, str, str + 1, str + len);
+    }
+
+    // boolean: t or f
+    DECODE_START_ERR(err, str, len);
+    switch (*str) {
+    case 't':
+        *v = 1;
+        break;
+    case 'f':
+        *v = 0;
+        break;
+    default:
+        return decode_seterr_at(err, EILSEQ, str, str, tail_);
+    }
+    DECODE_END_ERR(str + 1);
+    return 0;
+}
+
+#endif
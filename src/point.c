@@ -30,18 +30,17 @@ static int decode_point_lua(lua_State *L)
     static const char *op = "postgres.decode.point";
     size_t len            = 0;
     char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    double x              = 0;
-    double y              = 0;
+    pgdec_point_t v       = {0};
+    pgdec_error_t err     = {0};
 
-    lua_settop(L, 1);
-    // point: (x, y)
-    DECODE_START(L, op, str, len);
-    GEOM_STR2POINT(str, x, y);
-    DECODE_END(str);
+    lua_settop(L, 2);
+    if (decode_point(&v, &err, str, len)) {
+        return decode_error_from(L, op, &err);
+    }
 
-    lua_createtable(L, 2, 0);
-    lauxh_pushnum2arr(L, 1, x);
-    lauxh_pushnum2arr(L, 2, y);
+    decode_table(L, 2, 2, 0, 0);
+    lauxh_pushnum2arr(L, 1, v.x);
+    lauxh_pushnum2arr(L, 2, v.y);
     return 1;
 }
 
@@ -49,5 +48,6 @@ LUALIB_API int luaopen_postgres_decode_point(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_point_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.point", NULL);
     return 1;
 }
@@ -20,44 +20,79 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode_geom.h"
+#include "lua_postgres_decode_points.h"
 
 // 8.8.6. Polygons
 // https://www.postgresql.org/docs/current/datatype-geometric.html#DATATYPE-POLYGON
 
-static int decode_polygon_lua(lua_State *L)
+/**
+ * @brief decode_polygon_parse
+ *  parse the whole polygon string into the points in the arena.
+ * @return int 0 on success and the number of the points is stored to
+ * *npoint, otherwise the number of the pushed error values.
+ */
+static int decode_polygon_parse(lua_State *L, const char *op, char *str,
+                                size_t len, decode_arena_t *a, int *npoint)
 {
-    static const char *op = "postgres.decode.polygon";
-    size_t len            = 0;
-    char *str             = (char *)lauxh_checklstring(L, 1, &len);
-    int idx               = 0;
-    double x, y;
+    const char *tail  = str + len;
+    pgdec_point_t pt  = {0};
+    pgdec_error_t err = {0};
+    int idx           = 0;
+    decode_quota_t quota;
 
-    lua_settop(L, 1);
-    lua_newtable(L);
     // polygon: ((x1, y1), ... (xn, yn))
+    decode_quota_start(L, &quota);
     DECODE_START(L, op, str, len);
-    GEOM_SKIP_DELIM(str, '(', "opening round bracket not found");
+    str = decode_skip_delim(str, tail, '(', 0, 1);
+    if (!str) {
+        return decode_error(L, op, EILSEQ, "opening round bracket not found");
+    }
 
 CHECK_NEXT:
-    GEOM_STR2POINT(str, x, y);
-    lua_createtable(L, 2, 0);
-    lauxh_pushnum2arr(L, 1, x);
-    lauxh_pushnum2arr(L, 2, y);
-    lua_rawseti(L, -2, ++idx);
+    if (decode_geom_point(&str, tail, &pt, &err)) {
+        return decode_error_from(L, op, &err);
+    } else if (decode_points_add(L, op, &quota, a, &pt)) {
+        return lua_gettop(L);
+    }
+    idx++;
     if (*str == ',') {
-        str = decode_skip_space(str + 1);
+        str = decode_skip_space(str + 1, tail);
         goto CHECK_NEXT;
     }
-    GEOM_SKIP_DELIM(str, ')', "closing round bracket not found");
+    str = decode_skip_delim(str, tail, ')', 0, 1);
+    if (!str) {
+        return decode_error(L, op, EILSEQ, "closing round bracket not found");
+    }
     DECODE_END(str);
 
-    return 1;
+    *npoint = idx;
+    return 0;
+}
+
+static int decode_polygon_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.polygon";
+    size_t len            = 0;
+    char *str             = (char *)lauxh_checklstring(L, 1, &len);
+    decode_arena_t *a     = NULL;
+    int npoint            = 0;
+    int rv                = 0;
+
+    lua_settop(L, 2);
+    a = decode_arena_enter(L, lua_upvalueindex(1));
+    if ((rv = decode_polygon_parse(L, op, str, len, a, &npoint))) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        return rv;
+    }
+    return decode_points(L, op, a, npoint);
 }
 
 LUALIB_API int luaopen_postgres_decode_polygon(lua_State *L)
 {
     lua_errno_loadlib(L);
-    lua_pushcfunction(L, decode_polygon_lua);
+    // arena to parse the polygon string
+    decode_arena_new(L);
+    lua_pushcclosure(L, decode_polygon_lua, 1);
+    DECODE_STATS_WRAP(L, "postgres.decode.polygon", NULL);
     return 1;
 }
@@ -22,6 +22,34 @@
 
 #include "lua_postgres_decode_range.h"
 
+/**
+ * @brief decode_range
+ *  decode range string into the table at the top of the stack.
+ *  if pos is not NULL, then pos is used as the start position.
+ * @param L
+ * @param op operation name for error message
+ * @param src source string
+ * @param tail end of source string
+ * @param pos start position of source string or NULL
+ * @return char* next position of source string or NULL on error, when error
+ * then nil and error message are pushed to the stack.
+ */
+static char *decode_range(lua_State *L, const char *op, char *src,
+                          const char *tail, char *pos)
+{
+    pgdec_range_t v   = {0};
+    pgdec_error_t err = {0};
+    char *str         = decode_range_scan(&v, &err, src, tail, pos);
+
+    if (!str) {
+        decode_error_from(L, op, &err);
+        return NULL;
+    } else if (decode_range_push(L, op, src, &v, 0)) {
+        return NULL;
+    }
+    return str;
+}
+
 static int decode_range_lua(lua_State *L)
 {
     static const char *op = "postgres.decode.range";
@@ -32,12 +60,13 @@ static int decode_range_lua(lua_State *L)
     if (lua_gettop(L) < 3) {
         lua_pushnil(L);
     }
-    lua_settop(L, 3);
+    lua_settop(L, 4);
+    decode_table(L, 4, 2, 2, 0);
 
     DECODE_START(L, op, src, len);
-    src = decode_range(L, op, (char *)src, NULL);
+    src = decode_range(L, op, (char *)src, src + len, NULL);
     if (!src) {
-        return 2;
+        return lua_gettop(L);
     }
     DECODE_END(src);
 
@@ -48,5 +77,6 @@ LUALIB_API int luaopen_postgres_decode_range(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_range_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.range", NULL);
     return 1;
 }
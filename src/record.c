@@ -0,0 +1,203 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_field.h"
+
+// 8.16.6. Composite Type Input and Output Syntax
+// https://www.postgresql.org/docs/current/rowtypes.html#ROWTYPES-IO-SYNTAX
+
+/**
+ * @brief decode_record_unquote
+ *  push the unescaped string of the quoted string.
+ *  each escaped character of the string is unescaped.
+ */
+static char *decode_record_unquote(lua_State *L, char *str)
+{
+    luaL_Buffer b;
+    char *head = ++str;
+
+    luaL_buffinit(L, &b);
+    while (*str != '"') {
+        switch (*str) {
+        case 0:
+            return NULL;
+        case '\\':
+            luaL_addlstring(&b, head, str - head);
+            str++;
+            if (!*str) {
+                return NULL;
+            }
+            head = str;
+        }
+        str++;
+    }
+    luaL_addlstring(&b, head, str - head);
+    luaL_pushresult(&b);
+    return str + 1;
+}
+
+static int decode_record_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.record";
+    size_t len            = 0;
+    char *src             = (char *)lauxh_checklstring(L, 1, &len);
+    char *str             = src;
+    int nfield            = 0;
+
+    lua_settop(L, 5);
+    if (!lua_isnil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+    }
+    if (!lua_isnil(L, 4)) {
+        luaL_checktype(L, 4, LUA_TTABLE);
+    }
+
+    if (*str == '"') {
+        // quoted record value that passed from array decoder:
+        //  "(1,\"foo bar\")"
+        char *tail = decode_record_unquote(L, str);
+        if (!tail) {
+            return decode_error(L, op, EILSEQ, "closing quotation not found");
+        } else if (*tail) {
+            return decode_error_at(L, op, EILSEQ, src, tail);
+        }
+        src = str = (char *)lua_tolstring(L, -1, &len);
+    }
+
+    // record: (field1,field2,...)
+    DECODE_START(L, op, str, len);
+    if (*str != '(') {
+        return decode_error(L, op, EILSEQ, "opening round bracket not found");
+    }
+    str++;
+    decode_table(L, 5, 0, 0, 0);
+
+NEXT_FIELD:
+    nfield++;
+    switch (*str) {
+    case ',':
+    case ')':
+        // empty field is NULL
+        goto CHECK_DELIMITER;
+    }
+
+    {
+        char *head    = str;
+        int in_quote  = 0;
+        int is_quoted = *str == '"';
+        luaL_Buffer b;
+
+        // find the end of unquoted and unescaped field
+        while (*str != ',' && *str != ')') {
+            switch (*str) {
+            case 0:
+                return decode_error(L, op, EILSEQ, "malformed record string");
+            case '"':
+            case '\\':
+                goto UNESCAPE;
+            }
+            str++;
+        }
+        lua_pushlstring(L, head, str - head);
+        goto DECODE_FIELD;
+
+UNESCAPE:
+        luaL_buffinit(L, &b);
+        luaL_addlstring(&b, head, str - head);
+        head = str;
+        while (in_quote || (*str != ',' && *str != ')')) {
+            switch (*str) {
+            case 0:
+                if (in_quote) {
+                    return decode_error(L, op, EILSEQ,
+                                        "closing quotation not found");
+                }
+                return decode_error(L, op, EILSEQ, "malformed record string");
+
+            case '"':
+                luaL_addlstring(&b, head, str - head);
+                if (in_quote && str[1] == '"') {
+                    // doubled quote: ""
+                    str++;
+                    head = str;
+                } else {
+                    in_quote = !in_quote;
+                    head     = str + 1;
+                }
+                break;
+
+            case '\\':
+                luaL_addlstring(&b, head, str - head);
+                str++;
+                if (!*str) {
+                    return decode_error(L, op, EILSEQ,
+                                        "malformed record string");
+                }
+                head = str;
+                break;
+            }
+            str++;
+        }
+        luaL_addlstring(&b, head, str - head);
+        luaL_pushresult(&b);
+
+DECODE_FIELD:
+        if (decode_field(L, op, 2, 3, lua_upvalueindex(1), nfield,
+                         is_quoted)) {
+            return lua_gettop(L);
+        }
+    }
+
+    // set field value
+    if (!lua_isnil(L, 4)) {
+        lua_rawgeti(L, 4, nfield);
+        if (lua_type(L, -1) == LUA_TSTRING) {
+            lua_insert(L, -2);
+            lua_rawset(L, -3);
+            goto CHECK_DELIMITER;
+        }
+        lua_pop(L, 1);
+    }
+    lua_rawseti(L, -2, nfield);
+
+CHECK_DELIMITER:
+    if (*str == ',') {
+        str++;
+        goto NEXT_FIELD;
+    }
+    // found closing round bracket
+    str++;
+
+    DECODE_END(str);
+
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_record(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    // cache table of built-in decoders
+    lua_newtable(L);
+    lua_pushcclosure(L, decode_record_lua, 1);
+    DECODE_STATS_WRAP(L, "postgres.decode.record", NULL);
+    return 1;
+}
@@ -0,0 +1,700 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode.h"
+#include <string.h>
+
+// resumable decoders of the array, bytea and hstore values that are fed in
+// arbitrary chunks.
+
+#define STREAM_MT "postgres.decode.stream"
+
+#define MAX_ARRAY_DEPTH 64
+
+enum {
+    STREAM_ARRAY = 0,
+    STREAM_BYTEA,
+    STREAM_HSTORE,
+};
+
+static const char *const STREAM_TYPES[] = {
+    "array",
+    "bytea",
+    "hstore",
+    NULL,
+};
+
+static const char *const STREAM_OPS[] = {
+    "postgres.decode.stream.array",
+    "postgres.decode.stream.bytea",
+    "postgres.decode.stream.hstore",
+};
+
+// parser states
+enum {
+    // common
+    S_START = 0,
+    S_END,
+    // array
+    S_ARRAY_ELEMENT,
+    S_ARRAY_QUOTED,
+    S_ARRAY_UNQUOTED,
+    S_ARRAY_DELIMITER,
+    // bytea
+    S_BYTEA_PREFIX,
+    S_BYTEA_HEX,
+    // hstore
+    S_HSTORE_KEY,
+    S_HSTORE_ARROW,
+    S_HSTORE_VALUE_START,
+    S_HSTORE_VALUE,
+    S_HSTORE_NULL,
+    S_HSTORE_NEXT,
+};
+
+typedef struct {
+    int type;                         // value type
+    int state;                        // parser state
+    int failed;                       // failed to decode
+    size_t pos;                       // number of the consumed bytes
+    char *buf;                        // token or decoded data
+    size_t len;                       // length of the buffered data
+    size_t cap;                       // capacity of the buffer
+    // array
+    char delim;                       // element delimiter
+    int escape;                       // next character is escaped
+    int depth;                        // nesting level
+    int arrlen[MAX_ARRAY_DEPTH + 1];  // number of elements at each level
+    // bytea
+    int nibble;                       // pending high nibble or -1
+    // hstore
+    size_t keylen;                    // length of the key in the buffer
+    int nnull;                        // number of matched NULL characters
+    int ref;                          // reference of the table {fn, ctx, tbl}
+} stream_t;
+
+static int stream_reserve(stream_t *s, size_t len)
+{
+    if (s->len + len > s->cap) {
+        size_t cap = s->cap ? s->cap : 256;
+        char *buf  = NULL;
+
+        while (cap < s->len + len) {
+            cap *= 2;
+        }
+        if (!(buf = realloc(s->buf, cap))) {
+            return -1;
+        }
+        s->buf = buf;
+        s->cap = cap;
+    }
+    return 0;
+}
+
+static inline int stream_append(stream_t *s, const char *str, size_t len)
+{
+    if (stream_reserve(s, len)) {
+        return -1;
+    }
+    memcpy(s->buf + s->len, str, len);
+    s->len += len;
+    return 0;
+}
+
+static int stream_error_at(lua_State *L, stream_t *s, const char *p,
+                           const char *chunk)
+{
+    return decode_error_pos(L, STREAM_OPS[s->type], EILSEQ, *p,
+                            s->pos + (p - chunk) + 1);
+}
+
+static int stream_nomem(lua_State *L, stream_t *s)
+{
+    return decode_error(L, STREAM_OPS[s->type], errno, NULL);
+}
+
+/**
+ * @brief stream_scan_quoted
+ *  append the characters until the closing quotation to the buffer. the
+ *  escaped characters are kept as is.
+ * @return const char* the pointer to the closing quotation, or the tail of
+ *  the chunk if the closing quotation is not found. NULL on failure.
+ */
+static const char *stream_scan_quoted(stream_t *s, const char *p,
+                                      const char *tail)
+{
+    const char *head = p;
+
+    if (s->escape && p < tail) {
+        s->escape = 0;
+        p++;
+    }
+    while (p < tail) {
+        if (*p == '\\') {
+            if (++p == tail) {
+                s->escape = 1;
+                break;
+            }
+        } else if (*p == '"') {
+            break;
+        }
+        p++;
+    }
+    if (stream_append(s, head, p - head)) {
+        return NULL;
+    }
+    return p;
+}
+
+/**
+ * @brief stream_array_element
+ *  decode the element in the buffer by the function, and set it to the
+ *  current array. the function, context object and the array stack must be
+ *  placed at index 3, 4 and 5 of the stack.
+ * @return int 0 on success, otherwise the number of the error values that
+ *  pushed to the stack.
+ */
+static int stream_array_element(lua_State *L, stream_t *s, int is_quoted)
+{
+    s->arrlen[s->depth]++;
+    if (!is_quoted && s->len == 4 && strncasecmp(s->buf, "NULL", 4) == 0) {
+        s->len = 0;
+        return 0;
+    }
+
+    lua_rawgeti(L, 5, s->depth);
+    lua_pushvalue(L, 3);
+    lua_pushlstring(L, s->buf, s->len);
+    lua_pushboolean(L, is_quoted);
+    lua_pushvalue(L, 4);
+    lua_call(L, 3, 2);
+    s->len = 0;
+    if (!lua_isnil(L, -1)) {
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            lua_tostring(L, -1));
+    }
+    lua_pop(L, 1);
+    lua_rawseti(L, -2, s->arrlen[s->depth]);
+    lua_pop(L, 1);
+    return 0;
+}
+
+static int stream_array_open(lua_State *L, stream_t *s)
+{
+    if (s->depth >= MAX_ARRAY_DEPTH) {
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "nesting level %d/%d too deep", s->depth + 1,
+                            MAX_ARRAY_DEPTH);
+    }
+    s->depth++;
+    s->arrlen[s->depth] = 0;
+    lua_newtable(L);
+    lua_rawseti(L, 5, s->depth);
+    s->state = S_ARRAY_ELEMENT;
+    return 0;
+}
+
+static void stream_array_close(lua_State *L, stream_t *s)
+{
+    s->depth--;
+    if (!s->depth) {
+        s->state = S_END;
+        return;
+    }
+    // set the nested array to the parent array
+    s->arrlen[s->depth]++;
+    lua_rawgeti(L, 5, s->depth);
+    lua_rawgeti(L, 5, s->depth + 1);
+    lua_rawseti(L, -2, s->arrlen[s->depth]);
+    lua_pop(L, 1);
+    lua_pushnil(L);
+    lua_rawseti(L, 5, s->depth + 1);
+    s->state = S_ARRAY_DELIMITER;
+}
+
+static int stream_array_feed(lua_State *L, stream_t *s, const char *chunk,
+                             size_t len)
+{
+    const char *p    = chunk;
+    const char *tail = chunk + len;
+
+    while (p < tail) {
+        switch (s->state) {
+        case S_START:
+            if (*p == ' ') {
+                break;
+            } else if (*p != '{') {
+                return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                                    "opening curly bracket not found");
+            } else if (stream_array_open(L, s)) {
+                return lua_gettop(L);
+            }
+            break;
+
+        case S_ARRAY_ELEMENT:
+            if (*p == ' ') {
+                break;
+            } else if (*p == '{') {
+                if (stream_array_open(L, s)) {
+                    return lua_gettop(L);
+                }
+            } else if (*p == '}') {
+                stream_array_close(L, s);
+            } else if (*p == s->delim) {
+                return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                                    "empty elements are not allowed");
+            } else if (*p == '"') {
+                if (stream_append(s, p, 1)) {
+                    return stream_nomem(L, s);
+                }
+                s->state = S_ARRAY_QUOTED;
+            } else {
+                s->state = S_ARRAY_UNQUOTED;
+                continue;
+            }
+            break;
+
+        case S_ARRAY_QUOTED:
+            if (!(p = stream_scan_quoted(s, p, tail))) {
+                return stream_nomem(L, s);
+            } else if (p == tail) {
+                continue;
+            }
+            // closing quotation
+            if (stream_append(s, p, 1)) {
+                return stream_nomem(L, s);
+            } else if (stream_array_element(L, s, 1)) {
+                return lua_gettop(L);
+            }
+            s->state = S_ARRAY_DELIMITER;
+            break;
+
+        case S_ARRAY_UNQUOTED: {
+            const char *head = p;
+            while (p < tail && *p != ' ' && *p != s->delim && *p != '}') {
+                p++;
+            }
+            if (stream_append(s, head, p - head)) {
+                return stream_nomem(L, s);
+            } else if (p == tail) {
+                continue;
+            } else if (stream_array_element(L, s, 0)) {
+                return lua_gettop(L);
+            }
+            s->state = S_ARRAY_DELIMITER;
+            continue;
+        }
+
+        case S_ARRAY_DELIMITER:
+            if (*p == ' ') {
+                break;
+            } else if (*p == s->delim) {
+                s->state = S_ARRAY_ELEMENT;
+            } else if (*p == '}') {
+                stream_array_close(L, s);
+            } else {
+                return stream_error_at(L, s, p, chunk);
+            }
+            break;
+
+        case S_END:
+            if (*p != ' ') {
+                return stream_error_at(L, s, p, chunk);
+            }
+            break;
+        }
+        p++;
+    }
+
+    return 0;
+}
+
+static int stream_array_finish(lua_State *L, stream_t *s)
+{
+    switch (s->state) {
+    case S_START:
+        return decode_error(L, STREAM_OPS[s->type], EINVAL, "empty string");
+    case S_ARRAY_QUOTED:
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "closing quotation not found");
+    case S_END:
+        lua_rawgeti(L, 5, 1);
+        return 0;
+    default:
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "malformed array string");
+    }
+}
+
+static int stream_bytea_feed(lua_State *L, stream_t *s, const char *chunk,
+                             size_t len)
+{
+    const char *p    = chunk;
+    const char *tail = chunk + len;
+
+    // hex format: \x0123...
+    while (p < tail) {
+        switch (s->state) {
+        case S_START:
+            if (*p != '\\') {
+                return stream_error_at(L, s, p, chunk);
+            }
+            s->state = S_BYTEA_PREFIX;
+            p++;
+            break;
+
+        case S_BYTEA_PREFIX:
+            if (*p != 'x') {
+                return stream_error_at(L, s, p, chunk);
+            }
+            s->state = S_BYTEA_HEX;
+            p++;
+            break;
+
+        default: {
+            // decode hex digits into the buffer
+            unsigned char *out = NULL;
+
+            if (stream_reserve(s, (tail - p) / 2 + 1)) {
+                return stream_nomem(L, s);
+            }
+            out = (unsigned char *)s->buf + s->len;
+            for (; p < tail; p++) {
+                int v = decode_hexval(*p);
+                if (v < 0) {
+                    s->len = (char *)out - s->buf;
+                    return stream_error_at(L, s, p, chunk);
+                } else if (s->nibble < 0) {
+                    s->nibble = v;
+                } else {
+                    *out++    = (s->nibble << 4) | v;
+                    s->nibble = -1;
+                }
+            }
+            s->len = (char *)out - s->buf;
+        }
+        }
+    }
+
+    return 0;
+}
+
+static int stream_bytea_finish(lua_State *L, stream_t *s)
+{
+    switch (s->state) {
+    case S_START:
+        return decode_error(L, STREAM_OPS[s->type], EINVAL, "empty string");
+    case S_BYTEA_HEX:
+        if (s->nibble < 0) {
+            lua_pushlstring(L, s->buf ? s->buf : "", s->len);
+            return 0;
+        }
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "odd number of hex digits");
+    default:
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "invalid hex format");
+    }
+}
+
+static int stream_hstore_feed(lua_State *L, stream_t *s, const char *chunk,
+                              size_t len)
+{
+    static const char NULLSTR[] = "NULL";
+    const char *p               = chunk;
+    const char *tail            = chunk + len;
+
+    // hstore: "key"=>"value", ... "keyn"=>"valuen"
+    while (p < tail) {
+        switch (s->state) {
+        case S_START:
+            if (*p == ' ') {
+                break;
+            } else if (*p != '"') {
+                return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                                    "opening double-quote not found");
+            }
+            s->state = S_HSTORE_KEY;
+            break;
+
+        case S_HSTORE_KEY:
+        case S_HSTORE_VALUE:
+            if (!(p = stream_scan_quoted(s, p, tail))) {
+                return stream_nomem(L, s);
+            } else if (p == tail) {
+                continue;
+            } else if (s->state == S_HSTORE_KEY) {
+                s->keylen = s->len;
+                s->nnull  = 0;
+                s->state  = S_HSTORE_ARROW;
+                break;
+            }
+            // set key-value pair
+            lua_rawgeti(L, 5, 1);
+            lua_pushlstring(L, s->buf, s->keylen);
+            lua_pushlstring(L, s->buf + s->keylen, s->len - s->keylen);
+            lua_rawset(L, -3);
+            lua_pop(L, 1);
+            s->len   = 0;
+            s->state = S_HSTORE_NEXT;
+            break;
+
+        case S_HSTORE_ARROW:
+            // separator: =>
+            if (*p == ' ' && !s->nnull) {
+                break;
+            } else if (*p != "=>"[s->nnull]) {
+                return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                                    "key-value separator not found");
+            } else if (++s->nnull == 2) {
+                s->state = S_HSTORE_VALUE_START;
+            }
+            break;
+
+        case S_HSTORE_VALUE_START:
+            if (*p == ' ') {
+                break;
+            } else if (*p == 'N') {
+                s->nnull = 1;
+                s->state = S_HSTORE_NULL;
+            } else if (*p == '"') {
+                s->state = S_HSTORE_VALUE;
+            } else {
+                return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                                    "opening double-quote not found");
+            }
+            break;
+
+        case S_HSTORE_NULL:
+            if (*p != NULLSTR[s->nnull]) {
+                return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                                    "invalid null value");
+            } else if (++s->nnull == 4) {
+                s->len   = 0;
+                s->state = S_HSTORE_NEXT;
+            }
+            break;
+
+        case S_HSTORE_NEXT:
+            if (*p == ' ') {
+                break;
+            } else if (*p != ',') {
+                return stream_error_at(L, s, p, chunk);
+            }
+            s->state = S_START;
+            break;
+        }
+        p++;
+    }
+
+    return 0;
+}
+
+static int stream_hstore_finish(lua_State *L, stream_t *s)
+{
+    switch (s->state) {
+    case S_START:
+        if (!s->pos) {
+            return decode_error(L, STREAM_OPS[s->type], EINVAL,
+                                "empty string");
+        }
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "opening double-quote not found");
+    case S_HSTORE_KEY:
+    case S_HSTORE_VALUE:
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "closing double-quote not found");
+    case S_HSTORE_NEXT:
+        lua_rawgeti(L, 5, 1);
+        return 0;
+    default:
+        return decode_error(L, STREAM_OPS[s->type], EILSEQ,
+                            "malformed hstore string");
+    }
+}
+
+static const struct {
+    int (*feed)(lua_State *L, stream_t *s, const char *chunk, size_t len);
+    int (*finish)(lua_State *L, stream_t *s);
+} STREAM_DECODERS[] = {
+    [STREAM_ARRAY]  = {stream_array_feed,  stream_array_finish },
+    [STREAM_BYTEA]  = {stream_bytea_feed,  stream_bytea_finish },
+    [STREAM_HSTORE] = {stream_hstore_feed, stream_hstore_finish},
+};
+
+static stream_t *stream_check(lua_State *L)
+{
+    stream_t *s = luaL_checkudata(L, 1, STREAM_MT);
+
+    lua_settop(L, 2);
+    if (s->failed) {
+        decode_error(L, STREAM_OPS[s->type], EINVAL,
+                     "cannot decode data after an error or finish");
+        return NULL;
+    }
+    // push the function, context object and the table stack at index 3, 4
+    // and 5
+    lua_rawgeti(L, LUA_REGISTRYINDEX, s->ref);
+    lua_rawgeti(L, 3, 1);
+    lua_rawgeti(L, 3, 2);
+    lua_rawgeti(L, 3, 3);
+    lua_remove(L, 3);
+    return s;
+}
+
+static int stream_feed_lua(lua_State *L)
+{
+    size_t len        = 0;
+    const char *chunk = lauxh_checklstring(L, 2, &len);
+    stream_t *s       = stream_check(L);
+
+    if (!s) {
+        return lua_gettop(L);
+    } else if (STREAM_DECODERS[s->type].feed(L, s, chunk, len)) {
+        s->failed = 1;
+        return lua_gettop(L);
+    }
+    s->pos += len;
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int stream_finish_lua(lua_State *L)
+{
+    stream_t *s = stream_check(L);
+
+    if (!s) {
+        return lua_gettop(L);
+    }
+    s->failed = 1;
+    if (STREAM_DECODERS[s->type].finish(L, s)) {
+        return lua_gettop(L);
+    }
+    // release the buffer
+    free(s->buf);
+    s->buf = NULL;
+    s->len = s->cap = 0;
+    return 1;
+}
+
+static int stream_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, STREAM_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int stream_gc_lua(lua_State *L)
+{
+    stream_t *s = lua_touserdata(L, 1);
+
+    free(s->buf);
+    s->buf = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, s->ref);
+    s->ref = LUA_NOREF;
+    return 0;
+}
+
+static int decode_stream_lua(lua_State *L)
+{
+    int type    = luaL_checkoption(L, 1, NULL, STREAM_TYPES);
+    char delim  = ',';
+    stream_t *s = NULL;
+
+    lua_settop(L, 4);
+    if (type == STREAM_ARRAY) {
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+        if (!lua_isnil(L, 4)) {
+            size_t delim_len      = 0;
+            const char *delim_str = lauxh_checklstring(L, 4, &delim_len);
+            if (delim_len != 1) {
+                return decode_error(L, STREAM_OPS[type], EINVAL,
+                                    "delimiter must be a single character");
+            }
+            delim = *delim_str;
+        }
+    }
+
+    s  = lua_newuserdata(L, sizeof(stream_t));
+    *s = (stream_t){
+        .type   = type,
+        .delim  = delim,
+        .nibble = -1,
+        .ref    = LUA_NOREF,
+    };
+    luaL_getmetatable(L, STREAM_MT);
+    lua_setmetatable(L, -2);
+
+    // environment table: {fn, ctx, tbl}
+    lua_createtable(L, 3, 0);
+    lua_pushvalue(L, 2);
+    lua_rawseti(L, -2, 1);
+    lua_pushvalue(L, 3);
+    lua_rawseti(L, -2, 2);
+    lua_newtable(L);
+    if (type == STREAM_HSTORE) {
+        lua_newtable(L);
+        lua_rawseti(L, -2, 1);
+    }
+    lua_rawseti(L, -2, 3);
+    s->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_stream(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       stream_gc_lua      },
+        {"__tostring", stream_tostring_lua},
+        {NULL,         NULL               }
+    };
+    struct luaL_Reg method[] = {
+        {"feed",   stream_feed_lua  },
+        {"finish", stream_finish_lua},
+        {NULL,     NULL             }
+    };
+
+    lua_errno_loadlib(L);
+
+    // create metatable for the stream decoder
+    if (luaL_newmetatable(L, STREAM_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            DECODE_STATS_WRAP(L, "postgres.decode.stream", ptr->name);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, decode_stream_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.stream", NULL);
+    return 1;
+}
@@ -24,16 +24,18 @@
 
 static int decode_time_lua(lua_State *L)
 {
-    size_t len           = 0;
-    const char *str      = lauxh_checklstring(L, 1, &len);
-    datum_timestamp_t ts = {0};
+    static const char *op = "postgres.decode.time";
+    size_t len            = 0;
+    const char *str       = lauxh_checklstring(L, 1, &len);
+    datum_timestamp_t ts  = {0};
+    pgdec_error_t err     = {0};
 
-    lua_settop(L, 1);
-    if (decode_time(&ts, L, "postgres.decode.time", str, len, NULL)) {
-        return 2;
+    lua_settop(L, 2);
+    if (decode_time(&ts, &err, str, len, NULL, 0)) {
+        return decode_error_from(L, op, &err);
     }
 
-    lua_createtable(L, 0, 4);
+    decode_table(L, 2, 0, 4, 0);
     lauxh_pushint2tbl(L, "hour", ts.hour);
     lauxh_pushint2tbl(L, "min", ts.min);
     lauxh_pushint2tbl(L, "sec", ts.sec);
@@ -52,5 +54,6 @@ LUALIB_API int luaopen_postgres_decode_time(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_time_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.time", NULL);
     return 1;
 }
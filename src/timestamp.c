@@ -24,16 +24,18 @@
 
 static int decode_timestamp_lua(lua_State *L)
 {
-    size_t len           = 0;
-    const char *str      = lauxh_checklstring(L, 1, &len);
-    datum_timestamp_t ts = {0};
+    static const char *op = "postgres.decode.timestamp";
+    size_t len            = 0;
+    const char *str       = lauxh_checklstring(L, 1, &len);
+    datum_timestamp_t ts  = {0};
+    pgdec_error_t err     = {0};
 
-    lua_settop(L, 1);
-    if (decode_timestamp(&ts, L, "postgres.decode.timestamp", str, len)) {
-        return 2;
+    lua_settop(L, 2);
+    if (decode_timestamp(&ts, &err, str, len)) {
+        return decode_error_from(L, op, &err);
     }
 
-    lua_createtable(L, 0, 4);
+    decode_table(L, 2, 0, 4, 0);
     lauxh_pushint2tbl(L, "year", ts.year);
     lauxh_pushint2tbl(L, "month", ts.mon);
     lauxh_pushint2tbl(L, "day", ts.day);
@@ -55,5 +57,6 @@ LUALIB_API int luaopen_postgres_decode_timestamp(lua_State *L)
 {
     lua_errno_loadlib(L);
     lua_pushcfunction(L, decode_timestamp_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.timestamp", NULL);
     return 1;
 }
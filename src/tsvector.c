@@ -20,39 +20,87 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#include "lua_postgres_decode.h"
+#include "lua_postgres_decode_limits.h"
+#include "lua_postgres_decode_yield.h"
 
 #define SKIP_DELIM(s, delim, ...)                                              \
     do {                                                                       \
-        (s) = decode_skip_delim((s), (delim), 0, 0);                           \
+        (s) = decode_skip_delim((s), tail, (delim), 0, 0);                     \
         if (!(s)) {                                                            \
             return decode_error((L), (op), EILSEQ, __VA_ARGS__);               \
         }                                                                      \
     } while (0)
 
-static int decode_tsvector_lua(lua_State *L)
+// the tsvector string is decoded in two phases. the first phase parses the
+// whole string into the nodes in the arena, and the second phase builds the
+// tables of the exact sizes only after the string is validated.
+// each lexeme node is followed by the position nodes of the lexeme.
+typedef union {
+    struct {
+        // offset and length of the lexeme from the head of the string
+        size_t off;
+        size_t len;
+        int npos;
+        int nweight;
+    } lexeme;
+    struct {
+        intmax_t pos;
+        // weight character, or 0 if not specified
+        char weight;
+    } position;
+} tsvector_node_t;
+
+// state of the second phase that is kept in the arena to resume it
+typedef struct {
+    decode_yield_t y;
+    const char *tsv;
+    int nvec;
+    // number of the built lexemes
+    int k;
+    // index of the next lexeme node
+    size_t i;
+} tsvector_build_t;
+
+// stack index of the arena
+#define TSVECTOR_ARENA 3
+
+#define TSVECTOR_NODE(a, idx)                                                  \
+    ((tsvector_node_t *)decode_arena_at((a), sizeof(tsvector_node_t), (idx)))
+
+#define PUSH_NODE(node)                                                        \
+    do {                                                                       \
+        (node) = decode_arena_alloc(a, sizeof(tsvector_node_t));               \
+        if (!(node)) {                                                         \
+            return decode_error((L), (op), ENOMEM, NULL);                      \
+        }                                                                      \
+        nnode++;                                                               \
+    } while (0)
+
+/**
+ * @brief decode_tsvector_parse
+ *  phase 1: parse the whole tsvector string into the arena, and push the
+ *  table to build.
+ * @return int 0 on success and the offset of the build state is stored to
+ * *off, otherwise the number of the pushed error values.
+ */
+static int decode_tsvector_parse(lua_State *L, const char *op,
+                                 const char *tsv, size_t len,
+                                 decode_arena_t *a, size_t *off)
 {
-    static const char *op = "postgres.decode.tsvector";
-    size_t len            = 0;
-    const char *tsv       = lauxh_checklstring(L, 1, &len);
     char *str             = (char *)tsv;
+    const char *tail      = tsv + len;
     char *chunk           = NULL;
     int nvec              = 0;
-
-    lua_settop(L, 1);
-    // create result table
-    // {
-    //     [1] = {
-    //         lexem = 'foo',
-    //         positions = { 1, 2, 3 },
-    //         weights = { 'A', 'B', 'C' }
-    //     },
-    // }
-    lua_newtable(L);
+    size_t nnode          = 0;
+    size_t i              = 0;
+    tsvector_node_t *node = NULL;
+    tsvector_build_t *b   = NULL;
+    decode_quota_t quota;
 
     // parse the following formats
     //  'foo' 'bar' 'baz'
     //  'fo''o' 'bar' 'baz'
+    decode_quota_start(L, &quota);
     DECODE_START(L, op, str, len);
 
 NEXT_LEXEME:
@@ -64,42 +112,50 @@ ESCAPE_QUOTE:
         str++;
         goto ESCAPE_QUOTE;
     }
-    // create lexeme table
-    lua_newtable(L);
-    lua_pushliteral(L, "lexeme");
-    lua_pushlstring(L, chunk, str - chunk - 1);
-    lua_rawset(L, -3);
+    // lexeme node
+    if (decode_quota_string(&quota, str - chunk - 1) ||
+        decode_quota_add(&quota, 1,
+                         DECODE_SIZEOF_SLOT + DECODE_SIZEOF_TABLE +
+                             DECODE_SIZEOF_NODE * 3)) {
+        return decode_error_from(L, op, &quota.err);
+    }
+    PUSH_NODE(node);
+    *node = (tsvector_node_t){
+        .lexeme = {.off = chunk - tsv, .len = str - chunk - 1},
+    };
+    i = nnode - 1;
+    nvec++;
 
     // if the next character is ':', then parse the following formats
     //  'foo':1,2,3 'bar':4 'baz':1
     if (*str == ':') {
-        char *endptr  = NULL;
-        int nposition = 0;
-        int nweight   = 0;
-        intmax_t iv   = 0;
+        char *endptr = NULL;
+        intmax_t iv  = 0;
 
         // skip ':'
         str++;
-
-        // positions table
-        lua_pushliteral(L, "positions");
-        lua_newtable(L);
-        // weights table
-        lua_pushliteral(L, "weights");
-        lua_newtable(L);
+        // positions and weights tables
+        if (decode_quota_add(&quota, 0, DECODE_SIZEOF_TABLE * 2)) {
+            return decode_error_from(L, op, &quota.err);
+        }
 
 NEXT_POSITION:
         // parse position
-        iv = decode_str2imax(str, &endptr);
+        iv = decode_str2imax(str, tail, &endptr);
         if (str == endptr) {
             errno = EILSEQ;
         }
         if (errno) {
             return decode_error_at(L, op, errno, tsv, endptr);
         }
-        // set position
-        lua_pushinteger(L, iv);
-        lua_rawseti(L, -4, ++nposition);
+        // position node
+        if (decode_quota_add(&quota, 1, DECODE_SIZEOF_SLOT * 2)) {
+            return decode_error_from(L, op, &quota.err);
+        }
+        PUSH_NODE(node);
+        *node = (tsvector_node_t){
+            .position = {.pos = iv},
+        };
         str = endptr;
 
         // parse weight
@@ -107,12 +163,11 @@ NEXT_POSITION:
         case 'A':
         case 'B':
         case 'C':
-            // set weight
-            lua_pushlstring(L, str, 1);
-            lua_rawseti(L, -2, nposition);
-            nweight++;
+            node->position.weight = *str;
+            TSVECTOR_NODE(a, i)->lexeme.nweight++;
             str++;
         }
+        TSVECTOR_NODE(a, i)->lexeme.npos++;
 
         switch (*str) {
         case ',':
@@ -127,31 +182,146 @@ NEXT_POSITION:
             errno = EILSEQ;
             return decode_error_at(L, op, errno, tsv, str);
         }
-
-        // set weights table if not empty
-        if (nweight) {
-            lua_rawset(L, -5);
-        } else {
-            lua_pop(L, 2);
-        }
-        // set positions table
-        lua_rawset(L, -3);
     }
 
-    // add to result table
-    lua_rawseti(L, -2, ++nvec);
     if (*str) {
         goto NEXT_LEXEME;
     }
-
     DECODE_END(str);
 
+    if (!(b = decode_arena_alloc_state(a, sizeof(tsvector_build_t), off))) {
+        return decode_error(L, op, ENOMEM, NULL);
+    }
+    *b = (tsvector_build_t){
+        .tsv  = tsv,
+        .nvec = nvec,
+    };
+    decode_yield_init(L, &b->y);
+    decode_table(L, 2, nvec, 0, 1);
+    return 0;
+}
+
+#undef PUSH_NODE
+
+/**
+ * @brief decode_tsvector_build
+ *  phase 2: build the lexeme tables of the exact sizes to the table at the
+ *  top of the stack.
+ *  {
+ *      [1] = {
+ *          lexem = 'foo',
+ *          positions = { 1, 2, 3 },
+ *          weights = { 'A', 'B', 'C' }
+ *      },
+ *  }
+ * @return int 0 on success, or 1 if the current step is exhausted.
+ */
+static int decode_tsvector_build(lua_State *L, decode_arena_t *a,
+                                 tsvector_build_t *b)
+{
+    while (b->k < b->nvec) {
+        tsvector_node_t *lexeme = TSVECTOR_NODE(a, b->i++);
+        int npos                = lexeme->lexeme.npos;
+        int nweight             = lexeme->lexeme.nweight;
+        int k                   = ++b->k;
+
+        // create lexeme table
+        decode_subtable(L, k, 0, 1 + (npos > 0) + (nweight > 0), 0);
+        lua_pushliteral(L, "lexeme");
+        lua_pushlstring(L, b->tsv + lexeme->lexeme.off, lexeme->lexeme.len);
+        lua_rawset(L, -3);
+        if (npos) {
+            // positions table
+            lua_pushliteral(L, "positions");
+            lua_createtable(L, npos, 0);
+            // weights table
+            lua_pushliteral(L, "weights");
+            lua_createtable(L, nweight ? npos : 0, 0);
+            for (int j = 1; j <= npos; j++) {
+                tsvector_node_t *node = TSVECTOR_NODE(a, b->i++);
+                lua_pushinteger(L, node->position.pos);
+                lua_rawseti(L, -4, j);
+                if (node->position.weight) {
+                    lua_pushlstring(L, &node->position.weight, 1);
+                    lua_rawseti(L, -2, j);
+                }
+            }
+            // set weights table if not empty
+            if (nweight) {
+                lua_rawset(L, -5);
+            } else {
+                lua_pop(L, 2);
+            }
+            // set positions table
+            lua_rawset(L, -3);
+        }
+        // add to result table
+        lua_rawseti(L, -2, k);
+        if (decode_yield_tick(&b->y)) {
+            return 1;
+        }
+    }
+    decode_trimtable(L, b->nvec);
+    return 0;
+}
+
+static int decode_tsvector_continue(lua_State *L, size_t off);
+
+#if LUA_VERSION_NUM >= 503
+static int decode_tsvector_resume(lua_State *L, int status, lua_KContext ctx)
+{
+    (void)status;
+    decode_yield_state(L, TSVECTOR_ARENA, (size_t)ctx);
+    return decode_tsvector_continue(L, (size_t)ctx);
+}
+#endif
+
+/**
+ * @brief decode_tsvector_continue
+ *  build the tables from the state at the offset off in the arena, and
+ *  release the arena when it is done.
+ */
+static int decode_tsvector_continue(lua_State *L, size_t off)
+{
+    decode_arena_t *a   = lua_touserdata(L, TSVECTOR_ARENA);
+    tsvector_build_t *b = (tsvector_build_t *)(a->buf + off);
+
+#if LUA_VERSION_NUM >= 503
+    if (decode_tsvector_build(L, a, b)) {
+        return decode_yield(L, lua_upvalueindex(1), TSVECTOR_ARENA, &b->y,
+                            off, decode_tsvector_resume);
+    }
+#else
+    decode_tsvector_build(L, a, b);
+#endif
+    decode_arena_leave(L, lua_upvalueindex(1), a);
     return 1;
 }
 
+static int decode_tsvector_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.tsvector";
+    size_t len            = 0;
+    const char *tsv       = lauxh_checklstring(L, 1, &len);
+    decode_arena_t *a     = NULL;
+    size_t off            = 0;
+    int rv                = 0;
+
+    lua_settop(L, 2);
+    a = decode_arena_enter(L, lua_upvalueindex(1));
+    if ((rv = decode_tsvector_parse(L, op, tsv, len, a, &off))) {
+        decode_arena_leave(L, lua_upvalueindex(1), a);
+        return rv;
+    }
+    return decode_tsvector_continue(L, off);
+}
+
 LUALIB_API int luaopen_postgres_decode_tsvector(lua_State *L)
 {
     lua_errno_loadlib(L);
-    lua_pushcfunction(L, decode_tsvector_lua);
+    // arena to parse the tsvector string
+    decode_arena_new(L);
+    lua_pushcclosure(L, decode_tsvector_lua, 1);
+    DECODE_STATS_WRAP(L, "postgres.decode.tsvector", NULL);
     return 1;
 }
@@ -0,0 +1,58 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_uuid.h"
+
+static int decode_uuid_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.uuid";
+    size_t len            = 0;
+    char *str             = (char *)lauxh_checklstring(L, 1, &len);
+    int as_text           = lauxh_optboolean(L, 2, 0);
+    unsigned char uuid[UUID_LEN];
+    char *endptr = NULL;
+
+    if (!len) {
+        return decode_error(L, op, EINVAL, "empty string");
+    } else if ((endptr = decode_uuid(str, len, uuid))) {
+        if (!*endptr) {
+            return decode_error(L, op, EILSEQ,
+                                "uuid string must be %d characters",
+                                UUID_STRLEN);
+        }
+        return decode_error_at(L, op, EILSEQ, str, endptr);
+    } else if (len > UUID_STRLEN) {
+        // found trailing characters
+        return decode_error_at(L, op, EILSEQ, str, str + UUID_STRLEN);
+    }
+
+    decode_uuid_push(L, uuid, as_text);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_uuid(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, decode_uuid_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.uuid", NULL);
+    return 1;
+}
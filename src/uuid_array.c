@@ -0,0 +1,98 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_postgres_decode_uuid.h"
+
+static int decode_uuid_array_lua(lua_State *L)
+{
+    static const char *op = "postgres.decode.uuid_array";
+    size_t len            = 0;
+    char *src             = (char *)lauxh_checklstring(L, 1, &len);
+    char *tail            = src + len;
+    char *str             = src;
+    int as_text           = lauxh_optboolean(L, 2, 0);
+    int n                 = 0;
+    unsigned char uuid[UUID_LEN];
+
+    lua_settop(L, 2);
+    lua_newtable(L);
+
+    // one-dimensional array of uuid: {uuid,uuid,NULL,...}
+    str = decode_skip_space(str, tail);
+    if (!*str) {
+        return decode_error(L, op, EINVAL, "empty string");
+    } else if (*str != '{') {
+        return decode_error(L, op, EILSEQ, "opening curly bracket not found");
+    }
+    str = decode_skip_space(str + 1, tail);
+    if (*str == '}') {
+        str++;
+        goto CHECK_TAIL;
+    }
+
+NEXT_ELEMENT:
+    n++;
+    if (tail - str >= 4 && strncasecmp(str, "NULL", 4) == 0 &&
+        (str[4] == ',' || str[4] == '}' || str[4] == ' ')) {
+        // NULL element
+        str += 4;
+    } else {
+        char *endptr = decode_uuid(str, tail - str, uuid);
+        if (endptr) {
+            if (!*endptr) {
+                return decode_error(L, op, EILSEQ, "malformed array string");
+            }
+            return decode_error_at(L, op, EILSEQ, src, endptr);
+        }
+        decode_uuid_push(L, uuid, as_text);
+        lua_rawseti(L, -2, n);
+        str += UUID_STRLEN;
+    }
+
+    // next delimiter must be ',' or '}'
+    str = decode_skip_space(str, tail);
+    if (*str == ',') {
+        str = decode_skip_space(str + 1, tail);
+        goto NEXT_ELEMENT;
+    } else if (*str != '}') {
+        if (!*str) {
+            return decode_error(L, op, EILSEQ, "malformed array string");
+        }
+        return decode_error_at(L, op, EILSEQ, src, str);
+    }
+    str++;
+
+CHECK_TAIL:
+    str = decode_skip_space(str, tail);
+    if (*str) {
+        return decode_error_at(L, op, EILSEQ, src, str);
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_decode_uuid_array(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, decode_uuid_array_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.uuid_array", NULL);
+    return 1;
+}
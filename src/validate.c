@@ -0,0 +1,855 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <strings.h>
+// lua
+#include "lua_postgres_decode_datetime.h"
+
+// validate the text representation of the value by the same grammar as the
+// decoder of the type, without creating any lua values.
+//
+// each validator returns NULL if the string is valid, otherwise the pointer
+// to the invalid character. the string must be terminated by '\0'.
+
+#define MAX_ARRAY_DEPTH 64
+
+typedef struct validate_type_s validate_type_t;
+
+typedef struct {
+    const validate_type_t *elem; // element type of the array or range type
+    char delim;                  // delimiter of the array type
+    char *tail;                  // end of the string
+    int err;                     // errno of the system error
+} validate_t;
+
+struct validate_type_s {
+    const char *name;
+    char *(*fn)(validate_t *v, char *str);
+    int is_container;
+};
+
+#define VALIDATE_DIGIT(s, val, mind, maxd, minv, maxv)                         \
+    do {                                                                       \
+        char *endptr_ = (s);                                                   \
+        (val) = decode_digit((s), v->tail, (mind), (maxd), (minv), (maxv),     \
+                             &endptr_);                                        \
+        if (errno) {                                                           \
+            return endptr_;                                                    \
+        }                                                                      \
+        (s) = endptr_;                                                         \
+    } while (0)
+
+#define VALIDATE_FIXDIGIT(s, val, width, minv, maxv)                          \
+    do {                                                                       \
+        char *endptr_ = (s);                                                   \
+        (val) = decode_digit##width((s), v->tail, (minv), (maxv), &endptr_);   \
+        if (errno) {                                                           \
+            return endptr_;                                                    \
+        }                                                                      \
+        (s) = endptr_;                                                         \
+    } while (0)
+
+#define VALIDATE_CHAR(s, c)                                                    \
+    do {                                                                       \
+        if (*(s) != (c)) {                                                     \
+            return (s);                                                        \
+        }                                                                      \
+        (s)++;                                                                 \
+    } while (0)
+
+#define VALIDATE_SKIP_DELIM(s, delim, skip_trailing_spaces)                    \
+    do {                                                                       \
+        (s) = decode_skip_delim((s), v->tail, (delim), 0,                      \
+                                (skip_trailing_spaces));                       \
+        if (!(s)) {                                                            \
+            return v->tail;                                                    \
+        }                                                                      \
+    } while (0)
+
+#define VALIDATE_DBL(s)                                                        \
+    do {                                                                       \
+        char *endptr_ = NULL;                                                  \
+        decode_str2dbl((s), v->tail, &endptr_);                                \
+        if (errno) {                                                           \
+            return (s);                                                        \
+        }                                                                      \
+        (s) = endptr_;                                                         \
+    } while (0)
+
+#define VALIDATE_POINT(s)                                                      \
+    do {                                                                       \
+        VALIDATE_SKIP_DELIM((s), '(', 1);                                      \
+        VALIDATE_DBL(s);                                                       \
+        VALIDATE_SKIP_DELIM((s), ',', 1);                                      \
+        VALIDATE_DBL(s);                                                       \
+        VALIDATE_SKIP_DELIM((s), ')', 1);                                      \
+    } while (0)
+
+#define VALIDATE_END(s) return (*(s)) ? (s) : NULL
+
+static char *validate_bool(validate_t *v, char *str)
+{
+    (void)v;
+    if (*str != 't' && *str != 'f') {
+        return str;
+    }
+    VALIDATE_END(str + 1);
+}
+
+static char *validate_bytea(validate_t *v, char *str)
+{
+    (void)v;
+    // hex format
+    VALIDATE_CHAR(str, '\\');
+    VALIDATE_CHAR(str, 'x');
+    while (isxdigit(*str)) {
+        str++;
+    }
+    VALIDATE_END(str);
+}
+
+static char *validate_bit(validate_t *v, char *str)
+{
+    (void)v;
+    if (!*str) {
+        return str;
+    }
+    while (*str == '0' || *str == '1') {
+        str++;
+    }
+    VALIDATE_END(str);
+}
+
+static char *validate_int(validate_t *v, char *str)
+{
+    char *endptr = str;
+
+    (void)v;
+    switch (*str) {
+    case '-':
+        decode_str2imax(str, v->tail, &endptr);
+        break;
+
+    default:
+        if (!isdigit(*str) && *str != '+') {
+            return str;
+        } else if (decode_str2umax(str, v->tail, &endptr) > (uintmax_t)INTMAX_MAX) {
+            errno = ERANGE;
+        }
+    }
+    if (errno) {
+        return str;
+    }
+    VALIDATE_END(endptr);
+}
+
+static char *validate_float(validate_t *v, char *str)
+{
+    char *endptr = str;
+
+    (void)v;
+    if (!*str) {
+        return str;
+    } else if (isdigit(*str) || *str == '+' || *str == '-') {
+        decode_str2dbl(str, v->tail, &endptr);
+        if (errno) {
+            return str;
+        }
+    }
+    VALIDATE_END(endptr);
+}
+
+/**
+ * @brief validate_time_at
+ *  validate the time string at s. if hour is not negative, then hh:mm:ss is
+ *  already validated, and s points to the next character of it.
+ */
+static char *validate_time_at(validate_t *v, char *s, intmax_t hour)
+{
+    intmax_t min_max  = 59;
+    intmax_t sec_max  = 59;
+    intmax_t usec_max = 999999;
+    intmax_t unused   = 0;
+
+    (void)v;
+    if (hour >= 0) {
+        if (hour == 24) {
+            usec_max = 0;
+        }
+        goto VALIDATE_USEC;
+    }
+
+    // hh:mm:ss
+    VALIDATE_FIXDIGIT(s, hour, 2, 0, 24);
+    VALIDATE_CHAR(s, ':');
+    if (hour == 24) {
+        min_max  = 0;
+        sec_max  = 0;
+        usec_max = 0;
+    }
+    VALIDATE_FIXDIGIT(s, unused, 2, 0, min_max);
+    VALIDATE_CHAR(s, ':');
+    VALIDATE_FIXDIGIT(s, unused, 2, 0, sec_max);
+
+VALIDATE_USEC:
+    // .uuuuuu
+    if (*s == '.') {
+        s++;
+        VALIDATE_DIGIT(s, unused, 1, 6, 0, usec_max);
+    }
+
+    switch (*s) {
+    case 0:
+        return NULL;
+    case '+':
+    case '-':
+        s++;
+        break;
+    default:
+        return s;
+    }
+
+    // timezone: hh | hh:mm | hh:mm:ss
+    VALIDATE_FIXDIGIT(s, unused, 2, 0, 24);
+    if (*s == ':') {
+        s++;
+        VALIDATE_FIXDIGIT(s, unused, 2, 0, 59);
+        if (*s == ':') {
+            s++;
+            VALIDATE_FIXDIGIT(s, unused, 2, 0, 59);
+        }
+    }
+    (void)unused;
+    VALIDATE_END(s);
+}
+
+static char *validate_time(validate_t *v, char *str)
+{
+    if (!*str) {
+        return str;
+    }
+    return validate_time_at(v, str, -1);
+}
+
+static char *validate_date(validate_t *v, char *s)
+{
+    char delim      = (s[0] && s[1]) ? s[2] : 0;
+    intmax_t unused = 0;
+
+    (void)v;
+    switch (delim) {
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        // yyyy-mm-dd
+        VALIDATE_FIXDIGIT(s, unused, 4, 0, -1);
+        VALIDATE_CHAR(s, '-');
+        VALIDATE_FIXDIGIT(s, unused, 2, 1, 12);
+        VALIDATE_CHAR(s, '-');
+        VALIDATE_FIXDIGIT(s, unused, 2, 1, 31);
+        break;
+
+    case '.':
+        // dd.mm.yyyy
+        VALIDATE_FIXDIGIT(s, unused, 2, 1, 31);
+        VALIDATE_CHAR(s, delim);
+        VALIDATE_FIXDIGIT(s, unused, 2, 1, 12);
+        VALIDATE_CHAR(s, delim);
+        VALIDATE_FIXDIGIT(s, unused, 4, 0, -1);
+        break;
+
+    case '/':
+    case '-':
+        // mm/dd/yyyy or mm-dd-yyyy
+        VALIDATE_FIXDIGIT(s, unused, 2, 1, 12);
+        VALIDATE_CHAR(s, delim);
+        VALIDATE_FIXDIGIT(s, unused, 2, 1, 31);
+        VALIDATE_CHAR(s, delim);
+        VALIDATE_FIXDIGIT(s, unused, 4, 0, -1);
+        break;
+
+    default:
+        return s;
+    }
+    (void)unused;
+    VALIDATE_END(s);
+}
+
+static char *validate_timestamp(validate_t *v, char *s)
+{
+    datum_timestamp_t ts = {0};
+    intmax_t unused      = 0;
+
+    // fast path: yyyy-mm-dd hh:mm:ss
+    if (decode_timestamp_canonical(&ts, s, v->tail - s)) {
+        return validate_time_at(v, s + 19, ts.hour);
+    }
+
+    // yyyy-mm-dd
+    VALIDATE_FIXDIGIT(s, unused, 4, 0, -1);
+    VALIDATE_CHAR(s, '-');
+    VALIDATE_FIXDIGIT(s, unused, 2, 1, 12);
+    VALIDATE_CHAR(s, '-');
+    VALIDATE_FIXDIGIT(s, unused, 2, 1, 31);
+    (void)unused;
+    return validate_time_at(v, decode_skip_space(s, v->tail), -1);
+}
+
+static char *validate_point(validate_t *v, char *s)
+{
+    // (x, y)
+    VALIDATE_POINT(s);
+    VALIDATE_END(s);
+}
+
+static char *validate_line(validate_t *v, char *s)
+{
+    // {a,b,c}
+    VALIDATE_SKIP_DELIM(s, '{', 1);
+    VALIDATE_DBL(s);
+    VALIDATE_SKIP_DELIM(s, ',', 1);
+    VALIDATE_DBL(s);
+    VALIDATE_SKIP_DELIM(s, ',', 1);
+    VALIDATE_DBL(s);
+    VALIDATE_SKIP_DELIM(s, '}', 1);
+    VALIDATE_END(s);
+}
+
+static char *validate_lseg(validate_t *v, char *s)
+{
+    // [(x1, y1), (x2, y2)]
+    VALIDATE_SKIP_DELIM(s, '[', 1);
+    VALIDATE_POINT(s);
+    VALIDATE_SKIP_DELIM(s, ',', 1);
+    VALIDATE_POINT(s);
+    VALIDATE_SKIP_DELIM(s, ']', 1);
+    VALIDATE_END(s);
+}
+
+static char *validate_box(validate_t *v, char *s)
+{
+    // (x1, y1), (x2, y2)
+    VALIDATE_POINT(s);
+    VALIDATE_SKIP_DELIM(s, ',', 1);
+    VALIDATE_POINT(s);
+    VALIDATE_END(s);
+}
+
+static char *validate_path(validate_t *v, char *s)
+{
+    char delim_close = ']';
+
+    // [(x1, y1), ... (xn, yn)] or ((x1, y1), ... (xn, yn))
+    switch (*s) {
+    case '(':
+        delim_close = ')';
+    case '[':
+        s++;
+        break;
+    default:
+        return s;
+    }
+    if (!*s) {
+        return s;
+    }
+
+CHECK_NEXT:
+    VALIDATE_POINT(s);
+    if (*s == ',') {
+        s = decode_skip_space(s + 1, v->tail);
+        goto CHECK_NEXT;
+    }
+    VALIDATE_SKIP_DELIM(s, delim_close, 1);
+    VALIDATE_END(s);
+}
+
+static char *validate_polygon(validate_t *v, char *s)
+{
+    // ((x1, y1), ... (xn, yn))
+    VALIDATE_SKIP_DELIM(s, '(', 1);
+
+CHECK_NEXT:
+    VALIDATE_POINT(s);
+    if (*s == ',') {
+        s = decode_skip_space(s + 1, v->tail);
+        goto CHECK_NEXT;
+    }
+    VALIDATE_SKIP_DELIM(s, ')', 1);
+    VALIDATE_END(s);
+}
+
+static char *validate_circle(validate_t *v, char *s)
+{
+    // <(x,y),r>
+    VALIDATE_SKIP_DELIM(s, '<', 1);
+    VALIDATE_POINT(s);
+    VALIDATE_SKIP_DELIM(s, ',', 1);
+    VALIDATE_DBL(s);
+    VALIDATE_SKIP_DELIM(s, '>', 1);
+    VALIDATE_END(s);
+}
+
+static char *validate_hstore(validate_t *v, char *s)
+{
+    // "key"=>"value", ... "keyn"=>"valuen"
+CHECK_NEXT:
+    VALIDATE_SKIP_DELIM(s, '"', 0);
+    VALIDATE_SKIP_DELIM(s, '"', 0);
+    s = decode_skip_space(s, v->tail);
+    VALIDATE_CHAR(s, '=');
+    VALIDATE_CHAR(s, '>');
+    if (*s == 'N') {
+        // NULL value
+        s++;
+        VALIDATE_CHAR(s, 'U');
+        VALIDATE_CHAR(s, 'L');
+        VALIDATE_CHAR(s, 'L');
+    } else {
+        VALIDATE_SKIP_DELIM(s, '"', 0);
+        VALIDATE_SKIP_DELIM(s, '"', 0);
+    }
+    s = decode_skip_space(s, v->tail);
+    if (*s == ',') {
+        s++;
+        goto CHECK_NEXT;
+    }
+    VALIDATE_END(s);
+}
+
+static char *validate_tsvector(validate_t *v, char *s)
+{
+    // 'foo':1A,2 'ba''r' ...
+NEXT_LEXEME:
+    VALIDATE_SKIP_DELIM(s, '\'', 0);
+ESCAPE_QUOTE:
+    VALIDATE_SKIP_DELIM(s, '\'', 0);
+    if (*s == '\'') {
+        s++;
+        goto ESCAPE_QUOTE;
+    }
+
+    if (*s == ':') {
+        char *endptr = NULL;
+
+        s++;
+NEXT_POSITION:
+        decode_str2imax(s, v->tail, &endptr);
+        if (errno || s == endptr) {
+            return endptr;
+        }
+        s = endptr;
+        switch (*s) {
+        case 'A':
+        case 'B':
+        case 'C':
+            s++;
+        }
+
+        switch (*s) {
+        case ',':
+            s++;
+            goto NEXT_POSITION;
+        case ' ':
+        case 0:
+            break;
+        default:
+            return s;
+        }
+    }
+
+    if (*s) {
+        goto NEXT_LEXEME;
+    }
+    return NULL;
+}
+
+/**
+ * @brief validate_elem
+ *  validate the element of the array or range by the element type.
+ *  the quoted element is unquoted the same as the element decoder of
+ *  decode.decode.
+ */
+static char *validate_elem(validate_t *v, char *token, size_t len)
+{
+    validate_t ev = {0};
+    char *err     = NULL;
+    char *head    = token;
+    char *tail    = token + len;
+    char *buf     = NULL;
+    char tailc    = 0;
+
+    if (!v->elem) {
+        return NULL;
+    } else if (*token == '"') {
+        char stackbuf[256];
+        char *src = NULL;
+        char *dst = NULL;
+
+        head = token + 1;
+        tail = token + len - 1;
+        // unquoted in place unless the element contains escapes
+        for (src = head; src < tail; src++) {
+            if (*src == '\\' || (*src == '"' && src[1] == '"')) {
+                break;
+            }
+        }
+        if (src == tail) {
+            goto VALIDATE;
+        }
+
+        buf = stackbuf;
+        if ((size_t)(tail - head) >= sizeof(stackbuf) &&
+            !(buf = malloc(tail - head + 1))) {
+            v->err = errno;
+            return token;
+        }
+        for (src = head, dst = buf; src < tail; src++) {
+            if (*src == '\\' || (*src == '"' && src[1] == '"')) {
+                src++;
+            }
+            *dst++ = *src;
+        }
+        *dst    = 0;
+        ev.tail = dst;
+        err     = v->elem->fn(&ev, buf) ? token : NULL;
+        if (buf != stackbuf) {
+            free(buf);
+        }
+        return err;
+    }
+
+VALIDATE:
+    tailc   = *tail;
+    *tail   = 0;
+    ev.tail = tail;
+    err     = v->elem->fn(&ev, head);
+    *tail   = tailc;
+    return err;
+}
+
+static char *validate_array(validate_t *v, char *str)
+{
+    char delim       = v->delim;
+    int depth        = 0;
+    char *token      = NULL;
+    size_t token_len = 0;
+    char *err        = NULL;
+
+    str = decode_skip_space(str, v->tail);
+    VALIDATE_CHAR(str, '{');
+    str = decode_skip_space(str, v->tail);
+    depth++;
+
+NEXT_ELEMENT:
+    switch (*str) {
+    case 0:
+        return str;
+
+    case '{':
+        // nested array
+        if (++depth > MAX_ARRAY_DEPTH) {
+            return str;
+        }
+        str = decode_skip_space(str + 1, v->tail);
+        goto NEXT_ELEMENT;
+
+    case '}':
+        depth--;
+        str = decode_skip_space(str + 1, v->tail);
+        if (depth) {
+            if (*str == delim) {
+                str = decode_skip_space(str + 1, v->tail);
+            }
+            goto NEXT_ELEMENT;
+        }
+        VALIDATE_END(str);
+
+    case '"':
+        // quoted value
+        token = str++;
+        while (*str != '"') {
+            if (!*str) {
+                return str;
+            } else if (*str == '\\' && str[1]) {
+                str++;
+            }
+            str++;
+        }
+        str++;
+        token_len = str - token;
+        break;
+
+    default:
+        if (*str == delim) {
+            // empty elements are not allowed
+            return str;
+        }
+        // unquoted value
+        token = str;
+        while (*str != ' ' && *str != delim && *str != '}') {
+            if (!*str) {
+                return str;
+            }
+            str++;
+        }
+        token_len = str - token;
+        if (token_len == 4 && strncasecmp(token, "NULL", 4) == 0) {
+            goto CHECK_DELIMITER;
+        }
+    }
+
+    if ((err = validate_elem(v, token, token_len))) {
+        return err;
+    }
+
+CHECK_DELIMITER:
+    str = decode_skip_space(str, v->tail);
+    if (*str == delim) {
+        str = decode_skip_space(str + 1, v->tail);
+    } else if (*str != '}') {
+        return str;
+    }
+    goto NEXT_ELEMENT;
+}
+
+// closing brackets of the nested brackets in the range string
+static const char BRACKETS[256] = {
+    ['{'] = '}',
+    ['('] = ')',
+    ['['] = ']',
+    ['<'] = '>',
+};
+
+/**
+ * @brief validate_range_at
+ *  validate the range string at str, and set the next position to *next.
+ */
+static char *validate_range_at(validate_t *v, char *str, char **next)
+{
+    char *token = NULL;
+    char *err   = NULL;
+    int ntoken  = 0;
+
+    str = decode_skip_space(str, v->tail);
+    if (!*str) {
+        return str;
+    } else if (strncasecmp(str, "empty", 5) == 0) {
+        *next = decode_skip_space(str + 5, v->tail);
+        return NULL;
+    }
+
+    switch (*str) {
+    case '[':
+    case '(':
+        str   = decode_skip_space(str + 1, v->tail);
+        token = str;
+        break;
+    default:
+        return str;
+    }
+
+NEXT_CHAR:
+    switch (*str) {
+    case 0:
+        return str;
+
+    case '{':
+    case '(':
+    case '[':
+    case '<':
+        // skip the nested brackets
+        str = decode_skip_delim(str + 1, v->tail,
+                                BRACKETS[(unsigned char)*str], *str, 1);
+        if (!str) {
+            return v->tail;
+        }
+        goto NEXT_CHAR;
+
+    default:
+        str++;
+        goto NEXT_CHAR;
+
+    case ',':
+        if (ntoken) {
+            return str;
+        }
+        break;
+
+    case ']':
+    case ')':
+        if (!ntoken) {
+            return str;
+        }
+        break;
+    }
+
+    ntoken++;
+    if (str > token && (err = validate_elem(v, token, str - token))) {
+        return err;
+    }
+    str = decode_skip_space(str + 1, v->tail);
+    if (ntoken < 2) {
+        token = str;
+        goto NEXT_CHAR;
+    }
+    *next = str;
+    return NULL;
+}
+
+static char *validate_range(validate_t *v, char *str)
+{
+    char *err = validate_range_at(v, str, &str);
+
+    if (err) {
+        return err;
+    }
+    VALIDATE_END(str);
+}
+
+static char *validate_multirange(validate_t *v, char *str)
+{
+    char *err = NULL;
+
+    str = decode_skip_space(str, v->tail);
+    VALIDATE_CHAR(str, '{');
+    str = decode_skip_space(str, v->tail);
+    if (*str == '}') {
+        // empty multirange
+        VALIDATE_END(decode_skip_space(str + 1, v->tail));
+    }
+
+NEXT_RANGE:
+    if ((err = validate_range_at(v, str, &str))) {
+        return err;
+    }
+    switch (*str) {
+    case ',':
+        str++;
+        goto NEXT_RANGE;
+    case '}':
+        break;
+    default:
+        return str;
+    }
+    VALIDATE_END(decode_skip_space(str + 1, v->tail));
+}
+
+#undef VALIDATE_DIGIT
+#undef VALIDATE_FIXDIGIT
+#undef VALIDATE_CHAR
+#undef VALIDATE_SKIP_DELIM
+#undef VALIDATE_DBL
+#undef VALIDATE_POINT
+#undef VALIDATE_END
+
+static const validate_type_t VALIDATE_TYPES[] = {
+    {"array",      validate_array,      1},
+    {"bit",        validate_bit,        0},
+    {"bool",       validate_bool,       0},
+    {"box",        validate_box,        0},
+    {"bytea",      validate_bytea,      0},
+    {"circle",     validate_circle,     0},
+    {"date",       validate_date,       0},
+    {"float",      validate_float,      0},
+    {"hstore",     validate_hstore,     0},
+    {"int",        validate_int,        0},
+    {"line",       validate_line,       0},
+    {"lseg",       validate_lseg,       0},
+    {"multirange", validate_multirange, 1},
+    {"path",       validate_path,       0},
+    {"point",      validate_point,      0},
+    {"polygon",    validate_polygon,    0},
+    {"range",      validate_range,      1},
+    {"time",       validate_time,       0},
+    {"timestamp",  validate_timestamp,  0},
+    {"tsvector",   validate_tsvector,   0},
+    {NULL,         NULL,                0},
+};
+
+static const validate_type_t *validate_checktype(lua_State *L, int idx)
+{
+    const char *name = luaL_checkstring(L, idx);
+    int i            = 0;
+
+    for (; VALIDATE_TYPES[i].name; i++) {
+        if (strcmp(name, VALIDATE_TYPES[i].name) == 0) {
+            return &VALIDATE_TYPES[i];
+        }
+    }
+    luaL_argerror(L, idx, lua_pushfstring(L, "unknown type name '%s'", name));
+    return NULL;
+}
+
+static int validate_lua(lua_State *L)
+{
+    static const char *op    = "postgres.decode.validate";
+    const validate_type_t *t = validate_checktype(L, 1);
+    size_t len               = 0;
+    char *str                = (char *)lauxh_checklstring(L, 2, &len);
+    size_t delim_len         = 0;
+    const char *delim        = lauxh_optlstring(L, 4, ",", &delim_len);
+    validate_t v             = {0};
+    char *err                = NULL;
+
+    if (!lua_isnoneornil(L, 3)) {
+        v.elem = validate_checktype(L, 3);
+        luaL_argcheck(L, t->is_container, 3,
+                      "element type is only available for container types");
+        luaL_argcheck(L, !v.elem->is_container, 3,
+                      "element type must not be a container type");
+    }
+    luaL_argcheck(L, delim_len == 1, 4, "delimiter must be a single character");
+    v.delim = *delim;
+    v.tail  = str + len;
+
+    if (!len) {
+        // empty string is not allowed
+        err = str;
+    } else if ((err = t->fn(&v, str)) && v.err) {
+        return decode_error(L, op, v.err, NULL);
+    }
+
+    lua_settop(L, 0);
+    if (!err) {
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+    lua_pushboolean(L, 0);
+    lua_pushinteger(L, err - str + 1);
+    return 2;
+}
+
+LUALIB_API int luaopen_postgres_decode_validate(lua_State *L)
+{
+    lua_errno_loadlib(L);
+    lua_pushcfunction(L, validate_lua);
+    DECODE_STATS_WRAP(L, "postgres.decode.validate", NULL);
+    return 1;
+}
@@ -181,3 +181,136 @@ function testcase.illegal_character_error()
     assert.is_nil(v)
     assert.match(err, "'}' at position 4")
 end
+
+function testcase.destination_table()
+    local decode_int = require('postgres.decode.int')
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_array('{{1,2,3},{4,5},{6}}', decode_int, nil, nil,
+                                dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        {
+            1,
+            2,
+            3,
+        },
+        {
+            4,
+            5,
+        },
+        {
+            6,
+        },
+    })
+
+    -- test that the nested tables are reused and the rest are removed
+    local nested = dst[1]
+    v, err = decode_array('{{7},NULL}', decode_int, nil, nil, dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v[1], nested)
+    assert.equal(v, {
+        {
+            7,
+        },
+    })
+
+    -- test that the destination is ignored if it is not a table
+    v, err = decode_array('{1}', decode_int, nil, nil, 'foo')
+    assert.is_nil(err)
+    assert.equal(v, {
+        1,
+    })
+end
+
+function testcase.syntax_error_before_callback()
+    -- test that the syntax error is reported without calling the decoder
+    local ncall = 0
+    local dst = {
+        'foo',
+    }
+    local v, err = decode_array('{1,{2,3},4', function(elmstr)
+        ncall = ncall + 1
+        return elmstr
+    end, nil, nil, dst)
+    assert.is_nil(v)
+    assert.match(err, 'malformed array string')
+    assert.equal(ncall, 0)
+    assert.equal(dst, {
+        'foo',
+    })
+end
+
+function testcase.reentrant_decoder()
+    -- test that the decoder can be called from the decoder function
+    local decode_int = require('postgres.decode.int')
+    local v, err = decode_array('{a,{b},c}', function()
+        return assert(decode_array('{{1},2}', decode_int))
+    end)
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            {
+                1,
+            },
+            2,
+        },
+        {
+            {
+                {
+                    1,
+                },
+                2,
+            },
+        },
+        {
+            {
+                1,
+            },
+            2,
+        },
+    })
+end
+
+function testcase.reentrant_decoder_after_error()
+    -- test that the decoder can be called after the decoder function raised
+    -- an error, and from the decoder function again
+    local decode_int = require('postgres.decode.int')
+    local ok, err = pcall(decode_array, '{a,{b}}', function()
+        error('raised')
+    end)
+    assert.is_false(ok)
+    assert.match(err, 'raised')
+
+    local v = assert(decode_array('{1,{2,3}}', decode_int))
+    assert.equal(v, {
+        1,
+        {
+            2,
+            3,
+        },
+    })
+
+    v = assert(decode_array('{a,b}', function()
+        return assert(decode_array('{{1},2}', decode_int))
+    end))
+    assert.equal(v, {
+        {
+            {
+                1,
+            },
+            2,
+        },
+        {
+            {
+                1,
+            },
+            2,
+        },
+    })
+end
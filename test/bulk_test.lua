@@ -0,0 +1,117 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_bulk = require('postgres.decode.bulk')
+local decode_timestamp = require('postgres.decode.timestamp')
+
+function testcase.bulk()
+    -- test that the strings are decoded by each decoder
+    local v, err = decode_bulk('int', {
+        '1',
+        '-2',
+        false,
+        '+3',
+    })
+    assert.is_nil(err)
+    assert.equal(v, {
+        1,
+        -2,
+        nil,
+        3,
+    })
+
+    v, err = decode_bulk('timestamp', {
+        '2020-01-02 03:04:05.5+09:30',
+        '2020-01-02 03:04:05',
+    })
+    assert.is_nil(err)
+    assert.equal(v, {
+        decode_timestamp('2020-01-02 03:04:05.5+09:30'),
+        decode_timestamp('2020-01-02 03:04:05'),
+    })
+
+    v, err = decode_bulk('box', {
+        '(1,2),(3,4)',
+    })
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            {
+                1,
+                2,
+            },
+            {
+                3,
+                4,
+            },
+        },
+    })
+
+    -- test that the same values are returned by any number of threads
+    local strs = {}
+    local exp = {}
+    for i = 1, 100000 do
+        strs[i] = tostring(i * 7)
+        exp[i] = i * 7
+    end
+    for _, nthread in ipairs({
+        1,
+        4,
+    }) do
+        v, err = decode_bulk('int', strs, nthread)
+        assert.is_nil(err)
+        assert.equal(v, exp)
+    end
+
+    -- test that the first invalid string is reported with its row
+    strs[90000] = '1x'
+    strs[70000] = '2x'
+    v, err = decode_bulk('int', strs, 4)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'at position 2 of row 70000')
+
+    -- test that the destination table is reused
+    local dst = {
+        {
+            foo = 'bar',
+        },
+        'baz',
+        'qux',
+    }
+    local row = dst[1]
+    v = assert(decode_bulk('point', {
+        '(1,2)',
+    }, nil, dst))
+    assert.equal(v, dst)
+    assert.equal(v[1], row)
+    assert.equal(v, {
+        {
+            1,
+            2,
+        },
+    })
+
+    -- test that the rows after the nil holes are decoded if n is specified
+    strs = {}
+    strs[1] = '1'
+    strs[4] = '4'
+    v = assert(decode_bulk('int', strs, nil, nil, 4))
+    assert.equal(v, {
+        1,
+        nil,
+        nil,
+        4,
+    })
+    v = assert(decode_bulk('int', strs, nil, nil, 0))
+    assert.equal(v, {})
+
+    -- test that throws an error if the arguments are invalid
+    err = assert.throws(decode_bulk, 'int', {}, nil, nil, -1)
+    assert.match(err, 'n must be between 0 and INT_MAX')
+    err = assert.throws(decode_bulk, 'json', {})
+    assert.match(err, 'invalid option')
+    err = assert.throws(decode_bulk, 'int', {}, 0)
+    assert.match(err, 'nthread must be greater than 0')
+    err = assert.throws(decode_bulk, 'int', dst, nil, dst)
+    assert.match(err, 'dst must not be the same table')
+end
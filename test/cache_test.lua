@@ -0,0 +1,149 @@
+local testcase = require('testcase')
+local decode_cache = require('postgres.decode.cache')
+local decode_date = require('postgres.decode.date')
+local decode = require('postgres.decode')
+
+function testcase.cache()
+    local ncall = 0
+    local c = decode_cache(function(str)
+        ncall = ncall + 1
+        return decode_date(str)
+    end, 2)
+
+    -- test that the decoded value is cached and shared
+    local v1 = assert(c('2020-01-02'))
+    local v2 = assert(c:decode('2020-01-02'))
+    assert.equal(v1, {
+        year = 2020,
+        month = 1,
+        day = 2,
+    })
+    assert.equal(ncall, 1)
+    assert.rawequal(v1, v2)
+
+    -- test that the least recently used value is evicted
+    assert(c('2020-01-03'))
+    assert(c('2020-01-02'))
+    assert(c('2020-01-04'))
+    assert.equal(ncall, 3)
+    assert(c('2020-01-02'))
+    assert.equal(ncall, 3)
+    assert(c('2020-01-03'))
+    assert.equal(ncall, 4)
+
+    -- test that the error is not cached
+    local v, err = c('2020-01-0x')
+    assert.is_nil(v)
+    assert.match(err, "'x' at position 10")
+    v, err = c('2020-01-0x')
+    assert.is_nil(v)
+    assert.match(err, "'x' at position 10")
+    assert.equal(ncall, 6)
+
+    -- test that return the counters
+    assert.equal(c:stats(true), {
+        hits = 3,
+        misses = 6,
+        len = 2,
+        size = 2,
+    })
+    assert.equal(c:stats(), {
+        hits = 0,
+        misses = 0,
+        len = 2,
+        size = 2,
+    })
+
+    -- test that remove all cached values
+    c:clear()
+    assert.equal(c:stats().len, 0)
+    assert(c('2020-01-02'))
+    assert.equal(ncall, 7)
+
+    -- test that throws an error if invalid argument
+    err = assert.throws(decode_cache, 'date', 0)
+    assert.match(err, 'size out of range')
+    err = assert.throws(decode_cache, 'foo', 1)
+    assert.match(err, 'unknown decoder name')
+    err = assert.throws(decode_cache, {}, 1)
+    assert.match(err, 'function expected')
+end
+
+function testcase.extra_arguments()
+    local args
+    local c = decode_cache(function(...)
+        args = {
+            ...,
+        }
+        return decode_date((...))
+    end, 4)
+
+    -- test that the value is not cached if the extra arguments are passed
+    local ctx = {}
+    local v1 = assert(c('2020-01-02', false, ctx))
+    assert.equal(args, {
+        '2020-01-02',
+        false,
+        ctx,
+    })
+    local v2 = assert(c('2020-01-02', true, ctx))
+    assert.not_rawequal(v1, v2)
+    assert.equal(c:stats(), {
+        hits = 0,
+        misses = 0,
+        len = 0,
+        size = 4,
+    })
+
+    -- test that the trailing nil arguments are ignored
+    v1 = assert(c('2020-01-02', nil))
+    assert.equal(args, {
+        '2020-01-02',
+    })
+    v2 = assert(c('2020-01-02'))
+    assert.rawequal(v1, v2)
+
+    -- test that the destination table is never cached
+    c = decode_cache('time', 4)
+    local dst = {}
+    v1 = assert(c('01:02:03', dst))
+    assert.rawequal(v1, dst)
+    v2 = assert(c('01:02:03'))
+    assert.not_rawequal(v2, dst)
+    assert(c('04:05:06', dst))
+    assert.equal(c('01:02:03'), {
+        hour = 1,
+        min = 2,
+        sec = 3,
+        usec = 0,
+    })
+end
+
+function testcase.readonly()
+    local c = decode_cache('box', 4, true)
+
+    -- test that the cached table is read-only
+    local v = assert(c('(1,2),(3,4)'))
+    assert.equal(v[1][1], 1)
+    assert.equal(v[2][2], 4)
+    local err = assert.throws(function()
+        v[1] = 'foo'
+    end)
+    assert.match(err, 'read-only')
+    err = assert.throws(function()
+        v[1][1] = 'foo'
+    end)
+    assert.match(err, 'read-only')
+end
+
+function testcase.register()
+    local c = decode_cache('date', 4)
+
+    -- test that the cache is registered as the decoder of the type
+    assert(decode.register(1082, c, 1182))
+    local v, err = decode.decode(1182, '{2020-01-02,2020-01-02}')
+    assert.is_nil(err)
+    assert.rawequal(v[1], v[2])
+    assert.equal(c:stats().hits, 1)
+    assert(decode.register(1082, 'date', 1182))
+end
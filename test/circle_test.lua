@@ -11,3 +11,28 @@ function testcase.circle()
     })
 end
 
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_circle('<(1,2),3>', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        1,
+        2,
+        3,
+    })
+
+    -- test that the fields of the previous value are replaced
+    v, err = decode_circle('<(4,5),6>', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        4,
+        5,
+        6,
+    })
+end
@@ -0,0 +1,203 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_copy_binary = require('postgres.decode.copy_binary')
+
+local function int16(v)
+    if v < 0 then
+        v = v + 0x10000
+    end
+    return string.char(math.floor(v / 0x100), v % 0x100)
+end
+
+local function int32(v)
+    if v < 0 then
+        v = v + 0x100000000
+    end
+    return string.char(math.floor(v / 0x1000000) % 0x100,
+                       math.floor(v / 0x10000) % 0x100,
+                       math.floor(v / 0x100) % 0x100, v % 0x100)
+end
+
+local function field(v)
+    if v == nil then
+        return int32(-1)
+    end
+    return int32(#v) .. v
+end
+
+local HEADER = 'PGCOPY\n\255\r\n\0' .. int32(0) .. int32(2) .. 'xx'
+local TRAILER = int16(-1)
+
+local function tuple(...)
+    local fields = {
+        int16(select('#', ...)),
+    }
+    for i = 1, select('#', ...) do
+        fields[#fields + 1] = field((select(i, ...)))
+    end
+    return table.concat(fields)
+end
+
+function testcase.feed()
+    local data = HEADER .. tuple('\1', int16(-5), int32(-70000),
+                                 int32(0) .. int32(42), '\63\192\0\0',
+                                 '\192\2\0\0\0\0\0\0', int32(8634),
+                                 int32(0) .. int32(1000000), nil, 'foo') ..
+                     tuple('\0', nil, int32(1), int32(-1) .. int32(-1)) ..
+                     TRAILER
+
+    -- test that decode rows from the chunks of any size
+    for _, size in ipairs({
+        1,
+        7,
+        #data,
+    }) do
+        local c = decode_copy_binary({
+            'bool',
+            'int2',
+            'int4',
+            'int8',
+            'float4',
+            'float8',
+            'date',
+            'time',
+        })
+        assert.match(tostring(c), '^postgres%.decode%.copy_binary: ', false)
+
+        local rows = {}
+        for i = 1, #data, size do
+            local res, err = c:feed(string.sub(data, i, i + size - 1))
+            assert.is_nil(err)
+            for _, row in ipairs(res) do
+                rows[#rows + 1] = row
+            end
+        end
+        assert.equal(rows, {
+            {
+                true,
+                -5,
+                -70000,
+                42,
+                1.5,
+                -2.25,
+                {
+                    year = 2023,
+                    month = 8,
+                    day = 22,
+                },
+                {
+                    hour = 0,
+                    min = 0,
+                    sec = 1,
+                    usec = 0,
+                },
+                nil,
+                'foo',
+            },
+            {
+                false,
+                nil,
+                1,
+                -1,
+            },
+        })
+        assert.equal(c:finish(), {})
+
+        -- test that data after file trailer error
+        local res, err = c:feed('foo')
+        assert.is_nil(res)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, 'after file trailer')
+    end
+end
+
+function testcase.decoders()
+    -- test that decode fields by the decoder functions
+    local c = decode_copy_binary({
+        'timestamptz',
+        'jsonb',
+        function(v, ctx)
+            assert.equal(ctx, 'context')
+            return string.upper(v)
+        end,
+    }, 'context')
+    local rows, err = c:feed(HEADER ..
+                                 tuple(int32(0) .. int32(0), '\1{"a":1}',
+                                       'foo') .. TRAILER)
+    assert.is_nil(err)
+    assert.equal(rows, {
+        {
+            {
+                year = 2000,
+                month = 1,
+                day = 1,
+                hour = 0,
+                min = 0,
+                sec = 0,
+                usec = 0,
+                tz = '+',
+                tzhour = 0,
+                tzmin = 0,
+                tzsec = 0,
+            },
+            '{"a":1}',
+            'FOO',
+        },
+    })
+
+    -- test that the decoders after the nil holes are used if ncol is
+    -- specified
+    local decoders = {}
+    decoders[3] = 'int4'
+    c = decode_copy_binary(decoders, nil, 3)
+    rows, err = c:feed(HEADER .. tuple('foo', nil, int32(-2)) .. TRAILER)
+    assert.is_nil(err)
+    assert.equal(rows, {
+        {
+            'foo',
+            nil,
+            -2,
+        },
+    })
+
+    -- test that throws an error if ncol is out of range
+    err = assert.throws(decode_copy_binary, decoders, nil, -1)
+    assert.match(err, 'ncol must be between 0 and 32767')
+
+    -- test that throws an error if unknown decoder name
+    err = assert.throws(decode_copy_binary, {
+        'unknown',
+    })
+    assert.match(err, "unknown decoder name 'unknown'")
+end
+
+function testcase.error()
+    -- test that invalid signature error
+    local c = decode_copy_binary()
+    local rows, err = c:feed('PGCOPY\nxxxxxxxxxxxxxxxxxxxxxxx')
+    assert.is_nil(rows)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'invalid signature')
+
+    -- test that cannot decode data after an error
+    rows, err = c:feed(TRAILER)
+    assert.is_nil(rows)
+    assert.equal(err.type, errno.EINVAL)
+
+    -- test that invalid field length error
+    c = decode_copy_binary({
+        'int4',
+    })
+    rows, err = c:feed(HEADER .. tuple(int16(1)))
+    assert.is_nil(rows)
+    assert.match(err, 'invalid field length 2 of column #1 at row 1')
+
+    -- test that unexpected end error
+    c = decode_copy_binary()
+    rows, err = c:feed(HEADER .. string.sub(tuple('foo'), 1, 4))
+    assert.is_nil(err)
+    assert.equal(rows, {})
+    rows, err = c:finish()
+    assert.is_nil(rows)
+    assert.match(err, 'unexpected end of binary copy data')
+end
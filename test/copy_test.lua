@@ -0,0 +1,127 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_copy = require('postgres.decode.copy')
+
+local DATA = table.concat({
+    '1\tfoo\\tbar\tbaz',
+    '2\t\\N\tx\\\\y\\101\\x41',
+    '3\t\t',
+    '\\.',
+    '',
+}, '\n')
+
+function testcase.feed()
+    -- test that decode rows from the chunks of any size
+    for _, size in ipairs({
+        1,
+        3,
+        #DATA,
+    }) do
+        local c = decode_copy({
+            'int',
+            nil,
+            function(fieldstr, is_quoted, ctx)
+                assert.is_false(is_quoted)
+                assert.equal(ctx, 'context')
+                return string.upper(fieldstr)
+            end,
+        }, 'context')
+        assert.match(tostring(c), '^postgres%.decode%.copy: ', false)
+
+        local rows = {}
+        for i = 1, #DATA, size do
+            local res, err = c:feed(string.sub(DATA, i, i + size - 1))
+            assert.is_nil(err)
+            for _, row in ipairs(res) do
+                rows[#rows + 1] = row
+            end
+        end
+        assert.equal(rows, {
+            {
+                1,
+                'foo\tbar',
+                'BAZ',
+            },
+            {
+                2,
+                nil,
+                'X\\YAA',
+            },
+            {
+                3,
+                '',
+                '',
+            },
+        })
+        assert.equal(c:finish(), {})
+
+        -- test that data after end-of-data marker error
+        local res, err = c:feed('4\tfoo\n')
+        assert.is_nil(res)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, 'after end-of-data marker')
+    end
+end
+
+function testcase.finish()
+    -- test that finish decodes the row that is not terminated by a newline
+    local c = decode_copy()
+    local rows, err = c:feed('a\tb\nc\td')
+    assert.is_nil(err)
+    assert.equal(rows, {
+        {
+            'a',
+            'b',
+        },
+    })
+    rows, err = c:finish()
+    assert.is_nil(err)
+    assert.equal(rows, {
+        {
+            'c',
+            'd',
+        },
+    })
+end
+
+function testcase.delimiter()
+    -- test that decode rows with the custom delimiter
+    local c = decode_copy(nil, nil, ',')
+    local rows, err = c:feed('a,b\\,c,\\N\n')
+    assert.is_nil(err)
+    assert.equal(rows, {
+        {
+            'a',
+            'b,c',
+        },
+    })
+
+    -- test that invalid delimiter error
+    for _, delim in ipairs({
+        '',
+        ',,',
+        '\\',
+        '\n',
+    }) do
+        c, err = decode_copy(nil, nil, delim)
+        assert.is_nil(c)
+        assert.equal(err.type, errno.EINVAL)
+    end
+end
+
+function testcase.error()
+    -- test that pass through the error of built-in decoder
+    local c = decode_copy({
+        'int',
+    })
+    local rows, err = c:feed('1\nfoo\n')
+    assert.is_nil(rows)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'postgres.decode.int')
+
+    -- test that throws an error if unknown decoder name
+    err = assert.throws(decode_copy, {
+        'unknown',
+    })
+    assert.match(err, "unknown decoder name 'unknown'")
+end
@@ -0,0 +1,98 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_copyfile = require('postgres.decode.copyfile')
+
+local PATHNAME = os.tmpname()
+
+local function writefile(data)
+    local f = assert(io.open(PATHNAME, 'w'))
+    f:write(data)
+    f:close()
+end
+
+function testcase.after_all()
+    os.remove(PATHNAME)
+end
+
+function testcase.copyfile()
+    writefile(table.concat({
+        '1\tfoo\\tbar\tbaz',
+        '2\t\\N\tx\\\\y',
+        '3\t\t',
+        '\\.',
+        'ignored',
+    }, '\n'))
+
+    -- test that read rows of the copy file
+    local f, err = decode_copyfile(PATHNAME, {
+        'int',
+    })
+    assert.is_nil(err)
+    assert.match(tostring(f), '^postgres%.decode%.copyfile: ', false)
+    assert.equal(f:nrow(), 3)
+    assert.equal(f:nfield(1), 3)
+    assert.equal(f:nfield(4), 0)
+    assert.equal(f:row(1), {
+        1,
+        'foo\tbar',
+        'baz',
+    })
+    assert.equal(f:row(2), {
+        2,
+        nil,
+        'x\\y',
+    })
+    assert.equal(f:row(3), {
+        3,
+        '',
+        '',
+    })
+    assert.is_nil(f:row(4))
+
+    -- test that read fields of the copy file
+    assert.equal(f:field(1, 2), 'foo\tbar')
+    assert.equal(f:field(3, 1), 3)
+    assert.is_nil(f:field(2, 2))
+    assert.is_nil(f:field(2, 4))
+
+    -- test that throws an error after close
+    f:close()
+    err = assert.throws(f.nrow, f)
+    assert.match(err, 'closed')
+end
+
+function testcase.delimiter()
+    -- test that read rows with the custom delimiter
+    writefile('a,b\\,c\nd,e')
+    local f, err = decode_copyfile(PATHNAME, nil, nil, ',')
+    assert.is_nil(err)
+    assert.equal(f:nrow(), 2)
+    assert.equal(f:row(1), {
+        'a',
+        'b,c',
+    })
+    assert.equal(f:row(2), {
+        'd',
+        'e',
+    })
+    f:close()
+end
+
+function testcase.error()
+    -- test that file not found error
+    local f, err = decode_copyfile('/nonexistent/file')
+    assert.is_nil(f)
+    assert.equal(err.type, errno.ENOENT)
+
+    -- test that pass through the error of built-in decoder
+    writefile('foo\n')
+    f = assert(decode_copyfile(PATHNAME, {
+        'int',
+    }))
+    local v
+    v, err = f:field(1, 1)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'postgres.decode.int')
+    f:close()
+end
@@ -127,3 +127,26 @@ function testcase.date_postgres()
     assert.is_nil(err)
 end
 
+function testcase.date_callback()
+    local decode_array = require('postgres.decode.array')
+    local ctx = {}
+
+    -- test that the context object passed to the element decoder is not used
+    -- as the result table
+    local v, err = decode_array('{2020-01-02,2020-01-03}', decode_date, ctx)
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            year = 2020,
+            month = 1,
+            day = 2,
+        },
+        {
+            year = 2020,
+            month = 1,
+            day = 3,
+        },
+    })
+    assert.not_rawequal(v[1], ctx)
+    assert.equal(ctx, {})
+end
@@ -0,0 +1,553 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode = require('postgres.decode')
+
+function testcase.decode()
+    -- test that decode value by the built-in type oid
+    for _, v in ipairs({
+        {
+            oid = 16,
+            str = 't',
+            exp = true,
+        },
+        {
+            oid = 23,
+            str = '42',
+            exp = 42,
+        },
+        {
+            oid = 25,
+            str = 'foo',
+            exp = 'foo',
+        },
+        {
+            oid = 1007,
+            str = '{1,NULL,{2,3}}',
+            exp = {
+                1,
+                nil,
+                {
+                    2,
+                    3,
+                },
+            },
+        },
+        {
+            oid = 1009,
+            str = '{foo,"bar \\"baz\\"",NULL,"NULL"}',
+            exp = {
+                'foo',
+                'bar "baz"',
+                nil,
+                'NULL',
+            },
+        },
+        {
+            oid = 1020,
+            str = '{(1,2),(3,4);(5,6),(7,8)}',
+            exp = {
+                {
+                    {
+                        1,
+                        2,
+                    },
+                    {
+                        3,
+                        4,
+                    },
+                },
+                {
+                    {
+                        5,
+                        6,
+                    },
+                    {
+                        7,
+                        8,
+                    },
+                },
+            },
+        },
+        {
+            oid = 3904,
+            str = '[1,10)',
+            exp = {
+                1,
+                10,
+                lower_inc = true,
+            },
+        },
+        {
+            oid = 3905,
+            str = '{"[1,10)",empty}',
+            exp = {
+                {
+                    1,
+                    10,
+                    lower_inc = true,
+                },
+                {},
+            },
+        },
+        {
+            oid = 4451,
+            str = '{[1,3),[5,7]}',
+            exp = {
+                {
+                    1,
+                    3,
+                    lower_inc = true,
+                },
+                {
+                    5,
+                    7,
+                    lower_inc = true,
+                    upper_inc = true,
+                },
+            },
+        },
+        {
+            oid = 4451,
+            str = '{}',
+            exp = {},
+        },
+        {
+            oid = 6150,
+            str = '{"{[1,3)}",NULL,"{[5,7)}"}',
+            exp = {
+                {
+                    {
+                        1,
+                        3,
+                        lower_inc = true,
+                    },
+                },
+                nil,
+                {
+                    {
+                        5,
+                        7,
+                        lower_inc = true,
+                    },
+                },
+            },
+        },
+        -- unknown type oid
+        {
+            oid = 99999,
+            str = 'foo',
+            exp = 'foo',
+        },
+    }) do
+        local res, err = decode.decode(v.oid, v.str)
+        assert.is_nil(err)
+        assert.equal(res, v.exp)
+    end
+
+    -- test that return error of the built-in decoder
+    local res, err = decode.decode(23, 'foo')
+    assert.is_nil(res)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'postgres.decode.int')
+
+    -- test that return error of the element decoder
+    res, err = decode.decode(1007, '{1,foo}')
+    assert.is_nil(res)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'postgres.decode.int')
+
+    -- test that throws an error if invalid argument
+    err = assert.throws(decode.decode, 'foo', 'bar')
+    assert.match(err, 'number expected')
+    err = assert.throws(decode.decode, 23)
+    assert.match(err, 'string expected')
+end
+
+function testcase.decode_destination_table()
+    local dst = {}
+
+    -- test that decode into the destination table
+    local v, err = decode.decode(1083, '01:02:03.5', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        hour = 1,
+        min = 2,
+        sec = 3,
+        usec = 500000,
+    })
+
+    -- test that the destination table is passed to the array decoder
+    v, err = decode.decode(1007, '{1,{2}}', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        1,
+        {
+            2,
+        },
+    })
+
+    -- test that the destination table is ignored by the scalar decoder
+    v, err = decode.decode(23, '123', dst)
+    assert.is_nil(err)
+    assert.equal(v, 123)
+
+    -- test that the destination table is ignored by the date decoder
+    v, err = decode.decode(1082, '1999-01-08', dst)
+    assert.is_nil(err)
+    assert.not_rawequal(v, dst)
+    assert.equal(v, {
+        year = 1999,
+        month = 1,
+        day = 8,
+    })
+end
+
+function testcase.decode_first_call()
+    local function new_decode()
+        -- create a new registry that has no resolved decoders
+        package.loaded['postgres.decode'] = nil
+        local m = require('postgres.decode')
+        package.loaded['postgres.decode'] = decode
+        return m
+    end
+
+    -- test that the decoders that keep their state in the upvalues decode
+    -- the value at the first call of the registry
+    assert.equal(new_decode().decode(3614, "'a' 'b':1"), {
+        {
+            lexeme = 'a',
+        },
+        {
+            lexeme = 'b',
+            positions = {
+                1,
+            },
+        },
+    })
+    assert.equal(new_decode().decode(602, '[(1,2),(3,4)]'), {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+    })
+    assert.equal(new_decode().decode(604, '((1,2),(3,4))'), {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+    })
+    local m = new_decode()
+    assert.is_true(m.register(16384, 'hstore'))
+    assert.equal(m.decode(16384, '"a"=>"1"'), {
+        a = '1',
+    })
+    -- test that the decoders still work after the other decoders are resolved
+    assert.equal(m.decode(3614, "'c'"), {
+        {
+            lexeme = 'c',
+        },
+    })
+    assert.equal(m.decode(1007, '{1,{2}}'), {
+        1,
+        {
+            2,
+        },
+    })
+end
+
+function testcase.register()
+    -- test that register built-in decoder by name with array type oid
+    assert.equal(decode.decode(16384, '"a"=>"1"'), '"a"=>"1"')
+    assert.is_true(decode.register(16384, 'hstore', 16390))
+    assert.equal(decode.decode(16384, '"a"=>"1"'), {
+        a = '1',
+    })
+    assert.equal(decode.decode(16390, '{"\\"a\\"=>\\"1\\"",NULL}'), {
+        {
+            a = '1',
+        },
+    })
+
+    -- test that register decoder function
+    assert.is_true(decode.register(16400, function(str)
+        return string.upper(str)
+    end, 16401))
+    assert.equal(decode.decode(16400, 'foo'), 'FOO')
+    assert.equal(decode.decode(16401, '{foo,"bar baz"}'), {
+        'FOO',
+        'BAR BAZ',
+    })
+
+    -- test that register decoder as text
+    assert.is_true(decode.register(16400, 'text'))
+    assert.equal(decode.decode(16400, 'foo'), 'foo')
+
+    -- test that throws an error if invalid argument
+    local err = assert.throws(decode.register, 0, 'int')
+    assert.match(err, 'oid out of range')
+    err = assert.throws(decode.register, 16400, 'unknown')
+    assert.match(err, "unknown decoder name 'unknown'")
+    err = assert.throws(decode.register, 16400, {})
+    assert.match(err, 'string or function expected')
+    err = assert.throws(decode.register, 16400, 'int', 16400)
+    assert.match(err, 'invalid array type oid')
+end
+
+function testcase.stats()
+    -- test that return the statistics table
+    local stats = decode.stats(true)
+    assert.is_table(stats)
+    if not next(stats) then
+        -- not built with POSTGRES_DECODE_STATS
+        return
+    end
+
+    -- test that count the calls and errors of the decoder
+    assert.equal(decode.decode(1007, '{1,2}'), {
+        1,
+        2,
+    })
+    assert.is_nil(decode.decode(23, 'foo'))
+    stats = decode.stats()
+    assert.equal(stats['postgres.decode'].calls, 2)
+    assert.equal(stats['postgres.decode'].errors, 1)
+    assert.equal(stats['postgres.decode.array'].calls, 1)
+    assert.equal(stats['postgres.decode.array'].tables, 1)
+    assert.equal(stats['postgres.decode.int'].calls, 3)
+    assert.equal(stats['postgres.decode.int'].bytes, 5)
+    assert.equal(stats['postgres.decode.int'].errors, 1)
+
+    -- test that reset the statistics
+    decode.stats(true)
+    assert.equal(decode.stats()['postgres.decode.int'].calls, 0)
+
+    -- test that count the requested bytes even if the garbage is collected
+    -- while the decoder is running
+    local decode_array = require('postgres.decode.array')
+    local v = decode_array('{' .. string.rep('1,', 999) .. '1}', function(s)
+        collectgarbage('collect')
+        return tonumber(s)
+    end)
+    assert.equal(#v, 1000)
+    stats = decode.stats()
+    assert.is_true(stats['postgres.decode.array'].alloc >= 1000 * 8)
+end
+
+function testcase.fastfail()
+    -- test that return the error number and position in the fast-fail mode
+    local v, err, pos = decode.fastfail(decode.decode, 23, '12x')
+    assert.is_nil(v)
+    assert.equal(err, errno.EILSEQ.code)
+    assert.equal(pos, 3)
+
+    -- test that the position is not returned if it is unknown
+    v, err, pos = decode.fastfail(decode.decode, 23, '')
+    assert.is_nil(v)
+    assert.equal(err, errno.EINVAL.code)
+    assert.is_nil(pos)
+
+    -- test that the error of the element decoder is returned as the error
+    -- number of the container decoder
+    v, err, pos = decode.fastfail(function(str)
+        return decode.decode(1007, str)
+    end, '{1,x}')
+    assert.is_nil(v)
+    assert.equal(err, errno.EILSEQ.code)
+    assert.is_nil(pos)
+
+    -- test that return the values of the function
+    v, err = decode.fastfail(decode.decode, 23, '12')
+    assert.equal(v, 12)
+    assert.is_nil(err)
+
+    -- test that return the error object outside of the fast-fail mode
+    v, err = decode.decode(23, '12x')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, "'x' at position 3")
+
+    -- test that the mode is restored even if the function throws an error
+    err = assert.throws(decode.fastfail, function()
+        error('foo')
+    end)
+    assert.match(err, 'foo')
+    v, err = decode.decode(23, '12x')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EILSEQ)
+
+    -- test that the nested call keeps the fast-fail mode
+    v, err = decode.fastfail(function()
+        decode.fastfail(decode.decode, 23, 'x')
+        return decode.decode(23, 'x')
+    end)
+    assert.is_nil(v)
+    assert.equal(err, errno.EILSEQ.code)
+
+    -- test that throws an error if the function is not callable
+    err = assert.throws(decode.fastfail, 'foo')
+    assert.match(err, 'function expected')
+end
+
+function testcase.yieldstep()
+    local decode_array = require('postgres.decode.array')
+    local decode_elem = function(elmstr)
+        return tonumber(elmstr)
+    end
+    -- yielding requires Lua 5.3 or later, and the decoders wrapped by the
+    -- statistics never yield
+    local yieldable = _VERSION >= 'Lua 5.3' and not next(decode.stats())
+
+    -- test that yielding is disabled by default
+    assert.equal(decode.yieldstep(), 0)
+
+    -- test that set the step size and return the previous one
+    assert.equal(decode.yieldstep(2), 0)
+    assert.equal(decode.yieldstep(), 2)
+
+    -- test that the decoder yields the running coroutine between the steps
+    local nyield = 0
+    local co = coroutine.create(function()
+        return decode_array('{1,{2,3},{},4,NULL,5}', decode_elem)
+    end)
+    local ok, v = coroutine.resume(co)
+    while coroutine.status(co) == 'suspended' do
+        nyield = nyield + 1
+        ok, v = coroutine.resume(co, 'ignored')
+    end
+    assert.is_true(ok)
+    assert.equal(v, {
+        1,
+        {
+            2,
+            3,
+        },
+        {},
+        4,
+        nil,
+        5,
+    })
+    assert.equal(nyield > 0, yieldable)
+
+    -- test that the decoder runs to completion outside of the coroutine
+    v = decode_array('{1,{2,3}}', decode_elem)
+    assert.equal(v, {
+        1,
+        {
+            2,
+            3,
+        },
+    })
+
+    -- test that the decoder called by decode.decode never yields
+    co = coroutine.create(function()
+        return decode.decode(1007, '{1,2,3,4,5}')
+    end)
+    ok, v = coroutine.resume(co)
+    assert.is_true(ok)
+    assert.equal(coroutine.status(co), 'dead')
+    assert.equal(v, {
+        1,
+        2,
+        3,
+        4,
+        5,
+    })
+
+    -- test that disable yielding
+    assert.equal(decode.yieldstep(0), 2)
+    co = coroutine.create(function()
+        return decode_array('{1,2,3,4,5}', decode_elem)
+    end)
+    ok = coroutine.resume(co)
+    assert.is_true(ok)
+    assert.equal(coroutine.status(co), 'dead')
+
+    -- test that throws an error if the step size is negative
+    local err = assert.throws(decode.yieldstep, -1)
+    assert.match(err, 'non-negative')
+end
+
+function testcase.limits()
+    local decode_array = require('postgres.decode.array')
+    local decode_int = require('postgres.decode.int')
+
+    -- test that no limits are set by default
+    assert.equal(decode.limits(), {})
+
+    -- test that set the limits and return the previous limits
+    assert.equal(decode.limits({
+        elements = 3,
+        length = 3,
+        depth = 2,
+    }), {})
+    assert.equal(decode.limits(), {
+        elements = 3,
+        length = 3,
+        depth = 2,
+    })
+
+    -- test that the value within the limits is decoded
+    local v, err = decode_array('{{1},2}', decode_int)
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            1,
+        },
+        2,
+    })
+
+    -- test that return E2BIG if the number of elements exceeds the limit
+    local dst = {}
+    v, err = decode_array('{1,2,3,4}', decode_int, nil, nil, dst)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'too many elements')
+    assert.equal(dst, {})
+
+    -- test that return E2BIG if the element string is too long
+    v, err = decode_array('{1234}', decode_int)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'element string too long')
+
+    -- test that return E2BIG if the nesting level is too deep
+    v, err = decode_array('{{{1}}}', decode_int)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'nesting level too deep')
+
+    -- test that return E2BIG if the estimated bytes exceeds the limit
+    decode.limits({
+        bytes = 256,
+    })
+    v, err = decode_array('{1,2,3,4,5,6,7,8,9,10}', decode_int)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'decoded value too large')
+
+    -- test that remove the limits
+    assert.equal(decode.limits(nil), {
+        bytes = 256,
+    })
+    assert.equal(decode.limits(), {})
+    v = assert(decode_array('{1,2,3,4,5,6,7,8,9,10}', decode_int))
+    assert.equal(#v, 10)
+
+    -- test that throws an error if the limit is invalid
+    err = assert.throws(decode.limits, {
+        depth = -1,
+    })
+    assert.match(err, 'depth must be a non-negative integer')
+    err = assert.throws(decode.limits, 'foo')
+    assert.match(err, 'table expected')
+end
@@ -0,0 +1,86 @@
+local testcase = require('testcase')
+local decode_dict = require('postgres.decode.dict')
+local decode_array = require('postgres.decode.array')
+local decode_hstore = require('postgres.decode.hstore')
+
+function testcase.dict()
+    local d = decode_dict()
+
+    -- test that the codes are assigned in the order of appearance
+    assert.equal(d:encode('foo'), 1)
+    assert.equal(d:encode('bar'), 2)
+    assert.equal(d:encode('foo'), 1)
+    assert.equal(d:encode(''), 3)
+    assert.equal(d:code('bar'), 2)
+    assert.is_nil(d:code('baz'))
+    assert.equal(d:len(), 3)
+    assert.equal(d:values(), {
+        'foo',
+        'bar',
+        '',
+    })
+
+    -- test that the codes are kept after the hash table grows
+    for i = 1, 1000 do
+        assert.equal(d:encode('str' .. i), 3 + i)
+    end
+    assert.equal(d:code('foo'), 1)
+    assert.equal(d:code('str1000'), 1003)
+    assert.equal(d:values()[1003], 'str1000')
+    assert.match(tostring(d), '^postgres%.decode%.dict: ')
+end
+
+function testcase.array()
+    local d = decode_dict()
+
+    -- test that the elements are decoded to the codes
+    local v, err = decode_array(
+                       '{open,closed,"open",NULL,"NULL",{"a\\"b",closed}}', d)
+    assert.is_nil(err)
+    assert.equal(v, {
+        1,
+        2,
+        1,
+        nil,
+        3,
+        {
+            4,
+            2,
+        },
+    })
+    assert.equal(d:values(), {
+        'open',
+        'closed',
+        'NULL',
+        'a"b',
+    })
+
+    -- test that the codes are shared across the calls
+    v = assert(decode_array('{x;open}', d, nil, ';'))
+    assert.equal(v, {
+        5,
+        1,
+    })
+
+    -- test that return an error if the array is malformed
+    v, err = decode_array('{open,,}', d)
+    assert.is_nil(v)
+    assert.match(err, 'empty elements')
+end
+
+function testcase.hstore()
+    local d = decode_dict()
+
+    -- test that the keys and values are decoded to the codes
+    local v, err = decode_hstore('"a"=>"foo", "b"=>NULL, "foo"=>"a"', nil, d)
+    assert.is_nil(err)
+    assert.equal(v, {
+        [1] = 2,
+        [2] = 1,
+    })
+    assert.equal(d:values(), {
+        'a',
+        'foo',
+        'b',
+    })
+end
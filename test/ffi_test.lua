@@ -0,0 +1,228 @@
+local testcase = require('testcase')
+local decode_ffi = require('postgres.decode.ffi')
+local decode_timestamp = require('postgres.decode.timestamp')
+local decode_range = require('postgres.decode.range')
+
+-- the FFI is available only on LuaJIT
+local has_ffi = pcall(require, 'ffi')
+
+function testcase.decoders()
+    -- test that return the same values as the decoders of the lua C API
+    for name, list in pairs({
+        int = {
+            '0',
+            '-9007199254740992',
+            '12x',
+            '',
+        },
+        float = {
+            '1.5',
+            '-1e308',
+            '1e999',
+            'x',
+        },
+        bool = {
+            't',
+            'f',
+            'tt',
+        },
+        date = {
+            '2020-01-02',
+            '02/01/2020',
+            '2020-13-02',
+        },
+        time = {
+            '01:02:03.5+09:30',
+            '24:00:01',
+        },
+        timestamp = {
+            '2020-01-02 03:04:05',
+            '2020-01-02 03:04:05.123456-08',
+            '2020-01-02T03:04:05',
+        },
+        point = {
+            '(1.5,2)',
+            '(1,2',
+        },
+        line = {
+            '{1,2,3}',
+            '{1,2}',
+        },
+        lseg = {
+            '[(1,2),(3,4)]',
+            '[(1,2),(3,4)',
+        },
+        box = {
+            '(1,2),(3,4)',
+            '(1,2)',
+        },
+        circle = {
+            '<(1,2),3>',
+            '<(1,2),3',
+        },
+    }) do
+        local decode = require('postgres.decode.' .. name)
+        for _, str in ipairs(list) do
+            local v, err = decode_ffi[name](str)
+            local exp, experr = decode(str)
+            assert.equal(v, exp)
+            assert.equal(tostring(err), tostring(experr))
+        end
+    end
+
+    -- test that the destination table is reused
+    local dst = {
+        foo = 'bar',
+    }
+    local v = assert(decode_ffi.timestamp('2020-01-02 03:04:05', dst))
+    assert.rawequal(v, dst)
+    assert.equal(v, decode_timestamp('2020-01-02 03:04:05'))
+
+    -- test that throws an error if invalid argument
+    local err = assert.throws(decode_ffi.int, {})
+    assert.match(err, 'string expected')
+end
+
+function testcase.range()
+    local fn = function(str, is_quoted, ctx)
+        return str .. tostring(is_quoted) .. tostring(ctx)
+    end
+
+    -- test that return the same values as the decoder of the lua C API
+    for _, str in ipairs({
+        '[1,10)',
+        ' (1, 2] ',
+        '[,2]',
+        '["a b",]',
+        'empty',
+        '[1,2',
+        '[1,2)x',
+        '',
+    }) do
+        local v, err = decode_ffi.range(str, fn, 'ctx')
+        local exp, experr = decode_range(str, fn, 'ctx')
+        assert.equal(v, exp)
+        assert.equal(tostring(err), tostring(experr))
+    end
+
+    -- test that return the error of the callback function
+    local v, err = decode_ffi.range('[1,2]', function()
+        return nil, 'callback error'
+    end)
+    assert.is_nil(v)
+    assert.match(err, 'callback error')
+end
+
+function testcase.lib()
+    if not has_ffi then
+        -- test that the lib field is not available without the FFI
+        assert.is_nil(decode_ffi.lib)
+        return
+    end
+
+    -- test that decode into the struct
+    local ffi = require('ffi')
+    local ts = ffi.new('pgdec_timestamp_t')
+    local err = ffi.new('pgdec_error_t')
+    assert.equal(decode_ffi.lib.pgdec_timestamp('2020-01-02 03:04:05', 19, ts,
+                                                err), 0)
+    assert.equal(ts.year, 2020)
+    assert.equal(ts.sec, 5)
+
+    -- test that the string does not need to be terminated by '\0'
+    assert.equal(decode_ffi.lib.pgdec_date('2020-01-02XYZ', 10, 0, ts, err), 0)
+    assert.equal(ts.day, 2)
+
+    -- test that the number at the end of the string is not continued by the
+    -- following characters
+    local iv = ffi.new('int64_t[1]')
+    assert.equal(decode_ffi.lib.pgdec_int('12345', 2, iv, err), 0)
+    assert.equal(tonumber(iv[0]), 12)
+    local pt = ffi.new('pgdec_point_t')
+    assert.equal(decode_ffi.lib.pgdec_point('(1.5,2)345', 7, pt, err), 0)
+    assert.equal(pt.x, 1.5)
+    assert.equal(pt.y, 2)
+    local fv = ffi.new('double[1]')
+    assert.equal(decode_ffi.lib.pgdec_float('1.5e3', 3, fv, err), 0)
+    assert.equal(fv[0], 1.5)
+
+    -- test that the string is not modified
+    local buf = ffi.new('char[8]', '{1,2,3}')
+    assert.equal(decode_ffi.lib.pgdec_timestamp(buf, 4, ts, err), -1)
+    assert.equal(ffi.string(buf, 7), '{1,2,3}')
+
+    -- test that return the error position
+    assert.equal(decode_ffi.lib.pgdec_date('2020-01-0x', 10, 0, ts, err), -1)
+    assert.equal(tonumber(err.pos), 10)
+    assert.equal(string.char(err.c), 'x')
+end
+
+function testcase.lib_visitor()
+    if not has_ffi then
+        return
+    end
+
+    -- test that the elements point into the string passed to pgdec_array
+    local ffi = require('ffi')
+    local err = ffi.new('pgdec_error_t')
+    local buf = ffi.new('char[16]', '{foo,NULL,"b"}')
+    local head = ffi.cast('uintptr_t', buf)
+    local elems = {}
+    local v = ffi.new('pgdec_array_visitor_t')
+    local cbs = {
+        open = ffi.cast('int (*)(void *, int, size_t)', function()
+            return 0
+        end),
+        close = ffi.cast('int (*)(void *, int, size_t, size_t)', function()
+            return 0
+        end),
+        elem = ffi.cast('int (*)(void *, int, size_t, const char *, size_t)',
+                        function(_, _, _, str, len)
+            if str == nil then
+                elems[#elems + 1] = 'NULL'
+            else
+                elems[#elems + 1] = tonumber(ffi.cast('uintptr_t', str) -
+                                                 head) .. ':' ..
+                                        tonumber(len)
+            end
+            return 0
+        end),
+    }
+    v.open, v.close, v.elem = cbs.open, cbs.close, cbs.elem
+    assert.equal(decode_ffi.lib.pgdec_array(buf, 14, 44, v, nil, err), 0)
+    assert.equal(elems, {
+        '1:3',
+        'NULL',
+        '10:3',
+    })
+
+    -- test that the keys and values point into the string passed to
+    -- pgdec_hstore
+    buf = ffi.new('char[24]', '"a"=>"bc", "d"=>NULL')
+    head = ffi.cast('uintptr_t', buf)
+    local kvs = {}
+    local fn = ffi.cast('pgdec_hstore_visitor_t',
+                        function(_, key, klen, val, vlen)
+        kvs[#kvs + 1] = tonumber(ffi.cast('uintptr_t', key) - head) .. ':' ..
+                            tonumber(klen)
+        if val == nil then
+            kvs[#kvs + 1] = 'NULL'
+        else
+            kvs[#kvs + 1] = tonumber(ffi.cast('uintptr_t', val) - head) ..
+                                ':' .. tonumber(vlen)
+        end
+        return 0
+    end)
+    assert.equal(decode_ffi.lib.pgdec_hstore(buf, 20, fn, nil, err), 0)
+    assert.equal(kvs, {
+        '1:1',
+        '6:2',
+        '12:1',
+        'NULL',
+    })
+
+    for _, cb in pairs(cbs) do
+        cb:free()
+    end
+    fn:free()
+end
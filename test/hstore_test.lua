@@ -48,3 +48,107 @@ function testcase.hstore()
     err = assert.throws(decode_hstore)
     assert.match(err, 'string expected,')
 end
+
+function testcase.yield()
+    local decode = require('postgres.decode')
+    -- yielding requires Lua 5.3 or later, and the decoders wrapped by the
+    -- statistics never yield
+    local yieldable = _VERSION >= 'Lua 5.3' and not next(decode.stats())
+    local step = decode.yieldstep(1)
+
+    -- test that the decoder yields the running coroutine between the pairs,
+    -- and returns the value after resuming it until it is dead
+    local nyield = 0
+    local co = coroutine.create(function()
+        return decode_hstore('"a"=>"1", "b"=>NULL, "c"=>"x\\"y", "d"=>"4"')
+    end)
+    local ok, v = coroutine.resume(co)
+    while coroutine.status(co) == 'suspended' do
+        nyield = nyield + 1
+        ok, v = coroutine.resume(co)
+    end
+    decode.yieldstep(step)
+    assert.is_true(ok)
+    assert.equal(nyield > 0, yieldable)
+    assert.equal(v, {
+        a = '1',
+        c = 'x\\"y',
+        d = '4',
+    })
+end
+
+function testcase.limits()
+    local decode = require('postgres.decode')
+    decode.limits({
+        elements = 2,
+        length = 3,
+    })
+
+    -- test that the pairs within the limits are decoded
+    local v, err = decode_hstore('"a"=>"1", "b"=>"123"')
+    assert.is_nil(err)
+    assert.equal(v, {
+        a = '1',
+        b = '123',
+    })
+
+    -- test that return E2BIG if the number of pairs exceeds the limit, and
+    -- the destination table is untouched
+    local nested = {}
+    local dst = {
+        foo = 'bar',
+        nested,
+    }
+    v, err = decode_hstore('"a"=>"1", "b"=>"2", "c"=>"3"', dst)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'too many elements')
+    assert.equal(dst, {
+        foo = 'bar',
+        {},
+    })
+    assert.rawequal(dst[1], nested)
+
+    -- test that return E2BIG if the key or the value string is too long
+    for _, str in ipairs({
+        '"abcd"=>"1"',
+        '"a"=>"1234"',
+    }) do
+        v, err = decode_hstore(str, dst)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.E2BIG)
+        assert.match(err, 'element string too long')
+        assert.equal(dst, {
+            foo = 'bar',
+            {},
+        })
+    end
+
+    -- test that remove the limits
+    decode.limits(nil)
+    v = assert(decode_hstore('"a"=>"1", "b"=>"2", "c"=>"1234"'))
+    assert.equal(v.c, '1234')
+end
+
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_hstore('"a"=>"1", "b"=>"2"', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        a = '1',
+        b = '2',
+    })
+
+    -- test that the pairs of the previous value are removed
+    v, err = decode_hstore('"c"=>"3"', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        c = '3',
+    })
+end
@@ -0,0 +1,134 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_inet = require('postgres.decode.inet')
+
+function testcase.ipv4()
+    -- test that decode IPv4 address
+    for s, exp in pairs({
+        ['192.168.100.128/25'] = {
+            family = 4,
+            bits = 25,
+            addr = '\192\168\100\128',
+        },
+        ['10.0.0.1'] = {
+            family = 4,
+            bits = 32,
+            addr = '\10\0\0\1',
+        },
+        ['0.0.0.0/0'] = {
+            family = 4,
+            bits = 0,
+            addr = '\0\0\0\0',
+        },
+    }) do
+        local v, err = decode_inet(s)
+        assert.is_nil(err)
+        assert.equal(v, exp)
+    end
+end
+
+function testcase.ipv6()
+    -- test that decode IPv6 address
+    for s, exp in pairs({
+        ['2001:db8::1/64'] = {
+            family = 6,
+            bits = 64,
+            addr = '\032\001\013\184' .. string.rep('\0', 11) .. '\1',
+        },
+        ['::'] = {
+            family = 6,
+            bits = 128,
+            addr = string.rep('\0', 16),
+        },
+        ['fe80::'] = {
+            family = 6,
+            bits = 128,
+            addr = '\254\128' .. string.rep('\0', 14),
+        },
+        ['::ffff:1.2.3.4/120'] = {
+            family = 6,
+            bits = 120,
+            addr = string.rep('\0', 10) .. '\255\255\1\2\3\4',
+        },
+        ['1:2:3:4:5:6:7:8'] = {
+            family = 6,
+            bits = 128,
+            addr = '\0\1\0\2\0\3\0\4\0\5\0\6\0\7\0\8',
+        },
+    }) do
+        local v, err = decode_inet(s)
+        assert.is_nil(err)
+        assert.equal(v, exp)
+    end
+end
+
+function testcase.error()
+    -- test that empty string error
+    local v, err = decode_inet('')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EINVAL)
+    assert.match(err, 'empty string')
+
+    -- test that illegal character error
+    for s, pos in pairs({
+        ['256.1.1.1'] = "'2' at position 1",
+        ['1.2.3.4 '] = "' ' at position 8",
+        ['1::2::3'] = "':' at position 6",
+        [':1'] = "'1' at position 2",
+        ['1:2:3:4:5:6:7:8:9'] = "':' at position 16",
+        ['12345::'] = "'5' at position 5",
+    }) do
+        v, err = decode_inet(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, pos)
+    end
+
+    -- test that unexpected end error
+    for _, s in ipairs({
+        '1.2.3',
+        '1.2.3.4/',
+        '1:2:3',
+    }) do
+        v, err = decode_inet(s)
+        assert.is_nil(v)
+        assert.match(err, 'unexpected end of inet string')
+    end
+
+    -- test that netmask bits out of range error
+    for _, s in ipairs({
+        '1.2.3.4/33',
+        '::1/129',
+    }) do
+        v, err = decode_inet(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.ERANGE)
+        assert.match(err, 'out of range')
+    end
+end
+
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_inet('192.168.0.1/24', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        family = 4,
+        bits = 24,
+        addr = '\192\168\0\1',
+    })
+
+    -- test that the fields of the previous value are replaced
+    v, err = decode_inet('::1', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        family = 6,
+        bits = 128,
+        addr = string.rep('\0', 15) .. '\1',
+    })
+end
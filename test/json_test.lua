@@ -0,0 +1,196 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_json = require('postgres.decode.json')
+
+function testcase.json()
+    -- test that decode json value
+    local v, err = decode_json(
+                       ' {"a": 1, "b": [true, false, -2.5e1], "c": {"d": "e\\n\\u00e9\\ud83d\\ude00"}} ')
+    assert.is_nil(err)
+    assert.equal(v, {
+        a = 1,
+        b = {
+            true,
+            false,
+            -25,
+        },
+        c = {
+            d = 'e\n\195\169\240\159\152\128',
+        },
+    })
+
+    -- test that decode scalar values
+    for s, exp in pairs({
+        ['"foo \\"bar\\""'] = 'foo "bar"',
+        ['-0.5'] = -0.5,
+        ['123'] = 123,
+        ['true'] = true,
+        ['false'] = false,
+    }) do
+        v, err = decode_json(s)
+        assert.is_nil(err)
+        assert.equal(v, exp)
+    end
+
+    -- test that null is decoded to nil
+    v, err = decode_json('null')
+    assert.is_nil(err)
+    assert.is_nil(v)
+    v, err = decode_json('[1, null, 3]')
+    assert.is_nil(err)
+    assert.equal(v, {
+        1,
+        nil,
+        3,
+    })
+
+    -- test that decode empty containers
+    v, err = decode_json('[{}, []]')
+    assert.is_nil(err)
+    assert.equal(v, {
+        {},
+        {},
+    })
+
+    -- test that decode a long string that spans multiple blocks
+    local s = string.rep('abc\\"', 100)
+    v, err = decode_json('["' .. s .. '", "}"]')
+    assert.is_nil(err)
+    assert.equal(v, {
+        string.rep('abc"', 100),
+        '}',
+    })
+end
+
+function testcase.options()
+    -- test that null is decoded to the null sentinel
+    local null = setmetatable({}, {
+        __tostring = function()
+            return 'null'
+        end,
+    })
+    local v, err = decode_json('[1, null, {"a": null}]', {
+        null = null,
+    })
+    assert.is_nil(err)
+    assert.equal(v, {
+        1,
+        null,
+        {
+            a = null,
+        },
+    })
+
+    -- test that integer values are decoded to integer
+    if math.type then
+        v = assert(decode_json('[1, 1.0, 9223372036854775807]'))
+        assert.equal(math.type(v[1]), 'integer')
+        assert.equal(math.type(v[2]), 'float')
+        assert.equal(math.type(v[3]), 'integer')
+
+        -- test that integer values are decoded to float
+        v = assert(decode_json('[1, 1.0]', {
+            integer = false,
+        }))
+        assert.equal(math.type(v[1]), 'float')
+        assert.equal(math.type(v[2]), 'float')
+    end
+
+    -- test that large nested containers are decoded lazily
+    v, err = decode_json('{"small": [1], "large": {"a": [1, 2, 3], "b": "foo"}}',
+                         {
+        lazy = 16,
+    })
+    assert.is_nil(err)
+    assert.equal(v.small, {
+        1,
+    })
+    assert.is_table(getmetatable(v.large))
+    assert.equal(rawget(v.large, 'b'), nil)
+    assert.equal(v.large.b, 'foo')
+    assert.is_nil(getmetatable(v.large))
+    assert.equal(v.large, {
+        a = {
+            1,
+            2,
+            3,
+        },
+        b = 'foo',
+    })
+
+    -- test that the deeply nested containers are decoded lazily level by
+    -- level, and the invalid value is reported before any level is decoded
+    local str = string.rep('[', 300) .. '7' .. string.rep(']', 300)
+    v = assert(decode_json(str, {
+        lazy = 1,
+    }))
+    for _ = 1, 300 do
+        v = v[1]
+    end
+    assert.equal(v, 7)
+    v, err = decode_json(string.rep('[', 300) .. '7,' .. string.rep(']', 300),
+                         {
+        lazy = 1,
+    })
+    assert.is_nil(v)
+    assert.match(err, "']' at position 303")
+
+    -- test that throws an error if lazy option is invalid
+    err = assert.throws(decode_json, '[]', {
+        lazy = -1,
+    })
+    assert.match(err, 'lazy must be a non-negative integer')
+end
+
+function testcase.error()
+    -- test that empty string error
+    for _, s in ipairs({
+        '',
+        ' \t\n',
+    }) do
+        local v, err = decode_json(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.EINVAL)
+        assert.match(err, 'empty string')
+    end
+
+    -- test that illegal character error
+    for s, pos in pairs({
+        ['[1,]'] = "']' at position 4",
+        ['{"a" 1}'] = "'1' at position 6",
+        ['[1 2]'] = "'2' at position 4",
+        ['{1: 2}'] = "'1' at position 2",
+        ['01'] = "'1' at position 2",
+        ['[tru]'] = "'t' at position 2",
+        ['["\\x"]'] = "'\\' at position 3",
+        ['["\\ud800"]'] = "'\\' at position 3",
+        ['{"a": 1} x'] = "'x' at position 10",
+    }) do
+        local v, err = decode_json(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, pos)
+    end
+
+    -- test that unexpected end error
+    for _, s in ipairs({
+        '[1, 2',
+        '{"a":',
+        '1.',
+        '-',
+    }) do
+        local v, err = decode_json(s)
+        assert.is_nil(v)
+        assert.match(err, 'unexpected end of json string')
+    end
+
+    -- test that closing quotation error
+    local v, err = decode_json('["foo]')
+    assert.is_nil(v)
+    assert.match(err, 'closing quotation not found')
+
+    -- test that nesting level error
+    v, err = decode_json(string.rep('[', 513) .. string.rep(']', 513))
+    assert.is_nil(v)
+    assert.match(err, 'too deep')
+end
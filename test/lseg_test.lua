@@ -15,3 +15,41 @@ function testcase.lseg()
         },
     })
 end
+
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_lseg('[(1,2),(3,4)]', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+    })
+
+    -- test that the nested tables are reused
+    local nested = dst[1]
+    v, err = decode_lseg('[(5,6),(7,8)]', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.rawequal(v[1], nested)
+    assert.equal(v, {
+        {
+            5,
+            6,
+        },
+        {
+            7,
+            8,
+        },
+    })
+end
@@ -0,0 +1,43 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_macaddr = require('postgres.decode.macaddr')
+
+function testcase.macaddr()
+    -- test that decode macaddr and macaddr8 values
+    for s, exp in pairs({
+        ['08:00:2b:01:02:03'] = '\008\000\043\001\002\003',
+        ['08:00:2B:01:02:03:04:05'] = '\008\000\043\001\002\003\004\005',
+    }) do
+        local v, err = decode_macaddr(s)
+        assert.is_nil(err)
+        assert.equal(v, exp)
+    end
+
+    -- test that empty string error
+    local v, err = decode_macaddr('')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EINVAL)
+    assert.match(err, 'empty string')
+
+    -- test that illegal character error
+    for s, pos in pairs({
+        ['08:00:2b:01:02:0g'] = "'g' at position 17",
+        ['08-00-2b-01-02-03'] = "'-' at position 3",
+        ['08:00:2b:01:02:03:04:05:06'] = "':' at position 24",
+    }) do
+        v, err = decode_macaddr(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, pos)
+    end
+
+    -- test that invalid number of octets error
+    v, err = decode_macaddr('08:00:2b:01:02')
+    assert.is_nil(v)
+    assert.match(err, 'invalid number of octets 5')
+
+    -- test that unexpected end error
+    v, err = decode_macaddr('08:00:2b:01:02:03:')
+    assert.is_nil(v)
+    assert.match(err, 'unexpected end of macaddr string')
+end
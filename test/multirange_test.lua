@@ -1,4 +1,5 @@
 local testcase = require('testcase')
+local errno = require('errno')
 local decode_multirange = require('postgres.decode.multirange')
 
 function testcase.multirange()
@@ -75,6 +76,28 @@ function testcase.empty()
             {},
         })
     end
+
+    -- test that decode multirange value contains no ranges
+    for _, v in ipairs({
+        '{}',
+        ' { } ',
+    }) do
+        local rval, err = decode_multirange(v, function(elmstr)
+            return elmstr
+        end)
+        assert.is_nil(err)
+        assert.equal(rval, {})
+
+        -- test that the packed multirange contains nothing
+        rval, err = decode_multirange(v, function(elmstr)
+            return tonumber(elmstr)
+        end, nil, true)
+        assert.is_nil(err)
+        assert.equal(#rval, 0)
+        assert.is_false(rval:contains(0))
+        assert.is_false(rval:overlaps(nil, nil))
+        assert.is_nil(rval:range(1))
+    end
 end
 
 function testcase.callback_error()
@@ -84,6 +107,24 @@ function testcase.callback_error()
     end)
     assert.is_nil(rval)
     assert.match(err, 'callback error')
+
+    -- test that the decoder can be called after the callback raised an error
+    local ok
+    ok, err = pcall(decode_multirange, '{[123, 456]}', function()
+        error('raised')
+    end)
+    assert.is_false(ok)
+    assert.match(err, 'raised')
+    rval = assert(decode_multirange('{[1,2)}', function(elmstr)
+        return tonumber(elmstr)
+    end))
+    assert.equal(rval, {
+        {
+            1,
+            2,
+            lower_inc = true,
+        },
+    })
 end
 
 function testcase.invalid_format_error()
@@ -106,6 +147,8 @@ function testcase.invalid_format_error()
         '{ empty  ',
         '{[123,, 456], }',
         '{ (123, 456) ]}',
+        '{,}',
+        '{} x',
     }) do
         local rval, err = decode_multirange(v, function(elmstr)
             return elmstr
@@ -114,3 +157,284 @@ function testcase.invalid_format_error()
         assert.match(err, 'EILSEQ')
     end
 end
+
+function testcase.packed()
+    -- test that decode multirange value into packed multirange
+    local mr, err = decode_multirange('{(,0), [5,10), [20,)}', function(elmstr)
+        return tonumber(elmstr)
+    end, nil, true)
+    assert.is_nil(err)
+    assert.match(tostring(mr), '^postgres%.decode%.multirange: ', false)
+    assert.equal(#mr, 3)
+    assert.equal(mr:len(), 3)
+    assert.equal({
+        mr:range(2),
+    }, {
+        5,
+        10,
+        true,
+        false,
+    })
+    assert.equal({
+        mr:range(1),
+    }, {
+        nil,
+        0,
+        false,
+        false,
+    })
+    assert.equal({
+        mr:range(4),
+    }, {})
+
+    -- test that iterate ranges
+    local list = {}
+    for i, lower, upper, lower_inc, upper_inc in mr:ranges() do
+        list[i] = {
+            lower,
+            upper,
+            lower_inc = lower_inc,
+            upper_inc = upper_inc,
+        }
+    end
+    assert.equal(list, {
+        {
+            nil,
+            0,
+            lower_inc = false,
+            upper_inc = false,
+        },
+        {
+            5,
+            10,
+            lower_inc = true,
+            upper_inc = false,
+        },
+        {
+            20,
+            nil,
+            lower_inc = true,
+            upper_inc = false,
+        },
+    })
+
+    -- test that contains value
+    for v, ok in pairs({
+        [-100] = true,
+        [0] = false,
+        [1] = false,
+        [5] = true,
+        [7.5] = true,
+        [10] = false,
+        [15] = false,
+        [20] = true,
+        [1e9] = true,
+    }) do
+        assert.equal(mr:contains(v), ok)
+    end
+
+    -- test that overlaps with closed interval
+    assert.is_false(mr:overlaps(1, 4))
+    assert.is_false(mr:overlaps(10, 19))
+    assert.is_true(mr:overlaps(10, 20))
+    assert.is_true(mr:overlaps(-5, 0))
+    assert.is_true(mr:overlaps(nil, 1))
+    assert.is_true(mr:overlaps(11, nil))
+
+    -- test that empty ranges are not stored
+    mr = assert(decode_multirange('{empty, [1,2]}', function(elmstr)
+        return tonumber(elmstr)
+    end, nil, true))
+    assert.equal(#mr, 1)
+    assert.is_true(mr:contains(2))
+
+    -- test that bounds must be numbers
+    mr, err = decode_multirange('{[a,b]}', function(elmstr)
+        return elmstr
+    end, nil, true)
+    assert.is_nil(mr)
+    assert.match(err, 'lower bound must be a number')
+
+    -- test that ranges must be in canonical order
+    mr, err = decode_multirange('{[5,10), [1,2)}', function(elmstr)
+        return tonumber(elmstr)
+    end, nil, true)
+    assert.is_nil(mr)
+    assert.match(err, 'canonical order')
+end
+
+function testcase.yield()
+    local decode = require('postgres.decode')
+    local decode_bound = function(elmstr)
+        return tonumber(elmstr)
+    end
+    -- yielding requires Lua 5.3 or later, and the decoders wrapped by the
+    -- statistics never yield
+    local yieldable = _VERSION >= 'Lua 5.3' and not next(decode.stats())
+    local step = decode.yieldstep(1)
+
+    -- test that the decoder yields the running coroutine between the ranges,
+    -- and returns the value after resuming it until it is dead
+    local res = {}
+    for _, packed in ipairs({
+        false,
+        true,
+    }) do
+        local nyield = 0
+        local co = coroutine.create(function()
+            return decode_multirange('{[1,2), empty, (3,4], [5,)}',
+                                     decode_bound, nil, packed)
+        end)
+        local ok, v = coroutine.resume(co)
+        while coroutine.status(co) == 'suspended' do
+            nyield = nyield + 1
+            ok, v = coroutine.resume(co)
+        end
+        res[#res + 1] = {
+            ok = ok,
+            v = v,
+            nyield = nyield,
+        }
+    end
+    decode.yieldstep(step)
+
+    assert.is_true(res[1].ok)
+    assert.equal(res[1].nyield > 0, yieldable)
+    assert.equal(res[1].v, {
+        {
+            1,
+            2,
+            lower_inc = true,
+        },
+        {},
+        {
+            3,
+            4,
+            upper_inc = true,
+        },
+        {
+            5,
+            lower_inc = true,
+        },
+    })
+    assert.is_true(res[2].ok)
+    assert.equal(res[2].nyield > 0, yieldable)
+    assert.equal(#res[2].v, 3)
+    assert.equal({
+        res[2].v:range(3),
+    }, {
+        5,
+        nil,
+        true,
+        false,
+    })
+end
+
+function testcase.limits()
+    local decode = require('postgres.decode')
+    local decode_bound = function(elmstr)
+        return tonumber(elmstr)
+    end
+    decode.limits({
+        elements = 2,
+        length = 3,
+    })
+
+    -- test that the ranges within the limits are decoded
+    local v, err = decode_multirange('{[1,2), [3,100)}', decode_bound)
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            1,
+            2,
+            lower_inc = true,
+        },
+        {
+            3,
+            100,
+            lower_inc = true,
+        },
+    })
+
+    -- test that return E2BIG if the number of ranges exceeds the limit, and
+    -- the destination table is untouched
+    local nested = {}
+    local dst = {
+        foo = 'bar',
+        nested,
+    }
+    for _, packed in ipairs({
+        false,
+        true,
+    }) do
+        v, err = decode_multirange('{[1,2), [3,4), [5,6)}', decode_bound, nil,
+                                   packed, dst)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.E2BIG)
+        assert.match(err, 'too many elements')
+        assert.equal(dst, {
+            foo = 'bar',
+            {},
+        })
+        assert.rawequal(dst[1], nested)
+    end
+
+    -- test that return E2BIG if the bound string is too long
+    v, err = decode_multirange('{[1,1000)}', decode_bound, nil, nil, dst)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'element string too long')
+    assert.equal(dst, {
+        foo = 'bar',
+        {},
+    })
+
+    -- test that remove the limits
+    decode.limits(nil)
+    v = assert(decode_multirange('{[1,2), [3,4), [5,1000)}', decode_bound))
+    assert.equal(#v, 3)
+end
+
+function testcase.destination_table()
+    local decode_int = require('postgres.decode.int')
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_multirange('{[1,2),[3,4),[5,6)}', decode_int, nil,
+                                     nil, dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        {
+            1,
+            2,
+            lower_inc = true,
+        },
+        {
+            3,
+            4,
+            lower_inc = true,
+        },
+        {
+            5,
+            6,
+            lower_inc = true,
+        },
+    })
+
+    -- test that the nested tables are reused and the rest are removed
+    local nested = dst[1]
+    v, err = decode_multirange('{(7,8]}', decode_int, nil, nil, dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.rawequal(v[1], nested)
+    assert.equal(v, {
+        {
+            7,
+            8,
+            upper_inc = true,
+        },
+    })
+end
@@ -1,4 +1,5 @@
 local testcase = require('testcase')
+local errno = require('errno')
 local decode_polygon = require('postgres.decode.polygon')
 
 function testcase.polygon()
@@ -20,3 +21,124 @@ function testcase.polygon()
     })
 end
 
+function testcase.yield()
+    local decode = require('postgres.decode')
+    -- yielding requires Lua 5.3 or later, and the decoders wrapped by the
+    -- statistics never yield
+    local yieldable = _VERSION >= 'Lua 5.3' and not next(decode.stats())
+    local step = decode.yieldstep(1)
+
+    -- test that the decoder yields the running coroutine between the points,
+    -- and returns the value after resuming it until it is dead
+    local nyield = 0
+    local co = coroutine.create(function()
+        return decode_polygon('((1,2), (3,4), (5,6))')
+    end)
+    local ok, v = coroutine.resume(co)
+    while coroutine.status(co) == 'suspended' do
+        nyield = nyield + 1
+        ok, v = coroutine.resume(co)
+    end
+    decode.yieldstep(step)
+    assert.is_true(ok)
+    assert.equal(nyield > 0, yieldable)
+    assert.equal(v, {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+        {
+            5,
+            6,
+        },
+    })
+end
+
+function testcase.limits()
+    local decode = require('postgres.decode')
+    decode.limits({
+        elements = 2,
+    })
+
+    -- test that the points within the limits are decoded
+    local v, err = decode_polygon('((1,2), (3,4))')
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+    })
+
+    -- test that return E2BIG if the number of points exceeds the limit, and
+    -- the destination table is untouched
+    local nested = {}
+    local dst = {
+        foo = 'bar',
+        nested,
+    }
+    v, err = decode_polygon('((1,2), (3,4), (5,6))', dst)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'too many elements')
+    assert.equal(dst, {
+        foo = 'bar',
+        {},
+    })
+    assert.rawequal(dst[1], nested)
+
+    -- test that remove the limits
+    decode.limits(nil)
+    v = assert(decode_polygon('((1,2), (3,4), (5,6))'))
+    assert.equal(#v, 3)
+end
+
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_polygon('((1,2),(3,4),(5,6))', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+        {
+            5,
+            6,
+        },
+    })
+
+    -- test that the nested tables are reused and the rest are removed
+    local nested = dst[1]
+    v, err = decode_polygon('((7,8),(9,10))', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.rawequal(v[1], nested)
+    assert.equal(v, {
+        {
+            7,
+            8,
+        },
+        {
+            9,
+            10,
+        },
+    })
+end
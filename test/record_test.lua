@@ -0,0 +1,194 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_array = require('postgres.decode.array')
+local decode_record = require('postgres.decode.record')
+
+function testcase.record()
+    -- test that decode record value as text fields
+    local v, err = decode_record('(42,"foo ""bar""",,2023-01-01,"")')
+    assert.is_nil(err)
+    assert.equal(v, {
+        '42',
+        'foo "bar"',
+        nil,
+        '2023-01-01',
+        '',
+    })
+
+    -- test that decode escaped characters
+    v, err = decode_record([[(a\,b,"c\\d",e"f,g"h)]])
+    assert.is_nil(err)
+    assert.equal(v, {
+        'a,b',
+        'c\\d',
+        'ef,gh',
+    })
+
+    -- test that decode empty record
+    v, err = decode_record('()')
+    assert.is_nil(err)
+    assert.equal(v, {})
+end
+
+function testcase.decoders()
+    -- test that decode fields by built-in decoders and functions
+    local v, err = decode_record('(42,"foo bar",,2023-01-01,t)', {
+        'int',
+        function(fieldstr, is_quoted, ctx)
+            assert.equal(fieldstr, 'foo bar')
+            assert.is_true(is_quoted)
+            assert.equal(ctx, 'context')
+            return string.upper(fieldstr)
+        end,
+        'int',
+        'date',
+    }, 'context')
+    assert.is_nil(err)
+    assert.equal(v, {
+        42,
+        'FOO BAR',
+        nil,
+        {
+            year = 2023,
+            month = 1,
+            day = 1,
+        },
+        't',
+    })
+
+    -- test that returns a named table
+    v, err = decode_record('(42,foo,t)', {
+        'int',
+        nil,
+        'bool',
+    }, nil, {
+        'id',
+        'name',
+    })
+    assert.is_nil(err)
+    assert.equal(v, {
+        id = 42,
+        name = 'foo',
+        [3] = true,
+    })
+
+    -- test that pass through the error of built-in decoder
+    v, err = decode_record('(foo)', {
+        'int',
+    })
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'postgres.decode.int')
+
+    -- test that returns the error of decode function
+    v, err = decode_record('(foo)', {
+        function()
+            return nil, 'decode function error'
+        end,
+    })
+    assert.is_nil(v)
+    assert.match(err, 'decode function error')
+
+    -- test that throws an error if unknown decoder name
+    err = assert.throws(decode_record, '(foo)', {
+        'array',
+    })
+    assert.match(err, "unknown decoder name 'array'")
+
+    -- test that invalid decoder error
+    v, err = decode_record('(foo)', {
+        1,
+    })
+    assert.is_nil(v)
+    assert.match(err, 'decoder #1 must be string or function')
+end
+
+function testcase.record_array()
+    -- test that decode record[] value
+    local v, err = decode_array([[{"(1,foo)","(2,\"bar baz\")",NULL}]],
+                                function(elmstr)
+        return decode_record(elmstr, {
+            'int',
+        }, nil, {
+            'id',
+            'name',
+        })
+    end)
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            id = 1,
+            name = 'foo',
+        },
+        {
+            id = 2,
+            name = 'bar baz',
+        },
+    })
+end
+
+function testcase.invalid_format_error()
+    -- test that empty string error
+    local v, err = decode_record('')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EINVAL)
+    assert.match(err, 'empty string')
+
+    -- test that opening round bracket error
+    v, err = decode_record('foo,bar)')
+    assert.is_nil(v)
+    assert.match(err, 'opening round bracket')
+
+    -- test that closing quotation error
+    for _, s in ipairs({
+        '(foo,"bar)',
+        '"(foo,bar)',
+    }) do
+        v, err = decode_record(s)
+        assert.is_nil(v)
+        assert.match(err, 'closing quotation')
+    end
+
+    -- test that malformed record error
+    for _, s in ipairs({
+        '(foo,bar',
+        '(foo,b\\',
+    }) do
+        v, err = decode_record(s)
+        assert.is_nil(v)
+        assert.match(err, 'malformed record')
+    end
+
+    -- test that illegal character after closing bracket error
+    v, err = decode_record('(foo) ')
+    assert.is_nil(v)
+    assert.match(err, "' ' at position 6")
+end
+
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_record('(1,foo)', {
+        'int',
+    }, nil, {
+        'id',
+        'name',
+    }, dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        id = 1,
+        name = 'foo',
+    })
+
+    -- test that the fields of the previous value are removed
+    v, err = decode_record('(bar)', nil, nil, nil, dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        'bar',
+    })
+end
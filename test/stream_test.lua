@@ -0,0 +1,147 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_stream = require('postgres.decode.stream')
+
+local function decode_chunks(s, data, size)
+    for i = 1, #data, size do
+        local ok, err = s:feed(string.sub(data, i, i + size - 1))
+        if not ok then
+            return nil, err
+        end
+    end
+    return s:finish()
+end
+
+function testcase.array()
+    local data = ' { 1, "a\\"b,}" , {NULL, foo , {}}, {{x}}} '
+
+    -- test that decode array from the chunks of any size
+    for size = 1, #data do
+        local s = decode_stream('array', function(elm, is_quoted, ctx)
+            assert.equal(ctx, 'context')
+            if is_quoted then
+                return '<' .. elm .. '>'
+            end
+            return elm
+        end, 'context')
+        assert.match(tostring(s), '^postgres%.decode%.stream: ', false)
+        local v, err = decode_chunks(s, data, size)
+        assert.is_nil(err)
+        assert.equal(v, {
+            '1',
+            '<"a\\"b,}">',
+            {
+                nil,
+                'foo',
+                {},
+            },
+            {
+                {
+                    'x',
+                },
+            },
+        })
+
+        -- test that cannot feed data after finish
+        local ok
+        ok, err = s:feed('{}')
+        assert.is_nil(ok)
+        assert.equal(err.type, errno.EINVAL)
+    end
+
+    -- test that decode array with custom delimiter
+    local s = decode_stream('array', function(elm)
+        return elm
+    end, nil, ';')
+    local v, err = decode_chunks(s, '{a;b,c}', 2)
+    assert.is_nil(err)
+    assert.equal(v, {
+        'a',
+        'b,c',
+    })
+
+    -- test that return error
+    for _, str in ipairs({
+        '',
+        'foo',
+        '{1,,2}',
+        '{1,2',
+        '{"foo',
+        '{1} x',
+    }) do
+        s = decode_stream('array', function(elm)
+            return elm
+        end)
+        v, err = decode_chunks(s, str, 1)
+        assert.is_nil(v)
+        assert.is_true(err.type == errno.EINVAL or err.type == errno.EILSEQ)
+    end
+
+    -- test that return error from decode function
+    s = decode_stream('array', function()
+        return nil, 'error from fn'
+    end)
+    v, err = decode_chunks(s, '{1}', 1)
+    assert.is_nil(v)
+    assert.match(err, 'error from fn')
+
+    -- test that throws an error if fn is not function
+    err = assert.throws(decode_stream, 'array')
+    assert.match(err, 'function expected')
+end
+
+function testcase.bytea()
+    -- test that decode hex format from the chunks of any size
+    local data = '\\x48656c6C6f'
+    for size = 1, #data do
+        local v, err = decode_chunks(decode_stream('bytea'), data, size)
+        assert.is_nil(err)
+        assert.equal(v, 'Hello')
+    end
+
+    -- test that return error
+    for str, msg in pairs({
+        [''] = 'empty string',
+        ['\\'] = 'invalid hex format',
+        ['x41'] = "'x' at position 1",
+        ['\\x1g'] = "'g' at position 4",
+        ['\\x123'] = 'odd number of hex digits',
+    }) do
+        local v, err = decode_chunks(decode_stream('bytea'), str, 1)
+        assert.is_nil(v)
+        assert.match(err, msg, false)
+    end
+end
+
+function testcase.hstore()
+    -- test that decode hstore from the chunks of any size
+    local data = ' "a" => "1", "b\\"c"=>NULL ,"d"=>"x,y"'
+    for size = 1, #data do
+        local v, err = decode_chunks(decode_stream('hstore'), data, size)
+        assert.is_nil(err)
+        assert.equal(v, {
+            a = '1',
+            d = 'x,y',
+        })
+    end
+
+    -- test that return error
+    for str, msg in pairs({
+        [''] = 'empty string',
+        ['"a"=>NUL'] = 'malformed hstore string',
+        ['"a"=>NUX'] = 'invalid null value',
+        ['"a"="1"'] = 'key-value separator not found',
+        ['"a"=>"1'] = 'closing double-quote not found',
+        ['"a"=>"1",'] = 'opening double-quote not found',
+    }) do
+        local v, err = decode_chunks(decode_stream('hstore'), str, 1)
+        assert.is_nil(v)
+        assert.match(err, msg, false)
+    end
+end
+
+function testcase.unknown_type()
+    -- test that throws an error if unknown type
+    local err = assert.throws(decode_stream, 'foo')
+    assert.match(err, "invalid option 'foo'")
+end
@@ -78,5 +78,63 @@ function testcase.timestamp()
     v, err = decode_timestamp('1999-12-31 23:59:59.123456 15:59:59')
     assert.is_nil(v)
     assert.match(err, 'timezone symbol')
+
+    -- test that the canonical form that is out of range is reported at the
+    -- same position as the other forms
+    for _, c in ipairs({
+        {
+            str = '1999-13-31 23:59:59',
+            err = "'3' at position 7",
+        },
+        {
+            str = '1999-12-31 24:00:01',
+            err = "'1' at position 19",
+        },
+        {
+            str = '1999-12-31 24:00:00.1',
+            err = "'1' at position 21",
+        },
+        {
+            str = '1999-12-31 23:5x:59',
+            err = "'x' at position 16",
+        },
+    }) do
+        v, err = decode_timestamp(c.str)
+        assert.is_nil(v)
+        assert.match(err, c.err)
+    end
+
+    -- test that decode 24:00:00 in the canonical form
+    assert.equal(decode_timestamp('1999-12-31 24:00:00'), {
+        year = 1999,
+        month = 12,
+        day = 31,
+        hour = 24,
+        min = 0,
+        sec = 0,
+        usec = 0,
+    })
 end
 
+function testcase.destination_table()
+    local dst = {}
+
+    -- test that decode into the destination table
+    local v, err = decode_timestamp('1999-01-08 04:05:06+09', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+
+    -- test that the fields of the previous value are removed
+    v, err = decode_timestamp('1999-01-08 04:05:06', dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        year = 1999,
+        month = 1,
+        day = 8,
+        hour = 4,
+        min = 5,
+        sec = 6,
+        usec = 0,
+    })
+end
@@ -1,4 +1,5 @@
 local testcase = require('testcase')
+local errno = require('errno')
 local decode_tsvector = require('postgres.decode.tsvector')
 
 function testcase.tsvector()
@@ -193,3 +194,157 @@ function testcase.with_weights()
     })
 end
 
+function testcase.yield()
+    local decode = require('postgres.decode')
+    -- yielding requires Lua 5.3 or later, and the decoders wrapped by the
+    -- statistics never yield
+    local yieldable = _VERSION >= 'Lua 5.3' and not next(decode.stats())
+    local step = decode.yieldstep(1)
+
+    -- test that the decoder yields the running coroutine between the lexemes,
+    -- and returns the value after resuming it until it is dead
+    local nyield = 0
+    local co = coroutine.create(function()
+        return decode_tsvector("'a':1A 'cat':5 'fat':2,4C 'rat'")
+    end)
+    local ok, v = coroutine.resume(co)
+    while coroutine.status(co) == 'suspended' do
+        nyield = nyield + 1
+        ok, v = coroutine.resume(co)
+    end
+    decode.yieldstep(step)
+    assert.is_true(ok)
+    assert.equal(nyield > 0, yieldable)
+    assert.equal(v, {
+        {
+            lexeme = 'a',
+            positions = {
+                1,
+            },
+            weights = {
+                'A',
+            },
+        },
+        {
+            lexeme = 'cat',
+            positions = {
+                5,
+            },
+        },
+        {
+            lexeme = 'fat',
+            positions = {
+                2,
+                4,
+            },
+            weights = {
+                nil,
+                'C',
+            },
+        },
+        {
+            lexeme = 'rat',
+        },
+    })
+end
+
+function testcase.limits()
+    local decode = require('postgres.decode')
+    decode.limits({
+        elements = 3,
+        length = 3,
+    })
+
+    -- test that the lexemes and the positions within the limits are decoded
+    local v, err = decode_tsvector("'a':1 'cat'")
+    assert.is_nil(err)
+    assert.equal(v, {
+        {
+            lexeme = 'a',
+            positions = {
+                1,
+            },
+        },
+        {
+            lexeme = 'cat',
+        },
+    })
+
+    -- test that return E2BIG if the number of the lexemes and the positions
+    -- exceeds the limit, and the destination table is untouched
+    local nested = {}
+    local dst = {
+        foo = 'bar',
+        nested,
+    }
+    for _, str in ipairs({
+        "'a' 'b' 'c' 'd'",
+        "'a':1,2,3",
+    }) do
+        v, err = decode_tsvector(str, dst)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.E2BIG)
+        assert.match(err, 'too many elements')
+        assert.equal(dst, {
+            foo = 'bar',
+            {},
+        })
+        assert.rawequal(dst[1], nested)
+    end
+
+    -- test that return E2BIG if the lexeme is too long
+    v, err = decode_tsvector("'a' 'fat' 'rats'", dst)
+    assert.is_nil(v)
+    assert.equal(err.type, errno.E2BIG)
+    assert.match(err, 'element string too long')
+    assert.equal(dst, {
+        foo = 'bar',
+        {},
+    })
+
+    -- test that remove the limits
+    decode.limits(nil)
+    v = assert(decode_tsvector("'a' 'fat' 'rats' 'd'"))
+    assert.equal(#v, 4)
+end
+
+function testcase.destination_table()
+    local dst = {
+        foo = 'bar',
+    }
+
+    -- test that decode into the destination table
+    local v, err = decode_tsvector("'a':1,2 'b' 'c'", dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.equal(v, {
+        {
+            lexeme = 'a',
+            positions = {
+                1,
+                2,
+            },
+        },
+        {
+            lexeme = 'b',
+        },
+        {
+            lexeme = 'c',
+        },
+    })
+
+    -- test that the nested tables are reused and the rest are removed
+    local nested = dst[1]
+    v, err = decode_tsvector("'d':3", dst)
+    assert.is_nil(err)
+    assert.equal(v, dst)
+    assert.rawequal(v[1], nested)
+    assert.equal(v, {
+        {
+            lexeme = 'd',
+            positions = {
+                3,
+            },
+        },
+    })
+end
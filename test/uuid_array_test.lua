@@ -0,0 +1,70 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_uuid_array = require('postgres.decode.uuid_array')
+
+function testcase.uuid_array()
+    -- test that decode uuid[] value to array of 16 bytes binary string
+    local v, err = decode_uuid_array(
+                       '{a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11,NULL,A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A12}')
+    assert.is_nil(err)
+    assert.equal(v, {
+        '\160\238\188\153\156\011\078\248\187\109\107\185\189\056\010\017',
+        nil,
+        '\160\238\188\153\156\011\078\248\187\109\107\185\189\056\010\018',
+    })
+
+    -- test that decode uuid[] value to array of canonical lowercase text
+    v, err = decode_uuid_array(
+                 '{ A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11 , a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a12 }',
+                 true)
+    assert.is_nil(err)
+    assert.equal(v, {
+        'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11',
+        'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a12',
+    })
+
+    -- test that the third argument is not used as the result table
+    local ctx = {}
+    v, err = decode_uuid_array('{a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11}', true,
+                               ctx)
+    assert.is_nil(err)
+    assert.not_rawequal(v, ctx)
+    assert.equal(v, {
+        'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11',
+    })
+    assert.equal(ctx, {})
+
+    -- test that decode empty array
+    v, err = decode_uuid_array('{}')
+    assert.is_nil(err)
+    assert.equal(v, {})
+
+    -- test that empty string error
+    v, err = decode_uuid_array('')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EINVAL)
+    assert.match(err, 'empty string')
+
+    -- test that opening curly bracket error
+    v, err = decode_uuid_array('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11}')
+    assert.is_nil(v)
+    assert.match(err, 'opening curly bracket not found')
+
+    -- test that illegal character error
+    for s, pos in pairs({
+        ['{a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11,}'] = "'}' at position 39",
+        ['{a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11}x'] = "'x' at position 39",
+        ['{abc}'] = "'}' at position 5",
+        ['{{a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11}}'] = "'{' at position 2",
+    }) do
+        v, err = decode_uuid_array(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, pos)
+    end
+
+    -- test that malformed array error
+    v, err = decode_uuid_array('{a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11')
+    assert.is_nil(v)
+    assert.match(err, 'malformed array string')
+end
@@ -0,0 +1,40 @@
+local testcase = require('testcase')
+local errno = require('errno')
+local decode_uuid = require('postgres.decode.uuid')
+
+function testcase.uuid()
+    -- test that decode uuid value to 16 bytes binary string
+    local v, err = decode_uuid('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11')
+    assert.is_nil(err)
+    assert.equal(v,
+                 '\160\238\188\153\156\011\078\248\187\109\107\185\189\056\010\017')
+
+    -- test that decode uuid value to canonical lowercase text
+    v, err = decode_uuid('A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11', true)
+    assert.is_nil(err)
+    assert.equal(v, 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11')
+
+    -- test that empty string error
+    v, err = decode_uuid('')
+    assert.is_nil(v)
+    assert.equal(err.type, errno.EINVAL)
+    assert.match(err, 'empty string')
+
+    -- test that illegal character error
+    for s, pos in pairs({
+        ['g0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'] = "'g' at position 1",
+        ['a0eebc99x9c0b-4ef8-bb6d-6bb9bd380a11'] = "'x' at position 9",
+        ['a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a1-'] = "'-' at position 36",
+        ['a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11 '] = "' ' at position 37",
+    }) do
+        v, err = decode_uuid(s)
+        assert.is_nil(v)
+        assert.equal(err.type, errno.EILSEQ)
+        assert.match(err, pos)
+    end
+
+    -- test that invalid length error
+    v, err = decode_uuid('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a1')
+    assert.is_nil(v)
+    assert.match(err, 'must be 36 characters')
+end
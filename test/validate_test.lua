@@ -0,0 +1,234 @@
+local testcase = require('testcase')
+local validate = require('postgres.decode.validate')
+local decode = require('postgres.decode')
+
+function testcase.validate()
+    -- test that validate the value by the grammar of the type
+    for _, v in ipairs({
+        {
+            type = 'int',
+            str = '-123',
+        },
+        {
+            type = 'int',
+            str = '12x',
+            pos = 3,
+        },
+        {
+            type = 'float',
+            str = '1.5e3',
+        },
+        {
+            type = 'bool',
+            str = 'tt',
+            pos = 2,
+        },
+        {
+            type = 'bytea',
+            str = '\\x0g',
+            pos = 4,
+        },
+        {
+            type = 'date',
+            str = '2020-13-02',
+            pos = 7,
+        },
+        {
+            type = 'time',
+            str = '12:34:56.123456+09:30',
+        },
+        {
+            type = 'timestamp',
+            str = '2020-01-02 03:04:05-08',
+        },
+        {
+            type = 'timestamp',
+            str = '2020-01-02T03:04:05',
+            pos = 11,
+        },
+        {
+            type = 'box',
+            str = '(1,2),(3,4)',
+        },
+        {
+            type = 'polygon',
+            str = '((1,2),(3,4)',
+            pos = 13,
+        },
+        {
+            type = 'hstore',
+            str = '"a"=>"1", "b"=>NULL',
+        },
+        {
+            type = 'hstore',
+            str = '"a"=>NUL',
+            pos = 9,
+        },
+        {
+            type = 'tsvector',
+            str = '\'a\' \'b\':1,2A \'c\'\'d\':3',
+        },
+        {
+            type = 'tsvector',
+            str = '\'a\':1D',
+            pos = 6,
+        },
+        {
+            type = 'array',
+            str = '{1,{2,NULL},"a\\"b"}',
+        },
+        {
+            type = 'array',
+            str = '{1,,2}',
+            pos = 4,
+        },
+        {
+            type = 'range',
+            str = '[1,2)',
+        },
+        {
+            type = 'range',
+            str = '[1,2)x',
+            pos = 6,
+        },
+        {
+            type = 'multirange',
+            str = '{[1,2), empty}',
+        },
+        {
+            type = 'multirange',
+            str = '{}',
+        },
+        {
+            type = 'multirange',
+            str = ' { } ',
+        },
+        {
+            type = 'multirange',
+            str = '{} x',
+            pos = 4,
+        },
+        {
+            type = 'multirange',
+            str = '{,}',
+            pos = 2,
+        },
+        {
+            type = 'int',
+            str = '',
+            pos = 1,
+        },
+    }) do
+        local ok, pos = validate(v.type, v.str)
+        if v.pos then
+            assert.is_false(ok)
+            assert.equal(pos, v.pos)
+        else
+            assert.is_true(ok)
+            assert.is_nil(pos)
+        end
+    end
+
+    -- test that validate the elements by the element type
+    local ok, pos = validate('array', '{1,{2,NULL}}', 'int')
+    assert.is_true(ok)
+    assert.is_nil(pos)
+    ok, pos = validate('array', '{1,{2x,NULL}}', 'int')
+    assert.is_false(ok)
+    assert.equal(pos, 6)
+    ok, pos = validate('array', '{"2020-01-02 03:04:05","2020-01-0x 03:04:05"}',
+                       'timestamp')
+    assert.is_false(ok)
+    assert.equal(pos, 34)
+    ok, pos = validate('array', '{(1,2),(3,4);(5,6),(7,8)}', 'box', ';')
+    assert.is_true(ok)
+    assert.is_nil(pos)
+    ok, pos = validate('range', '[1,2x)', 'int')
+    assert.is_false(ok)
+    assert.equal(pos, 5)
+
+    -- test that throws an error if the type name is unknown
+    local err = assert.throws(validate, 'foo', '1')
+    assert.match(err, 'unknown type name')
+
+    -- test that throws an error if the element type is invalid
+    err = assert.throws(validate, 'int', '1', 'int')
+    assert.match(err, 'only available for container types')
+    err = assert.throws(validate, 'array', '{}', 'array')
+    assert.match(err, 'must not be a container type')
+
+    -- test that throws an error if the delimiter is invalid
+    err = assert.throws(validate, 'array', '{}', 'int', ',,')
+    assert.match(err, 'delimiter must be a single character')
+end
+
+function testcase.validate_oid()
+    -- test that validate the value by the type oid
+    for _, v in ipairs({
+        {
+            oid = 23,
+            str = '1x',
+            exp = false,
+        },
+        {
+            oid = 1007,
+            str = '{1,x}',
+            exp = false,
+        },
+        {
+            oid = 1009,
+            str = '{1,x}',
+            exp = true,
+        },
+        {
+            oid = 3908,
+            str = '["2020-01-02 03:04:05",)',
+            exp = true,
+        },
+        {
+            -- json has no validator, so it is validated by decoding it
+            oid = 114,
+            str = '{"a":}',
+            exp = false,
+        },
+        {
+            -- unknown type is always valid
+            oid = 99999,
+            str = 'x',
+            exp = true,
+        },
+    }) do
+        assert.equal(decode.validate(v.oid, v.str), v.exp)
+    end
+
+    -- test that the multirange types are validated by the validator with
+    -- the subtype
+    local ok, pos = decode.validate(4451, '{[1,3),[5,7]}')
+    assert.is_true(ok)
+    assert.is_nil(pos)
+    ok, pos = decode.validate(4451, '{[1,3),[5,x]}')
+    assert.is_false(ok)
+    assert.equal(pos, 11)
+
+    -- test that the arrays of the range types are validated by the
+    -- structure only
+    ok, pos = decode.validate(3905, '{"[1,10)","[1,x)",empty}')
+    assert.is_true(ok)
+    assert.is_nil(pos)
+    ok, pos = decode.validate(3905, '{"[1,10)",,empty}')
+    assert.is_false(ok)
+    assert.equal(pos, 11)
+
+    -- test that the position is returned if the value is validated by
+    -- decoding it and the error has the position
+    ok, pos = decode.validate(114, '{"a":}')
+    assert.is_false(ok)
+    assert.equal(pos, 6)
+    ok, pos = decode.validate(114, '')
+    assert.is_false(ok)
+    assert.is_nil(pos)
+
+    -- test that the error object is returned by decode.decode after that
+    local _, err = decode.decode(114, '{"a":}')
+    assert.match(err, "'}' at position 6")
+end